@@ -0,0 +1,128 @@
+#include "Benchmark.h"
+
+#include <smartjson/sj_parser.hpp>
+#include <cstdlib>
+
+void BenchmarkRunner::printResult(const Result &result) const
+{
+    if (result.unit == "ray")
+    {
+        printf("%-40s %12.2f ns/%-8s %12.4f Mrays/s\n", result.name.c_str(),
+            result.nsPerOp, result.unit.c_str(), 1e3 / result.nsPerOp);
+    }
+    else
+    {
+        printf("%-40s %12.2f ns/%-8s\n", result.name.c_str(), result.nsPerOp, result.unit.c_str());
+    }
+}
+
+bool BenchmarkRunner::check(const std::string &name, bool ok, const char *format, ...)
+{
+    printf("%-40s %-8s ", name.c_str(), ok ? "ok" : "FAILED");
+
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    printf("\n");
+
+    if (!ok)
+    {
+        ++nFailures_;
+    }
+    return ok;
+}
+
+bool BenchmarkRunner::writeJSON(const std::string &path, const std::string &isa) const
+{
+    FILE *fp = fopen(path.c_str(), "w");
+    if (fp == nullptr)
+    {
+        return false;
+    }
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "    \"seed\": %u,\n", seed_);
+    fprintf(fp, "    \"min_time\": %g,\n", minTime_);
+    fprintf(fp, "    \"repeats\": %d,\n", nRepeats_);
+    fprintf(fp, "    \"isa\": \"%s\",\n", isa.c_str());
+    fprintf(fp, "    \"results\": [\n");
+    for (size_t i = 0; i < results_.size(); ++i)
+    {
+        const Result &result = results_[i];
+        fprintf(fp, "        { \"name\": \"%s\", \"unit\": \"%s\", \"ns_per_op\": %.4f, \"ops\": %llu, \"checksum\": %llu",
+            result.name.c_str(), result.unit.c_str(), result.nsPerOp,
+            (unsigned long long)result.nOps, (unsigned long long)result.checksum);
+        if (result.unit == "ray")
+        {
+            fprintf(fp, ", \"mrays_per_sec\": %.4f", 1e3 / result.nsPerOp);
+        }
+        fprintf(fp, " }%s\n", i + 1 < results_.size() ? "," : "");
+    }
+    fprintf(fp, "    ]\n");
+    fprintf(fp, "}\n");
+
+    fclose(fp);
+    return true;
+}
+
+void BenchmarkRunner::checkJSON(const std::string &path, const std::string &isa)
+{
+    const char *name = "check/json";
+    if (!isChecking(name))
+    {
+        return;
+    }
+
+    if (!writeJSON(path, isa))
+    {
+        check(name, false, "failed to write '%s'", path.c_str());
+        return;
+    }
+
+    mjson::Parser parser;
+    bool ok = parser.parseFromFile(path.c_str());
+    remove(path.c_str());
+    if (!ok)
+    {
+        check(name, false, "parse error %d at %d", parser.getErrorCode(), parser.getErrorOffset());
+        return;
+    }
+
+    mjson::Node nodes = parser.getRoot()["results"];
+    size_t nMismatches = nodes.isArray() && nodes.size() == results_.size() ? 0 : 1;
+    for (size_t i = 0; nMismatches == 0 && i < results_.size(); ++i)
+    {
+        if (nodes[i]["name"].asStdString() != results_[i].name ||
+            nodes[i]["checksum"].asInt64() != int64_t(results_[i].checksum))
+        {
+            ++nMismatches;
+        }
+    }
+    check(name, nMismatches == 0, "%d results", int(results_.size()));
+}
+
+bool BenchmarkRunner::parseOption(const char *arg, const char *value)
+{
+    if (strcmp(arg, "--filter") == 0)
+    {
+        filter_ = value;
+    }
+    else if (strcmp(arg, "--min-time") == 0)
+    {
+        minTime_ = atof(value);
+    }
+    else if (strcmp(arg, "--repeats") == 0)
+    {
+        nRepeats_ = std::max(1, atoi(value));
+    }
+    else if (strcmp(arg, "--seed") == 0)
+    {
+        seed_ = (uint32_t)strtoul(value, nullptr, 10);
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdarg>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+/** 微基准测试的运行器。
+ *  每个测试先调用一次估计耗时，再重复若干轮，取每轮平均耗时的中位数。
+ *  测试函数返回一个计数(比如相交的次数)，用于防止编译器把计算优化掉，也会输出到结果中。
+ *  自检模式下每个测试只调用一次，另外运行各组的正确性检查(名字以check/开头)，有检查失败时main返回非0。
+ */
+class BenchmarkRunner
+{
+public:
+    struct Result
+    {
+        std::string name;
+        /// 操作的单位，比如ray、triangle、box。单位是ray时额外输出Mrays/s
+        std::string unit;
+        double      nsPerOp;
+        size_t      nOps;
+        /// 第一次调用fun的返回值
+        size_t      checksum;
+    };
+
+    /// 每个测试至少运行的时间(秒)
+    double      minTime_ = 0.5;
+    /// 计时的轮数
+    int         nRepeats_ = 5;
+    /// 随机数种子。每组测试都用它重新初始化随机数，保证数据与运行哪些测试无关
+    uint32_t    seed_ = 12345;
+    /// 只运行名字中包含此字符串的测试
+    std::string filter_;
+    /// 自检模式
+    bool        checkMode_ = false;
+
+    bool isEnabled(const std::string &name) const
+    {
+        return filter_.empty() || name.find(filter_) != std::string::npos;
+    }
+
+    /** 名字以group/或check/group/开头的一组测试(比如render)中，是否可能有需要运行的。用于跳过整组测试的准备工作。*/
+    bool isGroupEnabled(const std::string &group) const
+    {
+        return isEnabled(group + "/") || isEnabled("check/" + group + "/") || filter_.find(group) != std::string::npos;
+    }
+
+    /** 是否需要运行名为name的检查。*/
+    bool isChecking(const std::string &name) const
+    {
+        return checkMode_ && isEnabled(name);
+    }
+
+    /** 输出一项检查的结果，ok为false时计入失败的数量。format是附加的说明，格式与printf相同。*/
+    bool check(const std::string &name, bool ok, const char *format, ...);
+
+    int getFailureCount() const { return nFailures_; }
+
+    /** 运行一个测试。
+     *  @param opsPerCall   每次调用fun执行的操作数量
+     *  @param fun          size_t fun()
+     */
+    template<typename Fun>
+    void run(const std::string &name, const std::string &unit, size_t opsPerCall, Fun fun)
+    {
+        if (!isEnabled(name))
+        {
+            return;
+        }
+
+        // 预热，同时估计单次调用的耗时。第一次调用的返回值作为校验值，与计时的轮数无关
+        size_t checksum = 0;
+        double first = timeCalls(fun, 1, checksum);
+        if (checkMode_)
+        {
+            // 自检只确认测试能够运行，耗时没有参考价值
+            Result result = { name, unit, first / opsPerCall * 1e9, opsPerCall, checksum };
+            results_.push_back(result);
+            printResult(result);
+            return;
+        }
+
+        size_t nCalls = std::max<size_t>(1, size_t(minTime_ / nRepeats_ / std::max(first, 1e-9)));
+        int nRepeats = first >= minTime_ ? 1 : nRepeats_;
+
+        std::vector<double> samples;
+        for (int i = 0; i < nRepeats; ++i)
+        {
+            size_t sum = 0;
+            samples.push_back(timeCalls(fun, nCalls, sum) / double(nCalls * opsPerCall));
+            sink_ += sum;
+        }
+        std::sort(samples.begin(), samples.end());
+
+        Result result;
+        result.name = name;
+        result.unit = unit;
+        result.nsPerOp = samples[samples.size() / 2] * 1e9;
+        result.nOps = nCalls * opsPerCall * nRepeats;
+        result.checksum = checksum;
+        results_.push_back(result);
+
+        printResult(result);
+    }
+
+    const std::vector<Result>& getResults() const { return results_; }
+
+    void printResult(const Result &result) const;
+
+    /** 以json格式输出所有结果。*/
+    bool writeJSON(const std::string &path, const std::string &isa) const;
+
+    /** 自检：把结果写到path，再读回来确认每个结果都在，检查结束后删除文件。*/
+    void checkJSON(const std::string &path, const std::string &isa);
+
+    /** 解析各个测试程序共用、带一个参数的选项：--filter、--min-time、--repeats、--seed。不是这些选项时返回false。*/
+    bool parseOption(const char *arg, const char *value);
+
+private:
+    template<typename Fun>
+    static double timeCalls(Fun &fun, size_t nCalls, size_t &checksum)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < nCalls; ++i)
+        {
+            checksum += fun();
+        }
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::vector<Result> results_;
+    volatile size_t     sink_ = 0;
+    int                 nFailures_ = 0;
+};
+
+/** 两个浮点数逐位相同。与==不同，区分+0和-0。*/
+inline bool sameBits(float a, float b)
+{
+    return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+/** 各组测试。定义在各自的cpp中。*/
+void benchRay(BenchmarkRunner &runner);
+void benchMatrix(BenchmarkRunner &runner);
+void benchMesh(BenchmarkRunner &runner, size_t maxTriangles);
+void benchCompression(BenchmarkRunner &runner);
+void benchTransform(BenchmarkRunner &runner);
+void benchSpatial(BenchmarkRunner &runner);
+void benchOcclusion(BenchmarkRunner &runner);
+void benchTrace(BenchmarkRunner &runner);
+void benchProfiler(BenchmarkRunner &runner);
@@ -0,0 +1,224 @@
+#include "Benchmark.h"
+#include "Compression.h"
+
+#include <random>
+
+namespace
+{
+    /// 解压缓冲区末尾的保护字节，解压不能写到dstSize之后
+    const size_t GuardSize = 16;
+    const uint8_t GuardByte = 0xcd;
+
+    /** 解压到带保护字节的缓冲区中，保护字节被改写时guardOk为false。*/
+    bool decompressGuarded(const std::vector<uint8_t> &compressed, size_t dstSize, std::vector<uint8_t> &out, bool &guardOk)
+    {
+        out.assign(dstSize + GuardSize, GuardByte);
+        bool ok = decompressLZ(compressed.data(), compressed.size(), out.data(), dstSize);
+        guardOk = std::all_of(out.begin() + dstSize, out.end(), [](uint8_t b){ return b == GuardByte; });
+        out.resize(dstSize);
+        return ok;
+    }
+
+    /** 各种长度和内容的测试数据：随机字节、全0、短周期的重复(匹配与输出重叠)、
+     *  超过最大匹配距离的重复，以及字节重排之后的浮点网格。
+     */
+    std::vector<std::vector<uint8_t>> makeInputs(std::mt19937 &random)
+    {
+        std::uniform_int_distribution<int> byte(0, 255);
+        std::vector<std::vector<uint8_t>> inputs;
+        const size_t sizes[] = { 0, 1, 4, 5, 9, 10, 15, 16, 19, 20, 255, 270, 4096 };
+        for (size_t size : sizes)
+        {
+            std::vector<uint8_t> data(size);
+            for (uint8_t &b : data)
+            {
+                b = uint8_t(byte(random));
+            }
+            inputs.push_back(data);
+            inputs.push_back(std::vector<uint8_t>(size, 0));
+        }
+
+        for (size_t period = 1; period <= 7; ++period)
+        {
+            std::vector<uint8_t> data(3000 + period);
+            for (size_t i = 0; i < data.size(); ++i)
+            {
+                data[i] = i < period ? uint8_t(byte(random)) : data[i - period];
+            }
+            inputs.push_back(data);
+        }
+
+        // 两段相同的随机数据相距70000字节，超出了匹配距离
+        std::vector<uint8_t> far(150000);
+        for (size_t i = 0; i < far.size(); ++i)
+        {
+            far[i] = i < 70000 ? uint8_t(byte(random)) : far[i - 70000];
+        }
+        inputs.push_back(far);
+
+        // 高度随机的网格顶点，每个顶点3个float
+        std::uniform_real_distribution<float> height(-1.0f, 1.0f);
+        std::vector<float> grid;
+        for (int z = 0; z < 64; ++z)
+        {
+            for (int x = 0; x < 64; ++x)
+            {
+                grid.push_back(float(x));
+                grid.push_back(height(random));
+                grid.push_back(float(z));
+            }
+        }
+        std::vector<uint8_t> shuffled(grid.size() * sizeof(float));
+        shuffleBytes((const uint8_t*)grid.data(), shuffled.size(), sizeof(float) * 3, shuffled.data());
+        inputs.push_back(shuffled);
+        return inputs;
+    }
+
+    /** 压缩后解压要得到原始数据；目标大小不对、压缩数据被截断时返回false；
+     *  压缩数据被随机改写时可以返回任意结果，但不能写到目标缓冲区之外。
+     */
+    void checkLZ(BenchmarkRunner &runner)
+    {
+        const char *name = "check/compression/lz";
+        if (!runner.isChecking(name))
+        {
+            return;
+        }
+
+        std::mt19937 checkRandom(runner.seed_);
+        std::vector<std::vector<uint8_t>> inputs = makeInputs(checkRandom);
+
+        size_t nErrors = 0, nCorruptions = 0, nGuardErrors = 0;
+        size_t totalSize = 0, totalCompressed = 0;
+        std::vector<uint8_t> out;
+        bool guardOk;
+        for (const std::vector<uint8_t> &data : inputs)
+        {
+            std::vector<uint8_t> compressed;
+            compressLZ(data.data(), data.size(), compressed);
+            totalSize += data.size();
+            totalCompressed += compressed.size();
+
+            // 不可压缩的数据最多增加每255字节1字节的长度和一个标记字节
+            nErrors += compressed.size() <= data.size() + data.size() / 255 + 16 ? 0 : 1;
+
+            bool ok = decompressGuarded(compressed, data.size(), out, guardOk);
+            nErrors += ok && out == data ? 0 : 1;
+            nGuardErrors += guardOk ? 0 : 1;
+
+            ok = decompressGuarded(compressed, data.size() + 1, out, guardOk);
+            nErrors += ok ? 1 : 0;
+            nGuardErrors += guardOk ? 0 : 1;
+            if (!data.empty())
+            {
+                ok = decompressGuarded(compressed, data.size() - 1, out, guardOk);
+                nErrors += ok ? 1 : 0;
+                nGuardErrors += guardOk ? 0 : 1;
+            }
+
+            for (int i = 0; i < 32 && !data.empty(); ++i)
+            {
+                std::vector<uint8_t> corrupted = compressed;
+                size_t pos = std::uniform_int_distribution<size_t>(0, corrupted.size() - 1)(checkRandom);
+                bool truncate = (i & 1) != 0;
+                if (truncate)
+                {
+                    corrupted.resize(pos);
+                }
+                else
+                {
+                    corrupted[pos] = uint8_t(checkRandom());
+                }
+                ok = decompressGuarded(corrupted, data.size(), out, guardOk);
+                nErrors += truncate && ok ? 1 : 0;
+                nGuardErrors += guardOk ? 0 : 1;
+                ++nCorruptions;
+            }
+        }
+
+        // 字节重排可以还原，长度不是stride的整数倍时末尾原样保留
+        for (size_t stride = 1; stride <= 44; ++stride)
+        {
+            const std::vector<uint8_t> &data = inputs[inputs.size() - 2];
+            size_t size = std::min(data.size(), stride * 100 + stride / 2);
+            std::vector<uint8_t> shuffled(size), restored(size);
+            shuffleBytes(data.data(), size, stride, shuffled.data());
+            unshuffleBytes(shuffled.data(), size, stride, restored.data());
+            nErrors += std::equal(restored.begin(), restored.end(), data.begin()) ? 0 : 1;
+        }
+
+        runner.check(name, nErrors == 0 && nGuardErrors == 0, "%d inputs, %d corruptions, ratio: %.3f, errors: %d, out of bounds writes: %d",
+            (int)inputs.size(), (int)nCorruptions, double(totalCompressed) / double(totalSize), (int)nErrors, (int)nGuardErrors);
+    }
+
+    /** 与Compressed缓冲区相同的数据：256x256的地形网格，每个顶点是位置、法线、纹理坐标和切线共12个float，按顶点字节重排。*/
+    std::vector<uint8_t> makeMeshData(std::mt19937 &random)
+    {
+        const int nGrids = 256;
+        const size_t stride = 12 * sizeof(float);
+        std::uniform_real_distribution<float> height(-1.0f, 1.0f);
+        std::vector<float> vertices;
+        for (int z = 0; z <= nGrids; ++z)
+        {
+            for (int x = 0; x <= nGrids; ++x)
+            {
+                const float v[12] = { float(x), height(random), float(z), 0.0f, 1.0f, 0.0f,
+                    float(x) / nGrids, float(z) / nGrids, 1.0f, 0.0f, 0.0f, 0.0f };
+                vertices.insert(vertices.end(), v, v + 12);
+            }
+        }
+        std::vector<uint8_t> shuffled(vertices.size() * sizeof(float));
+        shuffleBytes((const uint8_t*)vertices.data(), shuffled.size(), stride, shuffled.data());
+        return shuffled;
+    }
+
+    /** 压缩和解压的吞吐量，单位是每KB原始数据的耗时。*/
+    void benchLZ(BenchmarkRunner &runner, const std::string &name, const std::vector<uint8_t> &data)
+    {
+        std::vector<uint8_t> compressed;
+        compressLZ(data.data(), data.size(), compressed);
+
+        const size_t nKB = std::max<size_t>(1, data.size() / 1024);
+        std::vector<uint8_t> encoded;
+        encoded.reserve(compressed.capacity());
+        runner.run("compression/lz/encode/" + name, "KB", nKB, [&]()
+        {
+            encoded.clear();
+            compressLZ(data.data(), data.size(), encoded);
+            return encoded.size();
+        });
+        if (runner.isEnabled("compression/lz/encode/" + name))
+        {
+            printf("    %d -> %d bytes\n", (int)data.size(), (int)compressed.size());
+        }
+
+        std::vector<uint8_t> decoded(data.size());
+        runner.run("compression/lz/decode/" + name, "KB", nKB, [&]()
+        {
+            bool ok = decompressLZ(compressed.data(), compressed.size(), decoded.data(), decoded.size());
+            return ok ? size_t(decoded[decoded.size() / 2]) : 0;
+        });
+    }
+}
+
+void benchCompression(BenchmarkRunner &runner)
+{
+    checkLZ(runner);
+
+    if (!runner.isGroupEnabled("compression"))
+    {
+        return;
+    }
+
+    // 重排之后的网格是Compressed缓冲区的典型数据，随机字节不可压缩，是压缩最慢的情况
+    std::mt19937 random(runner.seed_);
+    std::vector<uint8_t> mesh = makeMeshData(random);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::vector<uint8_t> noise(mesh.size());
+    for (uint8_t &b : noise)
+    {
+        b = uint8_t(byte(random));
+    }
+    benchLZ(runner, "mesh", mesh);
+    benchLZ(runner, "random", noise);
+}
@@ -0,0 +1,318 @@
+#include "Benchmark.h"
+#include "Matrix.h"
+#include "Vector4.h"
+
+#include <random>
+#include <cmath>
+
+namespace
+{
+    /// 每次调用测试的数据量
+    const size_t BatchSize = 1024;
+
+    Vector3 randomVector(std::mt19937 &random, float range)
+    {
+        std::uniform_real_distribution<float> dist(-range, range);
+        float x = dist(random);
+        float y = dist(random);
+        float z = dist(random);
+        return Vector3(x, y, z);
+    }
+
+    /** 随机的缩放、旋转、平移矩阵。*/
+    Matrix randomMatrix(std::mt19937 &random)
+    {
+        std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+        Vector3 angles = randomVector(random, PI_FULL);
+
+        Matrix s, r, t;
+        s.setScale(scale(random), scale(random), scale(random));
+        r.setRotate(angles.x, angles.y, angles.z);
+        t.setTranslate(randomVector(random, 10.0f));
+        return s * r * t;
+    }
+
+    /** 标量的参考实现，公式和运算顺序与Matrix.cpp中不使用SIMD时相同。*/
+    void multiplyReference(Matrix &out, const Matrix &m1, const Matrix &m2)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                out.m[i][j] = m1.m[i][0] * m2.m[0][j] + m1.m[i][1] * m2.m[1][j] + m1.m[i][2] * m2.m[2][j] + m1.m[i][3] * m2.m[3][j];
+            }
+        }
+    }
+
+    bool invertReference(Matrix &out, const Matrix &matrix)
+    {
+        float determinant = matrix.getDeterminant();
+        if (determinant == 0.f)
+        {
+            out.setIdentity();
+            return false;
+        }
+
+        float rcp = 1 / determinant;
+        const float (*a)[4] = matrix.m;
+        float adjoint[3][3] = {
+            { a[1][1] * a[2][2] - a[1][2] * a[2][1], a[0][2] * a[2][1] - a[0][1] * a[2][2], a[0][1] * a[1][2] - a[0][2] * a[1][1] },
+            { a[1][2] * a[2][0] - a[1][0] * a[2][2], a[0][0] * a[2][2] - a[0][2] * a[2][0], a[0][2] * a[1][0] - a[0][0] * a[1][2] },
+            { a[1][0] * a[2][1] - a[1][1] * a[2][0], a[0][1] * a[2][0] - a[0][0] * a[2][1], a[0][0] * a[1][1] - a[0][1] * a[1][0] },
+        };
+        for (int i = 0; i < 3; ++i)
+        {
+            for (int j = 0; j < 3; ++j)
+            {
+                out.m[i][j] = adjoint[i][j] * rcp;
+            }
+            out.m[i][3] = 0.0f;
+        }
+        for (int j = 0; j < 3; ++j)
+        {
+            out.m[3][j] = -(a[3][0] * out.m[0][j] + a[3][1] * out.m[1][j] + a[3][2] * out.m[2][j]);
+        }
+        out.m[3][3] = 1.0f;
+        return true;
+    }
+
+    Vector4 transformReference(const Matrix &mat, const Vector4 &p)
+    {
+        const float (*a)[4] = mat.m;
+        Vector4 ret;
+        ret.x = p.x * a[0][0] + p.y * a[1][0] + p.z * a[2][0] + p.w * a[3][0];
+        ret.y = p.x * a[0][1] + p.y * a[1][1] + p.z * a[2][1] + p.w * a[3][1];
+        ret.z = p.x * a[0][2] + p.y * a[1][2] + p.z * a[2][2] + p.w * a[3][2];
+        ret.w = p.x * a[0][3] + p.y * a[1][3] + p.z * a[2][3] + p.w * a[3][3];
+        return ret;
+    }
+
+    /** 与参考结果对比。误差按参考值的大小缩放，超过tolerance计入失败；不是逐位相同的单独统计。*/
+    struct Comparison
+    {
+        size_t  nValues = 0;
+        size_t  nDifferent = 0;
+        size_t  nFailures = 0;
+        float   maxError = 0.0f;
+
+        void compare(const float *values, const float *expected, size_t count, float tolerance = 1e-6f)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                float error = std::fabs(values[i] - expected[i]) / std::max(1.0f, std::fabs(expected[i]));
+                maxError = std::max(maxError, error);
+                nFailures += error <= tolerance ? 0 : 1;
+                nDifferent += sameBits(values[i], expected[i]) ? 0 : 1;
+            }
+            nValues += count;
+        }
+
+        void compare(const Matrix &value, const Matrix &expected) { compare(value.m[0], expected.m[0], 16); }
+        void compare(const Vector3 &value, const Vector3 &expected) { compare(&value.x, &expected.x, 3); }
+        void compare(bool value, bool expected) { ++nValues; nFailures += value == expected ? 0 : 1; }
+    };
+
+    /** 随机矩阵之外，容易出错的情况：没有平移、90度旋转、不可逆矩阵、投影矩阵。*/
+    std::vector<Matrix> createCheckMatrices(std::mt19937 &random)
+    {
+        std::vector<Matrix> matrices;
+        for (int i = 0; i < 256; ++i)
+        {
+            matrices.push_back(randomMatrix(random));
+        }
+
+        Matrix mat;
+        for (int i = 0; i < 4; ++i)
+        {
+            Matrix rotation;
+            rotation.setRotateX(PI_HALF * i);
+            matrices.push_back(rotation);
+            rotation.setRotateY(PI_HALF * i);
+            matrices.push_back(rotation);
+            rotation.setRotate(PI_HALF * i, PI_FULL, -PI_HALF);
+            matrices.push_back(rotation);
+
+            mat.setScale(2.0f, 0.5f, 4.0f);
+            matrices.push_back(mat * rotation);
+        }
+
+        matrices.push_back(Matrix::Identity);
+        mat.setScale(0.0f, 1.0f, 1.0f);
+        matrices.push_back(mat);
+        mat.setScale(1.0f, 1.0f, 0.0f);
+        mat._41 = 1.0f;
+        mat._42 = 2.0f;
+        mat._43 = 3.0f;
+        matrices.push_back(mat);
+
+        Matrix view, projection;
+        view.lookAt(Vector3(3.0f, 4.0f, -10.0f), Vector3::Zero, Vector3(0.0f, 1.0f, 0.0f));
+        projection.perspectiveProjectionGL(PI_QUARTER, 1.5f, 0.1f, 100.0f);
+        matrices.push_back(projection);
+        matrices.push_back(view * projection);
+        return matrices;
+    }
+
+    /** 对比Matrix的实现与标量参考实现，以及批量变换与逐个变换。返回不一致的数量。*/
+    size_t checkMatrix(std::mt19937 &random, Comparison &comparison)
+    {
+        std::vector<Matrix> matrices = createCheckMatrices(random);
+
+        std::vector<Vector3> points(64);
+        for (Vector3 &p : points)
+        {
+            p = randomVector(random, 10.0f);
+        }
+
+        // 带间隔的顶点数据，与顶点缓冲区中的位置相同
+        struct Vertex
+        {
+            Vector3 position;
+            float   uv[2];
+        };
+        std::vector<Vertex> vertices(points.size());
+        for (size_t i = 0; i < points.size(); ++i)
+        {
+            vertices[i].position = points[i];
+        }
+
+        size_t nBatchMismatches = 0;
+        std::vector<Vector3> batch(points.size());
+        std::vector<Vector3> strided(points.size());
+        std::vector<Vector3> normals(points.size());
+        for (size_t i = 0; i < matrices.size(); ++i)
+        {
+            const Matrix &m1 = matrices[i];
+            const Matrix &m2 = matrices[matrices.size() - 1 - i];
+
+            Matrix result, expected;
+            result.multiply(m1, m2);
+            multiplyReference(expected, m1, m2);
+            comparison.compare(result, expected);
+
+            // 输出与输入相同
+            result = m1;
+            result.multiply(result, m2);
+            comparison.compare(result, expected);
+
+            bool invertible = result.invert(m1);
+            comparison.compare(invertible, invertReference(expected, m1));
+            comparison.compare(result, expected);
+
+            result = m1;
+            comparison.compare(result.invert(result), invertible);
+            comparison.compare(result, expected);
+
+            m1.transformPoints(batch.data(), points.data(), points.size());
+            m1.transformPoints(strided.data(), vertices.data(), sizeof(Vertex), vertices.size());
+            m1.transformNormals(normals.data(), points.data(), points.size());
+            for (size_t k = 0; k < points.size(); ++k)
+            {
+                Vector4 p = transformReference(m1, Vector4(points[k], 1.0f));
+                Vector3 point = m1.transformPoint(points[k]);
+                comparison.compare(point, Vector3(p.x / p.w, p.y / p.w, p.z / p.w));
+
+                Vector4 n = transformReference(m1, Vector4(points[k], 0.0f));
+                comparison.compare(m1.transformNormal(points[k]), Vector3(n.x, n.y, n.z));
+
+                // 批量变换对仿射矩阵省掉了除法，但结果应该与逐个变换相同
+                nBatchMismatches += (sameBits(batch[k].x, point.x) && sameBits(batch[k].y, point.y) && sameBits(batch[k].z, point.z)) ? 0 : 1;
+                nBatchMismatches += (sameBits(strided[k].x, point.x) && sameBits(strided[k].y, point.y) && sameBits(strided[k].z, point.z)) ? 0 : 1;
+                Vector3 normal = m1.transformNormal(points[k]);
+                nBatchMismatches += (sameBits(normals[k].x, normal.x) && sameBits(normals[k].y, normal.y) && sameBits(normals[k].z, normal.z)) ? 0 : 1;
+            }
+        }
+        return nBatchMismatches;
+    }
+
+    /** 统计结果中x分量为正的数量，作为校验值。SIMD与标量版本的结果是逐位相同的，校验值也相同。*/
+    size_t countPositive(const Vector3 *points, size_t count)
+    {
+        size_t n = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            n += points[i].x > 0.0f ? 1 : 0;
+        }
+        return n;
+    }
+}
+
+void benchMatrix(BenchmarkRunner &runner)
+{
+    std::mt19937 random(runner.seed_);
+
+    std::vector<Matrix> matrices(BatchSize);
+    for (Matrix &mat : matrices)
+    {
+        mat = randomMatrix(random);
+    }
+
+    std::vector<Vector3> points(BatchSize);
+    for (Vector3 &p : points)
+    {
+        p = randomVector(random, 10.0f);
+    }
+
+    std::vector<Matrix> results(BatchSize);
+    runner.run("matrix/multiply", "matrix", BatchSize, [&]()
+    {
+        for (size_t i = 0; i < BatchSize; ++i)
+        {
+            results[i].multiply(matrices[i], matrices[BatchSize - 1 - i]);
+        }
+        return size_t(results[0]._41 > 0.0f ? 1 : 0);
+    });
+
+    runner.run("matrix/invert", "matrix", BatchSize, [&]()
+    {
+        size_t nValid = 0;
+        for (size_t i = 0; i < BatchSize; ++i)
+        {
+            nValid += results[i].invert(matrices[i]) ? 1 : 0;
+        }
+        return nValid;
+    });
+
+    const Matrix &mat = matrices[0];
+    std::vector<Vector3> transformed(BatchSize);
+    runner.run("matrix/transformPoint", "point", BatchSize, [&]()
+    {
+        for (size_t i = 0; i < BatchSize; ++i)
+        {
+            transformed[i] = mat.transformPoint(points[i]);
+        }
+        return countPositive(transformed.data(), BatchSize);
+    });
+
+    runner.run("matrix/transformPoints", "point", BatchSize, [&]()
+    {
+        mat.transformPoints(transformed.data(), points.data(), BatchSize);
+        return countPositive(transformed.data(), BatchSize);
+    });
+
+    runner.run("matrix/transformNormal", "point", BatchSize, [&]()
+    {
+        for (size_t i = 0; i < BatchSize; ++i)
+        {
+            transformed[i] = mat.transformNormal(points[i]);
+        }
+        return countPositive(transformed.data(), BatchSize);
+    });
+
+    runner.run("matrix/transformNormals", "point", BatchSize, [&]()
+    {
+        mat.transformNormals(transformed.data(), points.data(), BatchSize);
+        return countPositive(transformed.data(), BatchSize);
+    });
+
+    if (runner.isChecking("check/matrix"))
+    {
+        std::mt19937 checkRandom(runner.seed_);
+        Comparison comparison;
+        size_t nBatchMismatches = checkMatrix(checkRandom, comparison);
+        runner.check("check/matrix", comparison.nFailures == 0 && nBatchMismatches == 0,
+            "%d values, max error: %.2e, not bit-exact: %d, failures: %d, batch mismatches: %d",
+            (int)comparison.nValues, comparison.maxError, (int)comparison.nDifferent,
+            (int)comparison.nFailures, (int)nBatchMismatches);
+    }
+}
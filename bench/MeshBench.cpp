@@ -0,0 +1,648 @@
+#include "Benchmark.h"
+#include "Mesh.h"
+#include "Vertex.h"
+#include "VertexBuffer.h"
+#include "VertexDeclaration.h"
+#include "MeshFaceVisitor.h"
+#include "AABB.h"
+#include "Ray.h"
+#include "TraceManager.h"
+#include "TriangleBuffer.h"
+#include "MeshOptimizer.h"
+#include "VertexPacking.h"
+#include "MathDef.h"
+
+#include <random>
+#include <cmath>
+#include <cfloat>
+#include <array>
+
+namespace
+{
+    /// 射线的数量。网格越大，每条射线越慢，少量射线循环使用即可
+    const size_t NumRays = 1024;
+
+    /** 生成一个起伏的地形网格，三角形数量约为nTriangles。
+     *  只创建CPU端的缓冲区，不需要GL上下文。
+     */
+    MeshPtr createTerrain(std::mt19937 &random, size_t nTriangles, float size)
+    {
+        int nGrids = std::max(1, (int)std::ceil(std::sqrt(double(nTriangles) / 2.0)));
+        int nVertices = nGrids + 1;
+        float gridSize = size / float(nGrids);
+
+        std::uniform_real_distribution<float> height(-1.0f, 1.0f);
+
+        std::vector<MeshVertex> vertices(nVertices * nVertices);
+        for (int z = 0; z < nVertices; ++z)
+        {
+            for (int x = 0; x < nVertices; ++x)
+            {
+                MeshVertex &v = vertices[z * nVertices + x];
+                v.position.set(x * gridSize - size * 0.5f, height(random), z * gridSize - size * 0.5f);
+                v.normal.set(0.0f, 1.0f, 0.0f);
+                v.uv.set(float(x) / nGrids, float(z) / nGrids);
+                v.tangent.set(1.0f, 0.0f, 0.0f);
+            }
+        }
+
+        std::vector<uint32_t> indices;
+        indices.reserve(nGrids * nGrids * 6);
+        for (int z = 0; z < nGrids; ++z)
+        {
+            for (int x = 0; x < nGrids; ++x)
+            {
+                uint32_t a = z * nVertices + x;
+                uint32_t b = a + nVertices;
+                uint32_t c = a + 1;
+                uint32_t d = b + 1;
+
+                indices.push_back(a); indices.push_back(b); indices.push_back(c);
+                indices.push_back(c); indices.push_back(b); indices.push_back(d);
+            }
+        }
+
+        VertexBufferPtr vb = new VertexBufferEx<MeshVertex>(BufferUsage::Static, vertices.size(), vertices.data());
+        IndexBufferPtr ib = new IndexBufferEx<uint32_t>(BufferUsage::Static, indices.size(), indices.data());
+
+        MeshPtr mesh = new Mesh();
+        mesh->setVertexBuffer(vb);
+        mesh->setIndexBuffer(ib);
+
+        SubMeshPtr subMesh = new SubMesh();
+        subMesh->setPrimitive(PrimitiveType::TriangleList, 0, (uint32_t)indices.size(), 0, true);
+        mesh->addSubMesh(subMesh);
+        return mesh;
+    }
+
+    /** 从地形上方射向地形，绝大部分射线都会命中。*/
+    std::vector<Ray> createTerrainRays(std::mt19937 &random, float size)
+    {
+        std::uniform_real_distribution<float> position(-size * 0.5f, size * 0.5f);
+
+        std::vector<Ray> rays(NumRays);
+        for (Ray &ray : rays)
+        {
+            ray.origin_.set(position(random), 10.0f, position(random));
+            Vector3 target(position(random) * 0.5f, 0.0f, position(random) * 0.5f);
+            ray.direction_ = target - ray.origin_;
+            ray.direction_.normalize();
+        }
+        return rays;
+    }
+
+    /** TriangleBuffer的求交与逐个三角形调用Ray::intersectTriangle的结果逐位对比。返回不一致的数量。*/
+    size_t compareTriangleBuffer(const Mesh *mesh, const std::vector<Ray> &rays, size_t &nHits)
+    {
+        TriangleBuffer buffer;
+        buffer.addMesh(mesh, Matrix::Identity);
+
+        VertexBufferPtr vb = mesh->getVertexBuffer();
+        IndexBufferPtr ib = mesh->getIndexBuffer();
+        const MeshVertex *vertices = (const MeshVertex*)vb->lock(true);
+        const uint32_t *indices = (const uint32_t*)ib->lock(true);
+        size_t nTriangles = ib->count() / 3;
+
+        size_t nMismatches = buffer.size() == nTriangles ? 0 : 1;
+        for (size_t r = 0; r < rays.size() && nMismatches == 0; ++r)
+        {
+            const Ray &ray = rays[r];
+            int closest = -1;
+            float tMax = FLT_MAX, closestU = 0.0f, closestV = 0.0f;
+            for (size_t i = 0; i < nTriangles; ++i)
+            {
+                const uint32_t *index = indices + i * 3;
+                float t = 0.0f, u = 0.0f, v = 0.0f;
+                bool hit = ray.intersectTriangle(vertices[index[0]].position, vertices[index[1]].position,
+                    vertices[index[2]].position, &t, &u, &v);
+
+                float bt = 0.0f, bu = 0.0f, bv = 0.0f;
+                bool bufferHit = buffer.intersectTriangle(uint32_t(i), ray, bt, bu, bv);
+                if (hit != bufferHit || (hit && (!sameBits(t, bt) || !sameBits(u, bu) || !sameBits(v, bv))))
+                {
+                    ++nMismatches;
+                }
+
+                if (hit && t < tMax)
+                {
+                    closest = int(i);
+                    tMax = t;
+                    closestU = u;
+                    closestV = v;
+                }
+            }
+
+            float t = FLT_MAX, u = 0.0f, v = 0.0f;
+            int index = buffer.intersect(ray, t, u, v);
+            if (index != closest || (closest >= 0 && (!sameBits(t, tMax) || !sameBits(u, closestU) || !sameBits(v, closestV))))
+            {
+                ++nMismatches;
+            }
+            if (buffer.intersectAny(ray, FLT_MAX) != (closest >= 0))
+            {
+                ++nMismatches;
+            }
+            nHits += closest >= 0 ? 1 : 0;
+        }
+
+        ib->unlock();
+        vb->unlock();
+        return nMismatches;
+    }
+
+    typedef std::array<float, 9> TrianglePositions;
+
+    /** 收集子模型的三角形顶点位置，旋转到最小的顶点在前(保持绕序)之后排序，
+     *  用于比较优化前后的三角形集合。
+     */
+    std::vector<TrianglePositions> collectTriangles(const Mesh *mesh, const SubMesh *subMesh)
+    {
+        VertexBufferPtr vb = mesh->getVertexBuffer();
+        IndexBufferPtr ib = mesh->getIndexBuffer();
+        const MeshVertex *vertices = (const MeshVertex*)vb->lock(true);
+        const char *indices = ib->lock(true);
+
+        std::vector<TrianglePositions> triangles;
+        for (uint32_t i = subMesh->start_; i + 2 < subMesh->start_ + subMesh->count_; i += 3)
+        {
+            std::array<Vector3, 3> p;
+            for (int k = 0; k < 3; ++k)
+            {
+                p[k] = vertices[Mesh::extractIndex(indices, int(ib->stride()), int(i + k))].position;
+            }
+            auto less = [](const Vector3 &a, const Vector3 &b)
+            {
+                return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z < b.z;
+            };
+            std::rotate(p.begin(), std::min_element(p.begin(), p.end(), less), p.end());
+
+            TrianglePositions t;
+            for (int k = 0; k < 3; ++k)
+            {
+                t[k * 3 + 0] = p[k].x;
+                t[k * 3 + 1] = p[k].y;
+                t[k * 3 + 2] = p[k].z;
+            }
+            triangles.push_back(t);
+        }
+
+        ib->unlock();
+        vb->unlock();
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    }
+
+    /** 地形的副本前面插入一个没有被引用的顶点，三角形分成两个子模型，然后执行optimizeMesh。
+     *  每个子模型的三角形集合和绕序不变；没有引用的顶点被去掉；顶点按第一次引用的顺序排列；
+     *  改用16位索引；ACMR要比地形按行生成的顺序低，并且与重新统计的结果一致。
+     */
+    void checkOptimizeMesh(BenchmarkRunner &runner, const std::string &name, const Mesh *terrain)
+    {
+        VertexBufferPtr vb = terrain->getVertexBuffer();
+        IndexBufferPtr ib = terrain->getIndexBuffer();
+        const MeshVertex *source = (const MeshVertex*)vb->lock(true);
+        std::vector<MeshVertex> vertices(source, source + vb->count());
+        vb->unlock();
+        const uint32_t *sourceIndices = (const uint32_t*)ib->lock(true);
+        std::vector<uint32_t> indices(sourceIndices, sourceIndices + ib->count());
+        ib->unlock();
+
+        MeshVertex unused = vertices[0];
+        unused.position.set(0.0f, 100.0f, 0.0f);
+        vertices.insert(vertices.begin(), unused);
+        for (uint32_t &index : indices)
+        {
+            ++index;
+        }
+
+        VertexDeclMgr::initInstance();
+        MeshPtr mesh = new Mesh();
+        mesh->setVertexDecl(VertexDeclMgr::instance()->get(MeshVertex::getType()));
+        mesh->setVertexBuffer(new VertexBufferEx<MeshVertex>(BufferUsage::Static, vertices.size(), vertices.data()));
+        mesh->setIndexBuffer(new IndexBufferEx<uint32_t>(BufferUsage::Static, indices.size(), indices.data()));
+        uint32_t split = uint32_t(indices.size() / 6 * 3);
+        uint32_t ranges[2][2] = { { 0, split }, { split, uint32_t(indices.size()) - split } };
+        for (auto &range : ranges)
+        {
+            SubMeshPtr subMesh = new SubMesh();
+            subMesh->setPrimitive(PrimitiveType::TriangleList, range[0], range[1], 0, true);
+            mesh->addSubMesh(subMesh);
+        }
+
+        std::vector<std::vector<TrianglePositions>> before;
+        for (const SubMeshPtr &subMesh : mesh->getSubMeshes())
+        {
+            before.push_back(collectTriangles(mesh.get(), subMesh.get()));
+        }
+
+        MeshOptimizeStats stats;
+        bool optimized = optimizeMesh(mesh.get(), &stats);
+
+        size_t nErrors = optimized ? 0 : 1;
+        for (size_t i = 0; optimized && i < before.size(); ++i)
+        {
+            nErrors += collectTriangles(mesh.get(), mesh->getSubMeshes()[i].get()) == before[i] ? 0 : 1;
+        }
+
+        // 顶点按第一次引用的顺序排列，每个新出现的序号都是下一个顶点
+        IndexBufferPtr newIB = mesh->getIndexBuffer();
+        size_t nVertices = mesh->getVertexBuffer()->count();
+        std::vector<uint32_t> newIndices(newIB->count());
+        const char *indexData = newIB->lock(true);
+        uint32_t next = 0;
+        for (size_t i = 0; i < newIndices.size(); ++i)
+        {
+            newIndices[i] = Mesh::extractIndex(indexData, int(newIB->stride()), int(i));
+            nErrors += newIndices[i] <= next ? 0 : 1;
+            next = std::max(next, newIndices[i] + 1);
+        }
+        newIB->unlock();
+
+        VertexCacheStats after = analyzeVertexCache(newIndices.data(), newIndices.size(), nVertices);
+        bool ok = nErrors == 0 && stats.nVertices == vertices.size() && stats.nUsedVertices + 1 == vertices.size() &&
+            nVertices == stats.nUsedVertices && next == nVertices && newIB->stride() == sizeof(uint16_t) &&
+            after.acmr == stats.after.acmr && stats.after.acmr < stats.before.acmr && stats.nClusters >= 2;
+        runner.check(name, ok, "ACMR: %.3f -> %.3f, ATVR: %.3f -> %.3f, vertices: %d -> %d, clusters: %d, errors: %d",
+            stats.before.acmr, stats.after.acmr, stats.before.atvr, stats.after.atvr,
+            (int)stats.nVertices, (int)stats.nUsedVertices, (int)stats.nClusters, (int)nErrors);
+
+        mesh = nullptr;
+        VertexDeclMgr::finiInstance();
+    }
+
+    /// 八面体编码允许的最大夹角(弧度)，snorm16的量化误差约为0.003度
+    const float MaxOctahedralError = 0.01f * PI_FULL / 180.0f;
+
+    Vector3 randomDirection(std::mt19937 &random)
+    {
+        std::normal_distribution<float> gaussian;
+        Vector3 v;
+        do
+        {
+            v.set(gaussian(random), gaussian(random), gaussian(random));
+        } while (v.lengthSq() < 1e-6f);
+        v.normalize();
+        return v;
+    }
+
+    /** 小角度时acos受float精度的限制(约0.02度)，使用atan2计算。*/
+    float angleBetween(const Vector3 &a, const Vector3 &b)
+    {
+        return std::atan2(a.crossProduct(b).length(), a.dotProduct(b));
+    }
+
+    bool isHalfNaN(uint16_t h)
+    {
+        return (h & 0x7c00) == 0x7c00 && (h & 0x3ff) != 0;
+    }
+
+    /** 半精度浮点数：所有65536个值转换为float再转换回来不变(NaN仍为NaN)；
+     *  任意float转换后是最近的半精度值，距离相同时取偶数，超出范围变为无穷大。
+     *  八面体编码：随机方向和坐标轴、对角线方向解码后的夹角不超过MaxOctahedralError。
+     */
+    void checkEncoding(BenchmarkRunner &runner)
+    {
+        const char *name = "check/mesh/pack/encoding";
+        if (!runner.isChecking(name))
+        {
+            return;
+        }
+
+        size_t nHalfErrors = 0;
+        for (uint32_t h = 0; h <= 0xffff; ++h)
+        {
+            uint16_t back = floatToHalf(halfToFloat(uint16_t(h)));
+            nHalfErrors += isHalfNaN(uint16_t(h)) ? (isHalfNaN(back) ? 0 : 1) : (back == h ? 0 : 1);
+        }
+
+        std::mt19937 checkRandom(runner.seed_);
+        std::uniform_real_distribution<float> exponent(-26.0f, 16.0f);
+        for (int i = 0; i < 100000; ++i)
+        {
+            float x = std::ldexp(std::uniform_real_distribution<float>(1.0f, 2.0f)(checkRandom), int(exponent(checkRandom)));
+            x = (i & 1) ? -x : x;
+            uint16_t h = floatToHalf(x);
+            if ((h & 0x7fff) >= 0x7c00)
+            {
+                nHalfErrors += std::fabs(x) >= 65520.0f && (h & 0x7fff) == 0x7c00 ? 0 : 1;
+                continue;
+            }
+
+            // 绝对值方向上相邻的两个半精度值不能更近
+            float d = std::fabs(halfToFloat(h) - x);
+            for (int step = -1; step <= 1; step += 2)
+            {
+                uint16_t magnitude = uint16_t((h & 0x7fff) + step);
+                if (magnitude > 0x7bff || (step < 0 && (h & 0x7fff) == 0))
+                {
+                    continue;
+                }
+                float dn = std::fabs(halfToFloat(uint16_t((h & 0x8000) | magnitude)) - x);
+                nHalfErrors += d < dn || (d == dn && (h & 1) == 0) ? 0 : 1;
+            }
+        }
+        nHalfErrors += floatToHalf(65504.0f) == 0x7bff && floatToHalf(65520.0f) == 0x7c00 && floatToHalf(-1e6f) == 0xfc00 ? 0 : 1;
+
+        std::vector<Vector3> directions;
+        for (int i = 0; i < 27; ++i)
+        {
+            Vector3 v(float(i % 3 - 1), float(i / 3 % 3 - 1), float(i / 9 - 1));
+            if (i != 13)
+            {
+                v.normalize();
+                directions.push_back(v);
+            }
+        }
+        for (int i = 0; i < 100000; ++i)
+        {
+            directions.push_back(randomDirection(checkRandom));
+        }
+        float maxError = 0.0f;
+        for (const Vector3 &v : directions)
+        {
+            int16_t encoded[2];
+            encodeOctahedral(v, encoded);
+            maxError = std::max(maxError, angleBetween(decodeOctahedral(encoded), v));
+        }
+
+        bool ok = nHalfErrors == 0 && maxError <= MaxOctahedralError;
+        runner.check(name, ok, "half errors: %d, octahedral max error: %.4f deg (%d directions)",
+            (int)nHalfErrors, maxError * 180.0f / PI_FULL, (int)directions.size());
+    }
+
+    /** 地形的副本使用随机的法线和切线，执行packMeshVertices。
+     *  顶点格式变为PackedMeshVertex；解码矩阵按包围盒的最小点和最长边生成；
+     *  解码后的位置误差不超过半个量化步长，包围盒与压缩前一致；
+     *  法线和切线的夹角误差与八面体编码一致，uv是就近舍入的半精度值。
+     */
+    void checkPackMesh(BenchmarkRunner &runner, const std::string &name, const Mesh *terrain)
+    {
+        VertexBufferPtr vb = terrain->getVertexBuffer();
+        const MeshVertex *source = (const MeshVertex*)vb->lock(true);
+        std::vector<MeshVertex> vertices(source, source + vb->count());
+        vb->unlock();
+
+        std::mt19937 checkRandom(runner.seed_);
+        AABB bounds;
+        bounds.setEmpty();
+        for (MeshVertex &v : vertices)
+        {
+            v.normal = randomDirection(checkRandom);
+            v.tangent = randomDirection(checkRandom);
+            bounds.addPoint(v.position);
+        }
+
+        VertexDeclMgr::initInstance();
+        MeshPtr mesh = new Mesh();
+        mesh->setVertexDecl(VertexDeclMgr::instance()->get(MeshVertex::getType()));
+        mesh->setVertexBuffer(new VertexBufferEx<MeshVertex>(BufferUsage::Static, vertices.size(), vertices.data()));
+        mesh->setIndexBuffer(terrain->getIndexBuffer());
+        mesh->setSubMeshes(terrain->getSubMeshes());
+
+        bool packed = packMeshVertices(mesh.get());
+        VertexBufferPtr packedVB = mesh->getVertexBuffer();
+        packed = packed && packedVB->stride() == sizeof(PackedMeshVertex) && packedVB->count() == vertices.size() &&
+            mesh->getVertexDecl()->getName() == PackedMeshVertex::getType() && mesh->hasPositionDecode();
+
+        Vector3 size = bounds.getSize();
+        float scale = std::max(size.x, std::max(size.y, size.z));
+        Matrix decode;
+        makePositionDecode(decode, bounds.min_, scale);
+        size_t nErrors = packed && std::equal(decode._m, decode._m + 16, mesh->getPositionDecode()._m) ? 0 : 1;
+
+        // 半个量化步长，加上解码时float运算的误差
+        float maxPositionError = scale * (0.5f / 65535.0f) * std::sqrt(3.0f) + scale * 1e-6f;
+        float positionError = 0.0f, normalError = 0.0f;
+        if (packed)
+        {
+            const PackedMeshVertex *p = (const PackedMeshVertex*)packedVB->lock(true);
+            std::vector<Vector3> positions(vertices.size());
+            decodePositions(positions.data(), p, sizeof(PackedMeshVertex), positions.size(), mesh->getPositionDecode());
+            for (size_t i = 0; i < vertices.size(); ++i)
+            {
+                const MeshVertex &v = vertices[i];
+                positionError = std::max(positionError, (positions[i] - v.position).length());
+                normalError = std::max(normalError, angleBetween(decodeOctahedral(p[i].normal), v.normal));
+                normalError = std::max(normalError, angleBetween(decodeOctahedral(p[i].tangent), v.tangent));
+                nErrors += p[i].position[3] == 0xffff && p[i].uv[0] == floatToHalf(v.uv.x) && p[i].uv[1] == floatToHalf(v.uv.y) ? 0 : 1;
+            }
+            packedVB->unlock();
+
+            mesh->generateBoundingBox();
+            const AABB &packedBounds = mesh->getBoundingBox();
+            nErrors += (packedBounds.min_ - bounds.min_).length() <= maxPositionError &&
+                (packedBounds.max_ - bounds.max_).length() <= maxPositionError ? 0 : 1;
+        }
+
+        bool ok = nErrors == 0 && positionError <= maxPositionError && normalError <= MaxOctahedralError;
+        runner.check(name, ok, "%d vertices, max error: position %.2e (limit %.2e), normal %.4f deg, errors: %d",
+            (int)vertices.size(), positionError, maxPositionError, normalError * 180.0f / PI_FULL, (int)nErrors);
+
+        mesh = nullptr;
+        VertexDeclMgr::finiInstance();
+    }
+
+    std::string makeName(const char *prefix, size_t nTriangles)
+    {
+        char buffer[64];
+        if (nTriangles >= 1000000)
+        {
+            snprintf(buffer, sizeof(buffer), "%s/%dM", prefix, int(nTriangles / 1000000));
+        }
+        else
+        {
+            snprintf(buffer, sizeof(buffer), "%s/%dk", prefix, int(nTriangles / 1000));
+        }
+        return buffer;
+    }
+}
+
+void benchMesh(BenchmarkRunner &runner, size_t maxTriangles)
+{
+    const size_t sizes[] = { 1000, 10000, 100000, 1000000 };
+    const float terrainSize = 100.0f;
+
+    checkEncoding(runner);
+
+    for (size_t nTarget : sizes)
+    {
+        if (nTarget > maxTriangles)
+        {
+            break;
+        }
+
+        std::string boundsName = makeName("mesh/iterateFaces/boundingBox", nTarget);
+        std::string visitorName = makeName("mesh/iterateFaces/ray", nTarget);
+        std::string buildName = makeName("trace/build", nTarget);
+        std::string traceName = makeName("trace/rayIntersect", nTarget);
+        std::string optimizeName = makeName("mesh/optimize", nTarget);
+        std::string packName = makeName("mesh/pack", nTarget);
+        std::string cancelName = makeName("check/trace/cancel", nTarget);
+        std::string bufferName = makeName("check/mesh/triangleBuffer", nTarget);
+        std::string optimizeCheckName = makeName("check/mesh/optimize", nTarget);
+        std::string packCheckName = makeName("check/mesh/pack", nTarget);
+        if (!runner.isEnabled(boundsName) && !runner.isEnabled(visitorName) &&
+            !runner.isEnabled(buildName) && !runner.isEnabled(traceName) &&
+            !runner.isEnabled(optimizeName) && !runner.isEnabled(packName) &&
+            !runner.isChecking(cancelName) && !runner.isChecking(bufferName) &&
+            !runner.isChecking(optimizeCheckName) && !runner.isChecking(packCheckName))
+        {
+            continue;
+        }
+
+        std::mt19937 random(runner.seed_);
+        MeshPtr mesh = createTerrain(random, nTarget, terrainSize);
+        std::vector<Ray> rays = createTerrainRays(random, terrainSize);
+        size_t nTriangles = mesh->getIndexBuffer()->count() / 3;
+
+        runner.run(boundsName, "triangle", nTriangles, [&]()
+        {
+            AABB bounds;
+            bounds.setEmpty();
+            MeshBoundingBoxVisitor visitor(bounds);
+            mesh->iterateFaces(visitor);
+            return bounds.isValid() ? size_t(1) : size_t(0);
+        });
+
+        // 暴力遍历所有三角形，每次调用只测一条射线
+        size_t iRay = 0;
+        runner.run(visitorName, "ray", 1, [&]()
+        {
+            MeshRayVisitor visitor(rays[iRay++ % NumRays]);
+            mesh->iterateFaces(visitor);
+            return visitor.intersected_ ? size_t(1) : size_t(0);
+        });
+
+        // 暴力对比每条射线和每个三角形，只检查较小的网格
+        if (runner.isChecking(bufferName) && nTarget <= 10000)
+        {
+            // 反向的射线不会命中，用于检查没有交点的情况
+            std::vector<Ray> checkRays = rays;
+            for (size_t i = 0; i < NumRays / 8; ++i)
+            {
+                Ray ray = rays[i];
+                ray.direction_ = -ray.direction_;
+                checkRays.push_back(ray);
+            }
+
+            size_t nHits = 0;
+            size_t nMismatches = compareTriangleBuffer(mesh.get(), checkRays, nHits);
+            runner.check(bufferName, nMismatches == 0, "%s, %d rays, hits: %d, mismatches: %d",
+                getTrianglePacketISA(), (int)checkRays.size(), (int)nHits, (int)nMismatches);
+        }
+
+        if (runner.isEnabled(optimizeName))
+        {
+            VertexBufferPtr vb = mesh->getVertexBuffer();
+            IndexBufferPtr ib = mesh->getIndexBuffer();
+            const uint32_t *source = (const uint32_t*)ib->lock(true);
+            std::vector<uint32_t> indices(source, source + ib->count());
+            ib->unlock();
+            const char *positions = vb->lock(true);
+
+            // 三角形重排的总时间，地形按行生成，是顶点缓存不友好的顺序
+            std::vector<uint32_t> optimized(indices.size());
+            runner.run(optimizeName, "triangle", nTriangles, [&]()
+            {
+                optimizeVertexCache(optimized.data(), indices.data(), indices.size(), vb->count());
+                return optimizeOverdraw(optimized.data(), optimized.size(), positions, vb->count(), vb->stride());
+            });
+            vb->unlock();
+
+            VertexCacheStats before = analyzeVertexCache(indices.data(), indices.size(), vb->count());
+            VertexCacheStats after = analyzeVertexCache(optimized.data(), optimized.size(), vb->count());
+            printf("    ACMR: %.3f -> %.3f, ATVR: %.3f -> %.3f\n", before.acmr, after.acmr, before.atvr, after.atvr);
+        }
+
+        if (runner.isChecking(optimizeCheckName) && nTarget <= 10000)
+        {
+            checkOptimizeMesh(runner, optimizeCheckName, mesh.get());
+        }
+
+        if (runner.isChecking(packCheckName) && nTarget <= 10000)
+        {
+            checkPackMesh(runner, packCheckName, mesh.get());
+        }
+
+        if (runner.isEnabled(packName))
+        {
+            VertexBufferPtr vb = mesh->getVertexBuffer();
+            const MeshVertex *vertices = (const MeshVertex*)vb->lock(true);
+            std::vector<PackedMeshVertex> packed(vb->count());
+            Vector3 offset;
+            float scale;
+            runner.run(packName, "vertex", packed.size(), [&]()
+            {
+                packVertices(packed.data(), vertices, packed.size(), offset, scale);
+                return size_t(packed[0].position[0]);
+            });
+
+            // 解码误差：位置相对于地形的尺寸，法线为夹角
+            Matrix decode;
+            makePositionDecode(decode, offset, scale);
+            std::vector<Vector3> positions(packed.size());
+            decodePositions(positions.data(), packed.data(), sizeof(PackedMeshVertex), packed.size(), decode);
+            float positionError = 0.0f;
+            float normalError = 0.0f;
+            for (size_t i = 0; i < packed.size(); ++i)
+            {
+                positionError = std::max(positionError, (positions[i] - vertices[i].position).length());
+                normalError = std::max(normalError, angleBetween(decodeOctahedral(packed[i].normal), vertices[i].normal));
+            }
+            vb->unlock();
+            printf("    %d -> %d bytes/vertex, max error: position %.2e, normal %.4f deg\n",
+                (int)sizeof(MeshVertex), (int)sizeof(PackedMeshVertex), positionError / terrainSize, normalError * 180.0f / PI_FULL);
+        }
+
+        MeshInfo::Material mtl = { { 1.0f, 1.0f, 1.0f, 1.0f }, 0.0f, 0.0f };
+
+        // 三角形收集和BVH构建的总时间
+        runner.run(buildName, "triangle", nTriangles, [&]()
+        {
+            MeshInfoPtr info = new MeshInfo(mtl);
+            info->triangles_.addMesh(mesh.get(), Matrix::Identity);
+            info->build();
+            return info->bvh_.getNodes().size();
+        });
+
+        if (!runner.isEnabled(traceName) && !runner.isChecking(cancelName))
+        {
+            continue;
+        }
+
+        TraceManager traceMgr(1);
+        MeshInfoPtr info = new MeshInfo(mtl);
+        info->triangles_.addMesh(mesh.get(), Matrix::Identity);
+        info->build();
+        traceMgr.addMesh(info);
+        traceMgr.buildAccelerator();
+
+        runner.run(traceName, "ray", NumRays, [&]()
+        {
+            size_t nHits = 0;
+            for (const Ray &ray : rays)
+            {
+                TraceInfo trace;
+                trace.ray_ = ray;
+                traceMgr.rayIntersect(trace);
+                nHits += trace.isValid() ? 1 : 0;
+            }
+            return nHits;
+        });
+
+        // 取消之后追踪应该立即结束，否则waitTrace会一直阻塞
+        if (runner.isChecking(cancelName))
+        {
+            TraceCamera camera;
+            camera.lookAt(Vector3(0.0f, 50.0f, -50.0f), Vector3::Zero, Vector3(0.0f, 1.0f, 0.0f), PI_FULL / 3.0f, 1.0f, 0.1f);
+            traceMgr.initTrace(256, 256, camera);
+            traceMgr.cancelTrace();
+            bool finished = traceMgr.isFinished();
+            if (finished)
+            {
+                traceMgr.waitTrace();
+            }
+            runner.check(cancelName, finished, "passes: %d", traceMgr.getNumPasses());
+        }
+    }
+}
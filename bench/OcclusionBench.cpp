@@ -0,0 +1,226 @@
+#include "Benchmark.h"
+#include "OcclusionCuller.h"
+#include "ThreadPool.h"
+#include "MathDef.h"
+#include "Ray.h"
+#include "PrecomputedRay.h"
+
+#include <random>
+#include <cmath>
+
+namespace
+{
+    /** 包围盒的12个三角形，正面朝外、逆时针。*/
+    void addBoxTriangles(const AABB &box, std::vector<Vector3> &vertices)
+    {
+        const Vector3 &a = box.min_;
+        const Vector3 &b = box.max_;
+        Vector3 p[8] = {
+            Vector3(a.x, a.y, a.z), Vector3(b.x, a.y, a.z), Vector3(b.x, b.y, a.z), Vector3(a.x, b.y, a.z),
+            Vector3(a.x, a.y, b.z), Vector3(b.x, a.y, b.z), Vector3(b.x, b.y, b.z), Vector3(a.x, b.y, b.z),
+        };
+        const int faces[6][4] = {
+            { 0, 3, 2, 1 }, { 4, 5, 6, 7 }, // -z, +z
+            { 0, 4, 7, 3 }, { 1, 2, 6, 5 }, // -x, +x
+            { 0, 1, 5, 4 }, { 3, 7, 6, 2 }, // -y, +y
+        };
+        for (const int *f : faces)
+        {
+            vertices.push_back(p[f[0]]);
+            vertices.push_back(p[f[1]]);
+            vertices.push_back(p[f[2]]);
+            vertices.push_back(p[f[0]]);
+            vertices.push_back(p[f[2]]);
+            vertices.push_back(p[f[3]]);
+        }
+    }
+
+    /** 点是否在视锥内。scale缩小屏幕上的范围，只接受明显在屏幕内部的点，深度范围不变。*/
+    bool isInClipSpace(const Matrix &viewProj, const Vector3 &p, float scale)
+    {
+        Vector4 c;
+        viewProj.transformVector(c, Vector4(p.x, p.y, p.z, 1.0f));
+        float w = c.w * scale;
+        return c.w > 0.0f && std::fabs(c.x) <= w && std::fabs(c.y) <= w && std::fabs(c.z) <= c.w;
+    }
+
+    /** 参考实现：从相机向包围盒表面和内部的采样点发射线段，只要有一个点在视锥内且没有被任何一栋楼挡住，物体就是可见的。
+     *  遮挡体只写入像素中心被覆盖的像素，不到一个像素的缝隙可能被剔除，
+     *  所以楼按采样点的距离扩大约一个像素再求交，擦边的采样点算作被遮挡，参考结果只会偏向不可见。
+     */
+    bool isVisibleReference(const AABB &box, const Vector3 &eye, const Matrix &viewProj, const std::vector<AABB> &buildings)
+    {
+        const Vector3 &a = box.min_;
+        const Vector3 &b = box.max_;
+        Vector3 center = box.getCenter();
+        Vector3 samples[15] = {
+            Vector3(a.x, a.y, a.z), Vector3(b.x, a.y, a.z), Vector3(a.x, b.y, a.z), Vector3(b.x, b.y, a.z),
+            Vector3(a.x, a.y, b.z), Vector3(b.x, a.y, b.z), Vector3(a.x, b.y, b.z), Vector3(b.x, b.y, b.z),
+            Vector3(a.x, center.y, center.z), Vector3(b.x, center.y, center.z),
+            Vector3(center.x, a.y, center.z), Vector3(center.x, b.y, center.z),
+            Vector3(center.x, center.y, a.z), Vector3(center.x, center.y, b.z),
+            center,
+        };
+        for (const Vector3 &p : samples)
+        {
+            if (!isInClipSpace(viewProj, p, 0.99f))
+            {
+                continue;
+            }
+
+            Ray ray;
+            ray.origin_ = eye;
+            ray.direction_ = p - eye;
+            float distance = ray.direction_.length();
+            ray.direction_ *= 1.0f / distance;
+            PrecomputedRay pray(ray);
+
+            // 256x128的深度缓冲，45度的垂直视角，每个像素约0.0065弧度
+            float m = distance * 0.0065f;
+            const Vector3 margin(m, m, m);
+
+            bool blocked = false;
+            for (const AABB &building : buildings)
+            {
+                AABB fat;
+                fat.min_ = building.min_ - margin;
+                fat.max_ = building.max_ + margin;
+                float tNear, tFar;
+                if (pray.intersectAABB(fat, distance, tNear, tFar))
+                {
+                    blocked = true;
+                    break;
+                }
+            }
+            if (!blocked)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+void benchOcclusion(BenchmarkRunner &runner)
+{
+    std::mt19937 random(runner.seed_);
+
+    // 32x32个街区的城市，每个街区一栋楼，相机在街道上
+    const int nBlocks = 32;
+    const float blockSize = 20.0f;
+    std::uniform_real_distribution<float> height(10.0f, 60.0f);
+    std::vector<Vector3> occluders;
+    std::vector<AABB> buildings;
+    for (int i = 0; i < nBlocks; ++i)
+    {
+        for (int k = 0; k < nBlocks; ++k)
+        {
+            AABB building;
+            building.min_.set((i - nBlocks / 2) * blockSize + 3.0f, 0.0f, k * blockSize + 3.0f);
+            building.max_.set(building.min_.x + blockSize - 6.0f, height(random), building.min_.z + blockSize - 6.0f);
+            addBoxTriangles(building, occluders);
+            buildings.push_back(building);
+        }
+    }
+
+    // 街道和楼顶上的小物体
+    const size_t nObjects = 16384;
+    std::uniform_real_distribution<float> x(-nBlocks * blockSize * 0.5f, nBlocks * blockSize * 0.5f);
+    std::uniform_real_distribution<float> z(0.0f, nBlocks * blockSize);
+    std::uniform_real_distribution<float> y(0.0f, 40.0f);
+    std::vector<AABB> objects(nObjects);
+    for (AABB &box : objects)
+    {
+        Vector3 center(x(random), y(random), z(random));
+        box.min_ = center - Vector3(1.0f, 1.0f, 1.0f);
+        box.max_ = center + Vector3(1.0f, 1.0f, 1.0f);
+    }
+
+    Matrix view, proj;
+    Vector3 eye(1.5f, 2.0f, -10.0f);
+    view.lookAt(eye, Vector3(1.5f, 2.0f, 100.0f), Vector3(0.0f, 1.0f, 0.0f));
+    proj.perspectiveProjectionGL(PI_QUARTER, 16.0f / 9.0f, 0.5f, 2000.0f);
+    Matrix viewProj = view * proj;
+
+    OcclusionCuller culler(256, 128);
+    size_t nTriangles = occluders.size() / 3;
+
+    runner.run("occlusion/rasterize/12k", "triangle", nTriangles, [&]()
+    {
+        culler.beginFrame(viewProj);
+        culler.addTriangles(occluders.data(), occluders.size(), Matrix::Identity);
+        culler.rasterize();
+        return culler.getStats().nRasterized;
+    });
+
+    ThreadPool pool;
+    runner.run("occlusion/rasterize/parallel/12k", "triangle", nTriangles, [&]()
+    {
+        culler.beginFrame(viewProj);
+        culler.addTriangles(occluders.data(), occluders.size(), Matrix::Identity);
+        culler.rasterize(&pool);
+        return culler.getStats().nRasterized;
+    });
+
+    runner.run("occlusion/test/16k", "box", nObjects, [&]()
+    {
+        size_t nVisible = 0;
+        for (const AABB &box : objects)
+        {
+            nVisible += culler.isVisible(box, Matrix::Identity) ? 1 : 0;
+        }
+        return nVisible;
+    });
+
+    // 遮挡剔除必须是保守的：参考实现认为可见的物体不能被剔除。并行光栅化的结果与单线程相同
+    // 在街道上和斜向俯视城市的两个视角各检查一次
+    const char *checkName = "check/occlusion/conservative";
+    if (runner.isChecking(checkName))
+    {
+        Vector3 aerialEye(-100.0f, 120.0f, -60.0f);
+        Matrix aerialView;
+        aerialView.lookAt(aerialEye, Vector3(0.0f, 0.0f, 200.0f), Vector3(0.0f, 1.0f, 0.0f));
+        const Vector3 eyes[] = { eye, aerialEye };
+        const Matrix viewProjs[] = { viewProj, aerialView * proj };
+
+        size_t nChecked = 0, nVisible = 0, nCulled = 0, nFalseCulls = 0, nMismatches = 0;
+        for (int v = 0; v < 2; ++v)
+        {
+            OcclusionCuller serial(256, 128);
+            serial.beginFrame(viewProjs[v]);
+            serial.addTriangles(occluders.data(), occluders.size(), Matrix::Identity);
+            serial.rasterize();
+
+            culler.beginFrame(viewProjs[v]);
+            culler.addTriangles(occluders.data(), occluders.size(), Matrix::Identity);
+            culler.rasterize(&pool);
+
+            for (const AABB &box : objects)
+            {
+                bool visible = serial.isVisible(box, Matrix::Identity);
+                nMismatches += visible == culler.isVisible(box, Matrix::Identity) ? 0 : 1;
+
+                bool inFrustum = false;
+                for (int k = 0; k < 8 && !inFrustum; ++k)
+                {
+                    Vector3 corner((k & 1) ? box.max_.x : box.min_.x, (k & 2) ? box.max_.y : box.min_.y, (k & 4) ? box.max_.z : box.min_.z);
+                    inFrustum = isInClipSpace(viewProjs[v], corner, 1.0f);
+                }
+                if (!inFrustum)
+                {
+                    continue;
+                }
+
+                ++nChecked;
+                bool reference = isVisibleReference(box, eyes[v], viewProjs[v], buildings);
+                nVisible += reference ? 1 : 0;
+                nCulled += visible ? 0 : 1;
+                nFalseCulls += reference && !visible ? 1 : 0;
+            }
+        }
+
+        bool ok = nFalseCulls == 0 && nMismatches == 0 && nCulled > 0 && nVisible > 0;
+        runner.check(checkName, ok, "%d boxes in view, visible: %d, culled: %d, false culls: %d, serial/parallel mismatches: %d",
+            (int)nChecked, (int)nVisible, (int)nCulled, (int)nFalseCulls, (int)nMismatches);
+    }
+}
@@ -0,0 +1,186 @@
+// 与构建配置无关，总是展开PROFILE_*宏
+#ifndef PROFILER_ENABLE
+#define PROFILER_ENABLE 1
+#endif
+
+#include "Benchmark.h"
+#include "Profiler.h"
+
+#include <smartjson/sj_parser.hpp>
+#include <thread>
+#include <cmath>
+
+namespace
+{
+    // 作用域按名字的指针区分，使用同一个常量
+    const char OuterScope[] = "outer";
+    const char InnerScope[] = "inner";
+    const char WorkerScope[] = "worker";
+
+    /** 在一个事件列表中找到直接包含e的外层事件。*/
+    const Profiler::Event* findParent(const std::vector<Profiler::Event> &events, const Profiler::Event &e)
+    {
+        for (const Profiler::Event &parent : events)
+        {
+            if (parent.thread == e.thread && parent.depth + 1 == e.depth && parent.start <= e.start && e.end <= parent.end)
+            {
+                return &parent;
+            }
+        }
+        return nullptr;
+    }
+
+    /** 捕获几帧嵌套的作用域和另一个线程中的作用域，检查事件的嵌套关系、每帧的统计，
+     *  以及导出的Chrome trace能被解析，并且与捕获的事件一一对应。
+     */
+    void checkProfiler(BenchmarkRunner &runner)
+    {
+        const char *name = "check/profiler/trace";
+        if (!runner.isChecking(name))
+        {
+            return;
+        }
+
+        const int nFrames = 4;
+        const int nInner = 2;
+        const int nWorker = 3;
+
+        Profiler::initInstance();
+        Profiler *profiler = Profiler::instance();
+        profiler->beginCapture();
+
+        std::thread worker([&]()
+        {
+            profiler->setThreadName("Worker");
+            for (int i = 0; i < nWorker; ++i)
+            {
+                PROFILE_SCOPE(WorkerScope);
+            }
+        });
+        worker.join();
+
+        for (int frame = 0; frame < nFrames; ++frame)
+        {
+            {
+                PROFILE_SCOPE(OuterScope);
+                for (int i = 0; i < nInner; ++i)
+                {
+                    PROFILE_SCOPE(InnerScope);
+                    std::this_thread::yield();
+                }
+            }
+            profiler->endFrame();
+        }
+        profiler->endCapture();
+
+        // 内层的事件都包含在同一个线程的外层事件中，工作线程的事件在另一个线程上
+        const std::vector<Profiler::Event> &events = profiler->getCapturedEvents();
+        int nOuter = 0, nInnerFound = 0, nWorkerFound = 0;
+        size_t nErrors = 0;
+        uint16_t mainThread = 0;
+        for (const Profiler::Event &e : events)
+        {
+            nErrors += e.end >= e.start ? 0 : 1;
+            if (e.name == OuterScope)
+            {
+                ++nOuter;
+                mainThread = e.thread;
+                nErrors += e.depth == 0 ? 0 : 1;
+            }
+            else if (e.name == InnerScope)
+            {
+                ++nInnerFound;
+                const Profiler::Event *parent = findParent(events, e);
+                nErrors += parent != nullptr && parent->name == OuterScope ? 0 : 1;
+            }
+            else if (e.name == WorkerScope)
+            {
+                ++nWorkerFound;
+                nErrors += e.depth == 0 ? 0 : 1;
+            }
+        }
+        for (const Profiler::Event &e : events)
+        {
+            nErrors += e.name == WorkerScope && e.thread == mainThread ? 1 : 0;
+        }
+        nErrors += nOuter == nFrames && nInnerFound == nFrames * nInner && nWorkerFound == nWorker ? 0 : 1;
+
+        // 外层的耗时包含内层
+        Profiler::ScopeStats outer, inner;
+        bool hasStats = profiler->getScopeStats(OuterScope, false, outer) && profiler->getScopeStats(InnerScope, false, inner);
+        bool statsOk = hasStats && outer.calls == 1.0f && inner.calls == float(nInner) &&
+            inner.avg <= outer.avg && inner.max <= outer.max && profiler->getDroppedEvents() == 0;
+
+        // 导出的trace按捕获的顺序写出每个事件，时间单位为微秒，相对于第一个事件比较
+        std::string path = "raytrace_bench_trace.json";
+        size_t nTraceErrors = 0;
+        size_t nTraceEvents = 0;
+        mjson::Parser parser;
+        if (!profiler->saveChromeTrace(path) || !parser.parseFromFile(path.c_str()))
+        {
+            nTraceErrors = 1;
+        }
+        else
+        {
+            mjson::Node nodes = parser.getRoot()["traceEvents"];
+            double firstTs = 0.0;
+            for (size_t i = 0; nodes.isArray() && i < nodes.size(); ++i)
+            {
+                const mjson::Node &node = nodes[i];
+                if (node["ph"].asStdString() != "X")
+                {
+                    continue;
+                }
+                if (nTraceEvents >= events.size())
+                {
+                    ++nTraceErrors;
+                    break;
+                }
+
+                const Profiler::Event &e = events[nTraceEvents++];
+                if (nTraceEvents == 1)
+                {
+                    firstTs = node["ts"].asFloat();
+                }
+                double ts = double(int64_t(e.start - events[0].start)) * 1e-3;
+                double dur = double(e.end - e.start) * 1e-3;
+                if (node["name"].asStdString() != e.name || node["tid"].asInt() != int(e.thread) ||
+                    std::fabs(node["ts"].asFloat() - firstTs - ts) > 0.01 || std::fabs(node["dur"].asFloat() - dur) > 0.01)
+                {
+                    ++nTraceErrors;
+                }
+            }
+            nTraceErrors += nodes.isArray() && nTraceEvents == events.size() ? 0 : 1;
+        }
+        remove(path.c_str());
+
+        bool ok = nErrors == 0 && statsOk && nTraceErrors == 0;
+        runner.check(name, ok, "%d events, nesting errors: %d, inner calls per frame: %.1f, trace events: %d, trace errors: %d",
+            (int)events.size(), (int)nErrors, hasStats ? inner.calls : 0.0f, (int)nTraceEvents, (int)nTraceErrors);
+
+        Profiler::finiInstance();
+    }
+}
+
+void benchProfiler(BenchmarkRunner &runner)
+{
+    // 每帧1024个作用域，包括endFrame取走事件和更新统计的开销
+    const char *name = "profiler/scope";
+    if (runner.isEnabled(name))
+    {
+        const size_t nScopes = 1024;
+        Profiler::initInstance();
+        runner.run(name, "scope", nScopes, [&]()
+        {
+            for (size_t i = 0; i < nScopes; ++i)
+            {
+                PROFILE_SCOPE(OuterScope);
+            }
+            Profiler::instance()->endFrame();
+            return Profiler::instance()->getFrameIndex();
+        });
+        Profiler::finiInstance();
+    }
+
+    checkProfiler(runner);
+}
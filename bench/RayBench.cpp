@@ -0,0 +1,465 @@
+#include "Benchmark.h"
+#include "Ray.h"
+#include "PrecomputedRay.h"
+#include "AABB.h"
+#include "Matrix.h"
+#include "TrianglePacket.h"
+
+#include <random>
+#include <cmath>
+
+namespace
+{
+    /// 每次调用测试的数据量。数据总量要能放进L1/L2，避免测成内存带宽
+    const size_t BatchSize = 1024;
+
+    Vector3 randomVector(std::mt19937 &random, float range)
+    {
+        std::uniform_real_distribution<float> dist(-range, range);
+        float x = dist(random);
+        float y = dist(random);
+        float z = dist(random);
+        return Vector3(x, y, z);
+    }
+
+    /** 起点在z轴负方向远处，指向target附近的随机点。jitter控制命中率。*/
+    Ray randomRay(std::mt19937 &random, const Vector3 &target, float jitter)
+    {
+        Ray ray;
+        ray.origin_ = randomVector(random, 1.0f) + Vector3(0.0f, 0.0f, -20.0f);
+        ray.direction_ = target + randomVector(random, jitter) - ray.origin_;
+        ray.direction_.normalize();
+        return ray;
+    }
+
+    /** 双精度的slab测试，作为PrecomputedRay的参考。
+     *  margin是相交区间的长度(不相交时为负)，接近0说明射线擦过包围盒，float的结果不可靠。
+     */
+    bool intersectAABBReference(const Ray &ray, const AABB &ab, double tMax, double &tNear, double &margin)
+    {
+        double t0 = 0.0;
+        double t1 = tMax;
+        for (int i = 0; i < 3; ++i)
+        {
+            double o = ray.origin_[i];
+            double d = ray.direction_[i];
+            double lo = ab.min_[i];
+            double hi = ab.max_[i];
+            if (d == 0.0)
+            {
+                // 与slab平行，起点在slab之内才可能相交
+                if (o < lo || o > hi)
+                {
+                    margin = -std::min(std::fabs(o - lo), std::fabs(o - hi));
+                    return false;
+                }
+                continue;
+            }
+
+            double tA = (lo - o) / d;
+            double tB = (hi - o) / d;
+            t0 = std::max(t0, std::min(tA, tB));
+            t1 = std::min(t1, std::max(tA, tB));
+        }
+        tNear = t0;
+        margin = t1 - t0;
+        return t0 <= t1;
+    }
+
+    /** 随机的射线和包围盒。部分射线与坐标轴平行、起点在包围盒内或者在包围盒的平面上。*/
+    void createSlabCases(std::mt19937 &random, size_t count, std::vector<Ray> &rays, std::vector<AABB> &boxes)
+    {
+        std::uniform_int_distribution<int> kind(0, 7);
+        std::uniform_int_distribution<int> axis(0, 2);
+        rays.resize(count);
+        boxes.resize(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            Vector3 center = randomVector(random, 5.0f);
+            Vector3 extent = randomVector(random, 1.0f);
+            boxes[i].setEmpty();
+            boxes[i].addPoint(center - extent);
+            boxes[i].addPoint(center + extent);
+
+            Ray &ray = rays[i];
+            ray.origin_ = randomVector(random, 10.0f);
+            ray.direction_ = center + randomVector(random, 2.0f) - ray.origin_;
+
+            int k = kind(random);
+            if (k == 0)
+            {
+                ray.origin_ = center + randomVector(random, 0.5f) * extent;
+            }
+            else if (k == 1 || k == 2)
+            {
+                // 只保留一个轴，其余分量为0(或-0)
+                int a = axis(random);
+                Vector3 direction = Vector3::Zero;
+                direction[a] = ray.direction_[a];
+                direction[(a + 1) % 3] = k == 2 ? -0.0f : 0.0f;
+                ray.direction_ = direction;
+            }
+            else if (k == 3)
+            {
+                // 起点在包围盒的平面上，方向与该平面平行
+                int a = axis(random);
+                ray.origin_[a] = boxes[i].max_[a];
+                ray.direction_[a] = 0.0f;
+            }
+            ray.direction_.normalize();
+        }
+    }
+
+    /** 逐对比较PrecomputedRay、Ray::intersectAABB与双精度参考，再按4个一组与intersectAABBPacket逐位比较。*/
+    size_t compareSlab(const std::vector<Ray> &rays, const std::vector<AABB> &boxes, size_t &nHits, size_t &nGrazing)
+    {
+        size_t nMismatches = 0;
+        for (size_t i = 0; i < rays.size(); ++i)
+        {
+            // 交替使用无限和有限的tMax，检查区间的裁剪
+            float tMax = i % 2 ? 12.0f : FLT_MAX;
+            PrecomputedRay ray(rays[i]);
+            float tNear = 0.0f, tFar = 0.0f;
+            bool hit = ray.intersectAABB(boxes[i], tMax, tNear, tFar);
+
+            double refNear = 0.0, margin = 0.0;
+            bool refHit = intersectAABBReference(rays[i], boxes[i], tMax, refNear, margin);
+            if (std::fabs(margin) < 1e-4 * (1.0 + std::fabs(refNear)))
+            {
+                ++nGrazing;
+            }
+            else if (hit != refHit || (hit && std::fabs(tNear - refNear) > 1e-5 * (1.0 + refNear)))
+            {
+                ++nMismatches;
+            }
+            nHits += hit ? 1 : 0;
+
+            float distance = 0.0f;
+            bool rayHit = rays[i].intersectAABB(boxes[i], &distance);
+            float farNear = 0.0f, farFar = 0.0f;
+            bool farHit = ray.intersectAABB(boxes[i], FLT_MAX, farNear, farFar);
+            if (rayHit != farHit || (rayHit && !sameBits(distance, farNear)))
+            {
+                ++nMismatches;
+            }
+        }
+
+        for (size_t s = 0; s < rays.size(); s += 4)
+        {
+            int n = int(std::min<size_t>(4, rays.size() - s));
+            AABBPacket4 packet;
+            for (int i = 0; i < n; ++i)
+            {
+                packet.setAABB(i, boxes[s + i]);
+            }
+
+            for (int r = 0; r < n; ++r)
+            {
+                float tMax = r % 2 ? 12.0f : FLT_MAX;
+                PrecomputedRay ray(rays[s + r]);
+                float tNear[4];
+                int mask = intersectAABBPacket(ray, packet, tMax, tNear);
+                for (int i = 0; i < 4; ++i)
+                {
+                    float expectedNear = 0.0f, expectedFar = 0.0f;
+                    bool expected = i < n && ray.intersectAABB(boxes[s + i], tMax, expectedNear, expectedFar);
+                    bool hit = ((mask >> i) & 1) != 0;
+                    if (hit != expected || (hit && !sameBits(tNear[i], expectedNear)))
+                    {
+                        ++nMismatches;
+                    }
+                }
+            }
+        }
+        return nMismatches;
+    }
+
+    /** 容易出错的情况：与坐标轴平行的射线、命中顶点和边、退化三角形、射线与三角形共面等。*/
+    void appendSpecialCases(std::vector<Ray> &rays, std::vector<Vector3> &triangles)
+    {
+        const Vector3 a(0.0f, 0.0f, 0.0f), bx(1.0f, 0.0f, 0.0f), cy(0.0f, 1.0f, 0.0f), cz(0.0f, 0.0f, 1.0f);
+        struct Case
+        {
+            Vector3 origin, direction, a, b, c;
+        };
+        const Case cases[] =
+        {
+            { Vector3(0.25f, 0.25f, -5.0f), Vector3(0.0f, 0.0f, 1.0f), a, bx, cy },
+            { Vector3(0.25f, 0.25f, 5.0f), Vector3(0.0f, 0.0f, -1.0f), a, bx, cy },
+            { Vector3(0.0f, 0.0f, -5.0f), Vector3(0.0f, 0.0f, 1.0f), a, bx, cy },
+            { Vector3(1.0f, 0.0f, -5.0f), Vector3(0.0f, 0.0f, 1.0f), a, bx, cy },
+            { Vector3(0.5f, 0.0f, -5.0f), Vector3(0.0f, 0.0f, 1.0f), a, bx, cy },
+            { Vector3(0.5f, 0.5f, -5.0f), Vector3(0.0f, 0.0f, 1.0f), a, bx, cy },
+            { Vector3(-5.0f, 0.2f, 0.2f), Vector3(1.0f, 0.0f, 0.0f), a, cy, cz },
+            { Vector3(0.2f, 5.0f, 0.2f), Vector3(0.0f, -1.0f, 0.0f), a, bx, cz },
+            // 三角形在射线的后方
+            { Vector3(0.25f, 0.25f, 5.0f), Vector3(0.0f, 0.0f, 1.0f), a, bx, cy },
+            // 射线在三角形的平面内
+            { Vector3(-5.0f, 0.25f, 0.0f), Vector3(1.0f, 0.0f, 0.0f), a, bx, cy },
+            // 三点共线、三点重合
+            { Vector3(1.0f, 1.0f, -5.0f), Vector3(0.0f, 0.0f, 1.0f), a, Vector3(1.0f, 1.0f, 0.0f), Vector3(2.0f, 2.0f, 0.0f) },
+            { Vector3(1.0f, 1.0f, -5.0f), Vector3(0.0f, 0.0f, 1.0f), Vector3(1.0f, 1.0f, 0.0f), Vector3(1.0f, 1.0f, 0.0f), Vector3(1.0f, 1.0f, 0.0f) },
+            // 行列式在阈值附近的小三角形
+            { Vector3(0.001f, 0.001f, -5.0f), Vector3(0.0f, 0.0f, 1.0f), a, Vector3(0.01f, 0.0f, 0.0f), Vector3(0.0f, 0.01f, 0.0f) },
+            { Vector3(0.001f, 0.001f, -5.0f), Vector3(0.0f, 0.0f, 1.0f), a, Vector3(0.012f, 0.0f, 0.0f), Vector3(0.0f, 0.009f, 0.0f) },
+            // 方向没有归一化
+            { Vector3(0.3f, 0.3f, -5.0f), Vector3(0.0f, 0.0f, 1e-3f), a, bx, cy },
+        };
+
+        for (const Case &c : cases)
+        {
+            Ray ray;
+            ray.origin_ = c.origin;
+            ray.direction_ = c.direction;
+            rays.push_back(ray);
+            triangles.push_back(c.a);
+            triangles.push_back(c.b);
+            triangles.push_back(c.c);
+        }
+    }
+
+    struct ScalarHit
+    {
+        bool    hit;
+        float   t, u, v;
+    };
+
+    ScalarHit intersectScalar(const Ray &ray, const Vector3 *p)
+    {
+        ScalarHit result;
+        result.hit = ray.intersectTriangle(p[0], p[1], p[2], &result.t, &result.u, &result.v);
+        return result;
+    }
+
+    bool sameHit(const ScalarHit &expected, bool hit, float t, float u, float v)
+    {
+        if (expected.hit != hit)
+        {
+            return false;
+        }
+        return !hit || (sameBits(expected.t, t) && sameBits(expected.u, u) && sameBits(expected.v, v));
+    }
+
+    /** 打包求交与Ray::intersectTriangle逐位对比，第i条射线对准第i个三角形。返回不一致的数量。
+     *  每N条射线和N个三角形为一组，组内的射线两两求交，未使用的通道不能相交。
+     */
+    template<int N>
+    size_t compareTrianglePacket(const std::vector<Ray> &rays, const std::vector<Vector3> &triangles, size_t &nHits)
+    {
+        size_t nMismatches = 0;
+        for (size_t s = 0; s < rays.size(); s += N)
+        {
+            int n = int(std::min<size_t>(N, rays.size() - s));
+            TrianglePacket<N> tris;
+            RayPacket<N> packet;
+            for (int i = 0; i < n; ++i)
+            {
+                const Vector3 *p = &triangles[(s + i) * 3];
+                tris.setTriangle(i, p[0], p[1], p[2]);
+                packet.setRay(i, rays[s + i].origin_, rays[s + i].direction_);
+            }
+
+            // 一条射线与N个三角形
+            for (int r = 0; r < n; ++r)
+            {
+                PacketHit<N> hit;
+                int mask = intersectTrianglePacket(rays[s + r], tris, hit);
+                for (int i = 0; i < N; ++i)
+                {
+                    ScalarHit expected = { false, 0.0f, 0.0f, 0.0f };
+                    if (i < n)
+                    {
+                        expected = intersectScalar(rays[s + r], &triangles[(s + i) * 3]);
+                    }
+                    nMismatches += sameHit(expected, (mask >> i) & 1, hit.t[i], hit.u[i], hit.v[i]) ? 0 : 1;
+                    nHits += expected.hit ? 1 : 0;
+                }
+            }
+
+            // N条射线与一个三角形，边向量的计算与setTriangle相同
+            for (int i = 0; i < n; ++i)
+            {
+                const Vector3 *p = &triangles[(s + i) * 3];
+                Vector3 e1 = p[1] - p[0];
+                Vector3 e2 = p[2] - p[0];
+
+                PacketHit<N> hit;
+                int mask = intersectRayPacket(packet, p[0], e1, e2, hit);
+                for (int r = 0; r < N; ++r)
+                {
+                    ScalarHit expected = { false, 0.0f, 0.0f, 0.0f };
+                    if (r < n)
+                    {
+                        expected = intersectScalar(rays[s + r], p);
+
+                        float t = 0.0f, u = 0.0f, v = 0.0f;
+                        bool edgeHit = intersectTriangleEdges(rays[s + r], p[0], e1, e2, t, u, v);
+                        nMismatches += sameHit(expected, edgeHit, t, u, v) ? 0 : 1;
+                    }
+                    nMismatches += sameHit(expected, (mask >> r) & 1, hit.t[r], hit.u[r], hit.v[r]) ? 0 : 1;
+                }
+            }
+        }
+        return nMismatches;
+    }
+}
+
+void benchRay(BenchmarkRunner &runner)
+{
+    std::mt19937 random(runner.seed_);
+
+    // 每条射线指向对应图元的中心附近，命中率大约在一半左右，两个分支都能测到
+    std::vector<Ray> triangleRays(BatchSize);
+    std::vector<Vector3> triangles(BatchSize * 3);
+    for (size_t i = 0; i < BatchSize; ++i)
+    {
+        Vector3 center = randomVector(random, 5.0f);
+        Vector3 centroid = Vector3::Zero;
+        for (int k = 0; k < 3; ++k)
+        {
+            triangles[i * 3 + k] = center + randomVector(random, 2.0f);
+            centroid += triangles[i * 3 + k] / 3.0f;
+        }
+        triangleRays[i] = randomRay(random, centroid, 0.5f);
+    }
+
+    std::vector<Ray> boxRays(BatchSize);
+    std::vector<AABB> boxes(BatchSize);
+    for (size_t i = 0; i < BatchSize; ++i)
+    {
+        Vector3 center = randomVector(random, 5.0f);
+        Vector3 extent = randomVector(random, 1.0f);
+        boxes[i].setEmpty();
+        boxes[i].addPoint(center - extent);
+        boxes[i].addPoint(center + extent);
+        boxRays[i] = randomRay(random, center, 1.0f);
+    }
+
+    std::uniform_real_distribution<float> radius(0.5f, 1.5f);
+    std::vector<Ray> sphereRays(BatchSize);
+    std::vector<Vector4> spheres(BatchSize);
+    for (size_t i = 0; i < BatchSize; ++i)
+    {
+        Vector3 center = randomVector(random, 5.0f);
+        spheres[i].set(center.x, center.y, center.z, radius(random));
+        sphereRays[i] = randomRay(random, center, 1.0f);
+    }
+
+    std::vector<Matrix> matrices(BatchSize);
+    for (Matrix &mat : matrices)
+    {
+        Vector3 angles = randomVector(random, PI_FULL);
+        Vector3 position = randomVector(random, 10.0f);
+
+        Matrix rotation, translate;
+        rotation.setRotate(angles.x, angles.y, angles.z);
+        translate.setTranslate(position);
+        mat = rotation * translate;
+    }
+
+    runner.run("ray/intersectTriangle", "ray", BatchSize, [&]()
+    {
+        size_t nHits = 0;
+        for (size_t i = 0; i < BatchSize; ++i)
+        {
+            float t, u, v;
+            const Vector3 *p = &triangles[i * 3];
+            nHits += triangleRays[i].intersectTriangle(p[0], p[1], p[2], &t, &u, &v) ? 1 : 0;
+        }
+        return nHits;
+    });
+
+    if (runner.isChecking("check/ray/trianglePacket"))
+    {
+        std::vector<Ray> rays = triangleRays;
+        std::vector<Vector3> tris = triangles;
+        appendSpecialCases(rays, tris);
+
+        size_t nHits4 = 0, nHits8 = 0;
+        size_t nMismatches4 = compareTrianglePacket<4>(rays, tris, nHits4);
+        size_t nMismatches8 = compareTrianglePacket<8>(rays, tris, nHits8);
+        runner.check("check/ray/trianglePacket", nMismatches4 + nMismatches8 == 0,
+            "%s, %d rays, hits: %d/%d, mismatches: %d/%d (4/8 lanes)", getTrianglePacketISA(), (int)rays.size(),
+            (int)nHits4, (int)nHits8, (int)nMismatches4, (int)nMismatches8);
+    }
+
+    runner.run("ray/intersectAABB", "ray", BatchSize, [&]()
+    {
+        size_t nHits = 0;
+        for (size_t i = 0; i < BatchSize; ++i)
+        {
+            float distance;
+            nHits += boxRays[i].intersectAABB(boxes[i], &distance) ? 1 : 0;
+        }
+        return nHits;
+    });
+
+    // 射线预先计算好倒数，只测slab本身
+    std::vector<PrecomputedRay> slabRays(boxRays.begin(), boxRays.end());
+    runner.run("ray/intersectAABB/slab", "ray", BatchSize, [&]()
+    {
+        size_t nHits = 0;
+        for (size_t i = 0; i < BatchSize; ++i)
+        {
+            nHits += slabRays[i].intersectAABB(boxes[i]) ? 1 : 0;
+        }
+        return nHits;
+    });
+
+    // 每条射线测试相邻的4个包围盒
+    std::vector<AABBPacket4> boxPackets(BatchSize / 4);
+    for (size_t i = 0; i < BatchSize; ++i)
+    {
+        boxPackets[i / 4].setAABB(int(i % 4), boxes[i]);
+    }
+    runner.run("ray/intersectAABBPacket4", "box", BatchSize, [&]()
+    {
+        size_t nHits = 0;
+        for (size_t i = 0; i < BatchSize / 4; ++i)
+        {
+            float tNear[4];
+            int mask = intersectAABBPacket(slabRays[i * 4], boxPackets[i], FLT_MAX, tNear);
+            nHits += (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1);
+        }
+        return nHits;
+    });
+
+    if (runner.isChecking("check/ray/slab"))
+    {
+        // 使用独立的随机序列，不影响其他测试的数据
+        std::mt19937 checkRandom(runner.seed_);
+        std::vector<Ray> rays;
+        std::vector<AABB> boxes;
+        createSlabCases(checkRandom, 65534, rays, boxes);
+
+        size_t nHits = 0, nGrazing = 0;
+        size_t nMismatches = compareSlab(rays, boxes, nHits, nGrazing);
+        runner.check("check/ray/slab", nMismatches == 0, "%d pairs, hits: %d, grazing: %d, mismatches: %d",
+            (int)rays.size(), (int)nHits, (int)nGrazing, (int)nMismatches);
+    }
+
+    runner.run("ray/intersectSphere", "ray", BatchSize, [&]()
+    {
+        size_t nHits = 0;
+        for (size_t i = 0; i < BatchSize; ++i)
+        {
+            float t1, t2;
+            const Vector4 &s = spheres[i];
+            nHits += sphereRays[i].intersectSphere(Vector3(s.x, s.y, s.z), s.w, &t1, &t2) ? 1 : 0;
+        }
+        return nHits;
+    });
+
+    std::vector<AABB> transformed(BatchSize);
+    runner.run("aabb/applyMatrix", "box", BatchSize, [&]()
+    {
+        size_t nValid = 0;
+        for (size_t i = 0; i < BatchSize; ++i)
+        {
+            transformed[i] = boxes[i];
+            transformed[i].applyMatrix(matrices[i]);
+            nValid += transformed[i].isValid() ? 1 : 0;
+        }
+        return nValid;
+    });
+}
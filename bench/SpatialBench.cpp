@@ -0,0 +1,432 @@
+#include "Benchmark.h"
+#include "DynamicAABBTree.h"
+#include "Frustum.h"
+#include "Ray.h"
+#include "PrecomputedRay.h"
+#include "Matrix.h"
+
+#include <random>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+    /** 在边长为2 * range的立方体中随机生成n个大小不一的包围盒。*/
+    std::vector<AABB> createBoxes(std::mt19937 &random, size_t n, float range)
+    {
+        std::uniform_real_distribution<float> position(-range, range);
+        std::uniform_real_distribution<float> size(0.1f, 2.0f);
+
+        std::vector<AABB> boxes(n);
+        for (AABB &box : boxes)
+        {
+            Vector3 center(position(random), position(random), position(random));
+            Vector3 extent(size(random), size(random), size(random));
+            box.min_ = center - extent;
+            box.max_ = center + extent;
+        }
+        return boxes;
+    }
+
+    /** 随机创建、移动、删除代理之后，树的结构要保持正确，各种查询的结果与逐个测试胖包围盒相同。*/
+    void checkTree(BenchmarkRunner &runner, const Matrix &viewProj)
+    {
+        const char *name = "check/spatial/tree";
+        if (!runner.isChecking(name))
+        {
+            return;
+        }
+
+        const int nOps = 20000;
+        const float range = 200.0f;
+        std::mt19937 checkRandom(runner.seed_);
+        std::uniform_real_distribution<float> position(-range, range);
+        std::uniform_real_distribution<float> size(0.1f, 4.0f);
+        std::uniform_real_distribution<float> step(-3.0f, 3.0f);
+        std::uniform_int_distribution<int> op(0, 9);
+
+        DynamicAABBTree tree;
+        std::vector<int> proxies;
+        std::vector<AABB> boxes;
+        size_t nValidateFailures = 0;
+        size_t nNotContained = 0;
+        for (int i = 0; i < nOps; ++i)
+        {
+            int kind = proxies.empty() ? 0 : op(checkRandom);
+            if (kind < 4)
+            {
+                // 创建
+                AABB box;
+                Vector3 center(position(checkRandom), position(checkRandom), position(checkRandom));
+                Vector3 extent(size(checkRandom), size(checkRandom), size(checkRandom));
+                box.min_ = center - extent;
+                box.max_ = center + extent;
+                proxies.push_back(tree.createProxy(box, nullptr));
+                boxes.push_back(box);
+            }
+            else
+            {
+                std::uniform_int_distribution<size_t> pick(0, proxies.size() - 1);
+                size_t k = pick(checkRandom);
+                if (kind < 8)
+                {
+                    // 移动，偶尔跳到很远的地方
+                    Vector3 delta(step(checkRandom), step(checkRandom), step(checkRandom));
+                    if (kind == 7)
+                    {
+                        delta *= 20.0f;
+                    }
+                    boxes[k].min_ += delta;
+                    boxes[k].max_ += delta;
+                    tree.moveProxy(proxies[k], boxes[k], delta);
+                }
+                else
+                {
+                    // 删除
+                    tree.destroyProxy(proxies[k]);
+                    proxies[k] = proxies.back();
+                    boxes[k] = boxes.back();
+                    proxies.pop_back();
+                    boxes.pop_back();
+                }
+            }
+
+            if (i % 1000 == 999)
+            {
+                nValidateFailures += tree.validate() && tree.getProxyCount() == proxies.size() ? 0 : 1;
+                for (size_t k = 0; k < proxies.size(); ++k)
+                {
+                    nNotContained += tree.getFatAABB(proxies[k]).contains(boxes[k]) ? 0 : 1;
+                }
+            }
+        }
+
+        // 查询的都是胖包围盒，参考结果逐个测试胖包围盒
+        size_t nMismatches = 0;
+        size_t nResults = 0;
+        auto compare = [&](std::vector<int> &found, std::vector<int> &expected)
+        {
+            std::sort(found.begin(), found.end());
+            std::sort(expected.begin(), expected.end());
+            nMismatches += found == expected ? 0 : 1;
+            nResults += expected.size();
+            found.clear();
+            expected.clear();
+        };
+
+        std::vector<int> found, expected;
+        for (int i = 0; i < 100; ++i)
+        {
+            AABB query;
+            Vector3 center(position(checkRandom), position(checkRandom), position(checkRandom));
+            Vector3 extent(10.0f, 10.0f, 10.0f);
+            query.min_ = center - extent;
+            query.max_ = center + extent;
+            tree.queryAABB(query, [&](int proxy)
+            {
+                found.push_back(proxy);
+                return true;
+            });
+            for (int proxy : proxies)
+            {
+                if (tree.getFatAABB(proxy).intersect(query))
+                {
+                    expected.push_back(proxy);
+                }
+            }
+            compare(found, expected);
+        }
+
+        // 完全在视锥内的子树中的代理，单独测试时也要在视锥内
+        Frustum frustum;
+        frustum.setFromMatrix(viewProj);
+        tree.queryFrustum(frustum, [&](int proxy, bool inside)
+        {
+            found.push_back(proxy);
+            if (inside && frustum.intersectAABB(tree.getFatAABB(proxy)) != Frustum::INSIDE)
+            {
+                ++nMismatches;
+            }
+            return true;
+        });
+        for (int proxy : proxies)
+        {
+            if (frustum.intersectAABB(tree.getFatAABB(proxy)) != Frustum::OUTSIDE)
+            {
+                expected.push_back(proxy);
+            }
+        }
+        compare(found, expected);
+
+        // 射线：不缩短距离时返回所有相交的代理，缩短距离时找到最近的
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+        for (int i = 0; i < 100; ++i)
+        {
+            Ray ray;
+            ray.origin_.set(position(checkRandom), position(checkRandom), position(checkRandom));
+            ray.direction_.set(dist(checkRandom), dist(checkRandom), dist(checkRandom));
+            ray.direction_.normalize();
+            PrecomputedRay pray(ray);
+
+            tree.rayCast(ray, FLT_MAX, [&](int proxy, float tMax)
+            {
+                found.push_back(proxy);
+                return tMax;
+            });
+            float best = FLT_MAX;
+            for (int proxy : proxies)
+            {
+                float tNear, tFar;
+                if (pray.intersectAABB(tree.getFatAABB(proxy), FLT_MAX, tNear, tFar))
+                {
+                    expected.push_back(proxy);
+                    best = std::min(best, tNear);
+                }
+            }
+            compare(found, expected);
+
+            float nearest = FLT_MAX;
+            tree.rayCast(ray, FLT_MAX, [&](int proxy, float tMax)
+            {
+                float tNear, tFar;
+                if (pray.intersectAABB(tree.getFatAABB(proxy), tMax, tNear, tFar) && tNear < nearest)
+                {
+                    nearest = tNear;
+                    return tNear;
+                }
+                return tMax;
+            });
+            nMismatches += nearest == best ? 0 : 1;
+        }
+
+        // 最近的代理
+        for (int i = 0; i < 100; ++i)
+        {
+            Vector3 point(position(checkRandom), position(checkRandom), position(checkRandom));
+            float distance = FLT_MAX;
+            tree.queryNearest(point, FLT_MAX, nullptr, &distance);
+            float best = FLT_MAX;
+            for (int proxy : proxies)
+            {
+                best = std::min(best, sqrtf(tree.getFatAABB(proxy).distanceSquared(point)));
+            }
+            nMismatches += distance == best ? 0 : 1;
+        }
+
+        bool ok = nValidateFailures == 0 && nNotContained == 0 && nMismatches == 0;
+        runner.check(name, ok, "%d ops, %d proxies, height: %d, validate failures: %d, query results: %d, mismatches: %d",
+            nOps, (int)proxies.size(), tree.getHeight(), (int)(nValidateFailures + nNotContained), (int)nResults, (int)nMismatches);
+    }
+
+    /** 点经过clip变换后是否在裁剪空间内。scale小于1时只接受明显在内部的点，大于1时允许点略微超出。*/
+    bool isInClipSpace(const Matrix &clip, const Vector3 &p, float scale)
+    {
+        // transformPoint会做透视除法，这里需要除法之前的w判断点是否在相机后面
+        Vector4 c;
+        clip.transformVector(c, Vector4(p.x, p.y, p.z, 1.0f));
+        float w = c.w * scale;
+        return c.w > 0.0f && std::fabs(c.x) <= w && std::fabs(c.y) <= w && std::fabs(c.z) <= w;
+    }
+
+    /** 用裁剪空间中的采样点检查视锥裁剪：有采样点在视锥内的包围盒不能是OUTSIDE，INSIDE的包围盒所有角点都要在视锥内。
+     *  一半的包围盒直接测试，另一半经过随机的旋转、缩放和平移。
+     */
+    void checkFrustum(BenchmarkRunner &runner, const Matrix &viewProj)
+    {
+        const char *name = "check/spatial/frustum";
+        if (!runner.isChecking(name))
+        {
+            return;
+        }
+
+        const size_t nBoxes = 200000;
+        const int nSamples = 16;
+        std::mt19937 checkRandom(runner.seed_);
+        // 视锥朝向+z，远平面为100，包围盒集中在视锥及其边界附近
+        std::uniform_real_distribution<float> position(-60.0f, 60.0f);
+        std::uniform_real_distribution<float> depth(-20.0f, 120.0f);
+        std::uniform_real_distribution<float> size(0.05f, 20.0f);
+        std::uniform_real_distribution<float> angle(-PI_FULL, PI_FULL);
+        std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+        Frustum frustum;
+        frustum.setFromMatrix(viewProj);
+
+        size_t nVisible = 0, nInside = 0, nFalseRejections = 0, nFalseInside = 0;
+        for (size_t i = 0; i < nBoxes; ++i)
+        {
+            AABB box;
+            Vector3 center(position(checkRandom), position(checkRandom), depth(checkRandom));
+            Vector3 extent(size(checkRandom), size(checkRandom), size(checkRandom));
+            box.min_ = center - extent;
+            box.max_ = center + extent;
+
+            Matrix world;
+            Frustum::Result result;
+            if (i & 1)
+            {
+                Matrix rotation, scaling;
+                rotation.setRotate(angle(checkRandom), angle(checkRandom), angle(checkRandom));
+                scaling.setScale(scale(checkRandom), scale(checkRandom), scale(checkRandom));
+                world = scaling * rotation;
+                world._41 = position(checkRandom) * 0.1f;
+                world._42 = position(checkRandom) * 0.1f;
+                world._43 = position(checkRandom) * 0.1f;
+                result = frustum.intersectAABB(box, world);
+            }
+            else
+            {
+                world.setIdentity();
+                result = frustum.intersectAABB(box);
+            }
+            Matrix clip = world * viewProj;
+
+            // 8个角点、中心和若干内部的随机点
+            bool anyInside = isInClipSpace(clip, box.getCenter(), 0.999f);
+            bool allInside = true;
+            for (int k = 0; k < 8; ++k)
+            {
+                Vector3 corner((k & 1) ? box.max_.x : box.min_.x, (k & 2) ? box.max_.y : box.min_.y, (k & 4) ? box.max_.z : box.min_.z);
+                anyInside = anyInside || isInClipSpace(clip, corner, 0.999f);
+                allInside = allInside && isInClipSpace(clip, corner, 1.001f);
+            }
+            for (int k = 0; k < nSamples && !anyInside; ++k)
+            {
+                Vector3 p = box.min_ + (box.max_ - box.min_) * Vector3(unit(checkRandom), unit(checkRandom), unit(checkRandom));
+                anyInside = isInClipSpace(clip, p, 0.999f);
+            }
+
+            nVisible += anyInside ? 1 : 0;
+            nInside += result == Frustum::INSIDE ? 1 : 0;
+            nFalseRejections += anyInside && result == Frustum::OUTSIDE ? 1 : 0;
+            nFalseInside += result == Frustum::INSIDE && !allInside ? 1 : 0;
+        }
+
+        runner.check(name, nFalseRejections == 0 && nFalseInside == 0 && nVisible > 0 && nInside > 0,
+            "%d boxes, sampled visible: %d, inside: %d, false rejections: %d, false inside: %d",
+            (int)nBoxes, (int)nVisible, (int)nInside, (int)nFalseRejections, (int)nFalseInside);
+    }
+}
+
+void benchSpatial(BenchmarkRunner &runner)
+{
+    const size_t nBoxes = 16384;
+    const float range = 200.0f;
+
+    std::mt19937 random(runner.seed_);
+    std::vector<AABB> boxes = createBoxes(random, nBoxes, range);
+
+    DynamicAABBTree tree;
+    std::vector<int> proxies(nBoxes);
+    for (size_t i = 0; i < nBoxes; ++i)
+    {
+        proxies[i] = tree.createProxy(boxes[i], reinterpret_cast<void*>(i));
+    }
+
+    // 位于场景中心，朝向+z，远平面只覆盖场景的一部分
+    Matrix view, proj;
+    view.lookAt(Vector3::Zero, Vector3(0.0f, 0.0f, 1.0f), Vector3(0.0f, 1.0f, 0.0f));
+    proj.perspectiveProjectionGL(PI_QUARTER, 1.0f, 1.0f, 100.0f);
+    Frustum frustum;
+    frustum.setFromMatrix(view * proj);
+    checkFrustum(runner, view * proj);
+    checkTree(runner, view * proj);
+
+    runner.run("spatial/frustum/linear/16k", "box", nBoxes, [&]()
+    {
+        size_t nVisible = 0;
+        for (const AABB &box : boxes)
+        {
+            nVisible += frustum.intersectAABB(box) != Frustum::OUTSIDE ? 1 : 0;
+        }
+        return nVisible;
+    });
+
+    runner.run("spatial/frustum/tree/16k", "box", nBoxes, [&]()
+    {
+        size_t nVisible = 0;
+        tree.queryFrustum(frustum, [&](int proxy, bool inside)
+        {
+            const AABB &box = boxes[reinterpret_cast<size_t>(tree.getUserData(proxy))];
+            nVisible += inside || frustum.intersectAABB(box) != Frustum::OUTSIDE ? 1 : 0;
+            return true;
+        });
+        return nVisible;
+    });
+
+    // 随机方向的射线，求最近的包围盒
+    const size_t nRays = 256;
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::vector<Ray> rays(nRays);
+    for (Ray &ray : rays)
+    {
+        ray.origin_.set(dist(random) * range, dist(random) * range, dist(random) * range);
+        ray.direction_.set(dist(random), dist(random), dist(random));
+        ray.direction_.normalize();
+    }
+
+    runner.run("spatial/ray/linear/16k", "ray", nRays, [&]()
+    {
+        size_t nHits = 0;
+        for (const Ray &ray : rays)
+        {
+            PrecomputedRay pray(ray);
+            float best = FLT_MAX;
+            for (const AABB &box : boxes)
+            {
+                float tNear, tFar;
+                if (pray.intersectAABB(box, best, tNear, tFar) && tNear < best)
+                {
+                    best = tNear;
+                }
+            }
+            nHits += best < FLT_MAX ? 1 : 0;
+        }
+        return nHits;
+    });
+
+    runner.run("spatial/ray/tree/16k", "ray", nRays, [&]()
+    {
+        size_t nHits = 0;
+        for (const Ray &ray : rays)
+        {
+            PrecomputedRay pray(ray);
+            float best = FLT_MAX;
+            tree.rayCast(ray, FLT_MAX, [&](int proxy, float tMax)
+            {
+                const AABB &box = boxes[reinterpret_cast<size_t>(tree.getUserData(proxy))];
+                float tNear, tFar;
+                if (pray.intersectAABB(box, tMax, tNear, tFar) && tNear < best)
+                {
+                    best = tNear;
+                    return tNear;
+                }
+                return tMax;
+            });
+            nHits += best < FLT_MAX ? 1 : 0;
+        }
+        return nHits;
+    });
+
+    // 每次移动1%的包围盒，大部分仍在胖包围盒内，不需要重新插入
+    std::uniform_int_distribution<size_t> pick(0, nBoxes - 1);
+    std::vector<size_t> moving(nBoxes / 100);
+    for (size_t &i : moving)
+    {
+        i = pick(random);
+    }
+    Vector3 step(0.01f, 0.0f, 0.0f);
+    runner.run("spatial/tree/move/16k", "box", moving.size(), [&]()
+    {
+        size_t nReinserted = 0;
+        for (size_t i : moving)
+        {
+            boxes[i].min_ += step;
+            boxes[i].max_ += step;
+            nReinserted += tree.moveProxy(proxies[i], boxes[i], step) ? 1 : 0;
+        }
+        step = -step;
+        return nReinserted;
+    });
+}
@@ -0,0 +1,219 @@
+#include "Benchmark.h"
+#include "TraceManager.h"
+#include "TraceScene.h"
+#include "VertexDeclaration.h"
+#include "AABB.h"
+#include "MathDef.h"
+
+#include <numeric>
+#include <cmath>
+
+namespace
+{
+    /** 光线追踪demo场景的简化版本，包含反射和阴影。*/
+    const char *SceneText = R"({
+        "camera": { "position": [0, 3, -10], "target": [0, 0, 0], "up": [0, 1, 0], "fov": 45, "near": 1 },
+        "light": { "position": [-2, 5, -4], "color": [1, 1, 1, 1] },
+        "ambient": [0.2, 0.2, 0.2, 1],
+        "materials": [
+            { "color": [1.0, 1.0, 1.0, 1.0], "reflection": 1.0, "refraction": 0.0 },
+            { "color": [1.0, 0.0, 0.0, 1.0], "reflection": 0.3, "refraction": 0.0 },
+            { "color": [0.0, 1.0, 0.0, 1.0], "reflection": 0.3, "refraction": 0.0 }
+        ],
+        "objects": [
+            { "type": "box", "position": [0, -5, 0], "scale": 10, "material": 0 },
+            { "type": "box", "position": [0, 0.5, 0], "scale": 1, "material": 1 },
+            { "type": "box", "position": [2.5, 0.5, 0], "scale": 1.2, "material": 2 },
+            { "type": "plane", "position": [0, 0.01, 3], "scale": [8, 1, 2], "material": 1 },
+            { "type": "quad", "position": [-2.5, 1, 1], "rotation": [0, 30, 0], "scale": 1.5, "material": 2 }
+        ]
+    })";
+
+    const int ImageWidth = 96;
+    const int ImageHeight = 64;
+
+    bool loadScene(TraceManager &mgr, TraceScene &scene)
+    {
+        // 场景中的模型由DemoTool生成，只在加载时需要顶点声明
+        VertexDeclMgr::initInstance();
+        bool loaded = scene.load(SceneText, mgr);
+        VertexDeclMgr::finiInstance();
+        if (!loaded)
+        {
+            return false;
+        }
+        for (MeshInfoPtr &mesh : mgr.meshs_)
+        {
+            mesh->build();
+        }
+        mgr.buildAccelerator();
+        return true;
+    }
+
+    /** 渐进、自适应采样地追踪整个图像，输出每个像素的平均颜色。*/
+    bool traceImage(size_t nThreads, std::vector<float> &colors, size_t &nSamples)
+    {
+        TraceManager mgr(nThreads);
+        TraceScene scene;
+        if (!loadScene(mgr, scene))
+        {
+            return false;
+        }
+
+        mgr.progressive_ = true;
+        mgr.maxSamples_ = 8;
+        mgr.minSamples_ = 2;
+        mgr.initTrace(ImageWidth, ImageHeight, scene.createCamera(float(ImageWidth) / float(ImageHeight)));
+        mgr.waitTrace();
+
+        mgr.getAverageColors(colors);
+        nSamples = mgr.getNumSamples();
+        return true;
+    }
+
+    /** 场景中每种类型的物体由DemoTool的模型生成，按位置和缩放变换到世界空间。
+     *  检查每个物体的三角形数量和包围盒，以及不支持的类型会导致加载失败。
+     */
+    void checkScene(BenchmarkRunner &runner, const char *name)
+    {
+        TraceManager mgr(1);
+        TraceScene scene;
+        bool loaded = loadScene(mgr, scene);
+
+        // 与SceneText中的物体一一对应。quad旋转了30度，x和z方向的包围盒为0.75 * (cos30, sin30)
+        const float quadX = 0.75f * std::cos(PI_FULL / 6.0f);
+        const float quadZ = 0.75f * std::sin(PI_FULL / 6.0f);
+        const struct { size_t nTriangles; Vector3 min, max; } expected[] = {
+            { 12, Vector3(-5.0f, -10.0f, -5.0f), Vector3(5.0f, 0.0f, 5.0f) },
+            { 12, Vector3(-0.5f, 0.0f, -0.5f), Vector3(0.5f, 1.0f, 0.5f) },
+            { 12, Vector3(1.9f, -0.1f, -0.6f), Vector3(3.1f, 1.1f, 0.6f) },
+            { 2, Vector3(-4.0f, 0.01f, 2.0f), Vector3(4.0f, 0.01f, 4.0f) },
+            { 2, Vector3(-2.5f - quadX, 0.25f, 1.0f - quadZ), Vector3(-2.5f + quadX, 1.75f, 1.0f + quadZ) },
+        };
+        const size_t nObjects = sizeof(expected) / sizeof(expected[0]);
+
+        size_t nErrors = loaded && mgr.meshs_.size() == nObjects ? 0 : 1;
+        for (size_t i = 0; nErrors == 0 && i < nObjects; ++i)
+        {
+            const MeshInfo *mesh = mgr.meshs_[i].get();
+            const AABB &bounds = mesh->boundingBox_;
+            nErrors += mesh->triangles_.size() == expected[i].nTriangles &&
+                (bounds.min_ - expected[i].min).length() < 1e-4f && (bounds.max_ - expected[i].max).length() < 1e-4f ? 0 : 1;
+        }
+
+        TraceManager badMgr(1);
+        VertexDeclMgr::initInstance();
+        bool badLoaded = scene.load(R"({ "materials": [ {} ], "objects": [ { "type": "teapot", "material": 0 } ] })", badMgr);
+        VertexDeclMgr::finiInstance();
+        nErrors += badLoaded ? 1 : 0;
+
+        runner.check(name, nErrors == 0, "%d objects, %d triangles, errors: %d",
+            (int)mgr.meshs_.size(), (int)std::accumulate(mgr.meshs_.begin(), mgr.meshs_.end(), size_t(0),
+                [](size_t n, const MeshInfoPtr &mesh) { return n + mesh->triangles_.size(); }), (int)nErrors);
+    }
+
+    /** 追踪的同时不断取走完成的区块，每个位置保留最后一份像素副本。
+     *  最后一轮的副本拼起来要与追踪结束后的图像一致。返回不一致的区块数量。
+     */
+    size_t compareFinishedTiles(size_t &nTiles, int &nPasses)
+    {
+        TraceManager mgr(4);
+        TraceScene scene;
+        if (!loadScene(mgr, scene))
+        {
+            return 1;
+        }
+
+        mgr.progressive_ = true;
+        mgr.maxSamples_ = 8;
+        mgr.minSamples_ = 2;
+        mgr.initTrace(ImageWidth, ImageHeight, scene.createCamera(float(ImageWidth) / float(ImageHeight)));
+
+        std::vector<char> image(ImageWidth * ImageHeight * 4, 0);
+        std::vector<TraceTile> tiles;
+        size_t nErrors = 0;
+        nTiles = 0;
+        bool finished = false;
+        while (!finished)
+        {
+            finished = mgr.isFinished();
+            mgr.popFinishedTiles(tiles);
+            for (const TraceTile &tile : tiles)
+            {
+                nErrors += tile.pixels.size() == size_t(tile.width * tile.height * 4) ? 0 : 1;
+                for (int r = 0; r < tile.height && nErrors == 0; ++r)
+                {
+                    memcpy(&image[((tile.y + r) * ImageWidth + tile.x) * 4], &tile.pixels[r * tile.width * 4], tile.width * 4);
+                }
+            }
+            nTiles += tiles.size();
+        }
+        mgr.waitTrace();
+
+        nErrors += image == mgr.pixels_ ? 0 : 1;
+        nPasses = mgr.getNumPasses();
+        return nErrors;
+    }
+}
+
+void benchTrace(BenchmarkRunner &runner)
+{
+    const char *name = "trace/scene";
+    if (runner.isEnabled(name))
+    {
+        TraceManager mgr(1);
+        TraceScene scene;
+        if (loadScene(mgr, scene))
+        {
+            // 每个像素一个采样，单线程追踪，包括反射和阴影射线
+            mgr.progressive_ = false;
+            TraceCamera camera = scene.createCamera(float(ImageWidth) / float(ImageHeight));
+            runner.run(name, "ray", ImageWidth * ImageHeight, [&]()
+            {
+                mgr.initTrace(ImageWidth, ImageHeight, camera);
+                mgr.waitTrace();
+                return mgr.getNumRays();
+            });
+        }
+    }
+
+    // 每个区块、每一轮使用独立的随机序列，结果应该与线程数量无关
+    const char *checkName = "check/trace/deterministic";
+    if (runner.isChecking(checkName))
+    {
+        std::vector<float> colors1, colors4;
+        size_t nSamples1 = 0, nSamples4 = 0;
+        if (!traceImage(1, colors1, nSamples1) || !traceImage(4, colors4, nSamples4))
+        {
+            runner.check(checkName, false, "failed to load the scene");
+            return;
+        }
+
+        size_t nPixels = ImageWidth * ImageHeight;
+        size_t nMismatches = colors1.size() == colors4.size() ? 0 : 1;
+        for (size_t i = 0; nMismatches == 0 && i < colors1.size(); ++i)
+        {
+            nMismatches += sameBits(colors1[i], colors4[i]) ? 0 : 1;
+        }
+        bool ok = nMismatches == 0 && nSamples1 == nSamples4 && nSamples1 >= nPixels && nSamples1 <= nPixels * 8;
+        runner.check(checkName, ok, "samples: %d/%d (1/4 threads), %.2f per pixel, mismatches: %d",
+            (int)nSamples1, (int)nSamples4, double(nSamples1) / double(nPixels), (int)nMismatches);
+    }
+
+    const char *sceneName = "check/trace/scene";
+    if (runner.isChecking(sceneName))
+    {
+        checkScene(runner, sceneName);
+    }
+
+    // 主线程只从取走的区块副本中读取像素，不与下一轮的写入冲突
+    const char *tilesName = "check/trace/tiles";
+    if (runner.isChecking(tilesName))
+    {
+        size_t nTiles = 0;
+        int nPasses = 0;
+        size_t nErrors = compareFinishedTiles(nTiles, nPasses);
+        runner.check(tilesName, nErrors == 0 && nTiles > 0, "%d tiles in %d passes, errors: %d",
+            (int)nTiles, nPasses, (int)nErrors);
+    }
+}
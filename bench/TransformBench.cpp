@@ -0,0 +1,195 @@
+#include "Benchmark.h"
+#include "Transform.h"
+#include "TransformHierarchy.h"
+#include "ThreadPool.h"
+
+#include <random>
+#include <functional>
+#include <cmath>
+
+namespace
+{
+    /** 生成一棵随机的场景树：根结点下有nGroups个分组，每个分组下是若干层fanOut叉的子树。*/
+    TransformPtr createScene(std::mt19937 &random, int nGroups, int fanOut, int depth, std::vector<Transform*> &nodes)
+    {
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+        std::function<void(Transform*, int)> addChildren = [&](Transform *parent, int level)
+        {
+            int count = level == 0 ? nGroups : fanOut;
+            for (int i = 0; i < count; ++i)
+            {
+                TransformPtr t = new Transform();
+                t->setPosition(dist(random) * 10.0f, dist(random) * 10.0f, dist(random) * 10.0f);
+                t->setRotation(dist(random), dist(random), dist(random));
+                parent->addChild(t);
+                nodes.push_back(t.get());
+                if (level + 1 < depth)
+                {
+                    addChildren(t.get(), level + 1);
+                }
+            }
+        };
+
+        TransformPtr root = new Transform();
+        nodes.push_back(root.get());
+        addChildren(root.get(), 0);
+        return root;
+    }
+
+    /** 与Transform::draw相同的递归累乘，作为对比。*/
+    void updateRecursive(const Transform *node, const Matrix &parent, Matrix *&out)
+    {
+        Matrix world = node->getModelMatrix() * parent;
+        *out++ = world;
+        for (const TransformPtr &child : node->getChildren())
+        {
+            updateRecursive(child.get(), world, out);
+        }
+    }
+
+    /** 每个结点的世界矩阵与沿父结点链逐个相乘的结果对比，返回最大的相对误差。*/
+    float compareWorldMatrices(const TransformHierarchy &hierarchy, size_t &nChecked)
+    {
+        float maxError = 0.0f;
+        const std::vector<Transform*> &nodes = hierarchy.getNodes();
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            Matrix expected = nodes[i]->getModelMatrix();
+            for (const Transform *p = nodes[i]->getParent(); p != nullptr; p = p->getParent())
+            {
+                expected = expected * p->getModelMatrix();
+            }
+
+            const Matrix &world = hierarchy.getWorldMatrix(int(i));
+            for (int r = 0; r < 4; ++r)
+            {
+                for (int c = 0; c < 4; ++c)
+                {
+                    float error = std::fabs(world.m[r][c] - expected.m[r][c]) / std::max(1.0f, std::fabs(expected.m[r][c]));
+                    maxError = std::max(maxError, error);
+                }
+            }
+            ++nChecked;
+        }
+        return maxError;
+    }
+
+    bool isAncestor(const Transform *node, const Transform *descendant)
+    {
+        for (const Transform *p = descendant; p != nullptr; p = p->getParent())
+        {
+            if (p == node)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+void benchTransform(BenchmarkRunner &runner)
+{
+    // 64 * (1 + 16 + 256) = 17473个结点
+    std::mt19937 random(runner.seed_);
+    std::vector<Transform*> nodes;
+    TransformPtr root = createScene(random, 64, 16, 3, nodes);
+    size_t nNodes = nodes.size();
+
+    std::vector<Matrix> worlds(nNodes);
+    runner.run("transform/recursive/17k", "node", nNodes, [&]()
+    {
+        Matrix *out = worlds.data();
+        updateRecursive(root.get(), Matrix::Identity, out);
+        return size_t(out - worlds.data());
+    });
+
+    runner.run("transform/localToWorld/17k", "node", nNodes, [&]()
+    {
+        for (size_t i = 0; i < nNodes; ++i)
+        {
+            worlds[i] = nodes[i]->getLocalToWorldMatrix();
+        }
+        return nNodes;
+    });
+
+    TransformHierarchy hierarchy;
+    hierarchy.setRoot(root);
+    hierarchy.update();
+
+    // 修改根结点，所有的结点都需要重新计算
+    runner.run("transform/hierarchy/full/17k", "node", nNodes, [&]()
+    {
+        root->setPosition(root->getPosition());
+        hierarchy.update();
+        return hierarchy.getNumUpdated();
+    });
+
+    // 每次只移动1%的结点
+    std::uniform_int_distribution<size_t> pick(1, nNodes - 1);
+    std::vector<Transform*> moving(nNodes / 100);
+    for (Transform *&node : moving)
+    {
+        node = nodes[pick(random)];
+    }
+    runner.run("transform/hierarchy/partial/17k", "node", nNodes, [&]()
+    {
+        for (Transform *node : moving)
+        {
+            node->setPosition(node->getPosition());
+        }
+        hierarchy.update();
+        return hierarchy.getNumUpdated();
+    });
+
+    ThreadPool pool;
+    runner.run("transform/hierarchy/parallel/17k", "node", nNodes, [&]()
+    {
+        root->setPosition(root->getPosition());
+        hierarchy.update(&pool);
+        return hierarchy.getNumUpdated();
+    });
+
+    // 乘法的结合顺序不同，所以只能在误差范围内相同
+    const char *checkName = "check/transform/hierarchy";
+    if (runner.isChecking(checkName))
+    {
+        std::mt19937 checkRandom(runner.seed_);
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+        size_t nChecked = 0;
+
+        root->setPosition(1.0f, 2.0f, 3.0f);
+        hierarchy.update();
+        float fullError = compareWorldMatrices(hierarchy, nChecked);
+
+        // 移动一部分结点，用线程池更新
+        for (Transform *node : moving)
+        {
+            node->setPosition(dist(checkRandom) * 10.0f, dist(checkRandom) * 10.0f, dist(checkRandom) * 10.0f);
+        }
+        hierarchy.setParallelThreshold(1);
+        hierarchy.update(&pool);
+        float partialError = compareWorldMatrices(hierarchy, nChecked);
+
+        // 把一些子树挂到别的结点下面，结构需要重建
+        for (int i = 0; i < 32; ++i)
+        {
+            Transform *node = nodes[pick(checkRandom)];
+            Transform *parent = nodes[pick(checkRandom)];
+            if (isAncestor(node, parent))
+            {
+                continue;
+            }
+            TransformPtr child(node);
+            node->getParent()->removeChild(child);
+            parent->addChild(child);
+        }
+        hierarchy.update();
+        float restructureError = compareWorldMatrices(hierarchy, nChecked);
+
+        float maxError = std::max(fullError, std::max(partialError, restructureError));
+        runner.check(checkName, maxError <= 1e-5f && hierarchy.size() == nNodes,
+            "%d matrices, max error: %.2e/%.2e/%.2e (full/partial/restructure)",
+            (int)nChecked, fullError, partialError, restructureError);
+    }
+}
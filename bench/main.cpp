@@ -0,0 +1,100 @@
+/** 光线追踪、矩阵运算、网格优化、缓冲区压缩、场景树更新、空间查询、遮挡剔除、帧分析器作用域等热点路径的微基准测试。
+ *  用法：raytrace_bench [--json result.json] [--filter ray/] [--min-time 0.5] [--repeats 5] [--seed 12345] [--max-triangles 1000000] [--check]
+ *  输出每个测试的ns/op，射线相关的测试额外输出Mrays/s。数据由固定的种子生成，不同版本之间可以直接对比。
+ *  渲染相关的测试在render目录下的render_bench中。
+ *  --check是自检模式：每个测试只运行一次，再把优化的实现与参考实现逐一对比，有检查失败时返回1。
+ *  可以配合--filter只运行一部分检查，比如--check --filter check/ray/。ctest会以自检模式运行。
+ */
+#include "Benchmark.h"
+#include "TrianglePacket.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    void printUsage(const char *exe)
+    {
+        printf("usage: %s [options]\n"
+            "  --json <file>           write results as json\n"
+            "  --filter <text>         only run benchmarks whose name contains text\n"
+            "  --min-time <seconds>    minimum running time of each benchmark (default 0.5)\n"
+            "  --repeats <n>           number of timed rounds, the median is reported (default 5)\n"
+            "  --seed <n>              random seed (default 12345)\n"
+            "  --max-triangles <n>     skip meshes larger than n triangles (default 1000000)\n"
+            "  --res <dir>             res directory used by render benchmarks (default: searched upwards from the exe)\n"
+            "  --check                 run every benchmark once and compare the optimized paths with reference implementations\n",
+            exe);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    BenchmarkRunner runner;
+    std::string jsonPath;
+    size_t maxTriangles = 1000000;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--check") == 0)
+        {
+            runner.checkMode_ = true;
+            continue;
+        }
+
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (value == nullptr)
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+        ++i;
+
+        if (runner.parseOption(arg, value))
+        {
+            continue;
+        }
+
+        if (strcmp(arg, "--json") == 0)
+        {
+            jsonPath = value;
+        }
+        else if (strcmp(arg, "--max-triangles") == 0)
+        {
+            maxTriangles = (size_t)strtoull(value, nullptr, 10);
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    const char *isa = getTrianglePacketISA();
+    printf("seed: %u, isa: %s\n", runner.seed_, isa);
+
+    benchRay(runner);
+    benchMatrix(runner);
+    benchMesh(runner, maxTriangles);
+    benchCompression(runner);
+    benchTransform(runner);
+    benchSpatial(runner);
+    benchOcclusion(runner);
+    benchTrace(runner);
+    benchProfiler(runner);
+
+
+    if (runner.checkMode_)
+    {
+        runner.checkJSON("raytrace_bench_check.json", isa);
+        printf("%d check(s) failed\n", runner.getFailureCount());
+    }
+
+    if (!jsonPath.empty() && !runner.writeJSON(jsonPath, isa))
+    {
+        printf("Failed to write '%s'.\n", jsonPath.c_str());
+        return 1;
+    }
+    return runner.getFailureCount() == 0 ? 0 : 1;
+}
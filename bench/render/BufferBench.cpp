@@ -0,0 +1,443 @@
+#include "RenderBench.h"
+#include "Mesh.h"
+#include "Vertex.h"
+#include "HeadlessContext.h"
+#include "GLStateCache.h"
+
+#include <random>
+
+namespace
+{
+    /** 调用流中的一次glBufferData或glBufferSubData。*/
+    struct BufferUpload
+    {
+        size_t      offset;
+        size_t      size;
+        const void* data;
+        bool        newStorage;
+    };
+
+    std::vector<BufferUpload> getBufferUploads(const GLRecorder &recorder)
+    {
+        std::vector<BufferUpload> uploads;
+        recorder.iterateCalls([&](GLFunction::Type fn, const uint8_t *args, size_t size)
+        {
+            const uint8_t *p = args + sizeof(GLenum);
+            BufferUpload upload = BufferUpload();
+            GLintptr offset = 0;
+            GLsizeiptr bytes = 0;
+            if (fn == GLFunction::ID_glBufferData && size == sizeof(GLenum) * 2 + sizeof(GLsizeiptr) + sizeof(void*))
+            {
+                memcpy(&bytes, p, sizeof(bytes));
+                memcpy(&upload.data, p + sizeof(bytes), sizeof(void*));
+                upload.newStorage = true;
+            }
+            else if (fn == GLFunction::ID_glBufferSubData && size == sizeof(GLenum) + sizeof(GLintptr) + sizeof(GLsizeiptr) + sizeof(void*))
+            {
+                memcpy(&offset, p, sizeof(offset));
+                memcpy(&bytes, p + sizeof(offset), sizeof(bytes));
+                memcpy(&upload.data, p + sizeof(offset) + sizeof(bytes), sizeof(void*));
+            }
+            else
+            {
+                return;
+            }
+            upload.offset = size_t(offset);
+            upload.size = size_t(bytes);
+            uploads.push_back(upload);
+        });
+        return uploads;
+    }
+
+    /** 256x256的地形网格，高度随机。*/
+    void createTerrain(std::mt19937 &random, std::vector<MeshVertex> &vertices, std::vector<uint32_t> &indices)
+    {
+        const int nGrids = 256;
+        std::uniform_real_distribution<float> height(-1.0f, 1.0f);
+        vertices.resize((nGrids + 1) * (nGrids + 1));
+        for (size_t i = 0; i < vertices.size(); ++i)
+        {
+            float x = float(i % (nGrids + 1));
+            float z = float(i / (nGrids + 1));
+            vertices[i].position.set(x, height(random), z);
+            vertices[i].normal.set(0.0f, 1.0f, 0.0f);
+            vertices[i].uv.set(x / nGrids, z / nGrids);
+            vertices[i].tangent.set(1.0f, 0.0f, 0.0f);
+        }
+        indices.clear();
+        for (int z = 0; z < nGrids; ++z)
+        {
+            for (int x = 0; x < nGrids; ++x)
+            {
+                uint32_t a = z * (nGrids + 1) + x;
+                uint32_t b = a + nGrids + 1;
+                uint32_t quad[6] = { a, b, a + 1, a + 1, b, b + 1 };
+                indices.insert(indices.end(), quad, quad + 6);
+            }
+        }
+    }
+
+    /** 每帧随机修改动态缓冲区中的若干段，按调用流把上传的数据写入显存的镜像，镜像要与内存中的数据一致。
+     *  没有重新分配存储时，上传的区间互不重叠；修改不超过32段时，上传的字节恰好是修改过的字节。
+     *  每隔一段时间修改一半的数据触发orphan，或者增大缓冲区触发重新分配。
+     */
+    void checkBufferRanges(BenchmarkRunner &runner, GLRecorder &recorder)
+    {
+        const char *name = "check/render/buffer/ranges";
+        if (!runner.isChecking(name))
+        {
+            return;
+        }
+
+        std::mt19937 checkRandom(runner.seed_);
+        std::uniform_int_distribution<uint32_t> value;
+        std::vector<uint32_t> data(4096);
+        for (uint32_t &v : data)
+        {
+            v = value(checkRandom);
+        }
+        VertexBufferPtr vb = new VertexBufferEx<uint32_t>(BufferUsage::Dynamic, data.size(), data.data());
+        std::vector<uint8_t> gpu;
+        // 之前的测试留下的上传不计入第一帧
+        BufferBase::endFrame();
+
+        recorder.setStreamEnable(true);
+        const int nFrames = 200;
+        size_t nMismatches = 0, nRangeErrors = 0, nStatErrors = 0, nPartialFrames = 0;
+        for (int frame = 0; frame < nFrames; ++frame)
+        {
+            recorder.clear();
+            std::vector<uint8_t> dirty(data.size() * sizeof(uint32_t), 0);
+            size_t nEdits = 0;
+            if (frame % 50 == 25)
+            {
+                data.resize(data.size() + 512);
+                for (uint32_t &v : data)
+                {
+                    v = value(checkRandom);
+                }
+                vb->resize(data.size(), data.data());
+                dirty.assign(data.size() * sizeof(uint32_t), 1);
+            }
+            else
+            {
+                bool half = frame % 50 == 49;
+                nEdits = half ? 1 : std::uniform_int_distribution<size_t>(1, 48)(checkRandom);
+                for (size_t i = 0; i < nEdits; ++i)
+                {
+                    size_t count = half ? data.size() / 2 : std::uniform_int_distribution<size_t>(1, 64)(checkRandom);
+                    size_t start = std::uniform_int_distribution<size_t>(0, data.size() - count)(checkRandom);
+                    for (size_t k = start; k < start + count; ++k)
+                    {
+                        data[k] = value(checkRandom);
+                    }
+                    if (i & 1)
+                    {
+                        memcpy(vb->lockRange(start, count), &data[start], count * sizeof(uint32_t));
+                        vb->unlock();
+                    }
+                    else
+                    {
+                        vb->fill(start, count, &data[start]);
+                    }
+                    memset(&dirty[start * sizeof(uint32_t)], 1, count * sizeof(uint32_t));
+                }
+            }
+            vb->bind();
+            BufferBase::endFrame();
+
+            std::vector<BufferUpload> uploads = getBufferUploads(recorder);
+            std::vector<uint8_t> uploaded(dirty.size(), 0);
+            bool newStorage = false;
+            size_t nBytes = 0;
+            for (const BufferUpload &upload : uploads)
+            {
+                if (upload.newStorage)
+                {
+                    gpu.resize(upload.size);
+                    newStorage = true;
+                }
+                if (upload.data == nullptr)
+                {
+                    continue;
+                }
+                if (upload.offset + upload.size > gpu.size())
+                {
+                    ++nRangeErrors;
+                    continue;
+                }
+                memcpy(&gpu[upload.offset], upload.data, upload.size);
+                nBytes += upload.size;
+                for (size_t k = upload.offset; k < upload.offset + upload.size && k < uploaded.size(); ++k)
+                {
+                    nRangeErrors += uploaded[k]++ == 0 || newStorage ? 0 : 1;
+                }
+            }
+            nMismatches += gpu.size() >= dirty.size() && memcmp(gpu.data(), data.data(), dirty.size()) == 0 ? 0 : 1;
+
+            const BufferBase::UploadStats &stats = BufferBase::getUploadStats();
+            nStatErrors += stats.nCalls == uploads.size() && stats.nBytes == nBytes ? 0 : 1;
+            if (!newStorage)
+            {
+                ++nPartialFrames;
+                for (size_t k = 0; k < dirty.size(); ++k)
+                {
+                    bool ok = nEdits <= 32 ? (uploaded[k] != 0) == (dirty[k] != 0) : uploaded[k] != 0 || dirty[k] == 0;
+                    nRangeErrors += ok ? 0 : 1;
+                }
+                nRangeErrors += uploads.size() <= 32 ? 0 : 1;
+            }
+        }
+        vb->unbind();
+        recorder.setStreamEnable(false);
+        recorder.clear();
+
+        runner.check(name, nMismatches == 0 && nRangeErrors == 0 && nStatErrors == 0 && nPartialFrames > 0,
+            "%d frames, %d partial, mismatches: %d, range errors: %d, stats errors: %d",
+            nFrames, (int)nPartialFrames, (int)nMismatches, (int)nRangeErrors, (int)nStatErrors);
+    }
+}
+
+void benchBuffers(BenchmarkRunner &runner, GLRecorder &recorder)
+{
+    checkBufferRanges(runner, recorder);
+
+    std::mt19937 random(runner.seed_);
+
+    // 64k个顶点的动态缓冲区，每帧修改4段、每段64个顶点，与整体重新上传对比
+    {
+        const size_t nVertices = 64 * 1024;
+        const size_t nRanges = 4;
+        const size_t rangeSize = 64;
+        std::vector<MeshVertex> vertices(nVertices);
+        VertexBufferPtr vb = new VertexBufferEx<MeshVertex>(BufferUsage::Dynamic, nVertices, vertices.data());
+        vb->bind();
+        BufferBase::endFrame();
+
+        std::uniform_int_distribution<size_t> rangeStart(0, nVertices - rangeSize);
+        auto uploadFrame = [&](bool partial)
+        {
+            for (size_t i = 0; i < nRanges; ++i)
+            {
+                size_t start = rangeStart(random);
+                vertices[start].position.x += 1.0f;
+                if (partial)
+                {
+                    vb->fill(start, rangeSize, &vertices[start]);
+                }
+            }
+            if (!partial)
+            {
+                vb->resize(nVertices, vertices.data());
+            }
+            vb->bind();
+            BufferBase::endFrame();
+            return BufferBase::getUploadStats().nBytes;
+        };
+
+        runner.run("render/buffer/partial/64k", "frame", 1, [&]()
+        {
+            return uploadFrame(true);
+        });
+        runner.run("render/buffer/full/64k", "frame", 1, [&]()
+        {
+            return uploadFrame(false);
+        });
+
+        // 部分修改只用glBufferSubData上传修改过的段，整体重新上传时orphan一次
+        const char *uploadName = "check/render/buffer/64k";
+        if (runner.isChecking(uploadName))
+        {
+            const size_t rangeBytes = rangeSize * sizeof(MeshVertex);
+            uploadFrame(true);
+            BufferBase::UploadStats partial = BufferBase::getUploadStats();
+            uploadFrame(false);
+            const BufferBase::UploadStats &full = BufferBase::getUploadStats();
+            bool ok = partial.nOrphans == 0 && partial.nCalls >= 1 && partial.nCalls <= nRanges &&
+                partial.nBytes >= rangeBytes && partial.nBytes <= nRanges * rangeBytes &&
+                full.nOrphans == 1 && full.nCalls == 2 && full.nBytes == nVertices * sizeof(MeshVertex);
+            runner.check(uploadName, ok, "partial: %d bytes in %d calls, full: %d bytes in %d calls, %d orphans",
+                (int)partial.nBytes, (int)partial.nCalls, (int)full.nBytes, (int)full.nCalls, (int)full.nOrphans);
+        }
+        vb->unbind();
+    }
+
+    // 256x256的地形网格上传之后，按不同的residency保留内存中的副本，lock(true)时恢复
+    {
+        std::vector<MeshVertex> vertices;
+        std::vector<uint32_t> indices;
+        createTerrain(random, vertices, indices);
+
+        // Discard的lock要从显存读回，空后端上没有实际的读回，在benchBufferReadback中用真实的GL计时
+        const BufferResidency residencies[] = { BufferResidency::Keep, BufferResidency::Compressed, BufferResidency::Discard };
+        const char *names[] = { "keep", "compressed" };
+        for (int i = 0; i < 2; ++i)
+        {
+            VertexBufferPtr vb = new VertexBufferEx<MeshVertex>(BufferUsage::Static, vertices.size(), vertices.data());
+            IndexBufferPtr ib = new IndexBufferEx<uint32_t>(BufferUsage::Static, indices.size(), indices.data());
+            vb->setResidency(residencies[i]);
+            ib->setResidency(residencies[i]);
+            vb->bind();
+            ib->bind();
+            vb->unbind();
+            ib->unbind();
+
+            std::string name = std::string("render/residency/lock/") + names[i];
+            runner.run(name, "vertex", vertices.size(), [&]()
+            {
+                const char *p = vb->lock(true);
+                size_t n = p != nullptr ? size_t(p[0]) : 0;
+                vb->unlock();
+                return n;
+            });
+        }
+
+        // 上传之后只有Keep保留副本，Compressed只保留压缩数据，Discard不占用内存。lock可以嵌套，最外层的unlock之后才释放，
+        // 修改过的数据在重新上传之前一直保留。Discard的lock用一次glGetBufferSubData读回，空后端不返回数据，
+        // 这里不比较内容，由check/render/residency/readback在真实的GL上比较
+        const char *residencyName = "check/render/residency";
+        if (runner.isChecking(residencyName))
+        {
+            const size_t bytes = vertices.size() * sizeof(MeshVertex);
+            size_t nErrors = 0;
+            size_t memory[3];
+            for (int i = 0; i < 3; ++i)
+            {
+                bool keep = residencies[i] == BufferResidency::Keep;
+                bool discard = residencies[i] == BufferResidency::Discard;
+                std::vector<MeshVertex> expected = vertices;
+                VertexBufferPtr vb = new VertexBufferEx<MeshVertex>(BufferUsage::Static, expected.size(), expected.data());
+                vb->setResidency(residencies[i]);
+                // 还没有上传的数据不能释放
+                nErrors += vb->isResident() ? 0 : 1;
+                vb->bind();
+                vb->unbind();
+                nErrors += vb->isResident() == keep ? 0 : 1;
+                memory[i] = vb->getCPUMemory();
+
+                recorder.clear();
+                const char *p = vb->lock(true);
+                nErrors += vb->lock(true) == p ? 0 : 1;
+                nErrors += discard || memcmp(p, expected.data(), bytes) == 0 ? 0 : 1;
+                vb->unlock();
+                nErrors += vb->isResident() ? 0 : 1;
+                vb->unlock();
+                nErrors += vb->isResident() == keep && vb->getCPUMemory() == memory[i] ? 0 : 1;
+                nErrors += recorder.getCallCount(GLFunction::ID_glGetBufferSubData) == (discard ? 1u : 0u) ? 0 : 1;
+
+                MeshVertex *v = (MeshVertex*)vb->lock();
+                v[0].position.x = expected[0].position.x = 1000.0f;
+                vb->unlock();
+                nErrors += vb->isResident() ? 0 : 1;
+                vb->bind();
+                vb->unbind();
+                nErrors += vb->isResident() == keep ? 0 : 1;
+                p = vb->lock(true);
+                nErrors += discard || memcmp(p, expected.data(), bytes) == 0 ? 0 : 1;
+                vb->unlock();
+
+                // 切换到Keep时恢复副本
+                vb->setResidency(BufferResidency::Keep);
+                nErrors += vb->isResident() ? 0 : 1;
+                p = vb->lock(true);
+                nErrors += discard || memcmp(p, expected.data(), bytes) == 0 ? 0 : 1;
+                vb->unlock();
+            }
+
+            // Model::load通过Mesh::setResidency同时设置顶点和索引缓冲区
+            MeshPtr mesh = new Mesh();
+            mesh->setVertexBuffer(new VertexBufferEx<MeshVertex>(BufferUsage::Static, vertices.size(), vertices.data()));
+            mesh->setIndexBuffer(new IndexBufferEx<uint32_t>(BufferUsage::Static, indices.size(), indices.data()));
+            mesh->setResidency(BufferResidency::Compressed);
+            mesh->getVertexBuffer()->bind();
+            mesh->getIndexBuffer()->bind();
+            mesh->getVertexBuffer()->unbind();
+            mesh->getIndexBuffer()->unbind();
+            nErrors += mesh->getVertexBuffer()->isResident() || mesh->getIndexBuffer()->isResident() ? 1 : 0;
+
+            bool ok = nErrors == 0 && memory[0] >= bytes && memory[1] > 0 && memory[1] * 4 < bytes && memory[2] == 0;
+            runner.check(residencyName, ok, "cpu memory: %d/%d/%d bytes of %d (keep/compressed/discard), errors: %d",
+                (int)memory[0], (int)memory[1], (int)memory[2], (int)bytes, (int)nErrors);
+        }
+    }
+}
+
+void benchBufferReadback(BenchmarkRunner &runner)
+{
+    const char *name = "check/render/residency/readback";
+    if (!runner.isGroupEnabled("render"))
+    {
+        return;
+    }
+
+#ifdef BENCH_USE_EGL
+    HeadlessContext context;
+    if (!context.create())
+    {
+        runner.check(name, false, "failed to create an EGL context");
+        return;
+    }
+
+    GLDispatch::initInstance();
+    GLStateCache::initInstance();
+    GLStateCache::instance()->reset();
+
+    std::mt19937 random(runner.seed_);
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+    createTerrain(random, vertices, indices);
+    {
+        VertexBufferPtr vb = new VertexBufferEx<MeshVertex>(BufferUsage::Static, vertices.size(), vertices.data());
+        IndexBufferPtr ib = new IndexBufferEx<uint32_t>(BufferUsage::Static, indices.size(), indices.data());
+        vb->setResidency(BufferResidency::Discard);
+        ib->setResidency(BufferResidency::Discard);
+        vb->bind();
+        ib->bind();
+
+        // 每次lock都用glGetBufferSubData从显存读回整个缓冲区
+        runner.run("render/residency/lock/discard", "vertex", vertices.size(), [&]()
+        {
+            const char *p = vb->lock(true);
+            size_t n = p != nullptr ? size_t(p[0]) : 0;
+            vb->unlock();
+            return n;
+        });
+
+        // 读回的数据与上传的逐字节相同；修改并重新上传之后，读回的是修改后的数据
+        if (runner.isChecking(name))
+        {
+            size_t nErrors = 0;
+            nErrors += vb->isResident() || ib->isResident() ? 1 : 0;
+
+            const char *p = vb->lock(true);
+            nErrors += p != nullptr && memcmp(p, vertices.data(), vertices.size() * sizeof(MeshVertex)) == 0 ? 0 : 1;
+            vb->unlock();
+            p = ib->lock(true);
+            nErrors += p != nullptr && memcmp(p, indices.data(), indices.size() * sizeof(uint32_t)) == 0 ? 0 : 1;
+            ib->unlock();
+
+            MeshVertex *v = (MeshVertex*)vb->lockRange(100, 1);
+            v->position.y = vertices[100].position.y = 1000.0f;
+            vb->unlock();
+            vb->bind();
+            nErrors += vb->isResident() ? 1 : 0;
+            p = vb->lock(true);
+            nErrors += p != nullptr && memcmp(p, vertices.data(), vertices.size() * sizeof(MeshVertex)) == 0 ? 0 : 1;
+            vb->unlock();
+
+            runner.check(name, nErrors == 0 && glGetError() == GL_NO_ERROR, "%d vertices, %d indices, errors: %d, renderer: %s",
+                (int)vertices.size(), (int)indices.size(), (int)nErrors, (const char*)glGetString(GL_RENDERER));
+        }
+        vb->unbind();
+        ib->unbind();
+    }
+
+    GLStateCache::finiInstance();
+    GLDispatch::finiInstance();
+#else
+    if (runner.isChecking(name))
+    {
+        printf("%-40s %-8s %s\n", name, "skipped", "built without EGL, no GL context to read buffers back");
+    }
+#endif
+}
@@ -0,0 +1,185 @@
+#include "RenderBench.h"
+#include "GLStateCache.h"
+#include "Renderer.h"
+#include "DebugDraw.h"
+#include "AABB.h"
+#include "PathTool.h"
+
+#include <random>
+
+namespace
+{
+    /** 调试绘制的一次glDrawArrays，以及当时是否开启了深度测试。*/
+    struct DrawRange
+    {
+        GLenum  mode;
+        GLint   first;
+        GLsizei count;
+        bool    depthTest;
+
+        bool operator == (const DrawRange &r) const
+        {
+            return mode == r.mode && first == r.first && count == r.count && depthTest == r.depthTest;
+        }
+    };
+
+    /** 从调用流中按顺序取出所有的glDrawArrays。depthTest为开始记录时深度测试的状态。*/
+    std::vector<DrawRange> getDrawRanges(const GLRecorder &recorder, bool depthTest)
+    {
+        std::vector<DrawRange> ranges;
+        recorder.iterateCalls([&](GLFunction::Type fn, const uint8_t *args, size_t size)
+        {
+            if ((fn == GLFunction::ID_glEnable || fn == GLFunction::ID_glDisable) && size == sizeof(GLenum))
+            {
+                GLenum cap;
+                memcpy(&cap, args, sizeof(cap));
+                if (cap == GL_DEPTH_TEST)
+                {
+                    depthTest = fn == GLFunction::ID_glEnable;
+                }
+            }
+            else if (fn == GLFunction::ID_glDrawArrays && size == sizeof(GLenum) + sizeof(GLint) + sizeof(GLsizei))
+            {
+                DrawRange range;
+                memcpy(&range.mode, args, sizeof(GLenum));
+                memcpy(&range.first, args + sizeof(GLenum), sizeof(GLint));
+                memcpy(&range.count, args + sizeof(GLenum) + sizeof(GLint), sizeof(GLsizei));
+                range.depthTest = depthTest;
+                ranges.push_back(range);
+            }
+        });
+        return ranges;
+    }
+
+    /** 调试绘制：每种图元和深度模式只绘制一次，各批次在环形缓冲区中首尾相接；
+     *  环形缓冲区放不下时重新分配存储，一帧的数据超过容量时容量翻倍。
+     *  检查用16个顶点的小缓冲区，结束后重新创建DebugDraw。
+     */
+    void checkDebugDraw(BenchmarkRunner &runner, GLRecorder &recorder, const std::string &resPath)
+    {
+        const char *name = "check/render/debugdraw";
+        if (!runner.isChecking(name))
+        {
+            return;
+        }
+
+        DebugDraw *debugDraw = DebugDraw::instance();
+        if (!debugDraw->init(joinPath(resPath, "common/shader/xyzcolor.shader"), 16))
+        {
+            runner.check(name, false, "failed to initialize DebugDraw");
+            return;
+        }
+
+        const Color colors[] = { Color(1.0f, 0.0f, 0.0f), Color(0.0f, 1.0f, 0.0f), Color(0.0f, 0.0f, 1.0f), Color(1.0f, 1.0f, 1.0f) };
+        Renderer *renderer = Renderer::instance();
+        size_t nErrors = 0;
+        size_t nOrphans = 0;
+        auto drawFrame = [&](const std::vector<DrawRange> &expected, size_t expectedOrphans)
+        {
+            GLStateCache::instance()->reset();
+            bool depthTest = GLStateCache::instance()->isEnabled(GL_DEPTH_TEST);
+            recorder.clear();
+            debugDraw->draw(renderer);
+
+            const DebugDraw::Stats &stats = debugDraw->getStats();
+            nErrors += getDrawRanges(recorder, depthTest) == expected ? 0 : 1;
+            nErrors += stats.nDrawCalls == expected.size() && stats.nOrphans == expectedOrphans ? 0 : 1;
+            // 每帧只映射一次缓冲区，绘制之后恢复默认的深度模式
+            nErrors += recorder.getCallCount(GLFunction::ID_glMapBufferRange) == 1 ? 0 : 1;
+            nErrors += debugDraw->getDepthMode() == DebugDraw::DepthTest ? 0 : 1;
+            nOrphans += stats.nOrphans;
+        };
+
+        recorder.setStreamEnable(true);
+
+        // 两种深度模式交替提交，按深度模式、图元类型合并：15个顶点，4次绘制
+        Vector3 points[2] = { Vector3(0.0f, 0.0f, 0.0f), Vector3(1.0f, 0.0f, 0.0f) };
+        debugDraw->drawLine(Vector3::Zero, Vector3(1.0f, 0.0f, 0.0f), colors[0]);
+        debugDraw->setDepthMode(DebugDraw::NoDepthTest);
+        debugDraw->drawLine(Vector3::Zero, Vector3(0.0f, 1.0f, 0.0f), colors[1]);
+        debugDraw->setDepthMode(DebugDraw::DepthTest);
+        debugDraw->drawPoints(points, 2, colors[2]);
+        debugDraw->drawFilledTriangle(Vector3::Zero, Vector3(1.0f, 0.0f, 0.0f), Vector3(0.0f, 1.0f, 0.0f), colors[3]);
+        debugDraw->drawLine(Vector3::Zero, Vector3(0.0f, 0.0f, 1.0f), colors[1]);
+        debugDraw->drawLine(Vector3(1.0f, 0.0f, 0.0f), Vector3(1.0f, 1.0f, 0.0f), colors[2]);
+        debugDraw->setDepthMode(DebugDraw::NoDepthTest);
+        debugDraw->drawLine(Vector3(1.0f, 1.0f, 0.0f), Vector3(0.0f, 1.0f, 0.0f), colors[3]);
+        drawFrame({ { GL_POINTS, 0, 2, true }, { GL_LINES, 2, 6, true }, { GL_TRIANGLES, 8, 3, true }, { GL_LINES, 11, 4, false } }, 0);
+
+        // 剩下的1个顶点放不下，重新分配存储后从头写入
+        for (int i = 0; i < 3; ++i)
+        {
+            debugDraw->drawLine(Vector3::Zero, Vector3(float(i), 1.0f, 0.0f), colors[i]);
+        }
+        drawFrame({ { GL_LINES, 0, 6, true } }, 1);
+
+        // 颜色不同的线段和包围盒的12条边合并成一次绘制，104个顶点超过了容量，容量翻倍到128
+        for (int i = 0; i < 40; ++i)
+        {
+            debugDraw->drawLine(Vector3::Zero, Vector3(float(i), 1.0f, 0.0f), colors[i & 3]);
+        }
+        AABB box;
+        box.min_ = Vector3::Zero;
+        box.max_.set(1.0f, 1.0f, 1.0f);
+        debugDraw->drawAABB(box, Matrix::Identity, colors[0]);
+        drawFrame({ { GL_LINES, 0, 104, true } }, 1);
+
+        // 新的容量还有空间，接在上一帧的后面
+        debugDraw->drawLine(Vector3::Zero, Vector3(1.0f, 1.0f, 1.0f), colors[0]);
+        drawFrame({ { GL_LINES, 104, 2, true } }, 0);
+
+        recorder.setStreamEnable(false);
+        recorder.clear();
+
+        runner.check(name, nErrors == 0, "4 frames, orphans: %d, errors: %d", (int)nOrphans, (int)nErrors);
+
+        DebugDraw::finiInstance();
+        DebugDraw::initInstance();
+    }
+}
+
+void benchDebugDraw(BenchmarkRunner &runner, GLRecorder &recorder, const std::string &resPath)
+{
+    checkDebugDraw(runner, recorder, resPath);
+
+    // 10万条调试线段，按4种颜色交替提交
+    std::mt19937 random(runner.seed_);
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+    Renderer *renderer = Renderer::instance();
+    DebugDraw *debugDraw = DebugDraw::instance();
+    if (debugDraw->init(joinPath(resPath, "common/shader/xyzcolor.shader")))
+    {
+        const size_t nLines = 100000;
+        std::vector<Vector3> points(nLines * 2);
+        for (Vector3 &p : points)
+        {
+            p.set(position(random), position(random), position(random));
+        }
+        const Color colors[] = { Color(1.0f, 0.0f, 0.0f), Color(0.0f, 1.0f, 0.0f), Color(0.0f, 0.0f, 1.0f), Color(1.0f, 1.0f, 1.0f) };
+
+        auto drawLines = [&]()
+        {
+            recorder.clear();
+            GLStateCache::instance()->reset();
+            for (size_t i = 0; i < nLines; ++i)
+            {
+                debugDraw->drawLine(points[i * 2], points[i * 2 + 1], colors[i & 3]);
+            }
+            debugDraw->draw(renderer);
+            return recorder.getDrawCallCount();
+        };
+
+        drawLines();
+        runner.run("render/debugdraw/100k", "line", nLines, drawLines);
+
+        // 颜色交替的10万条线段只有一次绘制调用
+        const char *linesName = "check/render/debugdraw/100k";
+        if (runner.isChecking(linesName))
+        {
+            size_t nDraws = drawLines();
+            const DebugDraw::Stats &stats = debugDraw->getStats();
+            runner.check(linesName, nDraws == 1 && stats.nDrawCalls == 1 && stats.nVertices == nLines * 2,
+                "draw calls: %d, vertices: %d, state changes: %d", (int)nDraws, (int)stats.nVertices, (int)recorder.getStateChangeCount());
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#include "HeadlessContext.h"
+
+#ifdef BENCH_USE_EGL
+#include "glconfig.h"
+#include <EGL/eglext.h>
+
+HeadlessContext::~HeadlessContext()
+{
+    if (display_ != EGL_NO_DISPLAY)
+    {
+        eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context_ != EGL_NO_CONTEXT)
+        {
+            eglDestroyContext(display_, context_);
+        }
+        eglTerminate(display_);
+    }
+}
+
+bool HeadlessContext::create()
+{
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay == nullptr)
+    {
+        return false;
+    }
+    display_ = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display_ == EGL_NO_DISPLAY || !eglInitialize(display_, nullptr, nullptr) || !eglBindAPI(EGL_OPENGL_API))
+    {
+        return false;
+    }
+
+    const EGLint attributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE,
+    };
+    context_ = eglCreateContext(display_, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+    return context_ != EGL_NO_CONTEXT &&
+        eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, context_) &&
+        gladLoadGLLoader((GLADloadproc)eglGetProcAddress);
+}
+#endif
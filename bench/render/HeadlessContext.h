@@ -0,0 +1,20 @@
+#pragma once
+
+#ifdef BENCH_USE_EGL
+#include <EGL/egl.h>
+
+/** 不需要窗口的GL 3.3 core上下文(Mesa的surfaceless平台)，用BENCH_USE_EGL编译时才有。
+ *  create成功之后上下文是当前的，GL函数也已经加载。
+ */
+class HeadlessContext
+{
+public:
+    ~HeadlessContext();
+
+    bool create();
+
+private:
+    EGLDisplay  display_ = EGL_NO_DISPLAY;
+    EGLContext  context_ = EGL_NO_CONTEXT;
+};
+#endif
@@ -0,0 +1,433 @@
+#include "RenderBench.h"
+#include "GLStateCache.h"
+#include "ShaderProgramMgr.h"
+#include "Renderer.h"
+#include "RenderQueue.h"
+#include "Material.h"
+#include "Mesh.h"
+#include "DemoTool.h"
+#include "PathTool.h"
+#include "Transform.h"
+#include "TransformHierarchy.h"
+
+#include <random>
+
+namespace
+{
+    struct DrawItem
+    {
+        Matrix  world;
+        Mesh*   mesh;
+    };
+
+    float getViewDepth(const Matrix &world, const Matrix &view)
+    {
+        return world._41 * view._13 + world._42 * view._23 + world._43 * view._33 + view._43;
+    }
+
+    /** 检查排好序的渲染队列，返回违反顺序的次数。
+     *  排序键不减，不透明物体都在半透明物体之前；状态相同的不透明物体从前往后，半透明物体从后往前。
+     */
+    size_t checkQueueOrder(const RenderQueue &queue, const Matrix &view)
+    {
+        size_t nErrors = 0;
+        for (size_t i = 1; i < queue.size(); ++i)
+        {
+            const RenderQueue::Item &a = queue.getSortedItem(i - 1);
+            const RenderQueue::Item &b = queue.getSortedItem(i);
+            uint32_t depthA = RenderQueue::quantizeDepth(getViewDepth(a.world_, view));
+            uint32_t depthB = RenderQueue::quantizeDepth(getViewDepth(b.world_, view));
+
+            bool sameState = a.material_ == b.material_ && a.mesh_ == b.mesh_;
+            bool transparentA = a.material_->isTransparent();
+            bool transparentB = b.material_->isTransparent();
+            if (queue.getSortedKey(i - 1) > queue.getSortedKey(i) ||
+                (transparentA && !transparentB) ||
+                (!transparentA && sameState && depthA > depthB) ||
+                (transparentA && transparentB && depthA < depthB))
+            {
+                ++nErrors;
+            }
+        }
+        return nErrors;
+    }
+
+    /** 把立方体的索引分成两个子模型。*/
+    MeshPtr createTwoPartCube(MaterialPtr material)
+    {
+        MeshPtr mesh = createCube(Vector3(1.0f, 1.0f, 1.0f));
+        SubMeshPtr whole = mesh->getSubMesh(0);
+        uint32_t half = whole->count_ / 2;
+
+        SubMeshPtr first = new SubMesh();
+        SubMeshPtr second = new SubMesh();
+        first->setPrimitive(whole->primitiveType_, whole->start_, half, 0);
+        second->setPrimitive(whole->primitiveType_, whole->start_ + half, whole->count_ - half, 0);
+        mesh->clearSubMeshes();
+        mesh->addSubMesh(first);
+        mesh->addSubMesh(second);
+        mesh->addMaterial(material);
+        return mesh;
+    }
+
+    /** 同一个模型的9个拷贝使用实例化shader，每个子模型合并成一次实例化绘制，实例数据只上传一次；
+     *  另外3个使用普通shader的绘制项逐个绘制。
+     */
+    void checkInstancing(BenchmarkRunner &runner, GLRecorder &recorder, const std::string &resPath)
+    {
+        const char *name = "check/render/instancing";
+        if (!runner.isChecking(name))
+        {
+            return;
+        }
+
+        ShaderProgramPtr instancedShader = ShaderProgramMgr::instance()->get(joinPath(resPath, "common/shader/light_instanced.shader"));
+        ShaderProgramPtr plainShader = ShaderProgramMgr::instance()->get(joinPath(resPath, "common/shader/xyzuv.shader"));
+        if (!instancedShader || !plainShader || !instancedShader->isInstanced())
+        {
+            runner.check(name, false, "failed to load light_instanced.shader and xyzuv.shader");
+            return;
+        }
+
+        MaterialPtr instancedMaterial = new Material();
+        instancedMaterial->setShader(instancedShader);
+        MaterialPtr plainMaterial = new Material();
+        plainMaterial->setShader(plainShader);
+
+        MeshPtr source = createTwoPartCube(instancedMaterial);
+        std::vector<MeshPtr> copies;
+        for (int i = 0; i < 9; ++i)
+        {
+            MeshPtr copy = source->clone();
+            copy->setInstanceColor(Color(i / 9.0f, 1.0f, 1.0f));
+            copies.push_back(copy);
+        }
+        MeshPtr plain = createTwoPartCube(plainMaterial);
+
+        Renderer *renderer = Renderer::instance();
+        RenderQueue queue;
+        auto drawFrame = [&]()
+        {
+            renderer->setRenderQueue(&queue);
+            for (size_t i = 0; i < copies.size() + 3; ++i)
+            {
+                Matrix world;
+                world.setTranslate(float(i) * 2.0f, 0.0f, 0.0f);
+                renderer->pushMatrix(world);
+                (i < copies.size() ? copies[i] : plain)->draw(renderer);
+                renderer->popMatrix();
+            }
+            queue.flush(renderer);
+            renderer->setRenderQueue(nullptr);
+        };
+
+        // 第一帧会创建顶点数组、上传模型的缓冲区，不计入
+        drawFrame();
+        BufferBase::endFrame();
+        queue.resetStats();
+        recorder.clear();
+        drawFrame();
+        BufferBase::endFrame();
+
+        // 实例数据追加到环形缓冲区中：一次不需要同步的映射，不重新分配存储，也不经过BufferBase上传
+        size_t nInstanced = recorder.getCallCount(GLFunction::ID_glDrawElementsInstanced);
+        size_t nPlain = recorder.getCallCount(GLFunction::ID_glDrawElements);
+        size_t nMaps = recorder.getCallCount(GLFunction::ID_glMapBufferRange);
+        size_t nBufferData = recorder.getCallCount(GLFunction::ID_glBufferData);
+        const BufferBase::UploadStats &uploads = BufferBase::getUploadStats();
+        const RenderQueue::Stats &stats = queue.getStats();
+        bool ok = nInstanced == 2 && nPlain == 6 && nMaps == 1 && nBufferData == 0 && uploads.nCalls == 0 &&
+            stats.nInstancedBatches == 2 && stats.nInstances == 18;
+        runner.check(name, ok, "instanced calls: %d (%d instances), plain draws: %d, maps: %d, buffer data: %d, buffer uploads: %d",
+            (int)nInstanced, (int)stats.nInstances, (int)nPlain, (int)nMaps, (int)nBufferData, (int)uploads.nCalls);
+    }
+
+    /** 逐个结点测试视锥，统计应该绘制的数量，作为层次裁剪的参考。*/
+    size_t countVisibleNodes(const TransformHierarchy &hierarchy, Renderer *renderer, const Matrix &parent)
+    {
+        const Frustum &frustum = renderer->getFrustum();
+        size_t nVisible = 0;
+        for (size_t i = 0; i < hierarchy.size(); ++i)
+        {
+            Transform *node = hierarchy.getNodes()[i];
+            Mesh *mesh = node->hasComponents() ? dynamic_cast<Mesh*>(node->getComponentByIndex(0).get()) : nullptr;
+            if (mesh != nullptr && frustum.intersectAABB(mesh->getBoundingBox(), hierarchy.getWorldMatrix(int(i)) * parent) != Frustum::OUTSIDE)
+            {
+                ++nVisible;
+            }
+        }
+        return nVisible;
+    }
+
+    /** 100组、每组10个立方体的场景，分别用递归、扁平化的包围盒树和扁平化的子树范围三种方式绘制。
+     *  每种方式绘制的数量都要与逐个测试的结果相同，每个立方体只计数一次，且层次裁剪的测试次数少于结点数。
+     */
+    void checkCulling(BenchmarkRunner &runner, const std::string &resPath)
+    {
+        const char *name = "check/render/culling";
+        if (!runner.isChecking(name))
+        {
+            return;
+        }
+
+        ShaderProgramPtr shader = ShaderProgramMgr::instance()->get(joinPath(resPath, "common/shader/xyzuv.shader"));
+        if (!shader)
+        {
+            runner.check(name, false, "failed to load xyzuv.shader");
+            return;
+        }
+        MaterialPtr material = new Material();
+        material->setShader(shader);
+        MeshPtr cube = createCube(Vector3(1.0f, 1.0f, 1.0f));
+        cube->addMaterial(material);
+        cube->generateBoundingBox();
+
+        const int nGroups = 100;
+        const int nGroupSize = 10;
+        TransformPtr root = new Transform();
+        for (int i = 0; i < nGroups; ++i)
+        {
+            TransformPtr group = new Transform();
+            group->setPosition(float(i % 10 - 5) * 20.0f + 10.0f, 0.0f, float(i / 10) * 20.0f);
+            for (int k = 0; k < nGroupSize; ++k)
+            {
+                TransformPtr node = new Transform();
+                node->setPosition(0.0f, float(k) * 3.0f, 0.0f);
+                node->addComponent(cube->clone());
+                group->addChild(node);
+            }
+            root->addChild(group);
+        }
+
+        Renderer *renderer = Renderer::instance();
+        Matrix view, proj;
+        view.lookAt(Vector3(0.0f, 5.0f, -10.0f), Vector3(0.0f, 5.0f, 0.0f), Vector3(0.0f, 1.0f, 0.0f));
+        proj.perspectiveProjectionGL(PI_QUARTER, 1.0f, 1.0f, 100.0f);
+        renderer->setViewMatrix(view);
+        renderer->setProjMatrix(proj);
+
+        RenderQueue queue;
+        auto drawScene = [&](const Matrix &parent)
+        {
+            renderer->getCullStats() = Renderer::CullStats();
+            renderer->setRenderQueue(&queue);
+            renderer->pushMatrix(parent);
+            root->draw(renderer);
+            renderer->popMatrix();
+            renderer->setRenderQueue(nullptr);
+            queue.clear();
+            return renderer->getCullStats();
+        };
+
+        // 递归绘制
+        Renderer::CullStats recursive = drawScene(Matrix::Identity);
+
+        // 扁平化之后，父空间为单位矩阵时查询包围盒树，否则按子树范围跳过
+        TransformHierarchy hierarchy;
+        hierarchy.setRoot(root);
+        hierarchy.update();
+        Renderer::CullStats tree = drawScene(Matrix::Identity);
+        Matrix parent;
+        parent.setTranslate(3.0f, 0.0f, 0.0f);
+        Renderer::CullStats ranges = drawScene(parent);
+
+        const size_t nNodes = nGroups * nGroupSize;
+        size_t nExpected = countVisibleNodes(hierarchy, renderer, Matrix::Identity);
+        size_t nExpectedShifted = countVisibleNodes(hierarchy, renderer, parent);
+        bool ok = nExpected > 0 && nExpected < nNodes &&
+            recursive.nVisible == nExpected && recursive.nVisible + recursive.nCulled == nNodes && recursive.nTests < nNodes &&
+            tree.nVisible == nExpected && tree.nVisible + tree.nCulled == nNodes &&
+            ranges.nVisible == nExpectedShifted && ranges.nVisible + ranges.nCulled == nNodes && ranges.nTests < nNodes;
+        runner.check(name, ok, "drawn: %d/%d/%d of %d (expected %d/%d), tests: %d/%d/%d (recursive/tree/ranges)",
+            (int)recursive.nVisible, (int)tree.nVisible, (int)ranges.nVisible, (int)nNodes, (int)nExpected, (int)nExpectedShifted,
+            (int)recursive.nTests, (int)tree.nTests, (int)ranges.nTests);
+        hierarchy.setRoot(nullptr);
+    }
+}
+
+void benchQueue(BenchmarkRunner &runner, GLRecorder &recorder, const std::string &resPath)
+{
+    checkInstancing(runner, recorder, resPath);
+    checkCulling(runner, resPath);
+
+    const char *shaderFiles[] = { "common/shader/xyzuv.shader", "common/shader/xyzuv_upsidedown.shader" };
+    std::vector<MaterialPtr> materials;
+    for (const char *file : shaderFiles)
+    {
+        ShaderProgramPtr shader = ShaderProgramMgr::instance()->get(joinPath(resPath, file));
+        if (!shader)
+        {
+            break;
+        }
+        for (int i = 0; i < 2; ++i)
+        {
+            MaterialPtr material = new Material();
+            material->setShader(shader);
+            materials.push_back(material);
+        }
+    }
+
+    // 16种网格，每种64个拷贝，按随机顺序提交
+    const int nMeshes = 16;
+    const size_t nItems = 1024;
+    std::mt19937 random(runner.seed_);
+    std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+    std::vector<MeshPtr> meshes;
+    std::vector<DrawItem> items(nItems);
+    if (materials.size() == 4)
+    {
+        for (int i = 0; i < nMeshes; ++i)
+        {
+            MeshPtr mesh = createCube(Vector3(1.0f + i * 0.1f, 1.0f, 1.0f));
+            mesh->addMaterial(materials[i % materials.size()]);
+            meshes.push_back(mesh);
+        }
+        for (size_t i = 0; i < nItems; ++i)
+        {
+            items[i].world.setTranslate(position(random), position(random), position(random));
+            items[i].mesh = meshes[i % nMeshes].get();
+        }
+        std::shuffle(items.begin(), items.end(), random);
+    }
+
+    Renderer *renderer = Renderer::instance();
+    Matrix view, proj;
+    view.lookAt(Vector3(0.0f, 0.0f, -100.0f), Vector3::Zero, Vector3(0.0f, 1.0f, 0.0f));
+    proj.perspectiveProjectionGL(PI_QUARTER, 1.0f, 1.0f, 500.0f);
+    renderer->setViewMatrix(view);
+    renderer->setProjMatrix(proj);
+
+    RenderQueue queue;
+    auto drawFrame = [&](RenderQueue *renderQueue)
+    {
+        recorder.clear();
+        GLStateCache::instance()->reset();
+        renderer->setRenderQueue(renderQueue);
+        for (const DrawItem &item : items)
+        {
+            renderer->pushMatrix(item.world);
+            item.mesh->draw(renderer);
+            renderer->popMatrix();
+        }
+        if (renderQueue != nullptr)
+        {
+            renderQueue->flush(renderer);
+        }
+        renderer->setRenderQueue(nullptr);
+        return recorder.getStateChangeCount();
+    };
+
+    if (!meshes.empty())
+    {
+        // 第一帧会创建顶点数组，不计入
+        drawFrame(nullptr);
+
+        runner.run("render/direct/1k", "draw", nItems, [&]()
+        {
+            return drawFrame(nullptr);
+        });
+        // 场景不动时，队列沿用上一帧的排序结果
+        runner.run("render/queue/1k", "draw", nItems, [&]()
+        {
+            return drawFrame(&queue);
+        });
+        // 每帧交换16对物体的位置，排序键的顺序被打乱，每帧都要重新排序
+        std::uniform_int_distribution<size_t> pickItem(0, nItems - 1);
+        runner.run("render/queue/moving/1k", "draw", nItems, [&]()
+        {
+            for (int i = 0; i < 16; ++i)
+            {
+                std::swap(items[pickItem(random)].world, items[pickItem(random)].world);
+            }
+            return drawFrame(&queue);
+        });
+
+        // 直接绘制时每个绘制项都绑定、解绑网格和shader。渲染队列只在切换时绑定shader和材质，
+        // 同一个材质内按深度的数量级和网格分组，网格仍然会切换，但不会超过绘制项的数量
+        const char *callsName = "check/render/calls";
+        if (runner.isChecking(callsName))
+        {
+            // 绑定和解绑网格各修改3个状态：顶点数组、顶点缓冲区、索引缓冲区
+            const size_t meshStateChanges = 6;
+
+            drawFrame(nullptr);
+            size_t directDraws = recorder.getDrawCallCount();
+            size_t directStates = recorder.getStateChangeCount();
+            size_t directUniforms = recorder.getCategoryCount(GLFunction::Uniform);
+
+            queue.resetStats();
+            drawFrame(&queue);
+            const RenderQueue::Stats &stats = queue.getStats();
+            size_t queueDraws = recorder.getDrawCallCount();
+            size_t queueStates = recorder.getStateChangeCount();
+            size_t queueUniforms = recorder.getCategoryCount(GLFunction::Uniform);
+
+            bool ok = directDraws == nItems && directStates == nItems * (meshStateChanges + 2) && directUniforms == nItems &&
+                queueDraws == nItems && queueUniforms == nItems &&
+                stats.nShaderBinds == 2 && stats.nMaterialBinds == materials.size() && stats.nMeshBinds < nItems &&
+                queueStates == stats.nMeshBinds * meshStateChanges + stats.nShaderBinds + 1;
+            runner.check(callsName, ok, "draw calls: %d/%d, state changes: %d/%d, uniforms: %d/%d (direct/queue), mesh binds: %d",
+                (int)directDraws, (int)queueDraws, (int)directStates, (int)queueStates, (int)directUniforms, (int)queueUniforms,
+                (int)stats.nMeshBinds);
+        }
+
+        // 2万个绘制项，50种网格、20种材质，其中1/4的材质是半透明的
+        if (runner.isChecking("check/render/queue/order"))
+        {
+            std::vector<MaterialPtr> checkMaterials;
+            for (int i = 0; i < 20; ++i)
+            {
+                MaterialPtr material = new Material();
+                material->setShader(materials[i % materials.size()]->getShader());
+                material->setTransparent(i % 4 == 3);
+                checkMaterials.push_back(material);
+            }
+            std::vector<MeshPtr> checkMeshes;
+            for (int i = 0; i < 50; ++i)
+            {
+                checkMeshes.push_back(createCube(Vector3(1.0f, 1.0f + i * 0.1f, 1.0f)));
+            }
+
+            const size_t nCheckItems = 20000;
+            std::mt19937 checkRandom(runner.seed_);
+            std::uniform_int_distribution<size_t> pickMesh(0, checkMeshes.size() - 1);
+            std::uniform_int_distribution<size_t> pickMaterial(0, checkMaterials.size() - 1);
+            std::vector<DrawItem> checkItems(nCheckItems);
+            std::vector<Material*> itemMaterials(nCheckItems);
+            size_t nTransparent = 0;
+            for (size_t i = 0; i < nCheckItems; ++i)
+            {
+                checkItems[i].world.setTranslate(position(checkRandom), position(checkRandom), position(checkRandom));
+                checkItems[i].mesh = checkMeshes[pickMesh(checkRandom)].get();
+                itemMaterials[i] = checkMaterials[pickMaterial(checkRandom)].get();
+                nTransparent += itemMaterials[i]->isTransparent() ? 1 : 0;
+            }
+
+            // 3帧：第2帧与第1帧相同，沿用上一帧的顺序；第3帧把一个物体移到相机前面，需要重新排序
+            RenderQueue checkQueue;
+            size_t nErrors = 0;
+            for (int frame = 0; frame < 3; ++frame)
+            {
+                if (frame == 2)
+                {
+                    checkItems[nCheckItems / 2].world.setTranslate(0.0f, 0.0f, -99.0f);
+                }
+                for (size_t i = 0; i < nCheckItems; ++i)
+                {
+                    Mesh *mesh = checkItems[i].mesh;
+                    checkQueue.add(mesh, mesh->getSubMeshes()[0].get(), itemMaterials[i], checkItems[i].world, view);
+                }
+                checkQueue.sort();
+                nErrors += checkQueue.size() == nCheckItems ? checkQueueOrder(checkQueue, view) : 1;
+                nErrors += checkQueue.getStats().nReusedSorts == (frame == 0 ? 0u : 1u) ? 0 : 1;
+                checkQueue.clear();
+            }
+            runner.check("check/render/queue/order", nErrors == 0, "%d items, %d transparent, 3 frames, reused sorts: %d, errors: %d",
+                (int)nCheckItems, (int)nTransparent, (int)checkQueue.getStats().nReusedSorts, (int)nErrors);
+        }
+    }
+    else
+    {
+        printf("render: failed to load shaders from '%s'.\n", resPath.c_str());
+    }
+}
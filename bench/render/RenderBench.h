@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Benchmark.h"
+#include "GLDispatch.h"
+
+/** 渲染相关的各组测试，定义在各自的cpp中。
+ *  除benchBufferReadback和benchShaders外都在main准备好的空GL后端上运行，recorder记录GL调用的次数，自检模式用它检查每帧的调用。
+ */
+/** GL状态缓存、uniform缓存和环形uniform缓冲区。*/
+void benchState(BenchmarkRunner &runner, GLRecorder &recorder, const std::string &resPath);
+/** 直接绘制与渲染队列、实例化和层次裁剪。*/
+void benchQueue(BenchmarkRunner &runner, GLRecorder &recorder, const std::string &resPath);
+/** 调试图元绘制。*/
+void benchDebugDraw(BenchmarkRunner &runner, GLRecorder &recorder, const std::string &resPath);
+/** 缓冲区的部分上传，以及上传之后内存中的副本。*/
+void benchBuffers(BenchmarkRunner &runner, GLRecorder &recorder);
+/** 用真实的GL读回Discard缓冲区，需要BENCH_USE_EGL。*/
+void benchBufferReadback(BenchmarkRunner &runner);
+/** 自检模式下用真实的GL编译链接所有的shader，需要BENCH_USE_EGL。*/
+void benchShaders(BenchmarkRunner &runner, const std::string &resPath);
@@ -0,0 +1,118 @@
+#include "RenderBench.h"
+
+#ifdef BENCH_USE_EGL
+#include "GLDispatch.h"
+#include "GLStateCache.h"
+#include "FileSystem.h"
+#include "VertexDeclaration.h"
+#include "ShaderProgram.h"
+#include "UniformBlockMgr.h"
+#include "PathTool.h"
+#include "HeadlessContext.h"
+
+#include <dirent.h>
+
+namespace
+{
+    bool listShaders(const std::string &dir, std::vector<std::string> &files)
+    {
+        DIR *dp = opendir(dir.c_str());
+        if (dp == nullptr)
+        {
+            return false;
+        }
+        while (dirent *entry = readdir(dp))
+        {
+            if (stringEndWith(entry->d_name, ".shader"))
+            {
+                files.push_back(entry->d_name);
+            }
+        }
+        closedir(dp);
+        std::sort(files.begin(), files.end());
+        return true;
+    }
+
+    /** 返回program中名为name的uniform块的大小，没有这个块时返回0。*/
+    GLint getBlockSize(GLuint program, const std::string &name)
+    {
+        GLuint index = glGetUniformBlockIndex(program, name.c_str());
+        if (index == GL_INVALID_INDEX)
+        {
+            return 0;
+        }
+        GLint size = 0;
+        glGetActiveUniformBlockiv(program, index, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+        return size;
+    }
+}
+#endif
+
+void benchShaders(BenchmarkRunner &runner, const std::string &resPath)
+{
+    const char *name = "check/shader/compile";
+    if (!runner.isChecking(name))
+    {
+        return;
+    }
+
+#ifdef BENCH_USE_EGL
+    HeadlessContext context;
+    if (!context.create())
+    {
+        runner.check(name, false, "failed to create an EGL context");
+        return;
+    }
+
+    std::vector<std::string> files;
+    std::string shaderPath = joinPath(resPath, "common/shader");
+    if (!listShaders(shaderPath, files) || files.empty())
+    {
+        runner.check(name, false, "no shaders found in '%s'", shaderPath.c_str());
+        return;
+    }
+
+    // 真实后端：编译、链接都由驱动完成
+    GLDispatch::initInstance();
+    GLStateCache::initInstance();
+    GLStateCache::instance()->reset();
+    FileSystem::initInstance();
+    // 注册顶点属性的名字，program链接后按名字查找属性
+    VertexDeclMgr::initInstance();
+
+    // 每个shader都要能编译链接，声明的自动uniform块与C++中的结构体大小一致
+    size_t nFailures = 0;
+    size_t nBlocks = 0;
+    for (const std::string &file : files)
+    {
+        ShaderProgramPtr shader = new ShaderProgram();
+        if (!shader->loadFromFile(joinPath(shaderPath, file)))
+        {
+            printf("    %s: failed to compile or link\n", file.c_str());
+            ++nFailures;
+            continue;
+        }
+
+        GLint frameSize = getBlockSize(shader->getHandle(), AutoUniformBlock::Frame);
+        GLint objectSize = getBlockSize(shader->getHandle(), AutoUniformBlock::Object);
+        if ((frameSize != 0 && frameSize != GLint(sizeof(AutoUniformBlock::FrameData))) ||
+            (objectSize != 0 && objectSize != GLint(sizeof(AutoUniformBlock::ObjectData))))
+        {
+            printf("    %s: uniform block size %d/%d does not match the C++ layout\n", file.c_str(), frameSize, objectSize);
+            ++nFailures;
+        }
+        nBlocks += (frameSize != 0 ? 1 : 0) + (objectSize != 0 ? 1 : 0);
+    }
+
+    runner.check(name, nFailures == 0, "%d shaders, %d uniform blocks, failures: %d, renderer: %s",
+        (int)files.size(), (int)nBlocks, (int)nFailures, (const char*)glGetString(GL_RENDERER));
+
+    VertexDeclMgr::finiInstance();
+    FileSystem::finiInstance();
+    GLStateCache::finiInstance();
+    GLDispatch::finiInstance();
+#else
+    (void)resPath;
+    printf("%-40s %-8s %s\n", name, "skipped", "built without EGL, no GL context to compile shaders");
+#endif
+}
@@ -0,0 +1,176 @@
+#include "RenderBench.h"
+#include "GLStateCache.h"
+#include "ShaderProgramMgr.h"
+#include "UniformBlockMgr.h"
+#include "Renderer.h"
+#include "Texture.h"
+#include "ShaderUniform.h"
+#include "PathTool.h"
+
+namespace
+{
+    /** 重复设置相同的状态时只有第一次调用GL；只绑定纹理的地方要解除之前纹理留下的采样器。*/
+    void checkStateCache(BenchmarkRunner &runner, GLRecorder &recorder)
+    {
+        const char *name = "check/render/statecache";
+        if (!runner.isChecking(name))
+        {
+            return;
+        }
+
+        GLStateCache *cache = GLStateCache::instance();
+        cache->reset();
+        cache->resetStats();
+        recorder.clear();
+
+        // 10种与默认值不同的状态，每帧都设置一遍
+        const int nFrames = 100;
+        const int nStates = 10;
+        for (int i = 0; i < nFrames; ++i)
+        {
+            cache->useProgram(1);
+            cache->bindVertexArray(1);
+            cache->bindBuffer(GL_ARRAY_BUFFER, 1);
+            cache->activeTexture(1);
+            cache->enable(GL_BLEND);
+            cache->blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            cache->depthFunc(GL_LEQUAL);
+            cache->depthMask(false);
+            cache->cullFace(GL_FRONT);
+            cache->stencilMask(0x0f);
+        }
+        size_t nCalls = recorder.getTotalCallCount();
+        GLStateCache::Stats stats = cache->getStats();
+        bool ok = nCalls == nStates && stats.nIssued == nStates && stats.nElided == nStates * (nFrames - 1);
+
+        // 纹理A使用采样器，之后在同一个单元上创建纹理B(只绑定纹理)，采样器要被解除
+        cache->activeTexture(0);
+        TexturePtr textureA = new Texture();
+        TexturePtr textureB = new Texture();
+        textureA->create(0, 4, 4, TextureFormat::RGBA, nullptr, GL_UNSIGNED_BYTE);
+        textureA->setQuality(TextureQuality::Nearest);
+        textureA->bind();
+        GLuint samplerA = cache->getSamplerBinding(0);
+        textureB->create(0, 4, 4, TextureFormat::RGBA, nullptr, GL_UNSIGNED_BYTE);
+        GLuint samplerB = cache->getSamplerBinding(0);
+        textureA->bind();
+        ok = ok && samplerA != 0 && samplerB == 0 && cache->getSamplerBinding(0) == samplerA;
+
+        // invalidate之后活动单元仍然已知，纹理和采样器绑定到0号单元；超出范围的单元不缓存
+        cache->activeTexture(5);
+        cache->invalidate();
+        textureA->bind();
+        GLStateCache::Stats before = cache->getStats();
+        cache->bindSampler(GLStateCache::MaxTextureUnits + 3, samplerA);
+        cache->bindSampler(GLStateCache::MaxTextureUnits + 3, samplerA);
+        bool invalidateOk = cache->getActiveTexture() == 0 && cache->getSamplerBinding(0) == samplerA &&
+            cache->getTexture(0, GL_TEXTURE_2D) == textureA->getHandle() &&
+            cache->getSamplerBinding(GLStateCache::MaxTextureUnits + 3) != samplerA &&
+            cache->getStats().nIssued == before.nIssued + 2;
+
+        runner.check(name, ok && invalidateOk, "gl calls: %d, issued: %d, elided: %d, samplers: %d/%d, after invalidate: %s",
+            (int)nCalls, (int)stats.nIssued, (int)stats.nElided, (int)samplerA, (int)samplerB, invalidateOk ? "ok" : "failed");
+        cache->reset();
+    }
+
+    /** 重复上传相同的uniform时跳过glUniform*；转置标记不同、program被标记失效后都要重新上传。*/
+    void checkUniformCache(BenchmarkRunner &runner, GLRecorder &recorder, const std::string &resPath)
+    {
+        const char *name = "check/render/uniforms";
+        if (!runner.isChecking(name))
+        {
+            return;
+        }
+
+        ShaderProgramPtr shader = ShaderProgramMgr::instance()->get(joinPath(resPath, "common/shader/shadowmapping.shader"));
+        ShaderUniform *lightDir = shader ? shader->findUniform("lightDir") : nullptr;
+        ShaderUniform *shininess = shader ? shader->findUniform("shininess") : nullptr;
+        ShaderUniform *lightProj = shader ? shader->findUniform("matLightProj") : nullptr;
+        if (!lightDir || !shininess || !lightProj)
+        {
+            runner.check(name, false, "failed to load shadowmapping.shader");
+            return;
+        }
+
+        shader->bind();
+        ShaderUniform::resetStats();
+        recorder.clear();
+
+        // 每个uniform 5次，3次与上一次的值相同
+        Vector3 dir1(0.0f, -1.0f, 0.0f), dir2(1.0f, -1.0f, 0.0f);
+        const Vector3 dirs[] = { dir1, dir1, dir1, dir2, dir2 };
+        const float values[] = { 1.0f, 1.0f, 2.0f, 2.0f, 2.0f };
+        Matrix proj;
+        proj.perspectiveProjectionGL(PI_QUARTER, 1.0f, 1.0f, 100.0f);
+        for (int i = 0; i < 5; ++i)
+        {
+            lightDir->bindValue(dirs[i]);
+            shininess->bindValue(values[i]);
+            // 前3次不转置，后2次转置：字节相同，但调用的参数不同
+            lightProj->bindValue(&proj, 1, i >= 3);
+        }
+        // 绕过ShaderUniform修改之后，相同的值也要上传
+        shader->invalidateUniforms();
+        shininess->bindValue(values[4]);
+
+        const size_t nExpectedUploads = 7;
+        const size_t nExpectedSkips = 9;
+        ShaderUniform::Stats stats = ShaderUniform::getStats();
+        size_t nCalls = recorder.getCategoryCount(GLFunction::Uniform);
+        bool ok = stats.nUploads == nExpectedUploads && stats.nSkips == nExpectedSkips && nCalls == nExpectedUploads;
+        runner.check(name, ok, "binds: 16, uploads: %d, skips: %d, glUniform calls: %d",
+            (int)stats.nUploads, (int)stats.nSkips, (int)nCalls);
+        shader->unbind();
+    }
+
+    /** 环形uniform缓冲区：物体的矩阵不变时复用上一个块，写满后重新分配存储，并重新上传每帧的块。*/
+    void checkUniformBlocks(BenchmarkRunner &runner)
+    {
+        const char *name = "check/render/uniformblocks";
+        if (!runner.isChecking(name))
+        {
+            return;
+        }
+
+        // 空后端的对齐是256字节，每个块占256字节，容量是64个块
+        UniformBlockMgr *mgr = UniformBlockMgr::instance();
+        mgr->init(256 * 64);
+        mgr->resetStats();
+
+        Renderer *renderer = Renderer::instance();
+        Matrix view, proj;
+        view.lookAt(Vector3(0.0f, 0.0f, -10.0f), Vector3::Zero, Vector3(0.0f, 1.0f, 0.0f));
+        proj.perspectiveProjectionGL(PI_QUARTER, 1.0f, 1.0f, 100.0f);
+        renderer->setViewMatrix(view);
+        renderer->setProjMatrix(proj);
+
+        // 100个不同的世界矩阵，每个连续使用2次
+        const uint32_t mask = AutoUniformBlock::FrameBit | AutoUniformBlock::ObjectBit;
+        for (int i = 0; i < 100; ++i)
+        {
+            Matrix world;
+            world.setTranslate(float(i), 0.0f, 0.0f);
+            renderer->pushMatrix(world);
+            mgr->apply(mask);
+            mgr->apply(mask);
+            renderer->popMatrix();
+        }
+
+        // 第一段放下1个帧块和63个物体块，orphan之后重新上传帧块
+        UniformBlockMgr::Stats stats = mgr->getStats();
+        bool ok = stats.nObjectUploads == 100 && stats.nObjectReuses == 100 && stats.nOrphans == 1 && stats.nFrameUploads == 2;
+        runner.check(name, ok, "applies: 200, object uploads: %d, reuses: %d, orphans: %d, frame uploads: %d",
+            (int)stats.nObjectUploads, (int)stats.nObjectReuses, (int)stats.nOrphans, (int)stats.nFrameUploads);
+
+        // 恢复到没有uniform缓冲区的状态，后面的测试不使用uniform块
+        UniformBlockMgr::finiInstance();
+        UniformBlockMgr::initInstance();
+    }
+}
+
+void benchState(BenchmarkRunner &runner, GLRecorder &recorder, const std::string &resPath)
+{
+    checkStateCache(runner, recorder);
+    checkUniformCache(runner, recorder, resPath);
+    checkUniformBlocks(runner);
+}
@@ -0,0 +1,149 @@
+/** 渲染状态缓存、uniform上传、渲染队列、实例化、层次裁剪、调试图元绘制和缓冲区上传等渲染路径的微基准测试。
+ *  用法：render_bench [--json result.json] [--filter render/queue] [--min-time 0.5] [--repeats 5] [--seed 12345] [--res path/to/res] [--check]
+ *  不需要显卡：GL调用经过记录后端计数后交给空后端，自检模式检查每帧的绘制调用和状态切换次数。
+ *  用BENCH_USE_EGL编译时，在无窗口的EGL上下文中测试Discard缓冲区的读回；自检模式还会编译res/common/shader下所有的shader。
+ *  --check与raytrace_bench相同：每个测试只运行一次，再运行各组的检查，有检查失败时返回1。ctest会以自检模式运行。
+ */
+#include "RenderBench.h"
+#include "GLStateCache.h"
+#include "FileSystem.h"
+#include "VertexDeclaration.h"
+#include "TextureMgr.h"
+#include "ShaderProgramMgr.h"
+#include "UniformBlockMgr.h"
+#include "Renderer.h"
+#include "DebugDraw.h"
+#include "DemoTool.h"
+#include "TrianglePacket.h"
+
+#include <cstring>
+
+namespace
+{
+    void printUsage(const char *exe)
+    {
+        printf("usage: %s [options]\n"
+            "  --json <file>           write results as json\n"
+            "  --filter <text>         only run benchmarks whose name contains text\n"
+            "  --min-time <seconds>    minimum running time of each benchmark (default 0.5)\n"
+            "  --repeats <n>           number of timed rounds, the median is reported (default 5)\n"
+            "  --seed <n>              random seed (default 12345)\n"
+            "  --res <dir>             res directory with the shaders (default: searched upwards from the exe)\n"
+            "  --check                 run every benchmark once and check the GL calls of each frame\n",
+            exe);
+    }
+
+    /** 在空GL后端上运行各组测试。GL调用经过记录后端计数后丢弃，计时只需要计数，不写调用流。*/
+    void benchNullBackend(BenchmarkRunner &runner, const std::string &resPath)
+    {
+        if (!runner.isGroupEnabled("render"))
+        {
+            return;
+        }
+
+        GLDispatch::initInstance();
+        GLDispatch::instance()->setBackend(GLDispatch::BACKEND_RECORDING, GLDispatch::BACKEND_NULL);
+        GLRecorder &recorder = GLDispatch::instance()->getRecorder();
+        recorder.setStreamEnable(false);
+
+        GLStateCache::initInstance();
+        GLStateCache::instance()->reset();
+        FileSystem::initInstance();
+        VertexDeclMgr::initInstance();
+        TextureMgr::initInstance();
+        ShaderProgramMgr::initInstance();
+        Renderer::initInstance();
+        UniformBlockMgr::initInstance();
+        DebugDraw::initInstance();
+
+        benchState(runner, recorder, resPath);
+        benchQueue(runner, recorder, resPath);
+        benchDebugDraw(runner, recorder, resPath);
+        benchBuffers(runner, recorder);
+
+        DebugDraw::finiInstance();
+        UniformBlockMgr::finiInstance();
+        Renderer::finiInstance();
+        ShaderProgramMgr::finiInstance();
+        TextureMgr::finiInstance();
+        VertexDeclMgr::finiInstance();
+        FileSystem::finiInstance();
+        GLStateCache::finiInstance();
+        GLDispatch::finiInstance();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    BenchmarkRunner runner;
+    std::string jsonPath;
+    std::string resPath;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--check") == 0)
+        {
+            runner.checkMode_ = true;
+            continue;
+        }
+
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (value == nullptr)
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+        ++i;
+
+        if (runner.parseOption(arg, value))
+        {
+            continue;
+        }
+
+        if (strcmp(arg, "--json") == 0)
+        {
+            jsonPath = value;
+        }
+        else if (strcmp(arg, "--res") == 0)
+        {
+            resPath = value;
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (resPath.empty())
+    {
+        resPath = findResPath();
+    }
+    if (resPath.empty())
+    {
+        printf("res directory not found, use --res <dir>.\n");
+        return 1;
+    }
+
+    // 渲染器的矩阵运算与光线追踪共用SIMD实现，结果中记录指令集便于对比
+    const char *isa = getTrianglePacketISA();
+    printf("seed: %u, isa: %s\n", runner.seed_, isa);
+
+    benchNullBackend(runner, resPath);
+    benchBufferReadback(runner);
+    benchShaders(runner, resPath);
+
+    if (runner.checkMode_)
+    {
+        runner.checkJSON("render_bench_check.json", isa);
+        printf("%d check(s) failed\n", runner.getFailureCount());
+    }
+
+    if (!jsonPath.empty() && !runner.writeJSON(jsonPath, isa))
+    {
+        printf("Failed to write '%s'.\n", jsonPath.c_str());
+        return 1;
+    }
+    return runner.getFailureCount() == 0 ? 0 : 1;
+}
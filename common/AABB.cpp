@@ -12,7 +12,7 @@ void AABB::setZero()
 void AABB::setEmpty()
 {
     min_.set(FLT_MAX, FLT_MAX, FLT_MAX);
-    max_.set(FLT_MIN, FLT_MIN, FLT_MIN);
+    max_.set(-FLT_MAX, -FLT_MAX, -FLT_MAX);
 }
 
 bool AABB::isValid() const
@@ -58,11 +58,42 @@ void AABB::applyMatrix(const Matrix &matrix)
         {max_.x, min_.y, max_.z}, // back right bottom
     };
     
+    matrix.transformPoints(points, points, 8);
+
     setEmpty();
     
     for(Vector3 &p : points)
     {
-        p = matrix.transformPoint(p);
         addPoint(p);
     }
 }
+
+float AABB::getSurfaceArea() const
+{
+    Vector3 size = max_ - min_;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+bool AABB::contains(const AABB &other) const
+{
+    return min_.x <= other.min_.x && min_.y <= other.min_.y && min_.z <= other.min_.z &&
+        other.max_.x <= max_.x && other.max_.y <= max_.y && other.max_.z <= max_.z;
+}
+
+bool AABB::intersect(const AABB &other) const
+{
+    return min_.x <= other.max_.x && other.min_.x <= max_.x &&
+        min_.y <= other.max_.y && other.min_.y <= max_.y &&
+        min_.z <= other.max_.z && other.min_.z <= max_.z;
+}
+
+float AABB::distanceSquared(const Vector3 &point) const
+{
+    float distance = 0.0f;
+    for (int i = 0; i < 3; ++i)
+    {
+        float d = std::max(min_[i] - point[i], std::max(0.0f, point[i] - max_[i]));
+        distance += d * d;
+    }
+    return distance;
+}
@@ -25,4 +25,19 @@ public:
     void addAABB(const AABB &other);
     
     void applyMatrix(const Matrix &matrix);
+
+    Vector3 getCenter() const { return (min_ + max_) * 0.5f; }
+    Vector3 getSize() const { return max_ - min_; }
+
+    /** 包围盒的表面积。用于SAH等代价估算。*/
+    float getSurfaceArea() const;
+
+    /** other完全在包围盒内(包括边界)。*/
+    bool contains(const AABB &other) const;
+
+    /** 两个包围盒相交(包括边界接触)。*/
+    bool intersect(const AABB &other) const;
+
+    /** 点到包围盒距离的平方。点在包围盒内返回0。*/
+    float distanceSquared(const Vector3 &point) const;
 };
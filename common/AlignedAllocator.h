@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+/** 分配对齐的内存。size可以为0。*/
+inline void* alignedMalloc(size_t size, size_t alignment)
+{
+#ifdef _WIN32
+    return _aligned_malloc(size, alignment);
+#else
+    void *p = nullptr;
+    if (posix_memalign(&p, alignment, size) != 0)
+    {
+        return nullptr;
+    }
+    return p;
+#endif
+}
+
+inline void alignedFree(void *p)
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+/** 按Alignment字节对齐的STL分配器。默认按缓存行对齐。
+ *  C++17之前，std::vector不会遵守alignas指定的对齐，SIMD数据需要使用此分配器。
+ */
+template<typename T, size_t Alignment = 64>
+class AlignedAllocator
+{
+public:
+    typedef T               value_type;
+    typedef T*              pointer;
+    typedef const T*        const_pointer;
+    typedef T&              reference;
+    typedef const T&        const_reference;
+    typedef size_t          size_type;
+    typedef ptrdiff_t       difference_type;
+
+    template<typename U>
+    struct rebind
+    {
+        typedef AlignedAllocator<U, Alignment> other;
+    };
+
+    AlignedAllocator() {}
+
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment> &) {}
+
+    T* allocate(size_t n)
+    {
+        void *p = alignedMalloc(n * sizeof(T), Alignment);
+        if (p == nullptr && n > 0)
+        {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T *p, size_t)
+    {
+        alignedFree(p);
+    }
+
+    template<typename U>
+    bool operator == (const AlignedAllocator<U, Alignment> &) const { return true; }
+
+    template<typename U>
+    bool operator != (const AlignedAllocator<U, Alignment> &) const { return false; }
+};
@@ -10,6 +10,10 @@
 #include "ShaderProgramMgr.h"
 #include "Renderer.h"
 #include "DebugDraw.h"
+#include "GLStateCache.h"
+#include "GLDispatch.h"
+#include "Profiler.h"
+#include "UniformBlockMgr.h"
 #include "Mesh.h"
 
 Application *gApp = nullptr;
@@ -81,6 +85,7 @@ static void charCallback(GLFWwindow* window, unsigned int ch)
 Application::Application()
 : pWindow_(nullptr)
 , deltaTime_(0.0f)
+, showProfiler_(false)
 {
     gApp = this;
     
@@ -90,17 +95,23 @@ Application::Application()
         exit(0);
     }
     
+    GLDispatch::initInstance();
+    Profiler::initInstance();
+    GLStateCache::initInstance();
     FileSystem::initInstance();
     VertexDeclMgr::initInstance();
     TextureMgr::initInstance();
 	ShaderProgramMgr::initInstance();
 	Renderer::initInstance();
     DebugDraw::initInstance();
+    UniformBlockMgr::initInstance();
 }
 
 Application::~Application()
 {
+    Profiler::finiInstance();
 	ShaderProgramMgr::finiInstance();
+    UniformBlockMgr::finiInstance();
     TextureMgr::finiInstance();
     VertexDeclMgr::finiInstance();
     FileSystem::finiInstance();
@@ -112,6 +123,8 @@ Application::~Application()
         onDestroy();
         glfwDestroyWindow(pWindow_);
     }
+    GLStateCache::finiInstance();
+    GLDispatch::finiInstance();
    
     glfwTerminate();
     if(gApp == this)
@@ -143,6 +156,8 @@ bool Application::createWindow(int width, int height, const std::string &title)
         return false;
     }
 	LOG_INFO("GL Version: %d.%d", GLVersion.major, GLVersion.minor);
+    GLDispatch::instance()->captureRealFunctions();
+    GLStateCache::instance()->reset();
     if(GLVersion.major < 3)
     {
         LOG_ERROR("Unsupported OpenGL version.");
@@ -166,12 +181,16 @@ bool Application::createWindow(int width, int height, const std::string &title)
 	glClearStencil(0);
 	glClearDepth(1.0f);
     
-	glEnable(GL_DEPTH_TEST);
+	GLStateCache::instance()->enable(GL_DEPTH_TEST);
 
     if (!DebugDraw::instance()->init())
     {
         return false;
     }
+    if (!UniformBlockMgr::instance()->init())
+    {
+        return false;
+    }
     return onCreate();
 }
 
@@ -217,18 +236,36 @@ void Application::mainLoop()
 		deltaTime_ = float(curTime - lastTime);
 		lastTime = curTime;
 
-		onTick(deltaTime_);
+		{
+			PROFILE_SCOPE("Application::onTick");
+			onTick(deltaTime_);
+		}
         
         auto renderer = Renderer::instance();
         if (renderer->beginDraw())
         {
-            onDraw(renderer);
-            DebugDraw::instance()->draw(renderer);
+            {
+                PROFILE_GPU_SCOPE("Application::onDraw");
+                onDraw(renderer);
+            }
+            if (showProfiler_)
+            {
+                Profiler::instance()->drawOverlay(renderer);
+            }
+            {
+                PROFILE_GPU_SCOPE("DebugDraw::draw");
+                DebugDraw::instance()->draw(renderer);
+            }
             renderer->endDraw();
         }
 
-        glfwSwapBuffers(pWindow_);
+        {
+            PROFILE_SCOPE("Application::swapBuffers");
+            glfwSwapBuffers(pWindow_);
+        }
         glfwPollEvents();
+        BufferBase::endFrame();
+        PROFILE_END_FRAME();
     }
 }
 
@@ -256,6 +293,45 @@ void Application::onKey(int key, int scancode, int action, int modes)
 {
     if(key == GLFW_KEY_ESCAPE && action == GLFW_RELEASE)
         glfwSetWindowShouldClose(pWindow_, GLFW_TRUE);
+
+    // F3显示帧分析的耗时条，同时在日志中输出各行对应的作用域；F4开始/结束捕获，结束时保存trace
+    if(key == GLFW_KEY_F3 && action == GLFW_RELEASE)
+    {
+        setProfilerOverlay(!showProfiler_);
+        if(showProfiler_)
+        {
+            Profiler::instance()->dumpStats();
+
+            const BufferBase::UploadStats &upload = BufferBase::getUploadStats();
+            LOG_INFO("Buffer uploads: %d bytes, %d calls, %d orphans, %d reallocs",
+                (int)upload.nBytes, (int)upload.nCalls, (int)upload.nOrphans, (int)upload.nReallocs);
+        }
+    }
+    if(key == GLFW_KEY_F4 && action == GLFW_RELEASE)
+    {
+        Profiler *profiler = Profiler::instance();
+        if(!profiler->isCapturing())
+        {
+            profiler->beginCapture();
+            profiler->setGPUEnable(true);
+        }
+        else
+        {
+            profiler->endCapture();
+            profiler->setGPUEnable(showProfiler_);
+            std::string path = FileSystem::instance()->resolveWritablePath("profile_trace.json");
+            if(profiler->saveChromeTrace(path))
+            {
+                LOG_INFO("Profile trace saved: %s", path.c_str());
+            }
+        }
+    }
+}
+
+void Application::setProfilerOverlay(bool show)
+{
+    showProfiler_ = show;
+    Profiler::instance()->setGPUEnable(show || Profiler::instance()->isCapturing());
 }
 
 void Application::onError(int error, const char *description)
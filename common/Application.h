@@ -45,6 +45,10 @@ public:
 
 	int getKeyState(int key) { return glfwGetKey(pWindow_, key); }
 	bool isKeyPress(int key) { return getKeyState(key) == GLFW_PRESS; }
+
+    /** 在屏幕上显示帧分析的耗时条，同时开启GPU计时。也可以按F3切换。*/
+    void setProfilerOverlay(bool show);
+    bool isProfilerOverlay() const { return showProfiler_; }
     
 public:
     // 内部方法，不要手动调用
@@ -80,6 +84,7 @@ protected:
     
     GLFWwindow*  pWindow_;
 	float		deltaTime_;
+    bool        showProfiler_;
 };
 
 extern Application *gApp;
@@ -0,0 +1,313 @@
+#include "BVH.h"
+#include "Ray.h"
+#include "PrecomputedRay.h"
+#include "MathDef.h"
+#include <float.h>
+#include <cassert>
+#include <algorithm>
+
+namespace
+{
+    /** SAH分桶的数量。*/
+    const int SAHBucketCount = 12;
+
+    /** 遍历栈的深度。构建的时候会保证树的深度不超过此值。*/
+    const uint32_t MaxTreeDepth = 128;
+
+    /** 超过此深度后，不再使用SAH，直接从中间划分，防止退化成链表。
+     *  中间划分最多再增加32层，所以树的深度不会超过MaxTreeDepth。
+     */
+    const uint32_t MaxSAHDepth = 64;
+
+    /** SAH代价模型中，遍历一个内部结点的代价。图元求交的代价为1。*/
+    const float TraversalCost = 1.0f;
+
+    struct SAHBucket
+    {
+        uint32_t    count_;
+        AABB        bounds_;
+    };
+}
+
+BVH::BVH()
+    : maxLeafSize_(4)
+{
+}
+
+BVH::~BVH()
+{
+}
+
+void BVH::clear()
+{
+    nodes_.clear();
+    primitives_.clear();
+}
+
+const AABB& BVH::getBoundingBox() const
+{
+    static AABB s_empty = [](){ AABB ab; ab.setEmpty(); return ab; }();
+    return nodes_.empty() ? s_empty : nodes_[0].bounds_;
+}
+
+void BVH::build(const std::vector<AABB> &bounds, uint32_t maxLeafSize)
+{
+    clear();
+    maxLeafSize_ = std::max(maxLeafSize, 1u);
+
+    if (bounds.empty())
+    {
+        return;
+    }
+
+    std::vector<BuildItem> items(bounds.size());
+    for (size_t i = 0; i < bounds.size(); ++i)
+    {
+        BuildItem &item = items[i];
+        item.bounds_ = bounds[i];
+        item.center_ = bounds[i].getCenter();
+        item.index_ = (uint32_t)i;
+    }
+
+    nodes_.reserve(bounds.size() * 2);
+    primitives_.reserve(bounds.size());
+    buildRecursive(items, 0, (uint32_t)items.size(), 0);
+}
+
+uint32_t BVH::buildRecursive(std::vector<BuildItem> &items, uint32_t begin, uint32_t end, uint32_t depth)
+{
+    uint32_t nodeIndex = (uint32_t)nodes_.size();
+    nodes_.push_back(Node());
+
+    AABB bounds, centerBounds;
+    bounds.setEmpty();
+    centerBounds.setEmpty();
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        bounds.addAABB(items[i].bounds_);
+        centerBounds.addPoint(items[i].center_);
+    }
+    nodes_[nodeIndex].bounds_ = bounds;
+
+    uint32_t count = end - begin;
+
+    int bestAxis = -1;
+    int bestSplit = 0;
+    float bestCost = FLT_MAX;
+
+    if (count > 1 && depth < MaxSAHDepth)
+    {
+        float invArea = 1.0f / std::max(bounds.getSurfaceArea(), FLT_MIN);
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            float extent = centerBounds.max_[axis] - centerBounds.min_[axis];
+            if (extent <= 0.0f)
+            {
+                continue;
+            }
+
+            SAHBucket buckets[SAHBucketCount];
+            for (SAHBucket &b : buckets)
+            {
+                b.count_ = 0;
+                b.bounds_.setEmpty();
+            }
+
+            float scale = SAHBucketCount / extent;
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                int b = int((items[i].center_[axis] - centerBounds.min_[axis]) * scale);
+                b = clamp(b, 0, SAHBucketCount - 1);
+                buckets[b].count_++;
+                buckets[b].bounds_.addAABB(items[i].bounds_);
+            }
+
+            // 从右向左扫描，记录右侧部分的代价
+            float rightCost[SAHBucketCount];
+            AABB rightBounds;
+            rightBounds.setEmpty();
+            uint32_t rightCount = 0;
+            for (int i = SAHBucketCount - 1; i > 0; --i)
+            {
+                rightCount += buckets[i].count_;
+                rightBounds.addAABB(buckets[i].bounds_);
+                rightCost[i] = rightCount > 0 ? rightCount * rightBounds.getSurfaceArea() : 0.0f;
+            }
+
+            // 从左向右扫描，在第i个桶之后划分
+            AABB leftBounds;
+            leftBounds.setEmpty();
+            uint32_t leftCount = 0;
+            for (int i = 0; i < SAHBucketCount - 1; ++i)
+            {
+                leftCount += buckets[i].count_;
+                leftBounds.addAABB(buckets[i].bounds_);
+                if (leftCount == 0 || leftCount == count)
+                {
+                    continue;
+                }
+
+                float cost = TraversalCost + (leftCount * leftBounds.getSurfaceArea() + rightCost[i + 1]) * invArea;
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = i;
+                }
+            }
+        }
+    }
+
+    // 图元足够少，并且划分后不能降低代价，生成叶子结点
+    if (count == 1 || (count <= maxLeafSize_ && (bestAxis < 0 || bestCost >= float(count))))
+    {
+        Node &node = nodes_[nodeIndex];
+        node.first_ = (uint32_t)primitives_.size();
+        node.count_ = count;
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            primitives_.push_back(items[i].index_);
+        }
+        return nodeIndex;
+    }
+
+    uint32_t mid = begin;
+    if (bestAxis >= 0)
+    {
+        float minValue = centerBounds.min_[bestAxis];
+        float scale = SAHBucketCount / (centerBounds.max_[bestAxis] - minValue);
+        auto it = std::partition(items.begin() + begin, items.begin() + end, [=](const BuildItem &item)
+        {
+            int b = int((item.center_[bestAxis] - minValue) * scale);
+            return clamp(b, 0, SAHBucketCount - 1) <= bestSplit;
+        });
+        mid = uint32_t(it - items.begin());
+    }
+
+    // 中心点重合，或者树太深了，直接从中间划分
+    if (mid == begin || mid == end)
+    {
+        Vector3 size = centerBounds.getSize();
+        int axis = 0;
+        if (size.y > size[axis]) axis = 1;
+        if (size.z > size[axis]) axis = 2;
+
+        mid = begin + count / 2;
+        std::nth_element(items.begin() + begin, items.begin() + mid, items.begin() + end,
+            [axis](const BuildItem &a, const BuildItem &b)
+        {
+            return a.center_[axis] < b.center_[axis];
+        });
+    }
+
+    buildRecursive(items, begin, mid, depth + 1);
+    uint32_t right = buildRecursive(items, mid, end, depth + 1);
+
+    Node &node = nodes_[nodeIndex];
+    node.first_ = right;
+    node.count_ = 0;
+    return nodeIndex;
+}
+
+bool BVH::intersectClosest(const Ray &ray, BVHIntersector &intersector, float &tMax) const
+{
+    return traverse(ray, intersector, tMax, false);
+}
+
+bool BVH::intersectAny(const Ray &ray, BVHIntersector &intersector, float tMax) const
+{
+    return traverse(ray, intersector, tMax, true);
+}
+
+bool BVH::traverse(const Ray &ray, BVHIntersector &intersector, float &tMax, bool anyHit) const
+{
+    if (nodes_.empty())
+    {
+        return false;
+    }
+
+    // 方向的倒数和符号只计算一次，所有结点共用
+    PrecomputedRay slabRay(ray);
+
+    float tNear, tFar;
+    if (!slabRay.intersectAABB(nodes_[0].bounds_, tMax, tNear, tFar))
+    {
+        return false;
+    }
+
+    struct StackItem
+    {
+        uint32_t    node_;
+        float       tNear_;
+    };
+    StackItem stack[MaxTreeDepth];
+    int top = 0;
+
+    bool hit = false;
+    uint32_t index = 0;
+    while (true)
+    {
+        const Node &node = nodes_[index];
+        if (node.isLeaf())
+        {
+            for (uint32_t i = 0; i < node.count_; ++i)
+            {
+                if (intersector.intersect(primitives_[node.first_ + i], ray, tMax))
+                {
+                    hit = true;
+                    if (anyHit)
+                    {
+                        return true;
+                    }
+                }
+            }
+        }
+        else
+        {
+            uint32_t left = index + 1;
+            uint32_t right = node.first_;
+
+            float tLeft, tRight;
+            bool hitLeft = slabRay.intersectAABB(nodes_[left].bounds_, tMax, tLeft, tFar);
+            bool hitRight = slabRay.intersectAABB(nodes_[right].bounds_, tMax, tRight, tFar);
+
+            if (hitLeft && hitRight)
+            {
+                // 先访问近的子结点，远的子结点入栈
+                if (tRight < tLeft)
+                {
+                    std::swap(left, right);
+                    std::swap(tLeft, tRight);
+                }
+                assert(top < (int)MaxTreeDepth);
+                stack[top].node_ = right;
+                stack[top].tNear_ = tRight;
+                ++top;
+                index = left;
+                continue;
+            }
+            else if (hitLeft)
+            {
+                index = left;
+                continue;
+            }
+            else if (hitRight)
+            {
+                index = right;
+                continue;
+            }
+        }
+
+        // 出栈。已经找到更近的交点的结点，可以直接跳过
+        do
+        {
+            if (top == 0)
+            {
+                return hit;
+            }
+            --top;
+        } while (stack[top].tNear_ > tMax);
+        index = stack[top].node_;
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "AABB.h"
+#include <vector>
+#include <cstdint>
+
+class Ray;
+
+/** BVH叶子结点中图元的求交接口。由使用者实现具体的图元求交。*/
+class BVHIntersector
+{
+public:
+    /** 测试射线与图元primitive是否相交。
+     *  如果相交并且距离小于tMax，需要将tMax更新为新的距离，并返回true。
+     */
+    virtual bool intersect(uint32_t primitive, const Ray &ray, float &tMax) = 0;
+};
+
+/** 层次包围盒(Bounding Volume Hierarchy)。
+ *  使用分桶的SAH(Surface Area Heuristic)策略构建，结点按深度优先顺序存储在连续的数组中。
+ *  BVH只关心图元的包围盒，图元本身由BVHIntersector负责求交，所以既可以用于三角形，
+ *  也可以用于模型实例(两层BVH)。
+ */
+class BVH
+{
+public:
+    struct Node
+    {
+        AABB        bounds_;
+        /** 叶子结点：图元在primitives_中的起始下标。
+         *  内部结点：右子结点的下标。左子结点紧跟在当前结点之后。
+         */
+        uint32_t    first_;
+        /** 叶子结点的图元数量。内部结点为0。*/
+        uint32_t    count_;
+
+        bool isLeaf() const { return count_ > 0; }
+    };
+
+    BVH();
+    ~BVH();
+
+    /** 根据图元的包围盒构建BVH。
+     *  @param bounds       每个图元的包围盒，下标即图元的编号。
+     *  @param maxLeafSize  叶子结点最多容纳的图元数量。
+     */
+    void build(const std::vector<AABB> &bounds, uint32_t maxLeafSize = 4);
+
+    void clear();
+
+    bool empty() const { return nodes_.empty(); }
+
+    /** 整个BVH的包围盒。BVH为空时，返回无效的包围盒。*/
+    const AABB& getBoundingBox() const;
+
+    const std::vector<Node>& getNodes() const { return nodes_; }
+
+    /** 叶子结点引用的图元编号。*/
+    const std::vector<uint32_t>& getPrimitives() const { return primitives_; }
+
+    /** 查找最近的交点。
+     *  @param tMax 输入为最大的查找距离，如果相交，返回最近交点的距离。
+     *  @return 是否有交点。
+     */
+    bool intersectClosest(const Ray &ray, BVHIntersector &intersector, float &tMax) const;
+
+    /** 查找任意一个交点，找到后立即返回。适用于阴影射线等只关心是否遮挡的查询。*/
+    bool intersectAny(const Ray &ray, BVHIntersector &intersector, float tMax) const;
+
+private:
+    struct BuildItem
+    {
+        AABB        bounds_;
+        Vector3     center_;
+        uint32_t    index_;
+    };
+
+    uint32_t buildRecursive(std::vector<BuildItem> &items, uint32_t begin, uint32_t end, uint32_t depth);
+
+    bool traverse(const Ray &ray, BVHIntersector &intersector, float &tMax, bool anyHit) const;
+
+    std::vector<Node>       nodes_;
+    std::vector<uint32_t>   primitives_;
+    uint32_t                maxLeafSize_;
+};
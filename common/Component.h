@@ -6,6 +6,7 @@
 
 class Transform;
 class Renderer;
+class AABB;
 
 class Component : public ReferenceCount
 {
@@ -16,6 +17,11 @@ public:
     virtual void tick(float elapse) {}
     virtual void draw(Renderer *renderer) {}
 
+    /** 局部空间的包围盒，用于视锥裁剪。返回false表示没有包围盒，不会被裁剪掉。
+     *  包围盒发生变化后，需要调用所在Transform的invalidateBounds。
+     */
+    virtual bool getLocalBounds(AABB & /*bounds*/) const { return false; }
+
     const std::string& getName() const { return name_; }
     void setName(const std::string & name) { name_ = name; }
 
@@ -0,0 +1,221 @@
+#include "Compression.h"
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+    const size_t MinMatch = 4;
+    const size_t MaxOffset = 65535;
+    /// 最后的几个字节总是作为字面量，匹配的查找不需要检查末尾
+    const size_t LastLiterals = 5;
+    const int HashBits = 14;
+    /// 重排字节时每次处理的元素数量，一块的数据留在一级缓存中
+    const size_t TransposeBlock = 256;
+
+    inline uint32_t read32(const uint8_t *p)
+    {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    inline uint32_t hash4(uint32_t v)
+    {
+        return (v * 2654435761u) >> (32 - HashBits);
+    }
+
+    void writeLength(std::vector<uint8_t> &dst, size_t length)
+    {
+        for(; length >= 255; length -= 255)
+        {
+            dst.push_back(255);
+        }
+        dst.push_back(uint8_t(length));
+    }
+
+    bool readLength(const uint8_t *&ip, const uint8_t *end, size_t &length)
+    {
+        uint8_t b;
+        do
+        {
+            if(ip >= end)
+            {
+                return false;
+            }
+            b = *ip++;
+            length += b;
+        } while(b == 255);
+        return true;
+    }
+
+    void writeSequence(std::vector<uint8_t> &dst, const uint8_t *literals, size_t nLiterals, size_t offset, size_t matchLength)
+    {
+        size_t extra = matchLength >= MinMatch ? matchLength - MinMatch : 0;
+        uint8_t token = uint8_t((nLiterals < 15 ? nLiterals : 15) << 4);
+        if(matchLength > 0)
+        {
+            token |= uint8_t(extra < 15 ? extra : 15);
+        }
+        dst.push_back(token);
+        if(nLiterals >= 15)
+        {
+            writeLength(dst, nLiterals - 15);
+        }
+        dst.insert(dst.end(), literals, literals + nLiterals);
+
+        if(matchLength > 0)
+        {
+            dst.push_back(uint8_t(offset));
+            dst.push_back(uint8_t(offset >> 8));
+            if(extra >= 15)
+            {
+                writeLength(dst, extra - 15);
+            }
+        }
+    }
+}
+
+void compressLZ(const uint8_t *src, size_t size, std::vector<uint8_t> &dst)
+{
+    dst.reserve(dst.size() + size / 2 + 16);
+
+    size_t anchor = 0;
+    if(size > MinMatch + LastLiterals)
+    {
+        // 记录每个4字节序列最近一次出现的位置+1，0表示没有出现过
+        std::vector<uint32_t> table(size_t(1) << HashBits, 0);
+        const size_t limit = size - LastLiterals;
+
+        size_t pos = 0;
+        while(pos + MinMatch <= limit)
+        {
+            uint32_t v = read32(src + pos);
+            uint32_t &slot = table[hash4(v)];
+            size_t candidate = slot;
+            slot = uint32_t(pos + 1);
+
+            if(candidate == 0 || pos + 1 - candidate > MaxOffset || read32(src + candidate - 1) != v)
+            {
+                ++pos;
+                continue;
+            }
+            --candidate;
+
+            size_t length = MinMatch;
+            while(pos + length < limit && src[candidate + length] == src[pos + length])
+            {
+                ++length;
+            }
+
+            writeSequence(dst, src + anchor, pos - anchor, pos - candidate, length);
+            pos += length;
+            anchor = pos;
+
+            // 匹配内部的位置也记入表中，提高之后的命中率
+            if(pos + MinMatch <= limit)
+            {
+                table[hash4(read32(src + pos - 2))] = uint32_t(pos - 2 + 1);
+            }
+        }
+    }
+
+    writeSequence(dst, src + anchor, size - anchor, 0, 0);
+}
+
+bool decompressLZ(const uint8_t *src, size_t size, uint8_t *dst, size_t dstSize)
+{
+    const uint8_t *ip = src;
+    const uint8_t *end = src + size;
+    size_t op = 0;
+
+    while(ip < end)
+    {
+        uint8_t token = *ip++;
+
+        size_t nLiterals = token >> 4;
+        if(nLiterals == 15 && !readLength(ip, end, nLiterals))
+        {
+            return false;
+        }
+        if(nLiterals > size_t(end - ip) || nLiterals > dstSize - op)
+        {
+            return false;
+        }
+        memcpy(dst + op, ip, nLiterals);
+        ip += nLiterals;
+        op += nLiterals;
+
+        // 最后一个序列只有字面量
+        if(ip == end)
+        {
+            break;
+        }
+
+        if(end - ip < 2)
+        {
+            return false;
+        }
+        size_t offset = ip[0] | (size_t(ip[1]) << 8);
+        ip += 2;
+
+        size_t length = token & 15;
+        if(length == 15 && !readLength(ip, end, length))
+        {
+            return false;
+        }
+        length += MinMatch;
+
+        if(offset == 0 || offset > op || length > dstSize - op)
+        {
+            return false;
+        }
+        // 匹配与输出重叠时，内容以offset为周期重复。每次复制已经写出的整段，复制的长度逐次翻倍
+        const uint8_t *match = dst + op - offset;
+        uint8_t *out = dst + op;
+        for(size_t remaining = length; remaining > 0;)
+        {
+            size_t n = std::min(size_t(out - match), remaining);
+            memcpy(out, match, n);
+            out += n;
+            remaining -= n;
+        }
+        op += length;
+    }
+    return op == dstSize;
+}
+
+void shuffleBytes(const uint8_t *src, size_t size, size_t stride, uint8_t *dst)
+{
+    size_t count = stride > 0 ? size / stride : 0;
+    for(size_t first = 0; first < count; first += TransposeBlock)
+    {
+        size_t last = std::min(first + TransposeBlock, count);
+        for(size_t k = 0; k < stride; ++k)
+        {
+            uint8_t *out = dst + k * count;
+            for(size_t i = first; i < last; ++i)
+            {
+                out[i] = src[i * stride + k];
+            }
+        }
+    }
+    memcpy(dst + count * stride, src + count * stride, size - count * stride);
+}
+
+void unshuffleBytes(const uint8_t *src, size_t size, size_t stride, uint8_t *dst)
+{
+    size_t count = stride > 0 ? size / stride : 0;
+    for(size_t first = 0; first < count; first += TransposeBlock)
+    {
+        size_t last = std::min(first + TransposeBlock, count);
+        for(size_t k = 0; k < stride; ++k)
+        {
+            const uint8_t *in = src + k * count;
+            for(size_t i = first; i < last; ++i)
+            {
+                dst[i * stride + k] = in[i];
+            }
+        }
+    }
+    memcpy(dst + count * stride, src + count * stride, size - count * stride);
+}
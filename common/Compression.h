@@ -0,0 +1,20 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/** LZ77压缩，块格式与LZ4相同：每个序列由标记字节、字面量、2字节的匹配距离组成，
+ *  标记字节的高4位是字面量长度，低4位是匹配长度减4，为15时后面跟着扩展长度。
+ *  压缩结果追加到dst的末尾。
+ */
+void compressLZ(const uint8_t *src, size_t size, std::vector<uint8_t> &dst);
+
+/** dstSize必须等于原始数据的大小。数据损坏时返回false，不会越界读写。*/
+bool decompressLZ(const uint8_t *src, size_t size, uint8_t *dst, size_t dstSize);
+
+/** 把每个元素的第k个字节放在一起，浮点数组的指数和高位字节重复较多，重排之后更容易压缩。
+ *  size不是stride的整数倍时，剩余的字节原样放在末尾。
+ */
+void shuffleBytes(const uint8_t *src, size_t size, size_t stride, uint8_t *dst);
+void unshuffleBytes(const uint8_t *src, size_t size, size_t stride, uint8_t *dst);
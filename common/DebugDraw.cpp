@@ -1,115 +1,253 @@
 #include "DebugDraw.h"
-#include "Mesh.h"
-#include "VertexBuffer.h"
+#include "Material.h"
+#include "VertexAttribute.h"
 #include "VertexDeclaration.h"
 #include "Renderer.h"
+#include "GLStateCache.h"
+#include "AABB.h"
+#include <cstring>
 
 IMPLEMENT_SINGLETON(DebugDraw);
 
+namespace
+{
+    const GLenum BatchPrimitives[] = { GL_POINTS, GL_LINES, GL_TRIANGLES };
+}
+
 DebugDraw::DebugDraw()
+    : depthMode_(DepthTest)
+    , ring_(GL_ARRAY_BUFFER)
+    , vertexArray_(0)
+{
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+DebugDraw::~DebugDraw()
 {
+    if (vertexArray_ != 0)
+    {
+        glDeleteVertexArrays(1, &vertexArray_);
+        if (GLStateCache::hasInstance())
+        {
+            GLStateCache::instance()->onDeleteVertexArray(vertexArray_);
+        }
+    }
 }
 
-bool DebugDraw::init()
+bool DebugDraw::init(const std::string &shaderFile, uint32_t capacity)
 {
-    mesh_ = new Mesh();
+    shaderFile_ = shaderFile;
 
-    mesh_->setVertexDecl(VertexDeclMgr::instance()->get(VertexXYZColor::getType()));
-    mesh_->setVertexBuffer(new VertexBufferEx<VertexXYZColor>(BufferUsage::Dynamic, 0));
+    decl_ = VertexDeclMgr::instance()->get(VertexXYZColor::getType());
+    if (!decl_)
+    {
+        return false;
+    }
+
+    // 每次分配都对齐到顶点
+    if (!ring_.init((capacity > 0 ? capacity : 1) * sizeof(VertexXYZColor), sizeof(VertexXYZColor)))
+    {
+        return false;
+    }
+
+    GLStateCache *cache = GLStateCache::instance();
+    if (isVAOSupported())
+    {
+        glGenVertexArrays(1, &vertexArray_);
+        cache->bindVertexArray(vertexArray_);
+    }
+    ring_.bind();
+    if (vertexArray_ != 0)
+    {
+        // 属性指针的偏移固定为0，绘制时用first选择环形缓冲区中的位置
+        VertexAttribute::setupAttributes(decl_.get());
+        cache->bindVertexArray(0);
+    }
+    ring_.unbind();
     return true;
 }
 
+VertexXYZColor* DebugDraw::allocate(Batch batch, size_t count)
+{
+    std::vector<VertexXYZColor> &vertices = batches_[depthMode_][batch];
+    size_t n = vertices.size();
+    vertices.resize(n + count);
+    return &vertices[n];
+}
+
+uint32_t DebugDraw::upload(uint32_t count)
+{
+    ring_.bind();
+    size_t size = count * sizeof(VertexXYZColor);
+    if (ring_.reserve(size))
+    {
+        ++stats_.nOrphans;
+    }
+
+    size_t offset = 0;
+    char *p = (char*)ring_.map(size, offset);
+    if (p != nullptr)
+    {
+        for (auto &batches : batches_)
+        {
+            for (const std::vector<VertexXYZColor> &vertices : batches)
+            {
+                size_t bytes = vertices.size() * sizeof(VertexXYZColor);
+                if (bytes > 0)
+                {
+                    memcpy(p, vertices.data(), bytes);
+                    p += bytes;
+                }
+            }
+        }
+        ring_.unmap();
+    }
+    return uint32_t(offset / sizeof(VertexXYZColor));
+}
+
+void DebugDraw::bindBuffers()
+{
+    if (vertexArray_ != 0)
+    {
+        GLStateCache::instance()->bindVertexArray(vertexArray_);
+    }
+    else
+    {
+        ring_.bind();
+        VertexAttribute::setupAttributes(decl_.get());
+    }
+}
+
+void DebugDraw::unbindBuffers()
+{
+    if (vertexArray_ != 0)
+    {
+        GLStateCache::instance()->bindVertexArray(0);
+    }
+    else
+    {
+        VertexAttribute::disableAttributes(decl_.get());
+    }
+    GLStateCache::instance()->bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
 void DebugDraw::draw(Renderer * renderer)
 {
-    if (mesh_ && !vertices_.empty())
+    memset(&stats_, 0, sizeof(stats_));
+
+    size_t count = 0;
+    for (auto &batches : batches_)
     {
+        for (const std::vector<VertexXYZColor> &vertices : batches)
+        {
+            count += vertices.size();
+        }
+    }
+
+    if (count > 0 && ring_.getHandle() != 0)
+    {
+        if (!material_)
+        {
+            material_ = new Material();
+            material_->loadShader(shaderFile_);
+        }
+
         renderer->applyCameraMatrix();
         renderer->setWorldMatrix(Matrix::Identity);
 
-        if (mesh_->getMaterials().empty())
+        uint32_t first = upload(uint32_t(count));
+        stats_.nVertices = count;
+
+        bindBuffers();
+        if (material_->begin())
         {
-            MaterialPtr mtl = new Material();
-            mtl->loadShader("shader/xyzcolor.shader");
-            mesh_->addMaterial(mtl);
+            GLStateCache *cache = GLStateCache::instance();
+            bool cullFace = cache->isEnabled(GL_CULL_FACE);
+            bool depthTest = cache->isEnabled(GL_DEPTH_TEST);
+            cache->disable(GL_CULL_FACE);
+            cache->depthFunc(GL_LEQUAL);
+
+            for (int mode = 0; mode < DepthModeCount; ++mode)
+            {
+                cache->setEnabled(GL_DEPTH_TEST, mode == DepthTest);
+                for (int batch = 0; batch < BatchCount; ++batch)
+                {
+                    GLsizei n = GLsizei(batches_[mode][batch].size());
+                    if (n > 0)
+                    {
+                        glDrawArrays(BatchPrimitives[batch], first, n);
+                        first += n;
+                        ++stats_.nDrawCalls;
+                    }
+                }
+            }
+
+            cache->depthFunc(GL_LESS);
+            cache->setEnabled(GL_DEPTH_TEST, depthTest);
+            cache->setEnabled(GL_CULL_FACE, cullFace);
+            material_->end();
         }
-        GLint cullFace;
-        glGetIntegerv(GL_CULL_FACE, &cullFace);
-        glDisable(GL_CULL_FACE);
-        glDepthFunc(GL_LEQUAL);
-        VertexBufferPtr vb = mesh_->getVertexBuffer();
-        vb->resize(vertices_.size(), vertices_.data());
-
-        mesh_->draw(renderer);
-
-        mesh_->clearSubMeshes();
-        glDepthFunc(GL_LESS);
-        if (cullFace)
+        unbindBuffers();
+    }
+
+    // clear保留容量，之后的帧不再分配内存
+    for (auto &batches : batches_)
+    {
+        for (std::vector<VertexXYZColor> &vertices : batches)
         {
-            glEnable(GL_CULL_FACE);
+            vertices.clear();
         }
     }
-    vertices_.clear();
+    depthMode_ = DepthTest;
 }
 
 void DebugDraw::drawPoint(const Vector3 & point, const Color & color)
 {
-    SubMeshPtr sub = new SubMesh();
-    sub->setPrimitive(PrimitiveType::PointList, vertices_.size(), 1, 0, false);
-    mesh_->addSubMesh(sub);
-
-    VertexXYZColor v = { point, color };
-    vertices_.push_back(v);
+    VertexXYZColor *v = allocate(Points, 1);
+    v->position = point;
+    v->color = color;
 }
 
 void DebugDraw::drawPoints(const Vector3 * points, int count, const Color & color)
 {
-    SubMeshPtr sub = new SubMesh();
-    sub->setPrimitive(PrimitiveType::PointList, vertices_.size(), count, 0, false);
-    mesh_->addSubMesh(sub);
-
-    VertexXYZColor v;
-    v.color = color;
+    if (count <= 0)
+    {
+        return;
+    }
 
+    VertexXYZColor *v = allocate(Points, count);
     for (int i = 0; i < count; ++i)
     {
-        v.position = points[i];
-        vertices_.push_back(v);
+        v[i].position = points[i];
+        v[i].color = color;
     }
 }
 
 void DebugDraw::drawLine(const Vector3 & start, const Vector3 & end, const Color & color)
 {
-    SubMeshPtr sub = new SubMesh();
-    sub->setPrimitive(PrimitiveType::LineList, vertices_.size(), 2, 0, false);
-    mesh_->addSubMesh(sub);
-
-    VertexXYZColor v;
-    v.color = color;
-
-    v.position = start;
-    vertices_.push_back(v);
-
-    v.position = end;
-    vertices_.push_back(v);
+    VertexXYZColor *v = allocate(Lines, 2);
+    v[0].position = start;
+    v[0].color = color;
+    v[1].position = end;
+    v[1].color = color;
 }
 
 void DebugDraw::drawPolygon(const Vector3 * points, int count, const Color & color)
 {
-    SubMeshPtr sub = new SubMesh();
-    sub->setPrimitive(PrimitiveType::LineStrip, vertices_.size(), count + 1, 0, false);
-    mesh_->addSubMesh(sub);
-
-    VertexXYZColor v;
-    v.color = color;
+    if (count <= 0)
+    {
+        return;
+    }
 
+    // 闭合的折线拆成count条线段，与其它线段合并绘制
+    VertexXYZColor *v = allocate(Lines, count * 2);
     for (int i = 0; i < count; ++i)
     {
-        v.position = points[i];
-        vertices_.push_back(v);
+        v[i * 2].position = points[i];
+        v[i * 2].color = color;
+        v[i * 2 + 1].position = points[(i + 1) % count];
+        v[i * 2 + 1].color = color;
     }
-
-    v.position = points[0];
-    vertices_.push_back(v);
 }
 
 void DebugDraw::drawAABB(const AABB & ab, const Matrix & matrix, const Color & color)
@@ -141,21 +279,13 @@ void DebugDraw::drawAABB(const AABB & ab, const Matrix & matrix, const Color & c
 
 void DebugDraw::drawFilledTriangle(const Vector3 & a, const Vector3 & b, const Vector3 & c, const Color & color)
 {
-    SubMeshPtr sub = new SubMesh();
-    sub->setPrimitive(PrimitiveType::TriangleList, vertices_.size(), 3, 0, false);
-    mesh_->addSubMesh(sub);
-
-    VertexXYZColor v;
-    v.color = color;
-
-    v.position = a;
-    vertices_.push_back(v);
-
-    v.position = b;
-    vertices_.push_back(v);
-
-    v.position = c;
-    vertices_.push_back(v);
+    VertexXYZColor *v = allocate(Triangles, 3);
+    v[0].position = a;
+    v[0].color = color;
+    v[1].position = b;
+    v[1].color = color;
+    v[2].position = c;
+    v[2].color = color;
 }
 
 void DebugDraw::drawFilledTriangle(const Vector3 & a, const Vector3 & b, const Vector3 & c, const Color & color, const Matrix & matrix, float offset)
@@ -2,24 +2,57 @@
 #include "Singleton.h"
 #include "SmartPointer.h"
 #include "Vertex.h"
+#include "StreamingRing.h"
 #include <vector>
+#include <string>
 
 class Renderer;
-class Mesh;
+class Material;
+class VertexDeclaration;
 class Vector3;
 class Color;
 class AABB;
 class Matrix;
 
+/** 调试图元的绘制。
+ *  图元按类型(点、线、三角形)和深度模式分别追加到批次中，不为每个图元分配内存。
+ *  draw时所有批次一次性写入一个环形的流式顶点缓冲区，每个批次只绘制一次。
+ *  环形缓冲区写满后重新分配存储(orphan)，不需要等待GPU；一帧的数据超过容量时，容量翻倍。
+ */
 class DebugDraw : public Singleton<DebugDraw>
 {
 public:
+    enum DepthMode
+    {
+        /// 参与深度测试(GL_LEQUAL)，不剔除背面
+        DepthTest,
+        /// 不做深度测试，画在最上面
+        NoDepthTest,
+        DepthModeCount
+    };
+
+    struct Stats
+    {
+        size_t  nDrawCalls;
+        size_t  nVertices;
+        size_t  nOrphans;
+    };
+
     DebugDraw();
+    ~DebugDraw();
 
-    bool init();
+    /** 创建顶点缓冲区。GL上下文创建之后调用。
+     *  @param shaderFile   第一次绘制时加载
+     *  @param capacity     环形缓冲区初始可以容纳的顶点数量
+     */
+    bool init(const std::string &shaderFile = "shader/xyzcolor.shader", uint32_t capacity = 64 * 1024);
 
     void draw(Renderer *renderer);
 
+    /** 之后提交的图元使用的深度模式，draw之后恢复为DepthTest。*/
+    void setDepthMode(DepthMode mode){ depthMode_ = mode; }
+    DepthMode getDepthMode() const { return depthMode_; }
+
     void drawPoint(const Vector3 &point, const Color &color);
 
     void drawPoints(const Vector3 *point, int count, const Color &color);
@@ -33,7 +66,35 @@ public:
     void drawFilledTriangle(const Vector3 &a, const Vector3 &b, const Vector3 &c, const Color &color);
     void drawFilledTriangle(const Vector3 &a, const Vector3 &b, const Vector3 &c, const Color &color, const Matrix &matrix, float offset = 0.01f);
 
+    /** 最近一次draw的统计。*/
+    const Stats& getStats() const { return stats_; }
+
 private:
-    SmartPointer<Mesh> mesh_;
-    std::vector<VertexXYZColor> vertices_;
+    enum Batch
+    {
+        Points,
+        Lines,
+        Triangles,
+        BatchCount
+    };
+
+    /** 在当前深度模式的批次末尾追加count个顶点，返回第一个顶点。*/
+    VertexXYZColor* allocate(Batch batch, size_t count);
+
+    /** 写入所有批次的顶点，返回第一个顶点在缓冲区中的位置。*/
+    uint32_t upload(uint32_t count);
+    void bindBuffers();
+    void unbindBuffers();
+
+    std::vector<VertexXYZColor>     batches_[DepthModeCount][BatchCount];
+    DepthMode   depthMode_;
+
+    std::string shaderFile_;
+    SmartPointer<Material>          material_;
+    SmartPointer<VertexDeclaration> decl_;
+
+    StreamingRing   ring_;
+    GLuint          vertexArray_;
+
+    Stats       stats_;
 };
@@ -4,6 +4,7 @@
 #include "Vertex.h"
 #include "Mesh.h"
 #include "Matrix.h"
+#include "MeshOptimizer.h"
 
 #include <unordered_map>
 #include <unordered_set>
@@ -33,7 +34,7 @@ std::string findResPath()
 }
 
 template<typename VertexType, typename IndexType>
-MeshPtr createMesh(const VertexType *vertices, size_t nVertices, const IndexType *indices, size_t nIndices)
+MeshPtr createMesh(const VertexType *vertices, size_t nVertices, const IndexType *indices, size_t nIndices, bool optimize)
 {
 	VertexBufferPtr vb = new VertexBufferEx<VertexType>(BufferUsage::Static, nVertices, vertices);
 	IndexBufferPtr ib = new IndexBufferEx<IndexType>(BufferUsage::Static, nIndices, indices);
@@ -47,6 +48,10 @@ MeshPtr createMesh(const VertexType *vertices, size_t nVertices, const IndexType
 	subMesh->setPrimitive(PrimitiveType::TriangleList, 0, nIndices, 0, true);
 	mesh->addSubMesh(subMesh);
 
+	if (optimize)
+	{
+		optimizeMesh(mesh.get());
+	}
 	return mesh;
 }
 
@@ -230,14 +235,14 @@ void createSimpleGround(std::vector<MeshVertex> &vertices, std::vector<uint16_t>
 	computeTangents(vertices, indices);
 }
 
-MeshPtr createSimpleGround(const Vector2 &size, float height, float gridSize, float waveSize)
+MeshPtr createSimpleGround(const Vector2 &size, float height, float gridSize, float waveSize, bool optimize)
 {
 	typedef MeshVertex VertexType;
 	std::vector<VertexType> vertices;
 	std::vector<uint16_t> indices;
 
 	createSimpleGround(vertices, indices, size, height, gridSize, waveSize);
-	return createMesh<VertexType, uint16_t>(vertices.data(), vertices.size(), indices.data(), indices.size());
+	return createMesh<VertexType, uint16_t>(vertices.data(), vertices.size(), indices.data(), indices.size(), optimize);
 }
 
 void createPlane(std::vector<MeshVertex> &vertices, std::vector<uint16_t> &indices,
@@ -293,14 +298,14 @@ void createPlane(std::vector<MeshVertex> &vertices, std::vector<uint16_t> &indic
 	}
 }
 
-MeshPtr createPlane(const Vector2 &size, float gridSize)
+MeshPtr createPlane(const Vector2 &size, float gridSize, bool optimize)
 {
 	typedef MeshVertex VertexType;
 	std::vector<VertexType> vertices;
 	std::vector<uint16_t> indices;
 
 	createPlane(vertices, indices, size, gridSize);
-	return createMesh<VertexType, uint16_t>(vertices.data(), vertices.size(), indices.data(), indices.size());
+	return createMesh<VertexType, uint16_t>(vertices.data(), vertices.size(), indices.data(), indices.size(), optimize);
 }
 
 void createCube(std::vector<MeshVertex> &vertices, std::vector<uint16_t> &indices,
@@ -390,17 +395,17 @@ void createCube(std::vector<MeshVertex> &vertices, std::vector<uint16_t> &indice
 	}
 }
 
-MeshPtr createCube(const Vector3 &size)
+MeshPtr createCube(const Vector3 &size, bool optimize)
 {
 	typedef MeshVertex VertexType;
 	std::vector<VertexType> vertices;
 	std::vector<uint16_t> indices;
 
 	createCube(vertices, indices, size);
-	return createMesh<VertexType, uint16_t>(vertices.data(), vertices.size(), indices.data(), indices.size());
+	return createMesh<VertexType, uint16_t>(vertices.data(), vertices.size(), indices.data(), indices.size(), optimize);
 }
 
-MeshPtr createQuad(const Vector2 & size)
+MeshPtr createQuad(const Vector2 & size, bool optimize)
 {
 	typedef VertexXYZUV VertexType;
 
@@ -419,7 +424,7 @@ MeshPtr createQuad(const Vector2 & size)
 		2, 1, 3,
 	};
 
-	return createMesh<VertexType, uint16_t>(vertices, 4, indices, 6);
+	return createMesh<VertexType, uint16_t>(vertices, 4, indices, 6, optimize);
 }
 
 static uint32_t extractIndex(const char *data, size_t i, size_t stride)
@@ -466,7 +471,7 @@ void unionEdge(EdgeSet &edges, uint32_t a, uint32_t b)
 }
 
 
-MeshPtr createShaowVolumeForDirectionLight(MeshPtr source, const Matrix &matWorld, const Vector3 &lightDir)
+MeshPtr createShaowVolumeForDirectionLight(MeshPtr source, const Matrix &matWorld, const Vector3 &lightDir, bool optimize)
 {
 	VertexDeclarationPtr decl = source->getVertexDecl();
 	VertexBufferPtr vb = source->getVertexBuffer();
@@ -584,5 +589,10 @@ MeshPtr createShaowVolumeForDirectionLight(MeshPtr source, const Matrix &matWorl
 	SubMeshPtr subMesh = new SubMesh();
 	subMesh->setPrimitive(PrimitiveType::TriangleList, 0, indices.size(), 0, true);
 	ret->addSubMesh(subMesh);
+
+	if (optimize)
+	{
+		optimizeMesh(ret.get());
+	}
 	return ret;
 }
@@ -15,15 +15,19 @@ class Vector3;
 
 typedef SmartPointer<Mesh> MeshPtr;
 
-MeshPtr createSimpleGround(const Vector2 &size, float height,  float gridSize, float waveSize);
+/** 以下生成模型的函数，optimize为true时用optimizeMesh重排三角形和顶点，
+ *  适合顶点较多、绘制次数多的网格(地面、平面)，几个顶点的立方体和四边形收益很小。
+ */
+MeshPtr createSimpleGround(const Vector2 &size, float height,  float gridSize, float waveSize, bool optimize = false);
 
-MeshPtr createPlane(const Vector2 &size, float gridSize);
+MeshPtr createPlane(const Vector2 &size, float gridSize, bool optimize = false);
 
-MeshPtr createCube(const Vector3 &size);
+MeshPtr createCube(const Vector3 &size, bool optimize = false);
 
-MeshPtr createQuad(const Vector2 &size);
+MeshPtr createQuad(const Vector2 &size, bool optimize = false);
 
-MeshPtr createShaowVolumeForDirectionLight(MeshPtr source, const Matrix &matWorld, const Vector3 &lightDir);
+/** 生成方向光的阴影体。optimize为true时重排三角形和顶点，每帧都重新生成的阴影体不需要。*/
+MeshPtr createShaowVolumeForDirectionLight(MeshPtr source, const Matrix &matWorld, const Vector3 &lightDir, bool optimize = false);
 
 template<typename T>
 bool bindShaderUniform(ShaderProgram *shader, const char *name, const T &value)
@@ -0,0 +1,674 @@
+#include "DynamicAABBTree.h"
+#include "Frustum.h"
+#include "Ray.h"
+#include "PrecomputedRay.h"
+#include <algorithm>
+#include <queue>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+    /// 遍历栈的大小。树基本是平衡的，栈中的结点数不超过树的高度加1，这个深度足够用了
+    const int MaxStackSize = 128;
+
+    AABB combine(const AABB &a, const AABB &b)
+    {
+        AABB ret;
+        ret.min_.set(std::min(a.min_.x, b.min_.x), std::min(a.min_.y, b.min_.y), std::min(a.min_.z, b.min_.z));
+        ret.max_.set(std::max(a.max_.x, b.max_.x), std::max(a.max_.y, b.max_.y), std::max(a.max_.z, b.max_.z));
+        return ret;
+    }
+}
+
+DynamicAABBTree::DynamicAABBTree(float margin)
+    : root_(NullNode)
+    , freeList_(NullNode)
+    , nProxies_(0)
+    , margin_(margin)
+{
+}
+
+DynamicAABBTree::~DynamicAABBTree()
+{
+}
+
+void DynamicAABBTree::clear()
+{
+    nodes_.clear();
+    root_ = NullNode;
+    freeList_ = NullNode;
+    nProxies_ = 0;
+}
+
+int DynamicAABBTree::allocateNode()
+{
+    int node;
+    if (freeList_ != NullNode)
+    {
+        node = freeList_;
+        freeList_ = nodes_[node].next_;
+    }
+    else
+    {
+        node = (int)nodes_.size();
+        nodes_.push_back(Node());
+    }
+
+    Node &n = nodes_[node];
+    n.userData_ = nullptr;
+    n.parent_ = NullNode;
+    n.child1_ = NullNode;
+    n.child2_ = NullNode;
+    n.height_ = 0;
+    return node;
+}
+
+void DynamicAABBTree::freeNode(int node)
+{
+    nodes_[node].next_ = freeList_;
+    nodes_[node].height_ = -1;
+    freeList_ = node;
+}
+
+int DynamicAABBTree::createProxy(const AABB &bounds, void *userData)
+{
+    int proxy = allocateNode();
+
+    Vector3 margin(margin_, margin_, margin_);
+    Node &n = nodes_[proxy];
+    n.bounds_.min_ = bounds.min_ - margin;
+    n.bounds_.max_ = bounds.max_ + margin;
+    n.userData_ = userData;
+
+    insertLeaf(proxy);
+    ++nProxies_;
+    return proxy;
+}
+
+void DynamicAABBTree::destroyProxy(int proxy)
+{
+    assert(nodes_[proxy].isLeaf());
+
+    removeLeaf(proxy);
+    freeNode(proxy);
+    --nProxies_;
+}
+
+bool DynamicAABBTree::moveProxy(int proxy, const AABB &bounds, const Vector3 &displacement)
+{
+    assert(nodes_[proxy].isLeaf());
+
+    if (nodes_[proxy].bounds_.contains(bounds))
+    {
+        return false;
+    }
+
+    removeLeaf(proxy);
+
+    // 沿着移动的方向多扩大一些，预测下一次的位置
+    Vector3 margin(margin_, margin_, margin_);
+    AABB fat;
+    fat.min_ = bounds.min_ - margin;
+    fat.max_ = bounds.max_ + margin;
+    for (int i = 0; i < 3; ++i)
+    {
+        float d = displacement[i] * 2.0f;
+        if (d < 0.0f)
+        {
+            fat.min_[i] += d;
+        }
+        else
+        {
+            fat.max_[i] += d;
+        }
+    }
+
+    nodes_[proxy].bounds_ = fat;
+    insertLeaf(proxy);
+    return true;
+}
+
+void DynamicAABBTree::insertLeaf(int leaf)
+{
+    if (root_ == NullNode)
+    {
+        root_ = leaf;
+        nodes_[root_].parent_ = NullNode;
+        return;
+    }
+
+    // 按表面积代价找到最合适的兄弟结点
+    AABB leafBounds = nodes_[leaf].bounds_;
+    int index = root_;
+    while (!nodes_[index].isLeaf())
+    {
+        const Node &node = nodes_[index];
+        int child1 = node.child1_;
+        int child2 = node.child2_;
+
+        float area = node.bounds_.getSurfaceArea();
+        float combinedArea = combine(node.bounds_, leafBounds).getSurfaceArea();
+
+        // 在当前结点处新建父结点的代价
+        float cost = 2.0f * combinedArea;
+        // 继续下降时，祖先结点需要增加的面积
+        float inheritanceCost = 2.0f * (combinedArea - area);
+
+        float cost1 = combine(leafBounds, nodes_[child1].bounds_).getSurfaceArea() + inheritanceCost;
+        if (!nodes_[child1].isLeaf())
+        {
+            cost1 -= nodes_[child1].bounds_.getSurfaceArea();
+        }
+
+        float cost2 = combine(leafBounds, nodes_[child2].bounds_).getSurfaceArea() + inheritanceCost;
+        if (!nodes_[child2].isLeaf())
+        {
+            cost2 -= nodes_[child2].bounds_.getSurfaceArea();
+        }
+
+        if (cost < cost1 && cost < cost2)
+        {
+            break;
+        }
+
+        index = cost1 < cost2 ? child1 : child2;
+    }
+
+    int sibling = index;
+
+    // 新建父结点，代替兄弟结点的位置
+    int oldParent = nodes_[sibling].parent_;
+    int newParent = allocateNode();
+    nodes_[newParent].parent_ = oldParent;
+    nodes_[newParent].bounds_ = combine(leafBounds, nodes_[sibling].bounds_);
+    nodes_[newParent].height_ = nodes_[sibling].height_ + 1;
+    nodes_[newParent].child1_ = sibling;
+    nodes_[newParent].child2_ = leaf;
+    nodes_[sibling].parent_ = newParent;
+    nodes_[leaf].parent_ = newParent;
+
+    if (oldParent != NullNode)
+    {
+        if (nodes_[oldParent].child1_ == sibling)
+        {
+            nodes_[oldParent].child1_ = newParent;
+        }
+        else
+        {
+            nodes_[oldParent].child2_ = newParent;
+        }
+    }
+    else
+    {
+        root_ = newParent;
+    }
+
+    // 向上修正高度和包围盒
+    index = nodes_[leaf].parent_;
+    while (index != NullNode)
+    {
+        index = balance(index);
+
+        int child1 = nodes_[index].child1_;
+        int child2 = nodes_[index].child2_;
+        nodes_[index].height_ = 1 + std::max(nodes_[child1].height_, nodes_[child2].height_);
+        nodes_[index].bounds_ = combine(nodes_[child1].bounds_, nodes_[child2].bounds_);
+
+        index = nodes_[index].parent_;
+    }
+}
+
+void DynamicAABBTree::removeLeaf(int leaf)
+{
+    if (leaf == root_)
+    {
+        root_ = NullNode;
+        return;
+    }
+
+    int parent = nodes_[leaf].parent_;
+    int grandParent = nodes_[parent].parent_;
+    int sibling = nodes_[parent].child1_ == leaf ? nodes_[parent].child2_ : nodes_[parent].child1_;
+
+    // 兄弟结点代替父结点的位置，父结点被删除
+    if (grandParent != NullNode)
+    {
+        if (nodes_[grandParent].child1_ == parent)
+        {
+            nodes_[grandParent].child1_ = sibling;
+        }
+        else
+        {
+            nodes_[grandParent].child2_ = sibling;
+        }
+        nodes_[sibling].parent_ = grandParent;
+        freeNode(parent);
+
+        int index = grandParent;
+        while (index != NullNode)
+        {
+            index = balance(index);
+
+            int child1 = nodes_[index].child1_;
+            int child2 = nodes_[index].child2_;
+            nodes_[index].bounds_ = combine(nodes_[child1].bounds_, nodes_[child2].bounds_);
+            nodes_[index].height_ = 1 + std::max(nodes_[child1].height_, nodes_[child2].height_);
+
+            index = nodes_[index].parent_;
+        }
+    }
+    else
+    {
+        root_ = sibling;
+        nodes_[sibling].parent_ = NullNode;
+        freeNode(parent);
+    }
+}
+
+int DynamicAABBTree::balance(int iA)
+{
+    Node &A = nodes_[iA];
+    if (A.isLeaf() || A.height_ < 2)
+    {
+        return iA;
+    }
+
+    int iB = A.child1_;
+    int iC = A.child2_;
+    Node &B = nodes_[iB];
+    Node &C = nodes_[iC];
+
+    int diff = C.height_ - B.height_;
+
+    // C比B高，将C旋转上来
+    if (diff > 1)
+    {
+        int iF = C.child1_;
+        int iG = C.child2_;
+        Node &F = nodes_[iF];
+        Node &G = nodes_[iG];
+
+        C.child1_ = iA;
+        C.parent_ = A.parent_;
+        A.parent_ = iC;
+
+        if (C.parent_ != NullNode)
+        {
+            if (nodes_[C.parent_].child1_ == iA)
+            {
+                nodes_[C.parent_].child1_ = iC;
+            }
+            else
+            {
+                nodes_[C.parent_].child2_ = iC;
+            }
+        }
+        else
+        {
+            root_ = iC;
+        }
+
+        // F和G中较高的留在C下，较矮的给A
+        if (F.height_ > G.height_)
+        {
+            C.child2_ = iF;
+            A.child2_ = iG;
+            G.parent_ = iA;
+            A.bounds_ = combine(B.bounds_, G.bounds_);
+            C.bounds_ = combine(A.bounds_, F.bounds_);
+            A.height_ = 1 + std::max(B.height_, G.height_);
+            C.height_ = 1 + std::max(A.height_, F.height_);
+        }
+        else
+        {
+            C.child2_ = iG;
+            A.child2_ = iF;
+            F.parent_ = iA;
+            A.bounds_ = combine(B.bounds_, F.bounds_);
+            C.bounds_ = combine(A.bounds_, G.bounds_);
+            A.height_ = 1 + std::max(B.height_, F.height_);
+            C.height_ = 1 + std::max(A.height_, G.height_);
+        }
+        return iC;
+    }
+
+    // B比C高，将B旋转上来
+    if (diff < -1)
+    {
+        int iD = B.child1_;
+        int iE = B.child2_;
+        Node &D = nodes_[iD];
+        Node &E = nodes_[iE];
+
+        B.child1_ = iA;
+        B.parent_ = A.parent_;
+        A.parent_ = iB;
+
+        if (B.parent_ != NullNode)
+        {
+            if (nodes_[B.parent_].child1_ == iA)
+            {
+                nodes_[B.parent_].child1_ = iB;
+            }
+            else
+            {
+                nodes_[B.parent_].child2_ = iB;
+            }
+        }
+        else
+        {
+            root_ = iB;
+        }
+
+        if (D.height_ > E.height_)
+        {
+            B.child2_ = iD;
+            A.child1_ = iE;
+            E.parent_ = iA;
+            A.bounds_ = combine(C.bounds_, E.bounds_);
+            B.bounds_ = combine(A.bounds_, D.bounds_);
+            A.height_ = 1 + std::max(C.height_, E.height_);
+            B.height_ = 1 + std::max(A.height_, D.height_);
+        }
+        else
+        {
+            B.child2_ = iE;
+            A.child1_ = iD;
+            D.parent_ = iA;
+            A.bounds_ = combine(C.bounds_, D.bounds_);
+            B.bounds_ = combine(A.bounds_, E.bounds_);
+            A.height_ = 1 + std::max(C.height_, D.height_);
+            B.height_ = 1 + std::max(A.height_, E.height_);
+        }
+        return iB;
+    }
+
+    return iA;
+}
+
+void DynamicAABBTree::queryAABB(const AABB &bounds, const QueryCallback &callback) const
+{
+    if (root_ == NullNode)
+    {
+        return;
+    }
+
+    int stack[MaxStackSize];
+    int top = 0;
+    stack[top++] = root_;
+    while (top > 0)
+    {
+        const Node &node = nodes_[stack[--top]];
+        if (!node.bounds_.intersect(bounds))
+        {
+            continue;
+        }
+
+        if (node.isLeaf())
+        {
+            if (!callback(int(&node - nodes_.data())))
+            {
+                return;
+            }
+        }
+        else
+        {
+            assert(top + 2 <= MaxStackSize);
+            stack[top++] = node.child1_;
+            stack[top++] = node.child2_;
+        }
+    }
+}
+
+size_t DynamicAABBTree::queryFrustum(const Frustum &frustum, const FrustumCallback &callback) const
+{
+    if (root_ == NullNode)
+    {
+        return 0;
+    }
+
+    size_t nTests = 0;
+
+    // 栈中保存结点编号，完全在视锥内的子树用取反的编号标记
+    int stack[MaxStackSize];
+    int top = 0;
+    stack[top++] = root_;
+    while (top > 0)
+    {
+        int index = stack[--top];
+        bool inside = index < 0;
+        if (inside)
+        {
+            index = ~index;
+        }
+
+        const Node &node = nodes_[index];
+        if (!inside)
+        {
+            ++nTests;
+            Frustum::Result result = frustum.intersectAABB(node.bounds_);
+            if (result == Frustum::OUTSIDE)
+            {
+                continue;
+            }
+            inside = result == Frustum::INSIDE;
+        }
+
+        if (node.isLeaf())
+        {
+            if (!callback(index, inside))
+            {
+                break;
+            }
+        }
+        else
+        {
+            assert(top + 2 <= MaxStackSize);
+            stack[top++] = inside ? ~node.child1_ : node.child1_;
+            stack[top++] = inside ? ~node.child2_ : node.child2_;
+        }
+    }
+    return nTests;
+}
+
+void DynamicAABBTree::rayCast(const Ray &ray, float tMax, const RayCastCallback &callback) const
+{
+    if (root_ == NullNode)
+    {
+        return;
+    }
+
+    PrecomputedRay pray(ray);
+
+    int stack[MaxStackSize];
+    int top = 0;
+    stack[top++] = root_;
+    while (top > 0)
+    {
+        const Node &node = nodes_[stack[--top]];
+
+        float tNear, tFar;
+        if (!pray.intersectAABB(node.bounds_, tMax, tNear, tFar))
+        {
+            continue;
+        }
+
+        if (node.isLeaf())
+        {
+            float t = callback(int(&node - nodes_.data()), tMax);
+            if (t <= 0.0f)
+            {
+                return;
+            }
+            tMax = std::min(tMax, t);
+            continue;
+        }
+
+        // 近的子结点后入栈，先被访问
+        int child1 = node.child1_;
+        int child2 = node.child2_;
+        float near1, near2, far1, far2;
+        bool hit1 = pray.intersectAABB(nodes_[child1].bounds_, tMax, near1, far1);
+        bool hit2 = pray.intersectAABB(nodes_[child2].bounds_, tMax, near2, far2);
+        assert(top + 2 <= MaxStackSize);
+        if (hit1 && hit2)
+        {
+            if (near1 < near2)
+            {
+                std::swap(child1, child2);
+            }
+            stack[top++] = child1;
+            stack[top++] = child2;
+        }
+        else if (hit1)
+        {
+            stack[top++] = child1;
+        }
+        else if (hit2)
+        {
+            stack[top++] = child2;
+        }
+    }
+}
+
+int DynamicAABBTree::queryNearest(const Vector3 &point, float maxDistance, const DistanceCallback &distance,
+    float *outDistance) const
+{
+    if (root_ == NullNode)
+    {
+        return NullNode;
+    }
+
+    // 按包围盒距离的平方排序的优先队列
+    typedef std::pair<float, int> Item;
+    std::priority_queue<Item, std::vector<Item>, std::greater<Item>> queue;
+
+    float bestDistance = maxDistance;
+    float bestSquared = maxDistance * maxDistance;
+    int best = NullNode;
+
+    queue.push(Item(nodes_[root_].bounds_.distanceSquared(point), root_));
+    while (!queue.empty())
+    {
+        Item item = queue.top();
+        queue.pop();
+
+        // 剩下的结点都不会更近了
+        if (item.first > bestSquared)
+        {
+            break;
+        }
+
+        const Node &node = nodes_[item.second];
+        if (node.isLeaf())
+        {
+            float d = distance ? distance(item.second) : sqrtf(item.first);
+            if (d <= bestDistance)
+            {
+                bestDistance = d;
+                bestSquared = d * d;
+                best = item.second;
+            }
+            continue;
+        }
+
+        float d1 = nodes_[node.child1_].bounds_.distanceSquared(point);
+        if (d1 <= bestSquared)
+        {
+            queue.push(Item(d1, node.child1_));
+        }
+        float d2 = nodes_[node.child2_].bounds_.distanceSquared(point);
+        if (d2 <= bestSquared)
+        {
+            queue.push(Item(d2, node.child2_));
+        }
+    }
+
+    if (outDistance != nullptr && best != NullNode)
+    {
+        *outDistance = bestDistance;
+    }
+    return best;
+}
+
+int DynamicAABBTree::getHeight() const
+{
+    return root_ == NullNode ? 0 : nodes_[root_].height_;
+}
+
+float DynamicAABBTree::getAreaRatio() const
+{
+    if (root_ == NullNode)
+    {
+        return 0.0f;
+    }
+
+    float rootArea = nodes_[root_].bounds_.getSurfaceArea();
+    float totalArea = 0.0f;
+    for (const Node &node : nodes_)
+    {
+        if (node.height_ >= 0)
+        {
+            totalArea += node.bounds_.getSurfaceArea();
+        }
+    }
+    return rootArea > 0.0f ? totalArea / rootArea : 0.0f;
+}
+
+bool DynamicAABBTree::validate() const
+{
+    if (root_ != NullNode && nodes_[root_].parent_ != NullNode)
+    {
+        return false;
+    }
+    if (!validateNode(root_))
+    {
+        return false;
+    }
+
+    size_t nFree = 0;
+    for (int i = freeList_; i != NullNode; i = nodes_[i].next_)
+    {
+        ++nFree;
+    }
+
+    // 叶子n个，内部结点n-1个
+    size_t nUsed = nodes_.size() - nFree;
+    return nUsed == (nProxies_ == 0 ? 0 : nProxies_ * 2 - 1);
+}
+
+bool DynamicAABBTree::validateNode(int index) const
+{
+    if (index == NullNode)
+    {
+        return true;
+    }
+
+    const Node &node = nodes_[index];
+    if (node.isLeaf())
+    {
+        return node.child2_ == NullNode && node.height_ == 0;
+    }
+
+    int child1 = node.child1_;
+    int child2 = node.child2_;
+    if (nodes_[child1].parent_ != index || nodes_[child2].parent_ != index)
+    {
+        return false;
+    }
+
+    // 旋转只在插入、删除的路径上进行，不保证严格的AVL平衡，这里只检查高度是否一致
+    if (node.height_ != 1 + std::max(nodes_[child1].height_, nodes_[child2].height_))
+    {
+        return false;
+    }
+
+    if (!node.bounds_.contains(nodes_[child1].bounds_) || !node.bounds_.contains(nodes_[child2].bounds_))
+    {
+        return false;
+    }
+
+    return validateNode(child1) && validateNode(child2);
+}
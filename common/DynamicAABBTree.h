@@ -0,0 +1,123 @@
+#pragma once
+
+#include "AABB.h"
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+class Ray;
+class Frustum;
+
+/** 动态包围盒树，用作场景物体的粗略检测(broad-phase)。
+ *  每个物体是一个叶子结点(代理，proxy)，叶子保存的是向外扩大了margin的胖包围盒，
+ *  物体在胖包围盒内移动时不需要修改树。插入时按表面积代价选择兄弟结点，
+ *  插入和删除后沿父结点链用旋转保持平衡，插入、删除、移动都是O(log n)。
+ *
+ *  结点保存在连续的数组中，用下标互相引用，删除的结点放入空闲链表中复用。
+ *  代理的编号在删除之前保持不变。查询不修改树，可以在多个线程中同时进行。
+ */
+class DynamicAABBTree
+{
+    DynamicAABBTree(const DynamicAABBTree &);
+    const DynamicAABBTree & operator = (const DynamicAABBTree &);
+
+public:
+    enum { NullNode = -1 };
+
+    /** 返回false停止查询。*/
+    typedef std::function<bool(int proxy)> QueryCallback;
+
+    /** inside为true表示代理的胖包围盒完全在视锥内。返回false停止查询。*/
+    typedef std::function<bool(int proxy, bool inside)> FrustumCallback;
+
+    /** 射线与代理的胖包围盒相交时调用，tMax为当前的最大距离。
+     *  返回新的最大距离(比如精确求交的距离)用于裁剪之后的查询，返回值小于等于0停止查询。
+     */
+    typedef std::function<float(int proxy, float tMax)> RayCastCallback;
+
+    /** 返回点到代理的精确距离。*/
+    typedef std::function<float(int proxy)> DistanceCallback;
+
+    /** @param margin 胖包围盒每个方向扩大的距离。*/
+    explicit DynamicAABBTree(float margin = 0.1f);
+    ~DynamicAABBTree();
+
+    void clear();
+
+    int createProxy(const AABB &bounds, void *userData);
+    void destroyProxy(int proxy);
+
+    /** 更新代理的包围盒。仍在胖包围盒内时不做修改，返回false。
+     *  @param displacement 预测的位移，胖包围盒会沿着这个方向额外扩大，减少连续移动时的重新插入。
+     */
+    bool moveProxy(int proxy, const AABB &bounds, const Vector3 &displacement = Vector3::Zero);
+
+    void* getUserData(int proxy) const { return nodes_[proxy].userData_; }
+    const AABB& getFatAABB(int proxy) const { return nodes_[proxy].bounds_; }
+
+    size_t getProxyCount() const { return nProxies_; }
+
+    /** 查询胖包围盒与bounds相交的代理。*/
+    void queryAABB(const AABB &bounds, const QueryCallback &callback) const;
+
+    /** 查询胖包围盒与视锥相交的代理。完全在视锥内的子树不再测试。
+     *  @return 包围盒测试的次数
+     */
+    size_t queryFrustum(const Frustum &frustum, const FrustumCallback &callback) const;
+
+    /** 按照从近到远的大致顺序，查询与射线相交的代理。*/
+    void rayCast(const Ray &ray, float tMax, const RayCastCallback &callback) const;
+
+    /** 查找距离point最近的代理，按包围盒距离从近到远访问，距离不会更近的子树直接跳过。
+     *  @param distance 为空时使用点到胖包围盒的距离。
+     *  @param outDistance 返回最近的距离。
+     *  @return 代理编号，maxDistance范围内没有时返回NullNode。
+     */
+    int queryNearest(const Vector3 &point, float maxDistance, const DistanceCallback &distance = nullptr,
+        float *outDistance = nullptr) const;
+
+    /** 树的高度。叶子为0。*/
+    int getHeight() const;
+
+    /** 所有结点的表面积之和与根结点表面积的比值，用于衡量树的质量。*/
+    float getAreaRatio() const;
+
+    /** 检查树的结构和包围盒是否正确，用于调试。*/
+    bool validate() const;
+
+private:
+    struct Node
+    {
+        AABB    bounds_;
+        void*   userData_;
+        union
+        {
+            int parent_;
+            /// 在空闲链表中时，指向下一个空闲结点
+            int next_;
+        };
+        int     child1_;
+        int     child2_;
+        /// 叶子为0，空闲结点为-1
+        int     height_;
+
+        bool isLeaf() const { return child1_ == NullNode; }
+    };
+
+    int allocateNode();
+    void freeNode(int node);
+
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+
+    /** 如果iA的子树不平衡，旋转使其平衡。返回旋转后子树的根结点。*/
+    int balance(int iA);
+
+    bool validateNode(int node) const;
+
+    std::vector<Node>   nodes_;
+    int                 root_;
+    int                 freeList_;
+    size_t              nProxies_;
+    float               margin_;
+};
@@ -2,6 +2,7 @@
 #include "glconfig.h"
 #include "Texture.h"
 #include "LogTool.h"
+#include "GLStateCache.h"
 
 FrameBuffer::FrameBuffer()
 	: fbo_(0)
@@ -81,6 +82,10 @@ void FrameBuffer::destroy()
 	if (glIsFramebuffer(fbo_))
 	{
 		glDeleteFramebuffers(1, &fbo_);
+		if (GLStateCache::hasInstance())
+		{
+			GLStateCache::instance()->onDeleteFramebuffer(fbo_);
+		}
 		fbo_ = 0;
 		texture_ = nullptr;
 	}
@@ -93,15 +98,13 @@ TexturePtr FrameBuffer::getTexture()
 
 void FrameBuffer::bind()
 {
-	GLint oldFBO = 0;
-	GL_ASSERT(glGetIntegerv(GL_FRAMEBUFFER_BINDING, &oldFBO));
-	oldFBO_ = oldFBO;
-
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+	GLStateCache *cache = GLStateCache::instance();
+	oldFBO_ = cache->getFramebuffer();
+	cache->bindFramebuffer(fbo_);
 }
 
 void FrameBuffer::unbind()
 {
-	GL_ASSERT(glBindFramebuffer(GL_FRAMEBUFFER, oldFBO_));
+	GLStateCache::instance()->bindFramebuffer(oldFBO_);
     oldFBO_ = 0;
 }
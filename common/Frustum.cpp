@@ -0,0 +1,166 @@
+#include "Frustum.h"
+#include "Matrix.h"
+#include "AABB.h"
+#include "MathDef.h"
+#include <cmath>
+
+#if defined(MATH_SIMD_SSE)
+#include <emmintrin.h>
+#endif
+
+Frustum::Frustum()
+{
+    for (int i = 0; i < Stride; ++i)
+    {
+        nx_[i] = ny_[i] = nz_[i] = 0.0f;
+        d_[i] = 1.0f;
+    }
+}
+
+void Frustum::setFromMatrix(const Matrix &m)
+{
+    // 行向量右乘矩阵：clip = (x, y, z, 1) * M，裁剪坐标的每个分量对应矩阵的一列
+    Vector4 col[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        col[i].set(m.m[0][i], m.m[1][i], m.m[2][i], m.m[3][i]);
+    }
+
+    Vector4 planes[PLANE_COUNT] = {
+        col[3] + col[0], // -w <= x
+        col[3] - col[0], // x <= w
+        col[3] + col[1],
+        col[3] - col[1],
+        col[3] + col[2],
+        col[3] - col[2],
+    };
+
+    for (int i = 0; i < PLANE_COUNT; ++i)
+    {
+        const Vector4 &p = planes[i];
+        float length = sqrtf(p.x * p.x + p.y * p.y + p.z * p.z);
+        float inv = length > 0.0f ? 1.0f / length : 0.0f;
+        nx_[i] = p.x * inv;
+        ny_[i] = p.y * inv;
+        nz_[i] = p.z * inv;
+        d_[i] = p.w * inv;
+    }
+}
+
+Vector4 Frustum::getPlane(int i) const
+{
+    return Vector4(nx_[i], ny_[i], nz_[i], d_[i]);
+}
+
+Frustum::Result Frustum::intersectSphere(const Vector3 &center, float radius) const
+{
+    Result result = INSIDE;
+    for (int i = 0; i < PLANE_COUNT; ++i)
+    {
+        float distance = nx_[i] * center.x + ny_[i] * center.y + nz_[i] * center.z + d_[i];
+        if (distance < -radius)
+        {
+            return OUTSIDE;
+        }
+        if (distance < radius)
+        {
+            result = INTERSECT;
+        }
+    }
+    return result;
+}
+
+Frustum::Result Frustum::intersectAABB(const AABB &box) const
+{
+    Vector3 half = box.getSize() * 0.5f;
+    Vector3 axes[3] = {
+        Vector3(half.x, 0.0f, 0.0f),
+        Vector3(0.0f, half.y, 0.0f),
+        Vector3(0.0f, 0.0f, half.z),
+    };
+    return intersectBox(box.getCenter(), axes);
+}
+
+Frustum::Result Frustum::intersectAABB(const AABB &box, const Matrix &world) const
+{
+    Vector3 half = box.getSize() * 0.5f;
+    Vector3 axes[3] = {
+        world[0] * half.x,
+        world[1] * half.y,
+        world[2] * half.z,
+    };
+    return intersectBox(world.transformPoint(box.getCenter()), axes);
+}
+
+#if defined(MATH_SIMD_SSE)
+
+namespace
+{
+    inline __m128 absps(__m128 v)
+    {
+        return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+    }
+
+    inline __m128 dot3(__m128 nx, __m128 ny, __m128 nz, const Vector3 &v)
+    {
+        return _mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(nx, _mm_set1_ps(v.x)),
+            _mm_mul_ps(ny, _mm_set1_ps(v.y))),
+            _mm_mul_ps(nz, _mm_set1_ps(v.z)));
+    }
+}
+
+Frustum::Result Frustum::intersectBox(const Vector3 &center, const Vector3 axes[3]) const
+{
+    __m128 outside = _mm_setzero_ps();
+    __m128 intersect = _mm_setzero_ps();
+    for (int i = 0; i < Stride; i += 4)
+    {
+        __m128 nx = _mm_loadu_ps(nx_ + i);
+        __m128 ny = _mm_loadu_ps(ny_ + i);
+        __m128 nz = _mm_loadu_ps(nz_ + i);
+
+        __m128 distance = _mm_add_ps(dot3(nx, ny, nz, center), _mm_loadu_ps(d_ + i));
+        __m128 radius = _mm_add_ps(_mm_add_ps(
+            absps(dot3(nx, ny, nz, axes[0])),
+            absps(dot3(nx, ny, nz, axes[1]))),
+            absps(dot3(nx, ny, nz, axes[2])));
+
+        outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+        intersect = _mm_or_ps(intersect, _mm_cmplt_ps(_mm_sub_ps(distance, radius), _mm_setzero_ps()));
+    }
+
+    if (_mm_movemask_ps(outside))
+    {
+        return OUTSIDE;
+    }
+    return _mm_movemask_ps(intersect) ? INTERSECT : INSIDE;
+}
+
+#else
+
+Frustum::Result Frustum::intersectBox(const Vector3 &center, const Vector3 axes[3]) const
+{
+    Result result = INSIDE;
+    for (int i = 0; i < PLANE_COUNT; ++i)
+    {
+        float distance = nx_[i] * center.x + ny_[i] * center.y + nz_[i] * center.z + d_[i];
+        float radius = 0.0f;
+        for (int k = 0; k < 3; ++k)
+        {
+            radius += fabsf(nx_[i] * axes[k].x + ny_[i] * axes[k].y + nz_[i] * axes[k].z);
+        }
+
+        if (distance + radius < 0.0f)
+        {
+            return OUTSIDE;
+        }
+        if (distance - radius < 0.0f)
+        {
+            result = INTERSECT;
+        }
+    }
+    return result;
+}
+
+#endif
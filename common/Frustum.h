@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Vector3.h"
+#include "Vector4.h"
+
+class Matrix;
+class AABB;
+
+/** 视锥体，由6个朝内的平面组成。
+ *  平面按分量分开存储(SoA)，并补齐到8个，可以用SIMD一次测试4个平面。补齐的平面对任何物体都返回在内部。
+ */
+class Frustum
+{
+public:
+    enum Result
+    {
+        OUTSIDE,
+        INTERSECT,
+        INSIDE,
+    };
+
+    enum Plane
+    {
+        PLANE_LEFT,
+        PLANE_RIGHT,
+        PLANE_BOTTOM,
+        PLANE_TOP,
+        PLANE_NEAR,
+        PLANE_FAR,
+        PLANE_COUNT,
+    };
+
+    Frustum();
+
+    /** 从视图投影矩阵中提取平面(Gribb-Hartmann)。裁剪空间为GL的[-w, w]。
+     *  传入viewProj得到世界空间中的视锥，传入worldViewProj得到模型空间中的视锥。
+     */
+    void setFromMatrix(const Matrix &viewProj);
+
+    /** 平面方程(nx, ny, nz, d)，nx*x + ny*y + nz*z + d >= 0为内部，法线已经单位化。*/
+    Vector4 getPlane(int i) const;
+
+    Result intersectSphere(const Vector3 &center, float radius) const;
+    Result intersectAABB(const AABB &box) const;
+
+    /** 测试经过world变换的局部包围盒。按有向包围盒计算，比先将包围盒变换成AABB再测试更精确。*/
+    Result intersectAABB(const AABB &box, const Matrix &world) const;
+
+private:
+    /** 测试中心为center、在平面法线上的投影半径由axes决定的包围盒。
+     *  axes为包围盒三个半轴(已经乘以半长)，半径为sum(|dot(n, axis)|)。
+     */
+    Result intersectBox(const Vector3 &center, const Vector3 axes[3]) const;
+
+    enum { Stride = 8 };
+
+    float   nx_[Stride];
+    float   ny_[Stride];
+    float   nz_[Stride];
+    float   d_[Stride];
+};
@@ -0,0 +1,745 @@
+#include "GLDispatch.h"
+#include "LogTool.h"
+#include <cassert>
+#include <cctype>
+#include <cstdlib>
+#include <algorithm>
+#include <map>
+
+IMPLEMENT_SINGLETON(GLDispatch);
+
+namespace GLFunction
+{
+    static const char* s_names[Count] = {
+#define GL_DISPATCH_NAME(RET, NAME, PARAMS, ARGS) #NAME,
+        GL_DISPATCH_FUNCTIONS(GL_DISPATCH_NAME)
+#undef GL_DISPATCH_NAME
+    };
+
+    /** 按前缀匹配，先匹配的优先。没有匹配到的都算作State。*/
+    static const struct
+    {
+        const char* prefix;
+        Category    category;
+    } s_prefixes[] = {
+        { "glDrawArrays", Draw },
+        { "glDrawElements", Draw },
+        { "glClearColor", State },
+        { "glClearDepth", State },
+        { "glClearStencil", State },
+        { "glClear", Clear },
+        { "glBindAttribLocation", Resource },
+        { "glBind", Bind },
+        { "glUseProgram", Bind },
+        { "glActiveTexture", Bind },
+        { "glUniformBlockBinding", Resource },
+        { "glUniform", Uniform },
+        { "glBufferData", Upload },
+        { "glBufferSubData", Upload },
+        { "glTexImage", Upload },
+        { "glTexSubImage", Upload },
+        { "glMapBufferRange", Upload },
+        { "glUnmapBuffer", Upload },
+        { "glGenerateMipmap", Upload },
+        { "glGen", Resource },
+        { "glCreate", Resource },
+        { "glDelete", Resource },
+        { "glShaderSource", Resource },
+        { "glCompileShader", Resource },
+        { "glAttachShader", Resource },
+        { "glDetachShader", Resource },
+        { "glLinkProgram", Resource },
+        { "glFramebufferTexture", Resource },
+        { "glGet", Query },
+        { "glIs", Query },
+        { "glCheckFramebufferStatus", Query },
+        { "glBeginQuery", Query },
+        { "glEndQuery", Query },
+        { "glQueryCounter", Query },
+        { "glReadPixels", Query },
+    };
+
+    static std::vector<Category> buildCategories()
+    {
+        std::vector<Category> categories(Count, State);
+        for(int i = 0; i < Count; ++i)
+        {
+            for(const auto &entry : s_prefixes)
+            {
+                if(strncmp(s_names[i], entry.prefix, strlen(entry.prefix)) == 0)
+                {
+                    categories[i] = entry.category;
+                    break;
+                }
+            }
+        }
+        return categories;
+    }
+
+    const char* getName(Type fn)
+    {
+        assert(fn >= 0 && fn < Count);
+        return s_names[fn];
+    }
+
+    Category getCategory(Type fn)
+    {
+        static const std::vector<Category> categories = buildCategories();
+        return categories[fn];
+    }
+}
+
+GLRecorder::GLRecorder()
+    : streamEnable_(true)
+    , callBegin_(0)
+{
+    clear();
+}
+
+void GLRecorder::clear()
+{
+    stream_.clear();
+    memset(counts_, 0, sizeof(counts_));
+    memset(categoryCounts_, 0, sizeof(categoryCounts_));
+    totalCount_ = 0;
+}
+
+void GLRecorder::iterateCalls(const CallVisitor &visitor) const
+{
+    size_t pos = 0;
+    while(pos + sizeof(uint16_t) * 2 <= stream_.size())
+    {
+        uint16_t id, size;
+        memcpy(&id, &stream_[pos], sizeof(id));
+        memcpy(&size, &stream_[pos + sizeof(id)], sizeof(size));
+        pos += sizeof(uint16_t) * 2;
+
+        assert(pos + size <= stream_.size());
+        visitor(GLFunction::Type(id), size > 0 ? &stream_[pos] : nullptr, size);
+        pos += size;
+    }
+}
+
+void GLRecorder::dumpCounts() const
+{
+    LOG_INFO("GL calls: %d, draw: %d, state: %d", (int)totalCount_, (int)getDrawCallCount(), (int)getStateChangeCount());
+    for(int i = 0; i < GLFunction::Count; ++i)
+    {
+        if(counts_[i] > 0)
+        {
+            LOG_INFO("  %s: %d", GLFunction::getName(GLFunction::Type(i)), (int)counts_[i]);
+        }
+    }
+}
+
+namespace
+{
+    struct FunctionTable
+    {
+#define GL_DISPATCH_MEMBER(RET, NAME, PARAMS, ARGS) decltype(glad_##NAME) NAME##_;
+        GL_DISPATCH_FUNCTIONS(GL_DISPATCH_MEMBER)
+#undef GL_DISPATCH_MEMBER
+    };
+
+    FunctionTable s_real;
+    FunctionTable s_null;
+    /// 记录后端转发的目标
+    FunctionTable s_target;
+    GLRecorder *s_recorder = nullptr;
+
+    void applyTable(const FunctionTable &table)
+    {
+#define GL_DISPATCH_APPLY(RET, NAME, PARAMS, ARGS) glad_##NAME = table.NAME##_;
+        GL_DISPATCH_FUNCTIONS(GL_DISPATCH_APPLY)
+#undef GL_DISPATCH_APPLY
+    }
+
+    ///////////////////////////////////////////////////////////////////
+    // 记录后端
+    ///////////////////////////////////////////////////////////////////
+
+#define GL_DISPATCH_RECORD(RET, NAME, PARAMS, ARGS) \
+    RET APIENTRY record_##NAME PARAMS \
+    { \
+        s_recorder->beginCall(GLFunction::ID_##NAME); \
+        s_recorder->writeArgs ARGS; \
+        s_recorder->endCall(); \
+        return s_target.NAME##_ ARGS; \
+    }
+    GL_DISPATCH_FUNCTIONS(GL_DISPATCH_RECORD)
+#undef GL_DISPATCH_RECORD
+
+    ///////////////////////////////////////////////////////////////////
+    // 空后端
+    ///////////////////////////////////////////////////////////////////
+
+    template<typename T>
+    struct NullValue
+    {
+        static T get(){ return T(); }
+    };
+
+    template<>
+    struct NullValue<void>
+    {
+        static void get(){}
+    };
+
+    /** 空后端忽略所有参数。*/
+    template<typename... Args>
+    inline void ignoreArgs(const Args&...){}
+
+#define GL_DISPATCH_NULL(RET, NAME, PARAMS, ARGS) \
+    RET APIENTRY null_##NAME PARAMS { ignoreArgs ARGS; return NullValue<RET>::get(); }
+    GL_DISPATCH_FUNCTIONS(GL_DISPATCH_NULL)
+#undef GL_DISPATCH_NULL
+
+    GLuint s_lastHandle = 0;
+    std::vector<uint8_t> s_mappedBuffer;
+
+    /** 空后端不编译着色器，只从源码中找出attribute、uniform和uniform块，
+     *  让ShaderProgram的反射和材质的uniform设置可以正常运行。
+     */
+    struct NullVariable
+    {
+        std::string name;
+        GLenum      type;
+        GLint       size;
+        GLint       location;
+    };
+
+    struct NullShader
+    {
+        GLenum      type;
+        std::string source;
+    };
+
+    struct NullProgram
+    {
+        std::vector<GLuint>         shaders;
+        std::map<std::string, GLint> boundAttributes;
+        std::vector<NullVariable>   attributes;
+        std::vector<NullVariable>   uniforms;
+        std::vector<std::string>    blocks;
+    };
+
+    std::map<GLuint, NullShader>    s_shaders;
+    std::map<GLuint, NullProgram>   s_programs;
+
+    GLenum glslType2GL(const std::string &type)
+    {
+        static const std::pair<const char*, GLenum> types[] = {
+            std::make_pair("float", GL_FLOAT),
+            std::make_pair("vec2", GL_FLOAT_VEC2),
+            std::make_pair("vec3", GL_FLOAT_VEC3),
+            std::make_pair("vec4", GL_FLOAT_VEC4),
+            std::make_pair("mat3", GL_FLOAT_MAT3),
+            std::make_pair("mat4", GL_FLOAT_MAT4),
+            std::make_pair("int", GL_INT),
+            std::make_pair("bool", GL_BOOL),
+            std::make_pair("sampler2D", GL_SAMPLER_2D),
+            std::make_pair("samplerCube", GL_SAMPLER_CUBE),
+            std::make_pair("sampler2DArray", GL_SAMPLER_2D_ARRAY),
+            std::make_pair("sampler2DShadow", GL_SAMPLER_2D_SHADOW),
+            std::make_pair("sampler2DArrayShadow", GL_SAMPLER_2D_ARRAY_SHADOW),
+        };
+        for(auto &pair : types)
+        {
+            if(type == pair.first)
+            {
+                return pair.second;
+            }
+        }
+        return GL_FLOAT;
+    }
+
+    /** 按空白和标点切分，去掉注释和预处理指令。标点本身也作为单独的记号。*/
+    void tokenizeGLSL(const std::string &source, std::vector<std::string> &tokens)
+    {
+        size_t i = 0;
+        while(i < source.size())
+        {
+            char ch = source[i];
+            if(ch == '#' || source.compare(i, 2, "//") == 0)
+            {
+                i = source.find('\n', i);
+            }
+            else if(source.compare(i, 2, "/*") == 0)
+            {
+                i = source.find("*/", i);
+                i = i == std::string::npos ? i : i + 2;
+            }
+            else if(isalnum((unsigned char)ch) || ch == '_')
+            {
+                size_t start = i;
+                while(i < source.size() && (isalnum((unsigned char)source[i]) || source[i] == '_'))
+                {
+                    ++i;
+                }
+                tokens.push_back(source.substr(start, i - start));
+            }
+            else
+            {
+                if(!isspace((unsigned char)ch))
+                {
+                    tokens.push_back(std::string(1, ch));
+                }
+                ++i;
+            }
+        }
+    }
+
+    void reflectShader(const NullShader &shader, NullProgram &program)
+    {
+        std::vector<std::string> tokens;
+        tokenizeGLSL(shader.source, tokens);
+
+        int depth = 0;
+        for(size_t i = 0; i < tokens.size(); ++i)
+        {
+            const std::string &token = tokens[i];
+            if(token == "{")
+            {
+                ++depth;
+            }
+            else if(token == "}")
+            {
+                --depth;
+            }
+            if(depth > 0 || i + 2 >= tokens.size())
+            {
+                continue;
+            }
+
+            bool isAttribute = shader.type == GL_VERTEX_SHADER && (token == "in" || token == "attribute");
+            if(!isAttribute && token != "uniform")
+            {
+                continue;
+            }
+
+            // uniform块，跳过块中的成员
+            if(!isAttribute && tokens[i + 2] == "{")
+            {
+                if(std::find(program.blocks.begin(), program.blocks.end(), tokens[i + 1]) == program.blocks.end())
+                {
+                    program.blocks.push_back(tokens[i + 1]);
+                }
+                continue;
+            }
+
+            std::vector<NullVariable> &variables = isAttribute ? program.attributes : program.uniforms;
+            NullVariable var;
+            var.name = tokens[i + 2];
+            var.type = glslType2GL(tokens[i + 1]);
+            var.size = 1;
+            var.location = -1;
+            if(i + 4 < tokens.size() && tokens[i + 3] == "[")
+            {
+                // 数组大小可能是宏，此时当作1
+                var.size = std::max(1, atoi(tokens[i + 4].c_str()));
+                var.name += "[0]";
+            }
+
+            bool exist = false;
+            for(const NullVariable &v : variables)
+            {
+                exist = exist || v.name == var.name;
+            }
+            if(!exist)
+            {
+                variables.push_back(var);
+            }
+        }
+    }
+
+    void APIENTRY nullGenObjects(GLsizei n, GLuint *handles)
+    {
+        for(GLsizei i = 0; i < n; ++i)
+        {
+            handles[i] = ++s_lastHandle;
+        }
+    }
+
+    GLuint APIENTRY nullCreateProgram()
+    {
+        GLuint handle = ++s_lastHandle;
+        s_programs[handle] = NullProgram();
+        return handle;
+    }
+
+    GLuint APIENTRY nullCreateShader(GLenum type)
+    {
+        GLuint handle = ++s_lastHandle;
+        s_shaders[handle].type = type;
+        return handle;
+    }
+
+    void APIENTRY nullDeleteProgram(GLuint program)
+    {
+        s_programs.erase(program);
+    }
+
+    void APIENTRY nullDeleteShader(GLuint shader)
+    {
+        s_shaders.erase(shader);
+    }
+
+    void APIENTRY nullShaderSource(GLuint shader, GLsizei count, const GLchar *const*string, const GLint *length)
+    {
+        std::string &source = s_shaders[shader].source;
+        source.clear();
+        for(GLsizei i = 0; i < count; ++i)
+        {
+            if(length != nullptr && length[i] >= 0)
+            {
+                source.append(string[i], length[i]);
+            }
+            else
+            {
+                source.append(string[i]);
+            }
+        }
+    }
+
+    void APIENTRY nullAttachShader(GLuint program, GLuint shader)
+    {
+        s_programs[program].shaders.push_back(shader);
+    }
+
+    void APIENTRY nullDetachShader(GLuint program, GLuint shader)
+    {
+        std::vector<GLuint> &shaders = s_programs[program].shaders;
+        shaders.erase(std::remove(shaders.begin(), shaders.end(), shader), shaders.end());
+    }
+
+    void APIENTRY nullBindAttribLocation(GLuint program, GLuint index, const GLchar *name)
+    {
+        s_programs[program].boundAttributes[name] = GLint(index);
+    }
+
+    void APIENTRY nullLinkProgram(GLuint handle)
+    {
+        NullProgram &program = s_programs[handle];
+        program.attributes.clear();
+        program.uniforms.clear();
+        program.blocks.clear();
+        for(GLuint shader : program.shaders)
+        {
+            reflectShader(s_shaders[shader], program);
+        }
+
+        GLint location = 0;
+        for(NullVariable &var : program.attributes)
+        {
+            auto it = program.boundAttributes.find(var.name);
+            var.location = it != program.boundAttributes.end() ? it->second : location++;
+        }
+        location = 0;
+        for(NullVariable &var : program.uniforms)
+        {
+            var.location = location;
+            location += var.size;
+        }
+    }
+
+    GLboolean APIENTRY nullIsObject(GLuint handle)
+    {
+        return handle != 0 ? GL_TRUE : GL_FALSE;
+    }
+
+    void APIENTRY nullGetShaderiv(GLuint, GLenum pname, GLint *params)
+    {
+        *params = pname == GL_COMPILE_STATUS ? GL_TRUE : 0;
+    }
+
+    GLint maxNameLength(const std::vector<NullVariable> &variables)
+    {
+        size_t length = 0;
+        for(const NullVariable &var : variables)
+        {
+            length = std::max(length, var.name.size() + 1);
+        }
+        return GLint(length);
+    }
+
+    void APIENTRY nullGetProgramiv(GLuint handle, GLenum pname, GLint *params)
+    {
+        const NullProgram &program = s_programs[handle];
+        switch(pname)
+        {
+        case GL_LINK_STATUS:
+        case GL_VALIDATE_STATUS:
+            *params = GL_TRUE;
+            break;
+        case GL_ACTIVE_ATTRIBUTES:
+            *params = GLint(program.attributes.size());
+            break;
+        case GL_ACTIVE_ATTRIBUTE_MAX_LENGTH:
+            *params = maxNameLength(program.attributes);
+            break;
+        case GL_ACTIVE_UNIFORMS:
+            *params = GLint(program.uniforms.size());
+            break;
+        case GL_ACTIVE_UNIFORM_MAX_LENGTH:
+            *params = maxNameLength(program.uniforms);
+            break;
+        case GL_ACTIVE_UNIFORM_BLOCKS:
+            *params = GLint(program.blocks.size());
+            break;
+        default:
+            *params = 0;
+            break;
+        }
+    }
+
+    void getActiveVariable(const std::vector<NullVariable> &variables, GLuint index, GLsizei bufSize,
+        GLsizei *length, GLint *size, GLenum *type, GLchar *name)
+    {
+        assert(index < variables.size());
+        const NullVariable &var = variables[index];
+        GLsizei n = bufSize > 0 ? std::min(GLsizei(var.name.size()), bufSize - 1) : 0;
+        if(bufSize > 0)
+        {
+            memcpy(name, var.name.c_str(), n);
+            name[n] = '\0';
+        }
+        if(length != nullptr)
+        {
+            *length = n;
+        }
+        *size = var.size;
+        *type = var.type;
+    }
+
+    void APIENTRY nullGetActiveAttrib(GLuint program, GLuint index, GLsizei bufSize,
+        GLsizei *length, GLint *size, GLenum *type, GLchar *name)
+    {
+        getActiveVariable(s_programs[program].attributes, index, bufSize, length, size, type, name);
+    }
+
+    void APIENTRY nullGetActiveUniform(GLuint program, GLuint index, GLsizei bufSize,
+        GLsizei *length, GLint *size, GLenum *type, GLchar *name)
+    {
+        getActiveVariable(s_programs[program].uniforms, index, bufSize, length, size, type, name);
+    }
+
+    GLint findLocation(const std::vector<NullVariable> &variables, const GLchar *name)
+    {
+        for(const NullVariable &var : variables)
+        {
+            // 数组可以用"name"或"name[0]"查询
+            if(var.name == name || var.name == std::string(name) + "[0]")
+            {
+                return var.location;
+            }
+        }
+        return -1;
+    }
+
+    GLint APIENTRY nullGetAttribLocation(GLuint program, const GLchar *name)
+    {
+        return findLocation(s_programs[program].attributes, name);
+    }
+
+    GLint APIENTRY nullGetUniformLocation(GLuint program, const GLchar *name)
+    {
+        return findLocation(s_programs[program].uniforms, name);
+    }
+
+    GLuint APIENTRY nullGetUniformBlockIndex(GLuint handle, const GLchar *name)
+    {
+        const std::vector<std::string> &blocks = s_programs[handle].blocks;
+        auto it = std::find(blocks.begin(), blocks.end(), name);
+        return it != blocks.end() ? GLuint(it - blocks.begin()) : GL_INVALID_INDEX;
+    }
+
+    void APIENTRY nullGetInfoLog(GLuint, GLsizei bufSize, GLsizei *length, GLchar *infoLog)
+    {
+        if(length != nullptr)
+        {
+            *length = 0;
+        }
+        if(bufSize > 0)
+        {
+            infoLog[0] = '\0';
+        }
+    }
+
+    void APIENTRY nullGetIntegerv(GLenum pname, GLint *data)
+    {
+        switch(pname)
+        {
+        case GL_VIEWPORT:
+        case GL_SCISSOR_BOX:
+            data[0] = data[1] = data[2] = data[3] = 0;
+            break;
+        case GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT:
+            *data = 256;
+            break;
+        case GL_MAX_TEXTURE_SIZE:
+            *data = 4096;
+            break;
+        case GL_MAX_TEXTURE_IMAGE_UNITS:
+        case GL_MAX_VERTEX_ATTRIBS:
+            *data = 16;
+            break;
+        case GL_MAX_UNIFORM_BUFFER_BINDINGS:
+            *data = 36;
+            break;
+        case GL_MAX_UNIFORM_BLOCK_SIZE:
+            *data = 16384;
+            break;
+        default:
+            *data = 0;
+            break;
+        }
+    }
+
+    const GLubyte* APIENTRY nullGetString(GLenum)
+    {
+        return reinterpret_cast<const GLubyte*>("Null");
+    }
+
+    GLenum APIENTRY nullCheckFramebufferStatus(GLenum)
+    {
+        return GL_FRAMEBUFFER_COMPLETE;
+    }
+
+    /** 返回足够大的临时内存，写入的数据直接丢弃。*/
+    void* APIENTRY nullMapBufferRange(GLenum, GLintptr, GLsizeiptr length, GLbitfield)
+    {
+        if(s_mappedBuffer.size() < size_t(length))
+        {
+            s_mappedBuffer.resize(length);
+        }
+        return s_mappedBuffer.data();
+    }
+
+    GLboolean APIENTRY nullUnmapBuffer(GLenum)
+    {
+        return GL_TRUE;
+    }
+
+    /** 查询结果总是立即可用，值为0。*/
+    void APIENTRY nullGetQueryObjectiv(GLuint, GLenum pname, GLint *params)
+    {
+        *params = pname == GL_QUERY_RESULT_AVAILABLE ? GL_TRUE : 0;
+    }
+
+    void APIENTRY nullGetQueryObjectui64v(GLuint, GLenum, GLuint64 *params)
+    {
+        *params = 0;
+    }
+
+    void initNullTable()
+    {
+#define GL_DISPATCH_NULL(RET, NAME, PARAMS, ARGS) s_null.NAME##_ = null_##NAME;
+        GL_DISPATCH_FUNCTIONS(GL_DISPATCH_NULL)
+#undef GL_DISPATCH_NULL
+
+        s_null.glGenBuffers_ = nullGenObjects;
+        s_null.glGenTextures_ = nullGenObjects;
+        s_null.glGenVertexArrays_ = nullGenObjects;
+        s_null.glGenFramebuffers_ = nullGenObjects;
+        s_null.glGenSamplers_ = nullGenObjects;
+        s_null.glGenQueries_ = nullGenObjects;
+        s_null.glIsBuffer_ = nullIsObject;
+        s_null.glIsTexture_ = nullIsObject;
+        s_null.glIsVertexArray_ = nullIsObject;
+        s_null.glIsFramebuffer_ = nullIsObject;
+        s_null.glIsProgram_ = nullIsObject;
+        s_null.glIsShader_ = nullIsObject;
+
+        s_null.glCreateProgram_ = nullCreateProgram;
+        s_null.glCreateShader_ = nullCreateShader;
+        s_null.glDeleteProgram_ = nullDeleteProgram;
+        s_null.glDeleteShader_ = nullDeleteShader;
+        s_null.glShaderSource_ = nullShaderSource;
+        s_null.glAttachShader_ = nullAttachShader;
+        s_null.glDetachShader_ = nullDetachShader;
+        s_null.glBindAttribLocation_ = nullBindAttribLocation;
+        s_null.glLinkProgram_ = nullLinkProgram;
+        s_null.glGetShaderiv_ = nullGetShaderiv;
+        s_null.glGetProgramiv_ = nullGetProgramiv;
+        s_null.glGetShaderInfoLog_ = nullGetInfoLog;
+        s_null.glGetProgramInfoLog_ = nullGetInfoLog;
+        s_null.glGetActiveAttrib_ = nullGetActiveAttrib;
+        s_null.glGetActiveUniform_ = nullGetActiveUniform;
+        s_null.glGetAttribLocation_ = nullGetAttribLocation;
+        s_null.glGetUniformLocation_ = nullGetUniformLocation;
+        s_null.glGetUniformBlockIndex_ = nullGetUniformBlockIndex;
+
+        s_null.glGetIntegerv_ = nullGetIntegerv;
+        s_null.glGetString_ = nullGetString;
+        s_null.glCheckFramebufferStatus_ = nullCheckFramebufferStatus;
+        s_null.glMapBufferRange_ = nullMapBufferRange;
+        s_null.glUnmapBuffer_ = nullUnmapBuffer;
+        s_null.glGetQueryObjectiv_ = nullGetQueryObjectiv;
+        s_null.glGetQueryObjectui64v_ = nullGetQueryObjectui64v;
+    }
+
+    void captureTable(FunctionTable &table)
+    {
+#define GL_DISPATCH_CAPTURE(RET, NAME, PARAMS, ARGS) table.NAME##_ = glad_##NAME;
+        GL_DISPATCH_FUNCTIONS(GL_DISPATCH_CAPTURE)
+#undef GL_DISPATCH_CAPTURE
+    }
+
+    void initRecordTable(FunctionTable &table)
+    {
+#define GL_DISPATCH_RECORD(RET, NAME, PARAMS, ARGS) table.NAME##_ = record_##NAME;
+        GL_DISPATCH_FUNCTIONS(GL_DISPATCH_RECORD)
+#undef GL_DISPATCH_RECORD
+    }
+}
+
+GLDispatch::GLDispatch()
+    : backend_(BACKEND_REAL)
+    , target_(BACKEND_NULL)
+{
+    captureTable(s_real);
+    initNullTable();
+    s_recorder = &recorder_;
+}
+
+GLDispatch::~GLDispatch()
+{
+    applyTable(s_real);
+    s_recorder = nullptr;
+}
+
+void GLDispatch::captureRealFunctions()
+{
+    // gladLoadGLLoader会覆盖所有的指针，重新记录后再切回当前后端
+    captureTable(s_real);
+    applyBackend();
+}
+
+void GLDispatch::setBackend(Backend backend, Backend target)
+{
+    assert(target != BACKEND_RECORDING);
+    backend_ = backend;
+    target_ = target;
+    applyBackend();
+}
+
+void GLDispatch::applyBackend()
+{
+    switch(backend_)
+    {
+    case BACKEND_REAL:
+        applyTable(s_real);
+        break;
+    case BACKEND_NULL:
+        applyTable(s_null);
+        break;
+    case BACKEND_RECORDING:
+    {
+        s_target = target_ == BACKEND_REAL ? s_real : s_null;
+        FunctionTable table;
+        initRecordTable(table);
+        applyTable(table);
+        break;
+    }
+    }
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "Singleton.h"
+#include "glconfig.h"
+#include "GLDispatchFunctions.h"
+#include <vector>
+#include <string>
+#include <functional>
+#include <cstdint>
+#include <cstring>
+
+namespace GLFunction
+{
+    /** GLDispatchFunctions.h中的每个函数对应一个ID。*/
+    enum Type
+    {
+#define GL_DISPATCH_ID(RET, NAME, PARAMS, ARGS) ID_##NAME,
+        GL_DISPATCH_FUNCTIONS(GL_DISPATCH_ID)
+#undef GL_DISPATCH_ID
+        Count
+    };
+
+    /** 函数的分类，按函数名前缀划分。*/
+    enum Category
+    {
+        /// glDrawArrays*, glDrawElements*
+        Draw,
+        Clear,
+        /// glBind*, glUseProgram, glActiveTexture
+        Bind,
+        /// 混合、深度、模板、视口、顶点属性、纹理参数等
+        State,
+        Uniform,
+        /// 缓冲区和纹理数据的上传
+        Upload,
+        /// 对象的创建、删除，着色器的编译链接
+        Resource,
+        /// glGet*, glIs*和查询对象
+        Query,
+        CategoryCount
+    };
+
+    const char* getName(Type fn);
+    Category getCategory(Type fn);
+}
+
+/** 记录GL调用。
+ *  按函数统计调用次数。开启流记录时，每次调用写入：uint16函数ID、uint16参数字节数、参数的原始字节。
+ *  指针参数只记录地址，不记录指向的数据。
+ */
+class GLRecorder
+{
+public:
+    typedef std::function<void(GLFunction::Type fn, const uint8_t *args, size_t size)> CallVisitor;
+
+    GLRecorder();
+
+    /** 关闭后只计数，不写入调用流。默认开启。*/
+    void setStreamEnable(bool enable){ streamEnable_ = enable; }
+    bool isStreamEnable() const { return streamEnable_; }
+
+    /** 清空调用流和计数，通常在每帧开始时调用。*/
+    void clear();
+
+    size_t getCallCount(GLFunction::Type fn) const { return counts_[fn]; }
+    size_t getCategoryCount(GLFunction::Category category) const { return categoryCounts_[category]; }
+    size_t getTotalCallCount() const { return totalCount_; }
+
+    size_t getDrawCallCount() const { return categoryCounts_[GLFunction::Draw]; }
+    /** 绑定和渲染状态的修改次数，不包括uniform。*/
+    size_t getStateChangeCount() const { return categoryCounts_[GLFunction::Bind] + categoryCounts_[GLFunction::State]; }
+
+    const std::vector<uint8_t>& getStream() const { return stream_; }
+
+    /** 按顺序遍历调用流中的每次调用。*/
+    void iterateCalls(const CallVisitor &visitor) const;
+
+    /** 输出所有调用过的函数及次数。*/
+    void dumpCounts() const;
+
+    /** 由记录后端调用，每次调用依次调用beginCall、writeArgs、endCall。*/
+    void beginCall(GLFunction::Type fn)
+    {
+        ++counts_[fn];
+        ++categoryCounts_[GLFunction::getCategory(fn)];
+        ++totalCount_;
+
+        if(streamEnable_)
+        {
+            callBegin_ = stream_.size();
+            uint16_t header[2] = { uint16_t(fn), 0 };
+            writeArgs(header);
+        }
+    }
+
+    void writeArgs(){}
+
+    template<typename T, typename... Rest>
+    void writeArgs(const T &value, const Rest&... rest)
+    {
+        if(streamEnable_)
+        {
+            const uint8_t *p = reinterpret_cast<const uint8_t*>(&value);
+            stream_.insert(stream_.end(), p, p + sizeof(T));
+        }
+        writeArgs(rest...);
+    }
+
+    void endCall()
+    {
+        if(streamEnable_)
+        {
+            uint16_t size = uint16_t(stream_.size() - callBegin_ - sizeof(uint16_t) * 2);
+            memcpy(&stream_[callBegin_ + sizeof(uint16_t)], &size, sizeof(size));
+        }
+    }
+
+private:
+    bool                    streamEnable_;
+    std::vector<uint8_t>    stream_;
+    size_t                  callBegin_;
+    size_t                  counts_[GLFunction::Count];
+    size_t                  categoryCounts_[GLFunction::CategoryCount];
+    size_t                  totalCount_;
+};
+
+/** GL函数的分发层。
+ *  glad通过函数指针调用GL，这里替换这些指针来切换后端：
+ *  - 真实后端：gladLoadGLLoader加载的驱动函数。
+ *  - 空后端：不需要窗口和驱动，创建对象返回递增的假句柄，着色器编译链接总是成功，其余调用什么都不做。
+ *  - 记录后端：把调用记录到GLRecorder中，再转发给真实后端或空后端。
+ *
+ *  切换后端后，GLStateCache中的影子状态可能与新后端不一致，需要调用GLStateCache::reset。
+ *  无头运行时(比如基准测试)不创建窗口，直接：
+ *  GLDispatch::initInstance();
+ *  GLDispatch::instance()->setBackend(GLDispatch::BACKEND_RECORDING, GLDispatch::BACKEND_NULL);
+ */
+class GLDispatch : public Singleton<GLDispatch>
+{
+public:
+    enum Backend
+    {
+        BACKEND_REAL,
+        BACKEND_NULL,
+        BACKEND_RECORDING,
+    };
+
+    /** 记下当前glad中的函数指针作为真实后端。*/
+    GLDispatch();
+    /** 恢复真实后端。*/
+    ~GLDispatch();
+
+    /** 重新记下glad中的函数指针，在gladLoadGLLoader之后调用。当前后端保持不变。*/
+    void captureRealFunctions();
+
+    /** target为记录后端转发的目标，只能是BACKEND_REAL或BACKEND_NULL。*/
+    void setBackend(Backend backend, Backend target = BACKEND_NULL);
+    Backend getBackend() const { return backend_; }
+
+    GLRecorder& getRecorder(){ return recorder_; }
+    const GLRecorder& getRecorder() const { return recorder_; }
+
+private:
+    void applyBackend();
+
+    Backend     backend_;
+    Backend     target_;
+    GLRecorder  recorder_;
+};
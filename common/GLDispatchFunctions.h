@@ -0,0 +1,120 @@
+#pragma once
+
+/** 经过GLDispatch分发的GL函数列表。
+ *  每一项为X(返回值, 函数名, (参数列表), (实参列表))，使用者定义X后展开。
+ *  新用到的GL函数需要加到这里，否则空后端和记录后端不会接管它。
+ */
+#define GL_DISPATCH_FUNCTIONS(X) \
+    X(void, glActiveTexture, (GLenum texture), (texture)) \
+    X(void, glAttachShader, (GLuint program, GLuint shader), (program, shader)) \
+    X(void, glBeginQuery, (GLenum target, GLuint id), (target, id)) \
+    X(void, glBindAttribLocation, (GLuint program, GLuint index, const GLchar *name), (program, index, name)) \
+    X(void, glBindBuffer, (GLenum target, GLuint buffer), (target, buffer)) \
+    X(void, glBindBufferRange, (GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size), (target, index, buffer, offset, size)) \
+    X(void, glBindFramebuffer, (GLenum target, GLuint framebuffer), (target, framebuffer)) \
+    X(void, glBindSampler, (GLuint unit, GLuint sampler), (unit, sampler)) \
+    X(void, glBindTexture, (GLenum target, GLuint texture), (target, texture)) \
+    X(void, glBindVertexArray, (GLuint array), (array)) \
+    X(void, glBlendEquation, (GLenum mode), (mode)) \
+    X(void, glBlendFunc, (GLenum sfactor, GLenum dfactor), (sfactor, dfactor)) \
+    X(void, glBufferData, (GLenum target, GLsizeiptr size, const void *data, GLenum usage), (target, size, data, usage)) \
+    X(void, glBufferSubData, (GLenum target, GLintptr offset, GLsizeiptr size, const void *data), (target, offset, size, data)) \
+    X(GLenum, glCheckFramebufferStatus, (GLenum target), (target)) \
+    X(void, glClear, (GLbitfield mask), (mask)) \
+    X(void, glClearColor, (GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha), (red, green, blue, alpha)) \
+    X(void, glClearDepth, (GLdouble depth), (depth)) \
+    X(void, glClearStencil, (GLint s), (s)) \
+    X(void, glColorMask, (GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha), (red, green, blue, alpha)) \
+    X(void, glCompileShader, (GLuint shader), (shader)) \
+    X(GLuint, glCreateProgram, (), ()) \
+    X(GLuint, glCreateShader, (GLenum type), (type)) \
+    X(void, glCullFace, (GLenum mode), (mode)) \
+    X(void, glDeleteBuffers, (GLsizei n, const GLuint *buffers), (n, buffers)) \
+    X(void, glDeleteFramebuffers, (GLsizei n, const GLuint *framebuffers), (n, framebuffers)) \
+    X(void, glDeleteProgram, (GLuint program), (program)) \
+    X(void, glDeleteQueries, (GLsizei n, const GLuint *ids), (n, ids)) \
+    X(void, glDeleteShader, (GLuint shader), (shader)) \
+    X(void, glDeleteTextures, (GLsizei n, const GLuint *textures), (n, textures)) \
+    X(void, glDeleteVertexArrays, (GLsizei n, const GLuint *arrays), (n, arrays)) \
+    X(void, glDepthFunc, (GLenum func), (func)) \
+    X(void, glDepthMask, (GLboolean flag), (flag)) \
+    X(void, glDetachShader, (GLuint program, GLuint shader), (program, shader)) \
+    X(void, glDisable, (GLenum cap), (cap)) \
+    X(void, glDisableVertexAttribArray, (GLuint index), (index)) \
+    X(void, glDrawArrays, (GLenum mode, GLint first, GLsizei count), (mode, first, count)) \
+    X(void, glDrawArraysInstanced, (GLenum mode, GLint first, GLsizei count, GLsizei instancecount), (mode, first, count, instancecount)) \
+    X(void, glDrawBuffer, (GLenum buf), (buf)) \
+    X(void, glDrawBuffers, (GLsizei n, const GLenum *bufs), (n, bufs)) \
+    X(void, glDrawElements, (GLenum mode, GLsizei count, GLenum type, const void *indices), (mode, count, type, indices)) \
+    X(void, glDrawElementsInstanced, (GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instancecount), (mode, count, type, indices, instancecount)) \
+    X(void, glEnable, (GLenum cap), (cap)) \
+    X(void, glEnableVertexAttribArray, (GLuint index), (index)) \
+    X(void, glEndQuery, (GLenum target), (target)) \
+    X(void, glFramebufferTexture2D, (GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level), (target, attachment, textarget, texture, level)) \
+    X(void, glFramebufferTextureLayer, (GLenum target, GLenum attachment, GLuint texture, GLint level, GLint layer), (target, attachment, texture, level, layer)) \
+    X(void, glFrontFace, (GLenum mode), (mode)) \
+    X(void, glGenBuffers, (GLsizei n, GLuint *buffers), (n, buffers)) \
+    X(void, glGenFramebuffers, (GLsizei n, GLuint *framebuffers), (n, framebuffers)) \
+    X(void, glGenQueries, (GLsizei n, GLuint *ids), (n, ids)) \
+    X(void, glGenSamplers, (GLsizei count, GLuint *samplers), (count, samplers)) \
+    X(void, glGenTextures, (GLsizei n, GLuint *textures), (n, textures)) \
+    X(void, glGenVertexArrays, (GLsizei n, GLuint *arrays), (n, arrays)) \
+    X(void, glGenerateMipmap, (GLenum target), (target)) \
+    X(void, glGetActiveAttrib, (GLuint program, GLuint index, GLsizei bufSize, GLsizei *length, GLint *size, GLenum *type, GLchar *name), (program, index, bufSize, length, size, type, name)) \
+    X(void, glGetActiveUniform, (GLuint program, GLuint index, GLsizei bufSize, GLsizei *length, GLint *size, GLenum *type, GLchar *name), (program, index, bufSize, length, size, type, name)) \
+    X(GLint, glGetAttribLocation, (GLuint program, const GLchar *name), (program, name)) \
+    X(void, glGetBufferSubData, (GLenum target, GLintptr offset, GLsizeiptr size, void *data), (target, offset, size, data)) \
+    X(GLenum, glGetError, (), ()) \
+    X(void, glGetIntegerv, (GLenum pname, GLint *data), (pname, data)) \
+    X(void, glGetProgramInfoLog, (GLuint program, GLsizei bufSize, GLsizei *length, GLchar *infoLog), (program, bufSize, length, infoLog)) \
+    X(void, glGetProgramiv, (GLuint program, GLenum pname, GLint *params), (program, pname, params)) \
+    X(void, glGetQueryObjectiv, (GLuint id, GLenum pname, GLint *params), (id, pname, params)) \
+    X(void, glGetQueryObjectui64v, (GLuint id, GLenum pname, GLuint64 *params), (id, pname, params)) \
+    X(void, glGetShaderInfoLog, (GLuint shader, GLsizei bufSize, GLsizei *length, GLchar *infoLog), (shader, bufSize, length, infoLog)) \
+    X(void, glGetShaderiv, (GLuint shader, GLenum pname, GLint *params), (shader, pname, params)) \
+    X(const GLubyte *, glGetString, (GLenum name), (name)) \
+    X(GLuint, glGetUniformBlockIndex, (GLuint program, const GLchar *uniformBlockName), (program, uniformBlockName)) \
+    X(GLint, glGetUniformLocation, (GLuint program, const GLchar *name), (program, name)) \
+    X(GLboolean, glIsBuffer, (GLuint buffer), (buffer)) \
+    X(GLboolean, glIsEnabled, (GLenum cap), (cap)) \
+    X(GLboolean, glIsFramebuffer, (GLuint framebuffer), (framebuffer)) \
+    X(GLboolean, glIsProgram, (GLuint program), (program)) \
+    X(GLboolean, glIsShader, (GLuint shader), (shader)) \
+    X(GLboolean, glIsTexture, (GLuint texture), (texture)) \
+    X(GLboolean, glIsVertexArray, (GLuint array), (array)) \
+    X(void, glLineWidth, (GLfloat width), (width)) \
+    X(void, glLinkProgram, (GLuint program), (program)) \
+    X(void *, glMapBufferRange, (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access), (target, offset, length, access)) \
+    X(void, glPixelStorei, (GLenum pname, GLint param), (pname, param)) \
+    X(void, glPolygonMode, (GLenum face, GLenum mode), (face, mode)) \
+    X(void, glQueryCounter, (GLuint id, GLenum target), (id, target)) \
+    X(void, glReadBuffer, (GLenum src), (src)) \
+    X(void, glReadPixels, (GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void *pixels), (x, y, width, height, format, type, pixels)) \
+    X(void, glSamplerParameteri, (GLuint sampler, GLenum pname, GLint param), (sampler, pname, param)) \
+    X(void, glScissor, (GLint x, GLint y, GLsizei width, GLsizei height), (x, y, width, height)) \
+    X(void, glShaderSource, (GLuint shader, GLsizei count, const GLchar *const*string, const GLint *length), (shader, count, string, length)) \
+    X(void, glStencilFunc, (GLenum func, GLint ref, GLuint mask), (func, ref, mask)) \
+    X(void, glStencilMask, (GLuint mask), (mask)) \
+    X(void, glStencilOp, (GLenum fail, GLenum zfail, GLenum zpass), (fail, zfail, zpass)) \
+    X(void, glTexImage2D, (GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void *pixels), (target, level, internalformat, width, height, border, format, type, pixels)) \
+    X(void, glTexImage3D, (GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void *pixels), (target, level, internalformat, width, height, depth, border, format, type, pixels)) \
+    X(void, glTexParameteri, (GLenum target, GLenum pname, GLint param), (target, pname, param)) \
+    X(void, glTexSubImage2D, (GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void *pixels), (target, level, xoffset, yoffset, width, height, format, type, pixels)) \
+    X(void, glUniform1f, (GLint location, GLfloat v0), (location, v0)) \
+    X(void, glUniform1fv, (GLint location, GLsizei count, const GLfloat *value), (location, count, value)) \
+    X(void, glUniform1i, (GLint location, GLint v0), (location, v0)) \
+    X(void, glUniform1iv, (GLint location, GLsizei count, const GLint *value), (location, count, value)) \
+    X(void, glUniform2f, (GLint location, GLfloat v0, GLfloat v1), (location, v0, v1)) \
+    X(void, glUniform2fv, (GLint location, GLsizei count, const GLfloat *value), (location, count, value)) \
+    X(void, glUniform3f, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2), (location, v0, v1, v2)) \
+    X(void, glUniform3fv, (GLint location, GLsizei count, const GLfloat *value), (location, count, value)) \
+    X(void, glUniform4f, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3), (location, v0, v1, v2, v3)) \
+    X(void, glUniform4fv, (GLint location, GLsizei count, const GLfloat *value), (location, count, value)) \
+    X(void, glUniformBlockBinding, (GLuint program, GLuint uniformBlockIndex, GLuint uniformBlockBinding), (program, uniformBlockIndex, uniformBlockBinding)) \
+    X(void, glUniformMatrix4fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat *value), (location, count, transpose, value)) \
+    X(GLboolean, glUnmapBuffer, (GLenum target), (target)) \
+    X(void, glUseProgram, (GLuint program), (program)) \
+    X(void, glVertexAttrib4fv, (GLuint index, const GLfloat *v), (index, v)) \
+    X(void, glVertexAttribDivisor, (GLuint index, GLuint divisor), (index, divisor)) \
+    X(void, glVertexAttribPointer, (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer), (index, size, type, normalized, stride, pointer)) \
+    X(void, glViewport, (GLint x, GLint y, GLsizei width, GLsizei height), (x, y, width, height))
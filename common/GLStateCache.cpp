@@ -0,0 +1,478 @@
+#include "GLStateCache.h"
+#include <cassert>
+
+IMPLEMENT_SINGLETON(GLStateCache);
+
+namespace
+{
+    /// 不可能出现的句柄和枚举值，用于标记影子值未知
+    const GLuint  InvalidHandle = ~0u;
+    const GLenum  InvalidEnum = ~0u;
+    const GLint   InvalidInt = -1;
+}
+
+GLStateCache::GLStateCache()
+{
+    reset();
+}
+
+GLStateCache::~GLStateCache()
+{
+    // 析构时GL上下文可能已经销毁，采样器对象随上下文一起释放
+}
+
+void GLStateCache::reset()
+{
+    program_ = 0;
+    vertexArray_ = 0;
+    arrayBuffer_ = 0;
+    elementBuffer_ = 0;
+    framebuffer_ = 0;
+    activeUnit_ = 0;
+    memset(textures_, 0, sizeof(textures_));
+    memset(samplers_, 0, sizeof(samplers_));
+
+    memset(capabilities_, 0, sizeof(capabilities_));
+    blendSrc_ = GL_ONE;
+    blendDst_ = GL_ZERO;
+    cullFace_ = GL_BACK;
+    depthFunc_ = GL_LESS;
+    depthMask_ = 1;
+    colorMask_ = 0xf;
+    stencilFunc_ = GL_ALWAYS;
+    stencilRef_ = 0;
+    stencilFuncMask_ = ~0u;
+    stencilOps_[0] = stencilOps_[1] = stencilOps_[2] = GL_KEEP;
+    stencilMask_ = ~0u;
+    packAlignment_ = 4;
+    unpackAlignment_ = 4;
+
+    samplerObjects_.clear();
+    resetStats();
+}
+
+void GLStateCache::invalidate()
+{
+    program_ = InvalidHandle;
+    vertexArray_ = InvalidHandle;
+    arrayBuffer_ = InvalidHandle;
+    elementBuffer_ = InvalidHandle;
+    framebuffer_ = InvalidHandle;
+    memset(textures_, 0xff, sizeof(textures_));
+    memset(samplers_, 0xff, sizeof(samplers_));
+
+    memset(capabilities_, -1, sizeof(capabilities_));
+    blendSrc_ = blendDst_ = InvalidEnum;
+    cullFace_ = InvalidEnum;
+    depthFunc_ = InvalidEnum;
+    depthMask_ = -1;
+    colorMask_ = InvalidHandle;
+    stencilFunc_ = InvalidEnum;
+    stencilOps_[0] = stencilOps_[1] = stencilOps_[2] = InvalidEnum;
+    stencilMask_ = InvalidHandle;
+    packAlignment_ = InvalidInt;
+    unpackAlignment_ = InvalidInt;
+
+    // 纹理和采样器按活动单元缓存，活动单元不能未知，直接切换到0号单元
+    activeUnit_ = 0;
+    ++stats_.nIssued;
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void GLStateCache::resetStats()
+{
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+/*static*/ int GLStateCache::capabilityIndex(GLenum cap)
+{
+    switch (cap)
+    {
+    case GL_BLEND:          return CAP_BLEND;
+    case GL_CULL_FACE:      return CAP_CULL_FACE;
+    case GL_DEPTH_TEST:     return CAP_DEPTH_TEST;
+    case GL_STENCIL_TEST:   return CAP_STENCIL_TEST;
+    case GL_SCISSOR_TEST:   return CAP_SCISSOR_TEST;
+    default:                return -1;
+    }
+}
+
+/*static*/ int GLStateCache::textureTargetIndex(GLenum target)
+{
+    switch (target)
+    {
+    case GL_TEXTURE_2D:         return TEX_2D;
+    case GL_TEXTURE_CUBE_MAP:   return TEX_CUBE_MAP;
+    case GL_TEXTURE_2D_ARRAY:   return TEX_2D_ARRAY;
+    default:                    return -1;
+    }
+}
+
+void GLStateCache::useProgram(GLuint program)
+{
+    if (update(program_, program))
+    {
+        glUseProgram(program);
+    }
+}
+
+void GLStateCache::bindVertexArray(GLuint vao)
+{
+    if (update(vertexArray_, vao))
+    {
+        glBindVertexArray(vao);
+
+        // 索引缓冲区的绑定保存在顶点数组中，切换后不再知道它的值
+        elementBuffer_ = InvalidHandle;
+    }
+}
+
+void GLStateCache::bindBuffer(GLenum target, GLuint buffer)
+{
+    GLuint *shadow = nullptr;
+    if (target == GL_ARRAY_BUFFER)
+    {
+        shadow = &arrayBuffer_;
+    }
+    else if (target == GL_ELEMENT_ARRAY_BUFFER)
+    {
+        shadow = &elementBuffer_;
+    }
+
+    if (shadow == nullptr)
+    {
+        ++stats_.nIssued;
+        glBindBuffer(target, buffer);
+    }
+    else if (update(*shadow, buffer))
+    {
+        glBindBuffer(target, buffer);
+    }
+}
+
+GLuint GLStateCache::getBuffer(GLenum target) const
+{
+    if (target == GL_ARRAY_BUFFER)
+    {
+        return arrayBuffer_;
+    }
+    else if (target == GL_ELEMENT_ARRAY_BUFFER)
+    {
+        return elementBuffer_;
+    }
+    return InvalidHandle;
+}
+
+GLuint GLStateCache::getFramebuffer() const
+{
+    if (framebuffer_ == InvalidHandle)
+    {
+        GLint fbo = 0;
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &fbo);
+        return GLuint(fbo);
+    }
+    return framebuffer_;
+}
+
+void GLStateCache::bindFramebuffer(GLuint fbo)
+{
+    if (update(framebuffer_, fbo))
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    }
+}
+
+void GLStateCache::activeTexture(uint32_t unit)
+{
+    assert(unit < MaxTextureUnits);
+    if (update(activeUnit_, unit))
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+}
+
+void GLStateCache::bindTexture(GLenum target, GLuint texture, GLuint sampler)
+{
+    int index = textureTargetIndex(target);
+    if (index < 0 || activeUnit_ >= MaxTextureUnits)
+    {
+        ++stats_.nIssued;
+        glBindTexture(target, texture);
+    }
+    else if (update(textures_[activeUnit_][index], texture))
+    {
+        glBindTexture(target, texture);
+    }
+
+    if (activeUnit_ < MaxTextureUnits)
+    {
+        bindSampler(activeUnit_, sampler);
+    }
+}
+
+GLuint GLStateCache::getTexture(uint32_t unit, GLenum target) const
+{
+    int index = textureTargetIndex(target);
+    if (index < 0 || unit >= MaxTextureUnits)
+    {
+        return InvalidHandle;
+    }
+    return textures_[unit][index];
+}
+
+void GLStateCache::bindSampler(uint32_t unit, GLuint sampler)
+{
+    if (!isSamplerSupported())
+    {
+        return;
+    }
+
+    // 超出缓存范围的单元不记录影子值，与bindTexture一致
+    if (unit >= MaxTextureUnits)
+    {
+        ++stats_.nIssued;
+        glBindSampler(unit, sampler);
+    }
+    else if (update(samplers_[unit], sampler))
+    {
+        glBindSampler(unit, sampler);
+    }
+}
+
+GLuint GLStateCache::getSamplerBinding(uint32_t unit) const
+{
+    return unit < MaxTextureUnits ? samplers_[unit] : InvalidHandle;
+}
+
+GLuint GLStateCache::getSampler(GLenum minFilter, GLenum magFilter, GLenum wrapS, GLenum wrapT, GLenum wrapR)
+{
+    if (!isSamplerSupported())
+    {
+        return 0;
+    }
+
+    SamplerDesc desc = { { minFilter, magFilter, wrapS, wrapT, wrapR } };
+    auto it = samplerObjects_.find(desc);
+    if (it != samplerObjects_.end())
+    {
+        return it->second;
+    }
+
+    GLuint sampler = 0;
+    glGenSamplers(1, &sampler);
+    glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, minFilter);
+    glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, magFilter);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, wrapS);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, wrapT);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_R, wrapR);
+
+    samplerObjects_[desc] = sampler;
+    return sampler;
+}
+
+void GLStateCache::onDeleteProgram(GLuint program)
+{
+    if (program_ == program)
+    {
+        program_ = 0;
+    }
+}
+
+void GLStateCache::onDeleteVertexArray(GLuint vao)
+{
+    if (vertexArray_ == vao)
+    {
+        vertexArray_ = 0;
+        elementBuffer_ = InvalidHandle;
+    }
+}
+
+void GLStateCache::onDeleteBuffer(GLuint buffer)
+{
+    if (arrayBuffer_ == buffer)
+    {
+        arrayBuffer_ = 0;
+    }
+    if (elementBuffer_ == buffer)
+    {
+        elementBuffer_ = 0;
+    }
+}
+
+void GLStateCache::onDeleteTexture(GLuint texture)
+{
+    for (uint32_t unit = 0; unit < MaxTextureUnits; ++unit)
+    {
+        for (int i = 0; i < TEX_TARGET_MAX; ++i)
+        {
+            if (textures_[unit][i] == texture)
+            {
+                textures_[unit][i] = 0;
+            }
+        }
+    }
+}
+
+void GLStateCache::onDeleteFramebuffer(GLuint fbo)
+{
+    if (framebuffer_ == fbo)
+    {
+        framebuffer_ = 0;
+    }
+}
+
+void GLStateCache::setEnabled(GLenum cap, bool enable)
+{
+    int index = capabilityIndex(cap);
+    if (index < 0)
+    {
+        ++stats_.nIssued;
+    }
+    else if (!update(capabilities_[index], int8_t(enable ? 1 : 0)))
+    {
+        return;
+    }
+
+    if (enable)
+    {
+        glEnable(cap);
+    }
+    else
+    {
+        glDisable(cap);
+    }
+}
+
+bool GLStateCache::isEnabled(GLenum cap) const
+{
+    int index = capabilityIndex(cap);
+    if (index < 0 || capabilities_[index] < 0)
+    {
+        return glIsEnabled(cap) != GL_FALSE;
+    }
+    return capabilities_[index] != 0;
+}
+
+void GLStateCache::blendFunc(GLenum src, GLenum dst)
+{
+    if (blendSrc_ == src && blendDst_ == dst)
+    {
+        ++stats_.nElided;
+        return;
+    }
+    blendSrc_ = src;
+    blendDst_ = dst;
+    ++stats_.nIssued;
+    glBlendFunc(src, dst);
+}
+
+void GLStateCache::cullFace(GLenum mode)
+{
+    if (update(cullFace_, mode))
+    {
+        glCullFace(mode);
+    }
+}
+
+void GLStateCache::depthFunc(GLenum func)
+{
+    if (update(depthFunc_, func))
+    {
+        glDepthFunc(func);
+    }
+}
+
+void GLStateCache::depthMask(bool enable)
+{
+    if (update(depthMask_, int8_t(enable ? 1 : 0)))
+    {
+        glDepthMask(enable ? GL_TRUE : GL_FALSE);
+    }
+}
+
+void GLStateCache::colorMask(bool r, bool g, bool b, bool a)
+{
+    uint32_t mask = (r ? 1 : 0) | (g ? 2 : 0) | (b ? 4 : 0) | (a ? 8 : 0);
+    if (update(colorMask_, mask))
+    {
+        glColorMask(r, g, b, a);
+    }
+}
+
+void GLStateCache::stencilFunc(GLenum func, GLint ref, GLuint mask)
+{
+    if (stencilFunc_ == func && stencilRef_ == ref && stencilFuncMask_ == mask)
+    {
+        ++stats_.nElided;
+        return;
+    }
+    stencilFunc_ = func;
+    stencilRef_ = ref;
+    stencilFuncMask_ = mask;
+    ++stats_.nIssued;
+    glStencilFunc(func, ref, mask);
+}
+
+void GLStateCache::stencilOp(GLenum sfail, GLenum dpfail, GLenum dppass)
+{
+    if (stencilOps_[0] == sfail && stencilOps_[1] == dpfail && stencilOps_[2] == dppass)
+    {
+        ++stats_.nElided;
+        return;
+    }
+    stencilOps_[0] = sfail;
+    stencilOps_[1] = dpfail;
+    stencilOps_[2] = dppass;
+    ++stats_.nIssued;
+    glStencilOp(sfail, dpfail, dppass);
+}
+
+void GLStateCache::stencilMask(GLuint mask)
+{
+    if (update(stencilMask_, mask))
+    {
+        glStencilMask(mask);
+    }
+}
+
+void GLStateCache::pixelStore(GLenum name, GLint value)
+{
+    GLint *shadow = nullptr;
+    if (name == GL_PACK_ALIGNMENT)
+    {
+        shadow = &packAlignment_;
+    }
+    else if (name == GL_UNPACK_ALIGNMENT)
+    {
+        shadow = &unpackAlignment_;
+    }
+
+    if (shadow == nullptr)
+    {
+        ++stats_.nIssued;
+        glPixelStorei(name, value);
+    }
+    else if (update(*shadow, value))
+    {
+        glPixelStorei(name, value);
+    }
+}
+
+GLint GLStateCache::getPixelStore(GLenum name) const
+{
+    GLint value = InvalidInt;
+    if (name == GL_PACK_ALIGNMENT)
+    {
+        value = packAlignment_;
+    }
+    else if (name == GL_UNPACK_ALIGNMENT)
+    {
+        value = unpackAlignment_;
+    }
+
+    if (value == InvalidInt)
+    {
+        glGetIntegerv(name, &value);
+    }
+    return value;
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "Singleton.h"
+#include "glconfig.h"
+#include <map>
+#include <cstdint>
+#include <cstring>
+
+/** GL状态的影子缓存。
+ *  记录当前绑定的program、顶点数组、缓冲区、各个纹理单元的纹理和采样器，以及混合、深度、模板、裁剪等状态。
+ *  设置的值与影子值相同时，不再调用GL；查询当前状态时，直接返回影子值，避免glGet*造成的管线停顿。
+ *
+ *  所有对这些状态的修改都需要经过此缓存，否则影子值会失效。
+ *  如果外部代码(比如第三方UI库)直接修改了GL状态，需要调用invalidate。
+ */
+class GLStateCache : public Singleton<GLStateCache>
+{
+public:
+    enum { MaxTextureUnits = 32 };
+
+    struct Stats
+    {
+        /// 实际调用GL的次数
+        size_t  nIssued;
+        /// 因为状态没有变化而省掉的次数
+        size_t  nElided;
+    };
+
+    GLStateCache();
+    ~GLStateCache();
+
+    /** 将影子值设置为GL上下文的默认状态。上下文创建之后调用。*/
+    void reset();
+
+    /** 将所有的影子值设置为不可能出现的值，下一次设置时一定会调用GL。
+     *  活动纹理单元例外：会切换到0号单元，之后绑定的纹理和采样器都记录在0号单元上。
+     */
+    void invalidate();
+
+    // 绑定
+
+    void useProgram(GLuint program);
+    GLuint getProgram() const { return program_; }
+
+    /** 切换顶点数组时，索引缓冲区的绑定(属于顶点数组的状态)也随之改变。*/
+    void bindVertexArray(GLuint vao);
+    GLuint getVertexArray() const { return vertexArray_; }
+
+    /** 支持GL_ARRAY_BUFFER和GL_ELEMENT_ARRAY_BUFFER，其他的目标直接调用GL。*/
+    void bindBuffer(GLenum target, GLuint buffer);
+    /** 影子值未知时返回~0u。*/
+    GLuint getBuffer(GLenum target) const;
+
+    void bindFramebuffer(GLuint fbo);
+    GLuint getFramebuffer() const;
+
+    void activeTexture(uint32_t unit);
+    uint32_t getActiveTexture() const { return activeUnit_; }
+
+    /** 在当前激活的纹理单元上绑定纹理，同时把这个单元的采样器设置为sampler。
+     *  采样器会覆盖纹理自身的参数，只绑定纹理的地方(创建、读取纹理等)要把之前纹理留下的采样器解除掉。
+     */
+    void bindTexture(GLenum target, GLuint texture, GLuint sampler = 0);
+    GLuint getTexture(GLenum target) const { return getTexture(activeUnit_, target); }
+    GLuint getTexture(uint32_t unit, GLenum target) const;
+
+    /** 不支持采样器对象时忽略。*/
+    void bindSampler(uint32_t unit, GLuint sampler);
+    /** unit超出缓存范围时返回无效的句柄。*/
+    GLuint getSamplerBinding(uint32_t unit) const;
+
+    /** 获取参数相同的采样器对象，没有则创建。不支持采样器对象时返回0。*/
+    GLuint getSampler(GLenum minFilter, GLenum magFilter, GLenum wrapS, GLenum wrapT, GLenum wrapR);
+    bool isSamplerSupported() const { return glGenSamplers != nullptr; }
+
+    /** 对象被删除时，GL会自动解除绑定，影子值也要同步。*/
+    void onDeleteProgram(GLuint program);
+    void onDeleteVertexArray(GLuint vao);
+    void onDeleteBuffer(GLuint buffer);
+    void onDeleteTexture(GLuint texture);
+    void onDeleteFramebuffer(GLuint fbo);
+
+    // 渲染状态
+
+    /** 支持GL_BLEND、GL_CULL_FACE、GL_DEPTH_TEST、GL_STENCIL_TEST、GL_SCISSOR_TEST。*/
+    void setEnabled(GLenum cap, bool enable);
+    void enable(GLenum cap) { setEnabled(cap, true); }
+    void disable(GLenum cap) { setEnabled(cap, false); }
+    bool isEnabled(GLenum cap) const;
+
+    void blendFunc(GLenum src, GLenum dst);
+    void cullFace(GLenum mode);
+    void depthFunc(GLenum func);
+    void depthMask(bool enable);
+    void colorMask(bool r, bool g, bool b, bool a);
+    void stencilFunc(GLenum func, GLint ref, GLuint mask);
+    void stencilOp(GLenum sfail, GLenum dpfail, GLenum dppass);
+    void stencilMask(GLuint mask);
+
+    void pixelStore(GLenum name, GLint value);
+    /** 支持GL_PACK_ALIGNMENT和GL_UNPACK_ALIGNMENT。*/
+    GLint getPixelStore(GLenum name) const;
+
+    const Stats& getStats() const { return stats_; }
+    void resetStats();
+
+private:
+    enum Capability
+    {
+        CAP_BLEND,
+        CAP_CULL_FACE,
+        CAP_DEPTH_TEST,
+        CAP_STENCIL_TEST,
+        CAP_SCISSOR_TEST,
+        CAP_MAX,
+    };
+
+    enum TextureTargetIndex
+    {
+        TEX_2D,
+        TEX_CUBE_MAP,
+        TEX_2D_ARRAY,
+        TEX_TARGET_MAX,
+    };
+
+    static int capabilityIndex(GLenum cap);
+    static int textureTargetIndex(GLenum target);
+
+    /** 比较并更新影子值。返回true表示需要调用GL。*/
+    template<typename T>
+    bool update(T &shadow, const T &value)
+    {
+        if (shadow == value)
+        {
+            ++stats_.nElided;
+            return false;
+        }
+        shadow = value;
+        ++stats_.nIssued;
+        return true;
+    }
+
+    GLuint      program_;
+    GLuint      vertexArray_;
+    GLuint      arrayBuffer_;
+    GLuint      elementBuffer_;
+    GLuint      framebuffer_;
+    uint32_t    activeUnit_;
+    GLuint      textures_[MaxTextureUnits][TEX_TARGET_MAX];
+    GLuint      samplers_[MaxTextureUnits];
+
+    /// 1开启，0关闭，-1未知
+    int8_t      capabilities_[CAP_MAX];
+    GLenum      blendSrc_;
+    GLenum      blendDst_;
+    GLenum      cullFace_;
+    GLenum      depthFunc_;
+    int8_t      depthMask_;
+    uint32_t    colorMask_;
+    GLenum      stencilFunc_;
+    GLint       stencilRef_;
+    GLuint      stencilFuncMask_;
+    GLenum      stencilOps_[3];
+    GLuint      stencilMask_;
+    GLint       packAlignment_;
+    GLint       unpackAlignment_;
+
+    struct SamplerDesc
+    {
+        GLenum  params[5];
+
+        bool operator < (const SamplerDesc &other) const
+        {
+            return memcmp(params, other.params, sizeof(params)) < 0;
+        }
+    };
+    std::map<SamplerDesc, GLuint> samplerObjects_;
+
+    Stats       stats_;
+};
@@ -0,0 +1,75 @@
+#include "InstanceBuffer.h"
+#include "VertexAttribute.h"
+#include "GLStateCache.h"
+
+InstanceBuffer::InstanceBuffer()
+    : ring_(GL_ARRAY_BUFFER)
+    , base_(0)
+{
+    // 不使用VertexBuffer，避免修改当前模型的顶点缓冲区(VertexBuffer::s_vertexBuffer)
+    decl_ = VertexDeclMgr::instance()->get(InstanceVertex::getType());
+}
+
+InstanceBuffer::~InstanceBuffer()
+{
+}
+
+void InstanceBuffer::clear()
+{
+    instances_.clear();
+}
+
+void InstanceBuffer::add(const Matrix &world, const Color &color)
+{
+    InstanceVertex v;
+    v.world = world;
+    v.color = color;
+    instances_.push_back(v);
+}
+
+bool InstanceBuffer::upload()
+{
+    if (instances_.empty() || !decl_)
+    {
+        return false;
+    }
+
+    size_t bytes = instances_.size() * sizeof(InstanceVertex);
+    if (ring_.getHandle() == 0 && !ring_.init(bytes * 4, sizeof(InstanceVertex)))
+    {
+        return false;
+    }
+
+    ring_.bind();
+    base_ = ring_.write(instances_.data(), bytes) / sizeof(InstanceVertex);
+    ring_.unbind();
+    return true;
+}
+
+void InstanceBuffer::bindAttributes(size_t start)
+{
+    GLuint vb = GLStateCache::instance()->getBuffer(GL_ARRAY_BUFFER);
+
+    ring_.bind();
+    VertexAttribute::setupAttributes(decl_.get(), (base_ + start) * sizeof(InstanceVertex));
+
+    // 属性指针已经记录了缓冲区，恢复模型的顶点缓冲区绑定
+    if (vb != ~0u)
+    {
+        GLStateCache::instance()->bindBuffer(GL_ARRAY_BUFFER, vb);
+    }
+}
+
+void InstanceBuffer::unbindAttributes()
+{
+    VertexAttribute::disableAttributes(decl_.get());
+}
+
+/*static*/ void InstanceBuffer::setConstantAttributes(const Matrix &world, const Color &color)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        glVertexAttrib4fv(int(VertexUsage::INSTANCE_WORLD0) + i, world.m[i]);
+    }
+    glVertexAttrib4fv(int(VertexUsage::INSTANCE_COLOR), &color.r);
+}
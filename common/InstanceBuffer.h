@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Vertex.h"
+#include "StreamingRing.h"
+#include "SmartPointer.h"
+#include "VertexDeclaration.h"
+#include <vector>
+
+/** 实例化绘制的实例数据。
+ *  收集每个实例的世界矩阵和颜色，一次性追加到环形流式缓冲区(StreamingRing)中，
+ *  绘制时将其中的一段作为divisor为1的顶点属性(a_instanceWorld、a_instanceColor)绑定到当前的顶点数组上。
+ */
+class InstanceBuffer : public ReferenceCount
+{
+public:
+    InstanceBuffer();
+    ~InstanceBuffer();
+
+    void clear();
+    void add(const Matrix &world, const Color &color);
+
+    size_t size() const { return instances_.size(); }
+    bool empty() const { return instances_.empty(); }
+
+    /** 将所有的实例数据上传到缓冲区中，每次填充完之后调用一次。*/
+    bool upload();
+
+    /** 从第start个实例开始，设置实例属性。需要先绑定模型的顶点数组。*/
+    void bindAttributes(size_t start);
+    /** 关闭实例属性，避免影响顶点数组之后的非实例化绘制。*/
+    void unbindAttributes();
+
+    /** 实例化的shader用于普通绘制时，实例属性没有数组数据，用常量值代替。*/
+    static void setConstantAttributes(const Matrix &world, const Color &color);
+
+private:
+    std::vector<InstanceVertex> instances_;
+    StreamingRing               ring_;
+    /// 最近一次上传的第一个实例在缓冲区中的序号
+    size_t                      base_;
+    VertexDeclarationPtr        decl_;
+};
+
+typedef SmartPointer<InstanceBuffer> InstanceBufferPtr;
@@ -4,7 +4,10 @@
 
 Material::Material()
 	: autoBindUniform_(true)
+	, transparent_(false)
 {
+	static uint32_t s_sortID = 0;
+	sortID_ = ++s_sortID;
 }
 
 
@@ -59,11 +62,28 @@ bool Material::begin()
 		shader_->applyAutoUniforms();
 	}
 
+	bindTextures();
+	return true;
+}
+
+void Material::bindTextures()
+{
 	for (auto &pair : textures_)
 	{
 		bindUniform(pair.first, pair.second.get());
 	}
-	return true;
+}
+
+uint32_t Material::getTextureSetID() const
+{
+	// 与遍历顺序无关的组合方式
+	uint32_t id = 0;
+	for (auto &pair : textures_)
+	{
+		uint32_t handle = pair.second ? pair.second->getHandle() : 0;
+		id += (handle + 1) * 2654435761u;
+	}
+	return id;
 }
 
 void Material::end()
@@ -12,7 +12,7 @@ public:
 	~Material();
 
 	void setShader(ShaderProgramPtr shader) { shader_ = shader; }
-	ShaderProgramPtr getShader() { return shader_; }
+	const ShaderProgramPtr& getShader() const { return shader_; }
 
 	void setTexture(const std::string &key, TexturePtr texture);
 	TexturePtr getTexture(const std::string &key);
@@ -20,6 +20,12 @@ public:
 	bool begin();
 	void end();
 
+	/** 绑定所有的纹理。shader需要已经绑定。*/
+	void bindTextures();
+
+	/** 纹理集合的标识。使用相同纹理的材质标识相同，用于渲染队列的排序。*/
+	uint32_t getTextureSetID() const;
+
     ShaderUniform* findUniform(const std::string &name){ return shader_->findUniform(name); }
 	template<typename T>
 	bool bindUniform(const std::string &name, const T &value);
@@ -29,11 +35,21 @@ public:
 	void bindShader();
 
 	void setAutoBindUniform(bool enable) { autoBindUniform_ = enable; }
+	bool isAutoBindUniform() const { return autoBindUniform_; }
+
+	/** 半透明材质。在渲染队列中，半透明物体会在不透明物体之后，从后往前绘制，并开启alpha混合。*/
+	void setTransparent(bool transparent) { transparent_ = transparent; }
+	bool isTransparent() const { return transparent_; }
+
+	/** 每个材质唯一的编号，用于渲染队列的排序。*/
+	uint32_t getSortID() const { return sortID_; }
 
 private:
 	ShaderProgramPtr shader_;
 	std::unordered_map<std::string, TexturePtr> textures_;
 	bool	autoBindUniform_;
+	bool	transparent_;
+	uint32_t sortID_;
 };
 
 typedef SmartPointer<Material> MaterialPtr;
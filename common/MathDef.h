@@ -12,3 +12,13 @@ const T& clamp(const T& v, const T& low, const T& high)
     if (v > high) return high;
     return v;
 }
+
+// SIMD指令集的选择。定义MATH_NO_SIMD可以强制使用标量版本。
+#if !defined(MATH_NO_SIMD)
+#   if defined(__AVX2__)
+#       define MATH_SIMD_AVX2 1
+#   endif
+#   if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#       define MATH_SIMD_SSE 1
+#   endif
+#endif
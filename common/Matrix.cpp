@@ -6,6 +6,66 @@
 #include "Vector3.h"
 #include "Vector4.h"
 #include "Quaternion.h"
+#include "MathDef.h"
+
+#if defined(MATH_SIMD_SSE)
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+#if defined(MATH_SIMD_SSE)
+#   define MATRIX_SIMD 1
+
+    /** 矩阵的一行(4个float)。以下运算与标量版本的运算顺序完全一致，所以结果是逐位相同的。
+     *  注意不能合并成FMA，否则结果会与标量版本不同。其他平台(包括NEON)使用标量版本。
+     */
+    typedef __m128 Row;
+
+    inline Row loadRow(const float *p) { return _mm_loadu_ps(p); }
+    inline void storeRow(float *p, Row v) { _mm_storeu_ps(p, v); }
+    inline Row splat(float v) { return _mm_set1_ps(v); }
+    inline Row add(Row a, Row b) { return _mm_add_ps(a, b); }
+    inline Row sub(Row a, Row b) { return _mm_sub_ps(a, b); }
+    inline Row mul(Row a, Row b) { return _mm_mul_ps(a, b); }
+    inline Row div(Row a, Row b) { return _mm_div_ps(a, b); }
+    inline Row neg(Row a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+    inline float getW(Row v) { return _mm_cvtss_f32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))); }
+    inline Row swizzleYZX(Row v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 2, 1)); }
+    inline Row swizzleZXY(Row v) { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 1, 0, 2)); }
+    inline void transposeRows(Row &r0, Row &r1, Row &r2, Row &r3) { _MM_TRANSPOSE4_PS(r0, r1, r2, r3); }
+
+    /** 行向量乘以矩阵：p.x * row0 + p.y * row1 + p.z * row2 + p.w * row3 */
+    inline Row transformRow(float x, float y, float z, float w, const Row rows[4])
+    {
+        Row ret = add(mul(splat(x), rows[0]), mul(splat(y), rows[1]));
+        ret = add(ret, mul(splat(z), rows[2]));
+        return add(ret, mul(splat(w), rows[3]));
+    }
+
+    inline void loadRows(Row rows[4], const Matrix &m)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            rows[i] = loadRow(m.m[i]);
+        }
+    }
+
+    /** 前3个分量的叉乘。a.yzx * b.zxy - a.zxy * b.yzx，第4个分量无意义。*/
+    inline Row cross3(Row a, Row b)
+    {
+        return sub(mul(swizzleYZX(a), swizzleZXY(b)), mul(swizzleZXY(a), swizzleYZX(b)));
+    }
+
+    /** 存储前3个分量。避免写越界。*/
+    inline void storeVector3(Vector3 &out, Row v)
+    {
+        float tmp[4];
+        storeRow(tmp, v);
+        out.set(tmp[0], tmp[1], tmp[2]);
+    }
+#endif
+}
 
 /*static*/ Matrix Matrix::Identity(
     1, 0, 0, 0,
@@ -196,6 +256,32 @@ Vector3 Matrix::getRotate() const
 
 void Matrix::multiply( const Matrix& m1, const Matrix& m2 )
 {
+#if defined(MATRIX_SIMD)
+    // 先把所有的行都计算出来再写回，this可以是m1或m2
+    Row rows2[4];
+    loadRows(rows2, m2);
+
+    Row result[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        const float *a = m1.m[i];
+        result[i] = transformRow(a[0], a[1], a[2], a[3], rows2);
+    }
+
+    for (int i = 0; i < 4; ++i)
+    {
+        storeRow(m[i], result[i]);
+    }
+#else
+    // 与SIMD版本一样，允许this是m1或m2
+    if (this == &m1 || this == &m2)
+    {
+        Matrix ret;
+        ret.multiply(m1, m2);
+        *this = ret;
+        return;
+    }
+
     _11 = m1._11 * m2._11 + m1._12 * m2._21 + m1._13 * m2._31 + m1._14 * m2._41;
     _12 = m1._11 * m2._12 + m1._12 * m2._22 + m1._13 * m2._32 + m1._14 * m2._42;
     _13 = m1._11 * m2._13 + m1._12 * m2._23 + m1._13 * m2._33 + m1._14 * m2._43;
@@ -215,6 +301,7 @@ void Matrix::multiply( const Matrix& m1, const Matrix& m2 )
     _42 = m1._41 * m2._12 + m1._42 * m2._22 + m1._43 * m2._32 + m1._44 * m2._42;
     _43 = m1._41 * m2._13 + m1._42 * m2._23 + m1._43 * m2._33 + m1._44 * m2._43;
     _44 = m1._41 * m2._14 + m1._42 * m2._24 + m1._43 * m2._34 + m1._44 * m2._44;
+#endif
 }
 
 void Matrix::invertOrthonormal( const Matrix& matrix)
@@ -253,6 +340,39 @@ bool Matrix::invert( const Matrix& matrix)
 
     float rcp = 1 / determinant;
 
+#if defined(MATRIX_SIMD)
+    // 伴随矩阵的每一列是两行的叉乘，转置后得到逆矩阵的前3行
+    Row r0 = loadRow(matrix.m[0]);
+    Row r1 = loadRow(matrix.m[1]);
+    Row r2 = loadRow(matrix.m[2]);
+
+    Row scale = splat(rcp);
+    Row rows[4] = {
+        mul(cross3(r1, r2), scale),
+        mul(cross3(r2, r0), scale),
+        mul(cross3(r0, r1), scale),
+        splat(0.0f),
+    };
+    transposeRows(rows[0], rows[1], rows[2], rows[3]);
+    for (int i = 0; i < 3; ++i)
+    {
+        storeRow(m[i], rows[i]);
+    }
+
+    // 平移部分：-(t.x * row0 + t.y * row1 + t.z * row2)
+    Row t = add(mul(splat(matrix._41), rows[0]), mul(splat(matrix._42), rows[1]));
+    t = add(t, mul(splat(matrix._43), rows[2]));
+    storeRow(m[3], neg(t));
+    _44 = 1.0f;
+#else
+    if (this == &matrix)
+    {
+        Matrix ret;
+        ret.invert(matrix);
+        *this = ret;
+        return true;
+    }
+
     _11 = matrix._22 * matrix._33 - matrix._23 * matrix._32;
     _12 = matrix._13 * matrix._32 - matrix._12 * matrix._33;
     _13 = matrix._12 * matrix._23 - matrix._13 * matrix._22;
@@ -282,6 +402,7 @@ bool Matrix::invert( const Matrix& matrix)
     _42 = -(matrix._41 * _12 + matrix._42 * _22 + matrix._43 * _32);
     _43 = -(matrix._41 * _13 + matrix._42 * _23 + matrix._43 * _33);
     _44 = 1.0f;
+#endif
 
     return true;
 }
@@ -525,10 +646,16 @@ void Matrix::orthogonalProjectionOffCenterGL(float left, float right, float bott
 
 void Matrix::transformVector(Vector4 &ret, const Vector4 &p) const
 {
+#if defined(MATRIX_SIMD)
+    Row rows[4];
+    loadRows(rows, *this);
+    storeRow(&ret.x, transformRow(p.x, p.y, p.z, p.w, rows));
+#else
     ret.x = p.x * _11 + p.y * _21 + p.z * _31 + p.w * _41;
     ret.y = p.x * _12 + p.y * _22 + p.z * _32 + p.w * _42;
     ret.z = p.x * _13 + p.y * _23 + p.z * _33 + p.w * _43;
     ret.w = p.x * _14 + p.y * _24 + p.z * _34 + p.w * _44;
+#endif
 }
 
 Vector4 Matrix::transformPoint(const Vector4 &p) const
@@ -552,3 +679,71 @@ Vector3 Matrix::transformNormal(const Vector3 & p) const
     transformVector(ret, Vector4(p, 0.0f));
     return Vector3(ret.x, ret.y, ret.z);
 }
+
+bool Matrix::isAffine() const
+{
+    return _14 == 0.0f && _24 == 0.0f && _34 == 0.0f && _44 == 1.0f;
+}
+
+void Matrix::transformPoints(Vector3 *out, const Vector3 *in, size_t count) const
+{
+    transformPoints(out, in, sizeof(Vector3), count);
+}
+
+void Matrix::transformPoints(Vector3 *out, const void *in, size_t inStride, size_t count) const
+{
+    const char *src = (const char*)in;
+
+    // 仿射矩阵的w恒为1，可以省掉除法
+    bool affine = isAffine();
+
+#if defined(MATRIX_SIMD)
+    Row rows[4];
+    loadRows(rows, *this);
+
+    for (size_t i = 0; i < count; ++i, src += inStride)
+    {
+        const Vector3 &p = *(const Vector3*)src;
+        Row ret = transformRow(p.x, p.y, p.z, 1.0f, rows);
+        if (!affine)
+        {
+            ret = div(ret, splat(getW(ret)));
+        }
+        storeVector3(out[i], ret);
+    }
+#else
+    for (size_t i = 0; i < count; ++i, src += inStride)
+    {
+        const Vector3 &p = *(const Vector3*)src;
+        Vector4 ret;
+        transformVector(ret, Vector4(p, 1.0f));
+        if (affine)
+        {
+            out[i].set(ret.x, ret.y, ret.z);
+        }
+        else
+        {
+            out[i].set(ret.x / ret.w, ret.y / ret.w, ret.z / ret.w);
+        }
+    }
+#endif
+}
+
+void Matrix::transformNormals(Vector3 *out, const Vector3 *in, size_t count) const
+{
+#if defined(MATRIX_SIMD)
+    Row rows[4];
+    loadRows(rows, *this);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const Vector3 &p = in[i];
+        storeVector3(out[i], transformRow(p.x, p.y, p.z, 0.0f, rows));
+    }
+#else
+    for (size_t i = 0; i < count; ++i)
+    {
+        out[i] = transformNormal(in[i]);
+    }
+#endif
+}
@@ -54,12 +54,14 @@ public:
 	void setRotate(float x, float y, float z);
 	Vector3 getRotate() const;
 
+    /** this = m1 * m2。m1和m2可以是this。*/
     void multiply( const Matrix& m1, const Matrix& m2 );
     void preMultiply( const Matrix& m );
     void postMultiply( const Matrix& m );
 
     void invertOrthonormal( const Matrix& m );
     void invertOrthonormal();
+    /** 只计算3x4部分的逆矩阵。m可以是this，不可逆时设为单位矩阵并返回false。*/
     bool invert( const Matrix& m );
     bool invert();
     float getDeterminant() const;
@@ -111,6 +113,22 @@ public:
     /** 变换向量。*/
 	Vector3 transformNormal(const Vector3 &p) const;
 
+    /** 第4列是否为(0, 0, 0, 1)。仿射矩阵变换坐标时，不需要透视除法。*/
+    bool isAffine() const;
+
+    /** 批量变换坐标，并进行透视除法。结果与逐个调用transformPoint相同。
+     *  @param out  输出数组，可以与输入相同。
+     */
+    void transformPoints(Vector3 *out, const Vector3 *in, size_t count) const;
+
+    /** 批量变换坐标。输入是带步长的数组，比如顶点缓冲区中的position。
+     *  @param inStride 相邻两个输入坐标的字节间隔。
+     */
+    void transformPoints(Vector3 *out, const void *in, size_t inStride, size_t count) const;
+
+    /** 批量变换向量。结果与逐个调用transformNormal相同。*/
+    void transformNormals(Vector3 *out, const Vector3 *in, size_t count) const;
+
 public:
     static Matrix Identity;
     static Matrix Zero;
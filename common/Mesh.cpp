@@ -1,6 +1,10 @@
 ﻿#include "Mesh.h"
 #include "Renderer.h"
 #include "MeshFaceVisitor.h"
+#include "RenderQueue.h"
+#include "InstanceBuffer.h"
+#include "Profiler.h"
+#include "VertexPacking.h"
 
 SubMesh::SubMesh()
     : start_(0)
@@ -55,13 +59,48 @@ void SubMesh::draw(Renderer *renderer)
     }
 }
 
+void SubMesh::drawInstanced(Renderer *renderer, uint32_t count)
+{
+    if(count_ == 0 || count == 0)
+    {
+        return;
+    }
+
+    if(VertexBuffer::s_vertexBuffer == nullptr)
+    {
+        return;
+    }
+
+    if(useIndex_)
+    {
+        IndexBuffer *ib = IndexBuffer::s_indexBuffer;
+        if(ib == nullptr)
+        {
+            return;
+        }
+
+        glDrawElementsInstanced((GLenum)primitiveType_, count_, (GLenum)ib->getIndexType(), (GLvoid*)(start_ * ib->stride()), count);
+    }
+    else
+    {
+        glDrawArraysInstanced((GLenum)primitiveType_, start_, count_, count);
+    }
+}
+
 
 /////////////////////////////////////////////////////////////
 /// Mesh
 /////////////////////////////////////////////////////////////
 
 Mesh::Mesh()
+    : instanceColor_(Color::White)
+    , positionDecode_(Matrix::Identity)
+    , hasPositionDecode_(false)
 {
+    static uint32_t s_sortID = 0;
+    sortID_ = ++s_sortID;
+    boundingBox_.setEmpty();
+
     vertexAttribute_ = new VertexAttribute();
 }
 
@@ -84,6 +123,11 @@ MeshPtr Mesh::clone()
     mesh->indexBuffer_ = this->indexBuffer_;
     mesh->vertexDecl_ = this->vertexDecl_;
     mesh->vertexAttribute_ = this->vertexAttribute_;
+    mesh->sortID_ = this->sortID_;
+    mesh->instanceColor_ = this->instanceColor_;
+    mesh->positionDecode_ = this->positionDecode_;
+    mesh->hasPositionDecode_ = this->hasPositionDecode_;
+    mesh->boundingBox_ = this->boundingBox_;
     mesh->subMeshs_ = this->subMeshs_;
 
     mesh->materials_ = this->materials_;
@@ -97,6 +141,7 @@ MeshPtr Mesh::clone()
 
 void Mesh::draw(Renderer *renderer)
 {
+    PROFILE_SCOPE("Mesh::draw");
     if(!vertexBuffer_ || !vertexDecl_)
     {
         return;
@@ -107,15 +152,44 @@ void Mesh::draw(Renderer *renderer)
 	{
 		return;
 	}
-    
-    if(!vertexAttribute_->init(vertexBuffer_.get(), vertexDecl_.get()))
+    ++renderer->getCullStats().nVisible;
+
+    // 提交到渲染队列的世界矩阵同样包含解码变换
+    if (hasPositionDecode_)
+    {
+        renderer->pushMatrix();
+        renderer->getWorldMatrix().preMultiply(positionDecode_);
+        drawSubMeshes(renderer);
+        renderer->popMatrix();
+    }
+    else
     {
+        drawSubMeshes(renderer);
+    }
+}
+
+void Mesh::drawSubMeshes(Renderer *renderer)
+{
+    // 有渲染队列时，只提交绘制项，由队列排序后统一绘制
+    RenderQueue *queue = renderer->getRenderQueue();
+    if (queue != nullptr)
+    {
+        MaterialPtr overwrite = renderer->getOverwriteMaterial();
+        for (const SubMeshPtr &ptr : subMeshs_)
+        {
+            MaterialPtr mtl = overwrite ? overwrite : getMaterial(ptr->getMaterialID());
+            if (mtl && mtl->getShader())
+            {
+                queue->add(this, ptr.get(), mtl.get(), renderer->getWorldMatrix(), renderer->getViewMatrix(), instanceColor_);
+            }
+        }
         return;
     }
     
-    vertexAttribute_->bind();
-	if (indexBuffer_)
-		indexBuffer_->bind();
+    if(!bindBuffers())
+    {
+        return;
+    }
 
     for(SubMeshPtr ptr : subMeshs_)
     {
@@ -127,12 +201,34 @@ void Mesh::draw(Renderer *renderer)
 
         if(mtl && mtl->begin())
         {
+            if (mtl->getShader()->isInstanced())
+            {
+                InstanceBuffer::setConstantAttributes(renderer->getWorldMatrix(), instanceColor_);
+            }
             ptr->draw(renderer);
 
 			mtl->end();
         }
     }
 
+    unbindBuffers();
+}
+
+bool Mesh::bindBuffers()
+{
+    if(!vertexAttribute_->init(vertexBuffer_.get(), vertexDecl_.get()))
+    {
+        return false;
+    }
+    
+    vertexAttribute_->bind();
+	if (indexBuffer_)
+		indexBuffer_->bind();
+    return true;
+}
+
+void Mesh::unbindBuffers()
+{
     vertexAttribute_->unbind();
     if(indexBuffer_)
         indexBuffer_->unbind();
@@ -148,6 +244,18 @@ void Mesh::setIndexBuffer(IndexBufferPtr index)
     indexBuffer_ = index;
 }
 
+void Mesh::setResidency(BufferResidency residency)
+{
+    if (vertexBuffer_)
+    {
+        vertexBuffer_->setResidency(residency);
+    }
+    if (indexBuffer_)
+    {
+        indexBuffer_->setResidency(residency);
+    }
+}
+
 void Mesh::setVertexDecl(VertexDeclarationPtr decl)
 {
     vertexDecl_ = decl;
@@ -227,6 +335,16 @@ void Mesh::generateBoundingBox()
     }
 }
 
+bool Mesh::getLocalBounds(AABB &bounds) const
+{
+    if (!boundingBox_.isValid())
+    {
+        return false;
+    }
+    bounds = boundingBox_;
+    return true;
+}
+
 uint32_t Mesh::extractIndex(const char *pData, int stride, int index)
 {
     const char *p = pData + index * stride;
@@ -248,11 +366,26 @@ uint32_t Mesh::extractIndex(const char *pData, int stride, int index)
     return ret;
 }
 
+void Mesh::setPositionDecode(const Vector3 &offset, float scale)
+{
+    makePositionDecode(positionDecode_, offset, scale);
+    hasPositionDecode_ = true;
+}
+
 void Mesh::iterateFaces(MeshFaceVisitor & visitor) const
 {
     const char* vertexData = vertexBuffer_->lock(true);
     size_t vertexStride = vertexBuffer_->stride();
 
+    std::vector<Vector3> positions;
+    if (hasPositionDecode_)
+    {
+        positions.resize(vertexBuffer_->count());
+        decodePositions(positions.data(), vertexData, vertexStride, positions.size(), positionDecode_);
+        vertexData = (const char*)positions.data();
+        vertexStride = sizeof(Vector3);
+    }
+
     if (indexBuffer_)
     {
         const char* indexData = indexBuffer_->lock(true);
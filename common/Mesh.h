@@ -7,6 +7,8 @@
 #include "Material.h"
 #include "Component.h"
 #include "AABB.h"
+#include "Color.h"
+#include "Matrix.h"
 
 #include <vector>
 
@@ -22,6 +24,8 @@ public:
     ~SubMesh();
 
     void draw(Renderer *renderer);
+    /** 实例化绘制count份。需要先绑定实例属性。*/
+    void drawInstanced(Renderer *renderer, uint32_t count);
 
     int getMaterialID() const { return mtlID_; }
 
@@ -60,8 +64,17 @@ public:
 
     virtual void draw(Renderer *renderer) override;
 
+    /** 绑定顶点数组和索引缓冲区。用于在绘制多个子模型时，只绑定一次。*/
+    bool bindBuffers();
+    void unbindBuffers();
+
+    /** 每个模型唯一的编号，用于渲染队列的排序。clone出来的模型与源模型共享缓冲区，编号也相同。*/
+    uint32_t getSortID() const { return sortID_; }
+
     void setVertexBuffer(VertexBufferPtr vertex);
     void setIndexBuffer(IndexBufferPtr index);
+    /** 设置顶点和索引缓冲区上传之后内存副本的保留方式。*/
+    void setResidency(BufferResidency residency);
     void setVertexDecl(VertexDeclarationPtr decl);
 	void setVertexDecl(const std::string &type);
 
@@ -86,14 +99,31 @@ public:
     VertexDeclarationPtr getVertexDecl() const { return vertexDecl_; }
     IndexBufferPtr getIndexBuffer() const { return indexBuffer_; }
 
+    /** 实例颜色，使用实例化shader时有效(a_instanceColor)。*/
+    void setInstanceColor(const Color &color) { instanceColor_ = color; }
+    const Color& getInstanceColor() const { return instanceColor_; }
+
     void generateBoundingBox();
     const AABB& getBoundingBox() const { return boundingBox_; }
 
+    /** 没有调用过generateBoundingBox时返回false。*/
+    virtual bool getLocalBounds(AABB &bounds) const override;
+
+    /** 位置量化到[0, 1]时，解码到模型空间的变换：先缩放scale，再平移offset。
+     *  绘制时乘在世界矩阵之前，iterateFaces访问的是解码之后的位置。
+     */
+    void setPositionDecode(const Vector3 &offset, float scale);
+    bool hasPositionDecode() const { return hasPositionDecode_; }
+    const Matrix& getPositionDecode() const { return positionDecode_; }
+
+    /** 位置量化过的模型，访问者得到的三角形指向解码之后的Vector3，而不是顶点缓冲区。*/
     void iterateFaces(MeshFaceVisitor &visitor) const;
 
     static uint32_t extractIndex(const char *pData, int stride, int index);
 
 private:
+    void drawSubMeshes(Renderer *renderer);
+
     MeshPtr                 source_;
     std::string             resource_;
 
@@ -105,6 +135,10 @@ private:
     SubMeshes               subMeshs_;
     Materials               materials_;
     AABB                    boundingBox_;
+    uint32_t                sortID_;
+    Color                   instanceColor_;
+    Matrix                  positionDecode_;
+    bool                    hasPositionDecode_;
 };
 
 #endif //H__MESH_H
@@ -0,0 +1,519 @@
+#include "MeshOptimizer.h"
+#include "Mesh.h"
+#include "VertexBuffer.h"
+#include "VertexDeclaration.h"
+#include "Vector3.h"
+#include "LogTool.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    /// Forsyth算法中模拟的LRU缓存大小
+    const int CacheSize = 32;
+    const float LastTriangleScore = 0.75f;
+    const float CacheDecayPower = 1.5f;
+    const float ValenceBoostScale = 2.0f;
+    const float ValenceBoostPower = 0.5f;
+    const int MaxValence = 32;
+
+    struct ScoreTable
+    {
+        float cache[CacheSize];
+        float valence[MaxValence + 1];
+
+        ScoreTable()
+        {
+            for (int i = 0; i < CacheSize; ++i)
+            {
+                // 最近一个三角形的3个顶点得分固定，避免总是选择同一个方向的三角形
+                if (i < 3)
+                {
+                    cache[i] = LastTriangleScore;
+                }
+                else
+                {
+                    cache[i] = std::pow(1.0f - float(i - 3) / (CacheSize - 3), CacheDecayPower);
+                }
+            }
+            valence[0] = 0.0f;
+            for (int i = 1; i <= MaxValence; ++i)
+            {
+                // 剩下的三角形越少，越早处理完这个顶点
+                valence[i] = ValenceBoostScale * std::pow(float(i), -ValenceBoostPower);
+            }
+        }
+
+        float vertexScore(int cachePosition, uint32_t remaining) const
+        {
+            if (remaining == 0)
+            {
+                return -1.0f;
+            }
+            float score = cachePosition >= 0 ? cache[cachePosition] : 0.0f;
+            return score + valence[std::min<uint32_t>(remaining, MaxValence)];
+        }
+    };
+
+    /** 每个顶点相邻的三角形，按顶点连续存放。*/
+    struct Adjacency
+    {
+        std::vector<uint32_t> counts;
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> triangles;
+
+        void build(const uint32_t *indices, size_t nIndices, size_t nVertices)
+        {
+            counts.assign(nVertices, 0);
+            offsets.resize(nVertices);
+            triangles.resize(nIndices);
+
+            for (size_t i = 0; i < nIndices; ++i)
+            {
+                ++counts[indices[i]];
+            }
+            uint32_t offset = 0;
+            for (size_t i = 0; i < nVertices; ++i)
+            {
+                offsets[i] = offset;
+                offset += counts[i];
+            }
+            std::fill(counts.begin(), counts.end(), 0);
+            for (size_t i = 0; i < nIndices; ++i)
+            {
+                uint32_t v = indices[i];
+                triangles[offsets[v] + counts[v]++] = uint32_t(i / 3);
+            }
+        }
+    };
+
+    inline const Vector3& getPosition(const void *positions, size_t stride, uint32_t index)
+    {
+        return *(const Vector3*)((const char*)positions + index * stride);
+    }
+}
+
+VertexCacheStats analyzeVertexCache(const uint32_t *indices, size_t nIndices, size_t nVertices, uint32_t cacheSize)
+{
+    VertexCacheStats stats = { 0.0f, 0.0f };
+    if (nIndices < 3)
+    {
+        return stats;
+    }
+
+    // 记录每个顶点进入缓存时的时间戳，时间戳在最近cacheSize次之内的就在缓存中
+    std::vector<uint32_t> timestamps(nVertices, 0);
+    std::vector<uint8_t> used(nVertices, 0);
+    uint32_t time = cacheSize + 1;
+    size_t misses = 0;
+    size_t nUsed = 0;
+
+    for (size_t i = 0; i < nIndices; ++i)
+    {
+        uint32_t v = indices[i];
+        if (time - timestamps[v] > cacheSize)
+        {
+            timestamps[v] = time++;
+            ++misses;
+        }
+        if (!used[v])
+        {
+            used[v] = 1;
+            ++nUsed;
+        }
+    }
+
+    stats.acmr = float(misses) / float(nIndices / 3);
+    stats.atvr = nUsed > 0 ? float(misses) / float(nUsed) : 0.0f;
+    return stats;
+}
+
+void optimizeVertexCache(uint32_t *dst, const uint32_t *indices, size_t nIndices, size_t nVertices)
+{
+    static const ScoreTable s_scores;
+
+    size_t nTriangles = nIndices / 3;
+    if (nTriangles == 0)
+    {
+        return;
+    }
+
+    std::vector<uint32_t> source(indices, indices + nTriangles * 3);
+
+    Adjacency adjacency;
+    adjacency.build(source.data(), source.size(), nVertices);
+
+    // 每个顶点剩余的三角形数量，及其在缓存中的位置
+    std::vector<uint32_t> remaining(adjacency.counts);
+    std::vector<int> cachePositions(nVertices, -1);
+    std::vector<float> vertexScores(nVertices);
+    for (size_t i = 0; i < nVertices; ++i)
+    {
+        vertexScores[i] = s_scores.vertexScore(-1, remaining[i]);
+    }
+
+    std::vector<float> triangleScores(nTriangles);
+    for (size_t i = 0; i < nTriangles; ++i)
+    {
+        const uint32_t *t = &source[i * 3];
+        triangleScores[i] = vertexScores[t[0]] + vertexScores[t[1]] + vertexScores[t[2]];
+    }
+    std::vector<uint8_t> emitted(nTriangles, 0);
+
+    // 多出3个位置，容纳新三角形挤出去的顶点
+    uint32_t cache[CacheSize + 3];
+    uint32_t newCache[CacheSize + 3];
+    int cacheCount = 0;
+
+    size_t current = 0;
+    size_t cursor = 0;
+    for (size_t out = 0; out < nTriangles; ++out)
+    {
+        const uint32_t *t = &source[current * 3];
+        emitted[current] = 1;
+        dst[out * 3 + 0] = t[0];
+        dst[out * 3 + 1] = t[1];
+        dst[out * 3 + 2] = t[2];
+
+        // 三角形的顶点放到缓存的最前面，其余的依次后移
+        int newCount = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            newCache[newCount++] = t[k];
+        }
+        for (int k = 0; k < cacheCount; ++k)
+        {
+            uint32_t v = cache[k];
+            if (v != t[0] && v != t[1] && v != t[2])
+            {
+                newCache[newCount++] = v;
+            }
+        }
+
+        // 从邻接表中移除这个三角形
+        for (int k = 0; k < 3; ++k)
+        {
+            uint32_t v = t[k];
+            uint32_t *begin = &adjacency.triangles[adjacency.offsets[v]];
+            uint32_t *end = begin + remaining[v];
+            uint32_t *it = std::find(begin, end, uint32_t(current));
+            if (it != end)
+            {
+                std::swap(*it, *(end - 1));
+                --remaining[v];
+            }
+        }
+
+        // 更新缓存中顶点的得分，以及与它们相邻的三角形得分，从中选出下一个三角形
+        size_t best = size_t(-1);
+        float bestScore = 0.0f;
+        for (int k = 0; k < newCount; ++k)
+        {
+            uint32_t v = newCache[k];
+            int position = k < CacheSize ? k : -1;
+            cachePositions[v] = position;
+
+            float score = s_scores.vertexScore(position, remaining[v]);
+            float delta = score - vertexScores[v];
+            vertexScores[v] = score;
+
+            const uint32_t *adjacent = &adjacency.triangles[adjacency.offsets[v]];
+            for (uint32_t j = 0; j < remaining[v]; ++j)
+            {
+                uint32_t tri = adjacent[j];
+                triangleScores[tri] += delta;
+                if (triangleScores[tri] > bestScore)
+                {
+                    bestScore = triangleScores[tri];
+                    best = tri;
+                }
+            }
+        }
+
+        cacheCount = std::min(newCount, CacheSize);
+        memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+
+        // 缓存中的顶点没有剩余的三角形时，按原来的顺序取下一个
+        if (best == size_t(-1))
+        {
+            while (cursor < nTriangles && emitted[cursor])
+            {
+                ++cursor;
+            }
+            best = cursor;
+        }
+        current = best;
+    }
+}
+
+size_t optimizeOverdraw(uint32_t *indices, size_t nIndices, const void *positions, size_t nVertices, size_t stride, float threshold)
+{
+    const uint32_t cacheSize = 16;
+
+    size_t nTriangles = nIndices / 3;
+    if (nTriangles == 0)
+    {
+        return 0;
+    }
+
+    // 模拟FIFO缓存：3个顶点都不命中的三角形处缓存已经冷了，在这里切分不影响命中率
+    std::vector<uint32_t> timestamps(nVertices, 0);
+    uint32_t time = cacheSize + 1;
+    auto countMisses = [&](const uint32_t *t)
+    {
+        uint32_t misses = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            if (time - timestamps[t[k]] > cacheSize)
+            {
+                timestamps[t[k]] = time++;
+                ++misses;
+            }
+        }
+        return misses;
+    };
+
+    std::vector<uint32_t> hardBoundaries;
+    for (size_t i = 0; i < nTriangles; ++i)
+    {
+        if (countMisses(&indices[i * 3]) == 3)
+        {
+            hardBoundaries.push_back(uint32_t(i));
+        }
+    }
+    hardBoundaries.push_back(uint32_t(nTriangles));
+
+    // 每个簇从冷缓存开始，累计的ACMR不超过整段ACMR的threshold倍时，可以在这里再切分
+    std::vector<uint32_t> boundaries;
+    for (size_t h = 0; h + 1 < hardBoundaries.size(); ++h)
+    {
+        uint32_t begin = hardBoundaries[h];
+        uint32_t end = hardBoundaries[h + 1];
+
+        time += cacheSize + 1;
+        size_t misses = 0;
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            misses += countMisses(&indices[i * 3]);
+        }
+        float limit = float(misses) / float(end - begin) * threshold;
+
+        boundaries.push_back(begin);
+        time += cacheSize + 1;
+        misses = 0;
+        uint32_t start = begin;
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            misses += countMisses(&indices[i * 3]);
+            // 至少保留几个三角形，太小的簇排序的代价超过收益
+            if (i + 1 < end && i + 1 - start >= 8 && float(misses) / float(i + 1 - start) <= limit)
+            {
+                boundaries.push_back(i + 1);
+                start = i + 1;
+                misses = 0;
+                time += cacheSize + 1;
+            }
+        }
+    }
+    boundaries.push_back(uint32_t(nTriangles));
+
+    // 簇的中心相对模型中心的偏移在簇的平均法线上的投影越大，越靠外、越朝外，越应该先画
+    Vector3 meshCenter = Vector3::Zero;
+    float meshArea = 0.0f;
+    size_t nClusters = boundaries.size() - 1;
+    std::vector<Vector3> centers(nClusters, Vector3::Zero);
+    std::vector<Vector3> normals(nClusters, Vector3::Zero);
+    std::vector<float> areas(nClusters, 0.0f);
+    for (size_t c = 0; c < nClusters; ++c)
+    {
+        for (uint32_t i = boundaries[c]; i < boundaries[c + 1]; ++i)
+        {
+            const Vector3 &a = getPosition(positions, stride, indices[i * 3 + 0]);
+            const Vector3 &b = getPosition(positions, stride, indices[i * 3 + 1]);
+            const Vector3 &p = getPosition(positions, stride, indices[i * 3 + 2]);
+
+            Vector3 normal = (b - a).crossProduct(p - a);
+            float area = normal.length();
+            centers[c] += (a + b + p) * (area / 3.0f);
+            normals[c] += normal;
+            areas[c] += area;
+        }
+        meshCenter += centers[c];
+        meshArea += areas[c];
+    }
+    if (meshArea > 0.0f)
+    {
+        meshCenter *= 1.0f / meshArea;
+    }
+
+    std::vector<float> scores(nClusters);
+    for (size_t c = 0; c < nClusters; ++c)
+    {
+        Vector3 center = areas[c] > 0.0f ? centers[c] * (1.0f / areas[c]) : meshCenter;
+        Vector3 normal = normals[c];
+        normal.normalize();
+        scores[c] = (center - meshCenter).dotProduct(normal);
+    }
+
+    std::vector<uint32_t> order(nClusters);
+    for (size_t c = 0; c < nClusters; ++c)
+    {
+        order[c] = uint32_t(c);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b){ return scores[a] > scores[b]; });
+
+    std::vector<uint32_t> source(indices, indices + nTriangles * 3);
+    uint32_t *out = indices;
+    for (uint32_t c : order)
+    {
+        size_t count = (boundaries[c + 1] - boundaries[c]) * 3;
+        memcpy(out, &source[boundaries[c] * 3], count * sizeof(uint32_t));
+        out += count;
+    }
+    return nClusters;
+}
+
+size_t optimizeVertexFetch(void *dst, uint32_t *indices, size_t nIndices, const void *vertices, size_t nVertices, size_t vertexSize)
+{
+    std::vector<uint32_t> remap(nVertices, uint32_t(-1));
+    uint32_t next = 0;
+    for (size_t i = 0; i < nIndices; ++i)
+    {
+        uint32_t v = indices[i];
+        if (remap[v] == uint32_t(-1))
+        {
+            remap[v] = next;
+            memcpy((char*)dst + next * vertexSize, (const char*)vertices + v * vertexSize, vertexSize);
+            ++next;
+        }
+        indices[i] = remap[v];
+    }
+    return next;
+}
+
+bool optimizeMesh(Mesh *mesh, MeshOptimizeStats *stats)
+{
+    VertexBufferPtr vb = mesh->getVertexBuffer();
+    IndexBufferPtr ib = mesh->getIndexBuffer();
+    VertexDeclarationPtr decl = mesh->getVertexDecl();
+    if (!vb || !ib || !decl || vb->count() == 0)
+    {
+        return false;
+    }
+    for (const SubMeshPtr &sub : mesh->getSubMeshes())
+    {
+        if (!sub->useIndex_ || sub->start_ + sub->count_ > ib->count())
+        {
+            return false;
+        }
+    }
+
+    size_t positionOffset = 0;
+    bool hasPosition = false;
+    for (size_t i = 0; i < decl->getNumElement(); ++i)
+    {
+        const VertexElement &e = decl->getElement(i);
+        if (e.usage == VertexUsage::POSITION)
+        {
+            hasPosition = e.nComponent >= 3 && e.type == GL_FLOAT;
+            break;
+        }
+        positionOffset += e.size();
+    }
+
+    size_t nVertices = vb->count();
+    size_t vertexSize = vb->stride();
+    std::vector<uint32_t> indices(ib->count());
+    const char *indexData = ib->lock(true);
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        indices[i] = Mesh::extractIndex(indexData, int(ib->stride()), int(i));
+    }
+    ib->unlock();
+
+    for (uint32_t index : indices)
+    {
+        if (index >= nVertices)
+        {
+            LOG_ERROR("optimizeMesh: index out of range.");
+            return false;
+        }
+    }
+
+    std::vector<char> vertices(nVertices * vertexSize);
+    memcpy(vertices.data(), vb->lock(true), vertices.size());
+    vb->unlock();
+
+    MeshOptimizeStats result;
+    memset(&result, 0, sizeof(result));
+    result.nVertices = nVertices;
+
+    // 三角形的重排只在子模型内部进行，子模型的区间保持不变
+    std::vector<uint32_t> triangles;
+    for (const SubMeshPtr &sub : mesh->getSubMeshes())
+    {
+        if (sub->primitiveType_ == PrimitiveType::TriangleList)
+        {
+            triangles.insert(triangles.end(), indices.begin() + sub->start_, indices.begin() + sub->start_ + sub->count_ / 3 * 3);
+        }
+    }
+    result.before = analyzeVertexCache(triangles.data(), triangles.size(), nVertices);
+
+    triangles.clear();
+    for (const SubMeshPtr &sub : mesh->getSubMeshes())
+    {
+        if (sub->primitiveType_ != PrimitiveType::TriangleList)
+        {
+            continue;
+        }
+        uint32_t *p = &indices[sub->start_];
+        size_t count = sub->count_ / 3 * 3;
+        optimizeVertexCache(p, p, count, nVertices);
+        if (hasPosition)
+        {
+            result.nClusters += optimizeOverdraw(p, count, vertices.data() + positionOffset, nVertices, vertexSize);
+        }
+        triangles.insert(triangles.end(), p, p + count);
+    }
+
+    std::vector<char> newVertices(vertices.size());
+    result.nUsedVertices = optimizeVertexFetch(newVertices.data(), indices.data(), indices.size(), vertices.data(), nVertices, vertexSize);
+    if (result.nUsedVertices == 0)
+    {
+        return false;
+    }
+
+    // 重排之后再统计一次，顶点序号已经变了
+    triangles.clear();
+    for (const SubMeshPtr &sub : mesh->getSubMeshes())
+    {
+        if (sub->primitiveType_ == PrimitiveType::TriangleList)
+        {
+            triangles.insert(triangles.end(), indices.begin() + sub->start_, indices.begin() + sub->start_ + sub->count_ / 3 * 3);
+        }
+    }
+    result.after = analyzeVertexCache(triangles.data(), triangles.size(), result.nUsedVertices);
+
+    vb->resize(result.nUsedVertices, newVertices.data());
+
+    IndexBufferPtr newIB;
+    if (result.nUsedVertices <= 65536)
+    {
+        std::vector<uint16_t> indices16(indices.begin(), indices.end());
+        newIB = new IndexBufferEx<uint16_t>(BufferUsage::Static, indices16.size(), indices16.data());
+    }
+    else
+    {
+        newIB = new IndexBufferEx<uint32_t>(BufferUsage::Static, indices.size(), indices.data());
+    }
+    newIB->setResidency(ib->getResidency());
+    mesh->setIndexBuffer(newIB);
+
+    if (stats != nullptr)
+    {
+        *stats = result;
+    }
+    return true;
+}
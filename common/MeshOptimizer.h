@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+class Mesh;
+
+/** 顶点变换缓存的模拟结果。*/
+struct VertexCacheStats
+{
+    /// 平均每个三角形的缓存未命中次数(ACMR)，在0.5~3之间，越小越好
+    float   acmr;
+    /// 平均每个顶点被变换的次数(ATVR)，最小为1
+    float   atvr;
+};
+
+struct MeshOptimizeStats
+{
+    VertexCacheStats before;
+    VertexCacheStats after;
+    size_t  nVertices;
+    /// 顶点重排之后剩下的顶点数量，没有被引用的顶点被去掉
+    size_t  nUsedVertices;
+    /// 按遮挡顺序排列的三角形簇数量
+    size_t  nClusters;
+};
+
+/** 模拟cacheSize大小的FIFO顶点缓存。*/
+VertexCacheStats analyzeVertexCache(const uint32_t *indices, size_t nIndices, size_t nVertices, uint32_t cacheSize = 16);
+
+/** 按Forsyth的线性时间算法重排三角形，提高顶点缓存的命中率。dst可以与indices相同。*/
+void optimizeVertexCache(uint32_t *dst, const uint32_t *indices, size_t nIndices, size_t nVertices);
+
+/** 在顶点缓存优化的结果上，按缓存失效的位置把三角形切分成簇，再把朝外、靠外的簇排在前面，
+ *  使先画的三角形尽量遮挡后画的，减少像素的重复着色。threshold是允许ACMR变差的比例。
+ *  positions是每个顶点位置(3个float)的地址，相邻两个顶点相差stride字节。返回簇的数量。
+ */
+size_t optimizeOverdraw(uint32_t *indices, size_t nIndices, const void *positions, size_t nVertices, size_t stride, float threshold = 1.05f);
+
+/** 按索引中第一次出现的顺序重排顶点，让顶点的读取尽量连续，同时去掉没有被引用的顶点。
+ *  indices原地修改为新的顶点序号，dst需要容纳nVertices个顶点，不能与vertices相同。返回剩下的顶点数量。
+ */
+size_t optimizeVertexFetch(void *dst, uint32_t *indices, size_t nIndices, const void *vertices, size_t nVertices, size_t vertexSize);
+
+/** 依次执行以上三种优化，每个三角形列表子模型分别重排，顶点在所有子模型之间重排。
+ *  重新创建索引缓冲区，顶点数不超过65536时使用16位索引，否则使用32位。
+ *  会替换模型的索引缓冲区，需要在clone之前调用。所有子模型都使用索引时才能优化，否则返回false。
+ */
+bool optimizeMesh(Mesh *mesh, MeshOptimizeStats *stats = nullptr);
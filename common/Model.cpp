@@ -10,6 +10,10 @@
 #include "Material.h"
 #include "TextureMgr.h"
 #include "Renderer.h"
+#include "Transform.h"
+#include "Profiler.h"
+#include "MeshOptimizer.h"
+#include "VertexPacking.h"
 
 #include <sstream>
 
@@ -41,7 +45,7 @@ IndexBufferPtr extractIndices(const aiMesh *mesh)
 	return ib;
 }
 
-MeshPtr processMesh(const aiMesh *mesh)
+MeshPtr processMesh(const aiMesh *mesh, bool packVertices, BufferResidency residency)
 {
 	//LOG_DEBUG("Num Vertices %d", mesh->mNumVertices);
 	//LOG_DEBUG("Num Faces %d", mesh->mNumFaces);
@@ -83,11 +87,7 @@ MeshPtr processMesh(const aiMesh *mesh)
 	{
 		ib = nullptr;
 	}
-	else if (nIndices < 256)
-	{
-		ib = extractIndices<uint8_t>(mesh);
-	}
-	else if (nIndices < 65536)
+	else if (mesh->mNumVertices <= 65536)
 	{
 		ib = extractIndices<uint16_t>(mesh);
 	}
@@ -111,6 +111,30 @@ MeshPtr processMesh(const aiMesh *mesh)
 		subMesh->setPrimitive(PrimitiveType::TriangleList, 0, vb->count(), 0, false);
 	}
 	newMesh->addSubMesh(subMesh);
+
+	// 重排三角形和顶点，提高顶点缓存的命中率，减少重复着色
+	MeshOptimizeStats stats;
+	if (ib && optimizeMesh(newMesh.get(), &stats))
+	{
+		LOG_DEBUG("Optimize mesh '%s': ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, vertices %d -> %d, clusters %d",
+			mesh->mName.C_Str(), stats.before.acmr, stats.after.acmr, stats.before.atvr, stats.after.atvr,
+			(int)stats.nVertices, (int)stats.nUsedVertices, (int)stats.nClusters);
+	}
+
+	// 压缩模式使用的shader只能解码PackedMeshVertex，不能压缩的模型不能绘制
+	if (packVertices)
+	{
+		if (!packMeshVertices(newMesh.get()))
+		{
+			LOG_ERROR("Failed to pack mesh '%s'", mesh->mName.C_Str());
+			return nullptr;
+		}
+		LOG_DEBUG("Pack mesh '%s': %d bytes per vertex -> %d",
+			mesh->mName.C_Str(), (int)sizeof(MeshVertex), (int)sizeof(PackedMeshVertex));
+	}
+
+	// 优化和压缩都会替换缓冲区，最后再设置
+	newMesh->setResidency(residency);
 	return newMesh;
 }
 
@@ -179,13 +203,14 @@ void ModelNode::applyMatrix(const Matrix & parentTransform)
 
 Model::Model()
 {
+	bounds_.setEmpty();
 }
 
 Model::~Model()
 {
 }
 
-bool Model::load(const std::string & path, ShaderProgramPtr shader)
+bool Model::load(const std::string & path, ShaderProgramPtr shader, bool packVertices, BufferResidency residency)
 {
 	resource_ = path;
 	std::string resourcePath = getFilePath(path);
@@ -251,13 +276,17 @@ bool Model::load(const std::string & path, ShaderProgramPtr shader)
 	for (size_t i = 0; i < scene->mNumMeshes; ++i)
 	{
 		aiMesh *mesh = scene->mMeshes[i];
-		MeshPtr newMesh = processMesh(mesh);
-		if (newMesh)
+		MeshPtr newMesh = processMesh(mesh, packVertices, residency);
+		if (!newMesh)
 		{
-			if (mesh->mMaterialIndex < mtls.size())
-			{
-				newMesh->addMaterial(mtls[mesh->mMaterialIndex]);
-			}
+			LOG_ERROR("Failed to load model '%s'", fullPath.c_str());
+			return false;
+		}
+
+		newMesh->generateBoundingBox();
+		if (mesh->mMaterialIndex < mtls.size())
+		{
+			newMesh->addMaterial(mtls[mesh->mMaterialIndex]);
 		}
 		meshes_.push_back(newMesh);
 	}
@@ -278,10 +307,42 @@ void Model::applyMatrix(const Matrix & worldMatrix)
 	{
 		root_->applyMatrix(worldMatrix);
 	}
+
+	bounds_.setEmpty();
+	for (auto & info : drawInfo_)
+	{
+		for (int i : info.meshes)
+		{
+			if (meshes_[i] && meshes_[i]->getBoundingBox().isValid())
+			{
+				AABB bounds = meshes_[i]->getBoundingBox();
+				bounds.applyMatrix(info.node->worldTransform_);
+				bounds_.addAABB(bounds);
+			}
+		}
+	}
+
+	if (transform_ != nullptr)
+	{
+		transform_->invalidateBounds();
+	}
+}
+
+bool Model::getLocalBounds(AABB &bounds) const
+{
+	if (!bounds_.isValid())
+	{
+		return false;
+	}
+	bounds = bounds_;
+	return true;
 }
 
 void Model::draw(Renderer *renderer)
 {
+    PROFILE_SCOPE("Model::draw");
+	bool culling = renderer->isCullingEnable();
+
 	for (auto & info : drawInfo_)
 	{
 		if (info.visible)
@@ -291,6 +352,14 @@ void Model::draw(Renderer *renderer)
                 renderer->pushMatrix();
                 renderer->getWorldMatrix().preMultiply(info.node->worldTransform_);
 
+                if (culling && meshes_[i]->getBoundingBox().isValid() &&
+                    renderer->cullBounds(meshes_[i]->getBoundingBox(), renderer->getWorldMatrix()) == Frustum::OUTSIDE)
+                {
+                    ++renderer->getCullStats().nCulled;
+                    renderer->popMatrix();
+                    continue;
+                }
+
 				meshes_[i]->draw(renderer);
 
                 renderer->popMatrix();
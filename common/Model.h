@@ -5,6 +5,8 @@
 #include "Matrix.h"
 #include "Quaternion.h"
 #include "Component.h"
+#include "AABB.h"
+#include "VertexBuffer.h"
 
 #include <vector>
 #include <string>
@@ -48,10 +50,17 @@ public:
 	Model();
 	~Model();
 
-	bool load(const std::string &path, ShaderProgramPtr shader);
+	/** @param packVertices 顶点压缩为PackedMeshVertex格式(20字节)，shader需要解码，比如model_packed.shader。
+	 *  @param residency 顶点和索引缓冲区上传之后内存副本的保留方式。加载之后不再修改的模型可以用Compressed或Discard。
+	 */
+	bool load(const std::string &path, ShaderProgramPtr shader, bool packVertices = false,
+		BufferResidency residency = BufferResidency::Keep);
 
 	virtual void draw(Renderer *renderer) override;
 
+	/** 所有模型的包围盒经过结点矩阵变换后的并集。*/
+	virtual bool getLocalBounds(AABB &bounds) const override;
+
 	ModelNodePtr getRoot() const { return root_; }
 	ModelNodePtr findNode(const std::string &name) const;
 
@@ -64,6 +73,7 @@ protected:
 	std::vector<MeshPtr> meshes_;
 	std::vector<NodeDrawInfo> drawInfo_;
 	ModelNodePtr		root_;
+	AABB				bounds_;
 	std::unordered_map<std::string, ModelNodePtr> nodeMap_;
 
 	friend class ModelNodeLoader;
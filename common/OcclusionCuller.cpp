@@ -0,0 +1,551 @@
+#include "OcclusionCuller.h"
+#include "Mesh.h"
+#include "MeshFaceVisitor.h"
+#include "ThreadPool.h"
+#include "MathDef.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cfloat>
+
+#if defined(MATH_SIMD_SSE) || defined(MATH_SIMD_AVX2)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    /// 遮挡体和被遮挡体的深度计算方式不同，留一点余量，避免物体被自身的遮挡体剔除
+    const float DepthBias = 1e-5f;
+
+    /// 5个裁剪平面，每个平面最多增加一个顶点
+    const int MaxClipVertices = 8;
+
+    /** 标量版本，一次处理一个像素。比较的结果用全1的位模式表示。*/
+    struct Float1
+    {
+        enum { Width = 1 };
+        float v;
+
+        static Float1 load(const float *p) { Float1 r = { *p }; return r; }
+        static Float1 set(float x) { Float1 r = { x }; return r; }
+        static Float1 ramp() { return set(0.0f); }
+        void store(float *p) const { *p = v; }
+
+        static uint32_t bits(float x) { uint32_t r; memcpy(&r, &x, 4); return r; }
+        static Float1 fromBits(uint32_t x) { Float1 r; memcpy(&r.v, &x, 4); return r; }
+        static Float1 fromBool(bool b) { return fromBits(b ? 0xffffffffu : 0u); }
+
+        Float1 operator + (Float1 b) const { return set(v + b.v); }
+        Float1 operator * (Float1 b) const { return set(v * b.v); }
+        Float1 operator & (Float1 b) const { return fromBits(bits(v) & bits(b.v)); }
+
+        static Float1 min(Float1 a, Float1 b) { return set(a.v < b.v ? a.v : b.v); }
+        static Float1 greaterEqual(Float1 a, Float1 b) { return fromBool(a.v >= b.v); }
+        /** mask ? a : b */
+        static Float1 select(Float1 mask, Float1 a, Float1 b) { return bits(mask.v) ? a : b; }
+        static int movemask(Float1 a) { return int(bits(a.v) >> 31); }
+    };
+
+#if defined(MATH_SIMD_SSE)
+    struct Float4
+    {
+        enum { Width = 4 };
+        __m128 v;
+
+        static Float4 make(__m128 x) { Float4 r; r.v = x; return r; }
+        static Float4 load(const float *p) { return make(_mm_loadu_ps(p)); }
+        static Float4 set(float x) { return make(_mm_set1_ps(x)); }
+        static Float4 ramp() { return make(_mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f)); }
+        void store(float *p) const { _mm_storeu_ps(p, v); }
+
+        Float4 operator + (Float4 b) const { return make(_mm_add_ps(v, b.v)); }
+        Float4 operator * (Float4 b) const { return make(_mm_mul_ps(v, b.v)); }
+        Float4 operator & (Float4 b) const { return make(_mm_and_ps(v, b.v)); }
+
+        static Float4 min(Float4 a, Float4 b) { return make(_mm_min_ps(a.v, b.v)); }
+        static Float4 greaterEqual(Float4 a, Float4 b) { return make(_mm_cmpge_ps(a.v, b.v)); }
+        static Float4 select(Float4 mask, Float4 a, Float4 b)
+        {
+            return make(_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)));
+        }
+        static int movemask(Float4 a) { return _mm_movemask_ps(a.v); }
+    };
+#endif
+
+#if defined(MATH_SIMD_AVX2)
+    struct Float8
+    {
+        enum { Width = 8 };
+        __m256 v;
+
+        static Float8 make(__m256 x) { Float8 r; r.v = x; return r; }
+        static Float8 load(const float *p) { return make(_mm256_loadu_ps(p)); }
+        static Float8 set(float x) { return make(_mm256_set1_ps(x)); }
+        static Float8 ramp() { return make(_mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f)); }
+        void store(float *p) const { _mm256_storeu_ps(p, v); }
+
+        Float8 operator + (Float8 b) const { return make(_mm256_add_ps(v, b.v)); }
+        Float8 operator * (Float8 b) const { return make(_mm256_mul_ps(v, b.v)); }
+        Float8 operator & (Float8 b) const { return make(_mm256_and_ps(v, b.v)); }
+
+        static Float8 min(Float8 a, Float8 b) { return make(_mm256_min_ps(a.v, b.v)); }
+        static Float8 greaterEqual(Float8 a, Float8 b) { return make(_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)); }
+        static Float8 select(Float8 mask, Float8 a, Float8 b) { return make(_mm256_blendv_ps(b.v, a.v, mask.v)); }
+        static int movemask(Float8 a) { return _mm256_movemask_ps(a.v); }
+    };
+#endif
+
+#if defined(MATH_SIMD_AVX2)
+    typedef Float8 FloatWide;
+#elif defined(MATH_SIMD_SSE)
+    typedef Float4 FloatWide;
+#else
+    typedef Float1 FloatWide;
+#endif
+
+    /** 行向量右乘矩阵：clip = (p, 1) * m */
+    inline void transformPoint(float out[4], const Vector3 &p, const Matrix &m)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            out[i] = p.x * m.m[0][i] + p.y * m.m[1][i] + p.z * m.m[2][i] + m.m[3][i];
+        }
+    }
+
+    /** 到裁剪平面的距离，非负表示在内侧。依次为左、右、下、上、近平面。*/
+    inline float planeDistance(const float v[4], int plane)
+    {
+        switch (plane)
+        {
+        case 0: return v[3] + v[0];
+        case 1: return v[3] - v[0];
+        case 2: return v[3] + v[1];
+        case 3: return v[3] - v[1];
+        default: return v[3] + v[2];
+        }
+    }
+
+    /** 收集网格的所有三角形。*/
+    class OccluderFaceVisitor : public MeshFaceVisitor
+    {
+    public:
+        explicit OccluderFaceVisitor(std::vector<Vector3> &vertices) : vertices_(vertices) {}
+
+        virtual bool visit(const SubMesh * /*pSubMesh*/, const char **triangle) override
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                vertices_.push_back(*(const Vector3*)triangle[i]);
+            }
+            return true;
+        }
+
+    private:
+        std::vector<Vector3> &vertices_;
+    };
+}
+
+OcclusionCuller::OcclusionCuller(int width, int height)
+    : width_(0)
+    , height_(0)
+    , nBinsX_(0)
+    , nBinsY_(0)
+    , viewProj_(Matrix::Identity)
+{
+    memset(&stats_, 0, sizeof(stats_));
+    setResolution(width, height);
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+}
+
+void OcclusionCuller::setResolution(int width, int height)
+{
+    width_ = std::max<int>(BlockSize, (width + BlockSize - 1) / BlockSize * BlockSize);
+    height_ = std::max<int>(BlockSize, (height + BlockSize - 1) / BlockSize * BlockSize);
+    nBinsX_ = (width_ + BinWidth - 1) / BinWidth;
+    nBinsY_ = (height_ + BinHeight - 1) / BinHeight;
+
+    depth_.assign(width_ * height_, 1.0f);
+    hiz_.assign((width_ / BlockSize) * (height_ / BlockSize), 1.0f);
+    bins_.resize(nBinsX_ * nBinsY_);
+    triangles_.clear();
+}
+
+void OcclusionCuller::beginFrame(const Matrix &viewProj)
+{
+    viewProj_ = viewProj;
+    std::fill(depth_.begin(), depth_.end(), 1.0f);
+    std::fill(hiz_.begin(), hiz_.end(), 1.0f);
+    for (std::vector<uint32_t> &bin : bins_)
+    {
+        bin.clear();
+    }
+    triangles_.clear();
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+void OcclusionCuller::addOccluder(const Mesh *mesh, const Matrix &world)
+{
+    std::vector<Vector3> vertices;
+    OccluderFaceVisitor visitor(vertices);
+    mesh->iterateFaces(visitor);
+
+    addTriangles(vertices.data(), vertices.size(), world);
+}
+
+void OcclusionCuller::addTriangles(const Vector3 *vertices, size_t nVertices, const Matrix &world)
+{
+    Matrix m = world * viewProj_;
+
+    float clip[3][4];
+    for (size_t i = 0; i + 2 < nVertices; i += 3)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            transformPoint(clip[k], vertices[i + k], m);
+        }
+        addClipTriangle(clip);
+    }
+
+    ++stats_.nOccluders;
+    stats_.nTriangles += nVertices / 3;
+}
+
+void OcclusionCuller::addClipTriangle(const float clip[3][4])
+{
+    float buffers[2][MaxClipVertices][4];
+    float (*in)[4] = buffers[0];
+    float (*out)[4] = buffers[1];
+    memcpy(in, clip, sizeof(float) * 12);
+    int n = 3;
+
+    // 全部在视锥外的三角形直接丢弃，全部在内侧的平面不需要裁剪
+    for (int plane = 0; plane < 5; ++plane)
+    {
+        float d[MaxClipVertices];
+        bool allInside = true;
+        bool allOutside = true;
+        for (int i = 0; i < n; ++i)
+        {
+            d[i] = planeDistance(in[i], plane);
+            allInside &= d[i] >= 0.0f;
+            allOutside &= d[i] < 0.0f;
+        }
+        if (allOutside)
+        {
+            return;
+        }
+        if (allInside)
+        {
+            continue;
+        }
+
+        int m = 0;
+        for (int i = 0; i < n; ++i)
+        {
+            int j = (i + 1) % n;
+            if (d[i] >= 0.0f)
+            {
+                memcpy(out[m++], in[i], sizeof(float) * 4);
+            }
+            if ((d[i] >= 0.0f) != (d[j] >= 0.0f))
+            {
+                float t = d[i] / (d[i] - d[j]);
+                for (int k = 0; k < 4; ++k)
+                {
+                    out[m][k] = in[i][k] + (in[j][k] - in[i][k]) * t;
+                }
+                ++m;
+            }
+        }
+        std::swap(in, out);
+        n = m;
+        if (n < 3)
+        {
+            return;
+        }
+    }
+
+    // 投影到像素坐标，第0行在屏幕底部
+    float sx[MaxClipVertices], sy[MaxClipVertices], sz[MaxClipVertices];
+    for (int i = 0; i < n; ++i)
+    {
+        float invW = 1.0f / in[i][3];
+        sx[i] = (in[i][0] * invW * 0.5f + 0.5f) * width_;
+        sy[i] = (in[i][1] * invW * 0.5f + 0.5f) * height_;
+        sz[i] = in[i][2] * invW * 0.5f + 0.5f;
+    }
+
+    // 裁剪后是凸多边形，按扇形拆分
+    for (int i = 1; i + 1 < n; ++i)
+    {
+        int index[3] = { 0, i, i + 1 };
+        float area = (sx[i] - sx[0]) * (sy[i + 1] - sy[0]) - (sx[i + 1] - sx[0]) * (sy[i] - sy[0]);
+        if (!(area > 0.0f))
+        {
+            continue;
+        }
+
+        Triangle tri;
+        for (int k = 0; k < 3; ++k)
+        {
+            tri.x[k] = sx[index[k]];
+            tri.y[k] = sy[index[k]];
+            tri.z[k] = sz[index[k]];
+        }
+
+        // 远处的小三角形经常不覆盖任何像素中心
+        float minX = std::min(tri.x[0], std::min(tri.x[1], tri.x[2]));
+        float maxX = std::max(tri.x[0], std::max(tri.x[1], tri.x[2]));
+        float minY = std::min(tri.y[0], std::min(tri.y[1], tri.y[2]));
+        float maxY = std::max(tri.y[0], std::max(tri.y[1], tri.y[2]));
+        if (floorf(minX + 0.5f) == floorf(maxX + 0.5f) || floorf(minY + 0.5f) == floorf(maxY + 0.5f))
+        {
+            continue;
+        }
+
+        triangles_.push_back(tri);
+        binTriangle(uint32_t(triangles_.size() - 1));
+        ++stats_.nRasterized;
+    }
+}
+
+void OcclusionCuller::binTriangle(uint32_t index)
+{
+    const Triangle &tri = triangles_[index];
+    float minX = std::min(tri.x[0], std::min(tri.x[1], tri.x[2]));
+    float maxX = std::max(tri.x[0], std::max(tri.x[1], tri.x[2]));
+    float minY = std::min(tri.y[0], std::min(tri.y[1], tri.y[2]));
+    float maxY = std::max(tri.y[0], std::max(tri.y[1], tri.y[2]));
+
+    int bx0 = clamp(int(minX) / BinWidth, 0, nBinsX_ - 1);
+    int bx1 = clamp(int(maxX) / BinWidth, 0, nBinsX_ - 1);
+    int by0 = clamp(int(minY) / BinHeight, 0, nBinsY_ - 1);
+    int by1 = clamp(int(maxY) / BinHeight, 0, nBinsY_ - 1);
+    for (int by = by0; by <= by1; ++by)
+    {
+        for (int bx = bx0; bx <= bx1; ++bx)
+        {
+            bins_[by * nBinsX_ + bx].push_back(index);
+        }
+    }
+}
+
+namespace
+{
+    /** 在[x0, x1) x [y0, y1)的范围内光栅化一个三角形，只保留更近的深度。
+     *  x0和x1是8的倍数，每行按F::Width个像素对齐处理，不会越过范围。
+     */
+    template<typename F, typename Triangle>
+    void rasterizeTriangle(const Triangle &tri, float *depth, int stride, int x0, int y0, int x1, int y1)
+    {
+        float minX = std::min(tri.x[0], std::min(tri.x[1], tri.x[2]));
+        float maxX = std::max(tri.x[0], std::max(tri.x[1], tri.x[2]));
+        float minY = std::min(tri.y[0], std::min(tri.y[1], tri.y[2]));
+        float maxY = std::max(tri.y[0], std::max(tri.y[1], tri.y[2]));
+
+        // 像素中心为(x + 0.5, y + 0.5)
+        int px0 = std::max(x0, int(floorf(minX)));
+        int px1 = std::min(x1 - 1, int(ceilf(maxX)));
+        int py0 = std::max(y0, int(floorf(minY)));
+        int py1 = std::min(y1 - 1, int(ceilf(maxY)));
+        if (px0 > px1 || py0 > py1)
+        {
+            return;
+        }
+        px0 &= ~(F::Width - 1);
+
+        // 归一化的边函数就是重心坐标：lambda_i = a_i * x + b_i * y + c_i
+        float area = (tri.x[1] - tri.x[0]) * (tri.y[2] - tri.y[0]) - (tri.x[2] - tri.x[0]) * (tri.y[1] - tri.y[0]);
+        float invArea = 1.0f / area;
+        float a[3], b[3], c[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            int j = (i + 1) % 3;
+            int k = (i + 2) % 3;
+            a[i] = (tri.y[j] - tri.y[k]) * invArea;
+            b[i] = (tri.x[k] - tri.x[j]) * invArea;
+            c[i] = -a[i] * tri.x[j] - b[i] * tri.y[j];
+        }
+
+        // 深度在屏幕空间中是线性的
+        float za = a[0] * tri.z[0] + a[1] * tri.z[1] + a[2] * tri.z[2];
+        float zb = b[0] * tri.z[0] + b[1] * tri.z[1] + b[2] * tri.z[2];
+        float zc = c[0] * tri.z[0] + c[1] * tri.z[1] + c[2] * tri.z[2];
+
+        const F zero = F::set(0.0f);
+        const F farDepth = F::set(FLT_MAX);
+        const F ramp = F::ramp();
+        const F fa0 = F::set(a[0]), fa1 = F::set(a[1]), fa2 = F::set(a[2]), fza = F::set(za);
+
+        for (int y = py0; y <= py1; ++y)
+        {
+            float cy = y + 0.5f;
+            F row0 = F::set(b[0] * cy + c[0]);
+            F row1 = F::set(b[1] * cy + c[1]);
+            F row2 = F::set(b[2] * cy + c[2]);
+            F rowZ = F::set(zb * cy + zc);
+
+            float *line = depth + y * stride;
+            for (int x = px0; x <= px1; x += F::Width)
+            {
+                F cx = F::set(x + 0.5f) + ramp;
+                F mask = F::greaterEqual(fa0 * cx + row0, zero) &
+                    F::greaterEqual(fa1 * cx + row1, zero) &
+                    F::greaterEqual(fa2 * cx + row2, zero);
+                if (F::movemask(mask) == 0)
+                {
+                    continue;
+                }
+
+                F z = fza * cx + rowZ;
+                F::min(F::load(line + x), F::select(mask, z, farDepth)).store(line + x);
+            }
+        }
+    }
+}
+
+void OcclusionCuller::rasterizeBin(int bin)
+{
+    const std::vector<uint32_t> &triangles = bins_[bin];
+    if (triangles.empty())
+    {
+        return;
+    }
+
+    int x0 = (bin % nBinsX_) * BinWidth;
+    int y0 = (bin / nBinsX_) * BinHeight;
+    int x1 = std::min(x0 + BinWidth, width_);
+    int y1 = std::min(y0 + BinHeight, height_);
+    for (uint32_t index : triangles)
+    {
+        rasterizeTriangle<FloatWide>(triangles_[index], depth_.data(), width_, x0, y0, x1, y1);
+    }
+
+    buildHiZ(bin);
+}
+
+void OcclusionCuller::buildHiZ(int bin)
+{
+    int x0 = (bin % nBinsX_) * BinWidth;
+    int y0 = (bin / nBinsX_) * BinHeight;
+    int x1 = std::min(x0 + BinWidth, width_);
+    int y1 = std::min(y0 + BinHeight, height_);
+    int hizWidth = width_ / BlockSize;
+
+    for (int by = y0; by < y1; by += BlockSize)
+    {
+        for (int bx = x0; bx < x1; bx += BlockSize)
+        {
+            float maxDepth = 0.0f;
+            for (int y = by; y < by + BlockSize; ++y)
+            {
+                const float *line = depth_.data() + y * width_;
+                for (int x = bx; x < bx + BlockSize; ++x)
+                {
+                    maxDepth = std::max(maxDepth, line[x]);
+                }
+            }
+            hiz_[(by / BlockSize) * hizWidth + bx / BlockSize] = maxDepth;
+        }
+    }
+}
+
+void OcclusionCuller::rasterize(ThreadPool *pool)
+{
+    int nBins = nBinsX_ * nBinsY_;
+    if (pool != nullptr && nBins > 1 && !triangles_.empty())
+    {
+        // 每个块只写入自己的像素，互不相交
+        pool->parallelFor(nBins, 1, [this](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                rasterizeBin((int)i);
+            }
+        });
+    }
+    else
+    {
+        for (int i = 0; i < nBins; ++i)
+        {
+            rasterizeBin(i);
+        }
+    }
+}
+
+bool OcclusionCuller::isVisible(const AABB &bounds, const Matrix &world) const
+{
+    Matrix m = world * viewProj_;
+
+    float minX = FLT_MAX, minY = FLT_MAX, minZ = FLT_MAX;
+    float maxX = -FLT_MAX, maxY = -FLT_MAX;
+    for (int i = 0; i < 8; ++i)
+    {
+        Vector3 corner((i & 1) ? bounds.max_.x : bounds.min_.x,
+            (i & 2) ? bounds.max_.y : bounds.min_.y,
+            (i & 4) ? bounds.max_.z : bounds.min_.z);
+
+        float clip[4];
+        transformPoint(clip, corner, m);
+
+        // 与近平面相交，投影不再是有界的
+        if (planeDistance(clip, 4) <= 0.0f)
+        {
+            return true;
+        }
+
+        float invW = 1.0f / clip[3];
+        float x = (clip[0] * invW * 0.5f + 0.5f) * width_;
+        float y = (clip[1] * invW * 0.5f + 0.5f) * height_;
+        float z = clip[2] * invW * 0.5f + 0.5f;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        minZ = std::min(minZ, z);
+    }
+
+    // 包围盒覆盖的所有像素
+    if (maxX < 0.0f || maxY < 0.0f || minX >= width_ || minY >= height_)
+    {
+        return true;
+    }
+    int px0 = std::max(0, int(minX));
+    int px1 = std::min(width_ - 1, int(maxX));
+    int py0 = std::max(0, int(minY));
+    int py1 = std::min(height_ - 1, int(maxY));
+
+    float minDepth = minZ - DepthBias;
+    int hizWidth = width_ / BlockSize;
+    for (int by = py0 / BlockSize; by <= py1 / BlockSize; ++by)
+    {
+        for (int bx = px0 / BlockSize; bx <= px1 / BlockSize; ++bx)
+        {
+            // 整个块中的遮挡体都比包围盒近
+            if (hiz_[by * hizWidth + bx] < minDepth)
+            {
+                continue;
+            }
+
+            int x0 = std::max(px0, bx * BlockSize);
+            int x1 = std::min(px1, bx * BlockSize + BlockSize - 1);
+            int y0 = std::max(py0, by * BlockSize);
+            int y1 = std::min(py1, by * BlockSize + BlockSize - 1);
+            for (int y = y0; y <= y1; ++y)
+            {
+                const float *line = depth_.data() + y * width_;
+                for (int x = x0; x <= x1; ++x)
+                {
+                    if (line[x] >= minDepth)
+                    {
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "Matrix.h"
+#include "Vector3.h"
+#include "AABB.h"
+#include <vector>
+#include <cstdint>
+
+class Mesh;
+class ThreadPool;
+
+/** CPU软件遮挡剔除。
+ *  每帧把选定的遮挡体(比如墙壁、建筑)的三角形用低分辨率光栅化到CPU的深度缓冲中，
+ *  再用被遮挡体的包围盒与深度缓冲比较，完全被挡住的物体不再提交绘制。不需要GPU，也没有回读的延迟。
+ *
+ *  深度缓冲按64x32像素划分成若干块，三角形先分配到覆盖的块中，每个块在线程池中独立光栅化，
+ *  内层循环一次处理4个(SSE)或8个(AVX2)像素。光栅化完成后为每8x8个像素记录最远的深度(Hi-Z)，
+ *  测试包围盒时先用Hi-Z排除，只有不能确定的区域才逐像素比较。
+ *
+ *  测试是保守的：只会把可见的物体误判为可见，不会把可见的物体剔除掉。
+ *  遮挡体只写入像素中心被覆盖的像素，背面被剔除，所以遮挡体网格的正面需要是逆时针的。
+ *  因此只露出不到一个像素的物体可能被剔除。
+ *
+ *  使用方法：
+ *  culler.beginFrame(renderer->getViewProjMatrix());
+ *  culler.addOccluder(mesh, world); ...
+ *  culler.rasterize(pool);
+ *  renderer->setOcclusionCuller(&culler);
+ */
+class OcclusionCuller
+{
+    OcclusionCuller(const OcclusionCuller &);
+    const OcclusionCuller & operator = (const OcclusionCuller &);
+
+public:
+    struct Stats
+    {
+        size_t  nOccluders;
+        /// 提交的三角形数量
+        size_t  nTriangles;
+        /// 经过背面剔除和裁剪之后，实际光栅化的三角形数量
+        size_t  nRasterized;
+    };
+
+    enum
+    {
+        BlockSize = 8,
+        BinWidth = 64,
+        BinHeight = 32,
+    };
+
+    /** 宽高会向上取整到8的倍数。*/
+    OcclusionCuller(int width = 256, int height = 128);
+    ~OcclusionCuller();
+
+    void setResolution(int width, int height);
+    int getWidth() const { return width_; }
+    int getHeight() const { return height_; }
+
+    /** 清空遮挡体和深度缓冲。viewProj为世界空间到裁剪空间的矩阵。*/
+    void beginFrame(const Matrix &viewProj);
+
+    /** 添加一个遮挡体。三角形在这里变换、裁剪并分配到各个块中。*/
+    void addOccluder(const Mesh *mesh, const Matrix &world);
+
+    /** 添加三角形列表，每3个顶点为一个三角形。*/
+    void addTriangles(const Vector3 *vertices, size_t nVertices, const Matrix &world);
+
+    /** 光栅化所有的遮挡体，并生成Hi-Z。pool为空时在当前线程中执行。*/
+    void rasterize(ThreadPool *pool = nullptr);
+
+    /** 经过world变换的局部包围盒是否可能可见。不修改状态，可以在多个线程中同时调用。
+     *  包围盒与近平面相交或者在屏幕外时，总是返回true。
+     */
+    bool isVisible(const AABB &bounds, const Matrix &world) const;
+
+    /** 深度缓冲，行优先，第0行在屏幕底部。深度在[0, 1]之间，1为远平面。*/
+    const std::vector<float>& getDepthBuffer() const { return depth_; }
+
+    const Stats& getStats() const { return stats_; }
+
+private:
+    /** 屏幕空间中的三角形。x, y为像素坐标，z为[0, 1]的深度。*/
+    struct Triangle
+    {
+        float   x[3];
+        float   y[3];
+        float   z[3];
+    };
+
+    /** 裁剪空间中的三角形，裁剪、投影并剔除背面后加入triangles_。*/
+    void addClipTriangle(const float clip[3][4]);
+    void binTriangle(uint32_t index);
+
+    void rasterizeBin(int bin);
+    void buildHiZ(int bin);
+
+    int         width_;
+    int         height_;
+    int         nBinsX_;
+    int         nBinsY_;
+    Matrix      viewProj_;
+
+    std::vector<float>      depth_;
+    /// 每8x8个像素的最远深度
+    std::vector<float>      hiz_;
+    std::vector<Triangle>   triangles_;
+    /// 每个块中的三角形
+    std::vector<std::vector<uint32_t>>  bins_;
+
+    Stats       stats_;
+};
@@ -0,0 +1,56 @@
+#include "PrecomputedRay.h"
+#include "MathDef.h"
+
+#if defined(MATH_SIMD_SSE)
+#include <xmmintrin.h>
+#endif
+
+static_assert(sizeof(AABB) == sizeof(Vector3) * 2, "PrecomputedRay requires AABB::max_ to follow AABB::min_");
+
+#if defined(MATH_SIMD_SSE)
+
+int intersectAABBPacket(const PrecomputedRay &ray, const AABBPacket4 &boxes, float tMax, float tNear[4])
+{
+    __m128 t0 = _mm_setzero_ps();
+    __m128 t1 = _mm_set1_ps(tMax);
+    for (int i = 0; i < 3; ++i)
+    {
+        __m128 origin = _mm_set1_ps(ray.origin_[i]);
+        __m128 invDir = _mm_set1_ps(ray.invDirection_[i]);
+        __m128 tA = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(boxes.bounds[ray.sign_[i]][i]), origin), invDir);
+        __m128 tB = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(boxes.bounds[1 - ray.sign_[i]][i]), origin), invDir);
+
+        // maxps/minps在有NaN时返回第二个操作数，与标量版本的写法一致
+        t0 = _mm_max_ps(tA, t0);
+        t1 = _mm_min_ps(tB, t1);
+    }
+    _mm_storeu_ps(tNear, t0);
+    return _mm_movemask_ps(_mm_cmple_ps(t0, t1));
+}
+
+#else
+
+int intersectAABBPacket(const PrecomputedRay &ray, const AABBPacket4 &boxes, float tMax, float tNear[4])
+{
+    int mask = 0;
+    for (int lane = 0; lane < 4; ++lane)
+    {
+        float t0 = 0.0f;
+        float t1 = tMax;
+        for (int i = 0; i < 3; ++i)
+        {
+            float tA = (boxes.bounds[ray.sign_[i]][i][lane] - ray.origin_[i]) * ray.invDirection_[i];
+            float tB = (boxes.bounds[1 - ray.sign_[i]][i][lane] - ray.origin_[i]) * ray.invDirection_[i];
+            t0 = tA > t0 ? tA : t0;
+            t1 = tB < t1 ? tB : t1;
+        }
+        tNear[lane] = t0;
+        if (t0 <= t1)
+        {
+            mask |= 1 << lane;
+        }
+    }
+    return mask;
+}
+
+#endif
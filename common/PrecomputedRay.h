@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Ray.h"
+#include "AABB.h"
+#include <float.h>
+
+/** 预先计算了方向倒数和方向符号的射线。用于大量的射线与包围盒求交，比如BVH遍历。
+ *  每条射线只需要计算一次倒数，之后的slab测试只有乘法和min/max，没有除法和分支。
+ */
+class PrecomputedRay
+{
+public:
+    Vector3 origin_;
+    Vector3 direction_;
+    /// 方向的倒数。分量为0时是正负无穷
+    Vector3 invDirection_;
+    /// 方向分量是否为负(包括-0)。为1时，该轴先进入max平面，再离开min平面
+    int     sign_[3];
+
+    PrecomputedRay(){}
+    explicit PrecomputedRay(const Ray &ray) { set(ray); }
+
+    void set(const Ray &ray)
+    {
+        origin_ = ray.origin_;
+        direction_ = ray.direction_;
+        for (int i = 0; i < 3; ++i)
+        {
+            invDirection_[i] = 1.0f / direction_[i];
+            sign_[i] = invDirection_[i] < 0.0f ? 1 : 0;
+        }
+    }
+
+    /** slab测试。求交的区间限制在[0, tMax]之内。
+     *  @param tNear    射线进入包围盒的距离。起点在包围盒内，返回0。
+     *  @param tFar     射线离开包围盒的距离，不超过tMax。
+     */
+    bool intersectAABB(const AABB &ab, float tMax, float &tNear, float &tFar) const
+    {
+        // AABB的min_和max_是连续存放的，用符号位直接选出先进入和后离开的平面
+        const Vector3 *bounds = &ab.min_;
+
+        float t0 = 0.0f;
+        float t1 = tMax;
+        for (int i = 0; i < 3; ++i)
+        {
+            float tA = (bounds[sign_[i]][i] - origin_[i]) * invDirection_[i];
+            float tB = (bounds[1 - sign_[i]][i] - origin_[i]) * invDirection_[i];
+
+            // 写成这种形式，可以忽略掉NaN(射线起点恰好在slab平面上，并且方向与平面平行)
+            t0 = tA > t0 ? tA : t0;
+            t1 = tB < t1 ? tB : t1;
+        }
+        tNear = t0;
+        tFar = t1;
+        return t0 <= t1;
+    }
+
+    bool intersectAABB(const AABB &ab, float tMax = FLT_MAX) const
+    {
+        float tNear, tFar;
+        return intersectAABB(ab, tMax, tNear, tFar);
+    }
+};
+
+/** 4个包围盒打包成SoA布局，用于一条射线同时测试4个包围盒(比如4叉BVH的子结点)。
+ *  未使用的通道是反转的空包围盒，永远不会相交。
+ */
+struct alignas(16) AABBPacket4
+{
+    /// bounds[0]为min，bounds[1]为max。bounds[0][0]为4个包围盒min的x分量，以此类推
+    float   bounds[2][3][4];
+
+    AABBPacket4()
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            setEmpty(i);
+        }
+    }
+
+    void setAABB(int lane, const AABB &ab)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            bounds[0][k][lane] = ab.min_[k];
+            bounds[1][k][lane] = ab.max_[k];
+        }
+    }
+
+    void setEmpty(int lane)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            bounds[0][k][lane] = FLT_MAX;
+            bounds[1][k][lane] = -FLT_MAX;
+        }
+    }
+};
+
+/** 一条射线与4个包围盒做slab测试，结果与PrecomputedRay::intersectAABB逐位相同。
+ *  @param tNear    每个包围盒的进入距离。只有相交的通道是有效的。
+ *  @return 相交的掩码，第i位对应第i个包围盒。
+ */
+int intersectAABBPacket(const PrecomputedRay &ray, const AABBPacket4 &boxes, float tMax, float tNear[4]);
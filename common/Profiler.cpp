@@ -0,0 +1,465 @@
+#include "Profiler.h"
+#include "glconfig.h"
+#include "LogTool.h"
+#include "DebugDraw.h"
+#include "Renderer.h"
+#include "Color.h"
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cassert>
+
+IMPLEMENT_SINGLETON(Profiler);
+
+const size_t Profiler::InvalidQuery;
+
+namespace
+{
+    /// 每次创建Profiler都递增，用来判断线程局部的缓冲区指针是否属于当前的Profiler
+    uint32_t s_generation = 0;
+
+    thread_local void*      t_buffer = nullptr;
+    thread_local uint32_t   t_generation = 0;
+
+    void writeJSONString(FILE *fp, const char *str)
+    {
+        fputc('"', fp);
+        for(; *str != '\0'; ++str)
+        {
+            if(*str == '"' || *str == '\\')
+            {
+                fputc('\\', fp);
+            }
+            fputc(*str, fp);
+        }
+        fputc('"', fp);
+    }
+
+    /** 由名字生成一个稳定的颜色。*/
+    Color nameToColor(const char *name, bool gpu)
+    {
+        uint32_t hash = 2166136261u;
+        for(; *name != '\0'; ++name)
+        {
+            hash = (hash ^ uint8_t(*name)) * 16777619u;
+        }
+        float r = 0.35f + (hash & 0xff) / 255.0f * 0.65f;
+        float g = 0.35f + ((hash >> 8) & 0xff) / 255.0f * 0.65f;
+        float b = 0.35f + ((hash >> 16) & 0xff) / 255.0f * 0.65f;
+        if(gpu)
+        {
+            return Color(r * 0.4f, g * 0.6f, 1.0f);
+        }
+        return Color(r, g, b * 0.5f);
+    }
+}
+
+Profiler::Profiler()
+    : enable_(true)
+    , gpuEnable_(false)
+    , capturing_(false)
+    , generation_(++s_generation)
+    , mainThread_(std::this_thread::get_id())
+    , dropped_(0)
+    , frameTimes_(HistoryFrames, 0.0f)
+    , frameIndex_(0)
+    , frameStart_(now())
+    , gpuQueryBase_(0)
+    , captureStart_(0)
+{
+    setThreadName("Main");
+}
+
+Profiler::~Profiler()
+{
+    if(!allQueries_.empty() && glDeleteQueries != nullptr)
+    {
+        glDeleteQueries(GLsizei(allQueries_.size()), allQueries_.data());
+    }
+}
+
+/*static*/ uint64_t Profiler::now()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::setGPUEnable(bool enable)
+{
+    gpuEnable_ = enable && glQueryCounter != nullptr && glGetQueryObjectui64v != nullptr;
+}
+
+void Profiler::setThreadName(const char *name)
+{
+    getThreadBuffer()->name = name;
+}
+
+Profiler::ThreadBuffer* Profiler::getThreadBuffer()
+{
+    if(t_buffer != nullptr && t_generation == generation_)
+    {
+        return static_cast<ThreadBuffer*>(t_buffer);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    ThreadBuffer *buffer = new ThreadBuffer();
+    buffer->events.resize(ThreadBufferSize);
+    buffer->head = 0;
+    buffer->tail = 0;
+    buffer->index = uint16_t(threads_.size());
+    buffer->depth = 0;
+    buffer->name = nullptr;
+    threads_.push_back(std::unique_ptr<ThreadBuffer>(buffer));
+
+    t_buffer = buffer;
+    t_generation = generation_;
+    return buffer;
+}
+
+void Profiler::endFrame()
+{
+    assert(std::this_thread::get_id() == mainThread_);
+
+    uint64_t time = now();
+    size_t slot = size_t(frameIndex_ % HistoryFrames);
+    frameTimes_[slot] = float((time - frameStart_) * 1e-6);
+    frameStart_ = time;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for(auto &buffer : threads_)
+        {
+            uint32_t tail = buffer->tail.load(std::memory_order_relaxed);
+            uint32_t head = buffer->head.load(std::memory_order_acquire);
+            for(; tail != head; ++tail)
+            {
+                addEvent(buffer->events[tail & (ThreadBufferSize - 1)], false);
+            }
+            buffer->tail.store(tail, std::memory_order_release);
+        }
+    }
+
+    resolveGPUQueries();
+
+    for(Scope &scope : scopes_)
+    {
+        scope.history[slot] = float(scope.frameTime * 1e-6);
+        scope.calls[slot] = uint16_t(std::min<uint32_t>(scope.frameCalls, 0xffff));
+        scope.frameTime = 0.0;
+        scope.frameCalls = 0;
+    }
+    ++frameIndex_;
+}
+
+void Profiler::addEvent(const Event &e, bool gpu)
+{
+    Scope &scope = findScope(e.name, gpu);
+    scope.frameTime += double(e.end - e.start);
+    ++scope.frameCalls;
+
+    if(capturing_ && e.start >= captureStart_ && captured_.size() < MaxCaptureEvents)
+    {
+        captured_.push_back(e);
+    }
+}
+
+Profiler::Scope& Profiler::findScope(const char *name, bool gpu)
+{
+    for(Scope &scope : scopes_)
+    {
+        if(scope.name == name && scope.gpu == gpu)
+        {
+            return scope;
+        }
+    }
+
+    // 新出现的作用域，之前的帧都记为0
+    Scope scope = Scope();
+    scope.name = name;
+    scope.gpu = gpu;
+    scopes_.push_back(scope);
+    return scopes_.back();
+}
+
+size_t Profiler::beginGPUScope(const char *name, uint16_t depth)
+{
+    if(!gpuEnable_ || std::this_thread::get_id() != mainThread_)
+    {
+        return InvalidQuery;
+    }
+
+    if(freeQueries_.size() < 2)
+    {
+        GLuint queries[16];
+        glGenQueries(16, queries);
+        freeQueries_.insert(freeQueries_.end(), queries, queries + 16);
+        allQueries_.insert(allQueries_.end(), queries, queries + 16);
+    }
+
+    GPUQuery query;
+    query.name = name;
+    query.queries[0] = freeQueries_.back();
+    freeQueries_.pop_back();
+    query.queries[1] = freeQueries_.back();
+    freeQueries_.pop_back();
+    query.frame = frameIndex_;
+    query.cpuStart = now();
+    query.depth = depth;
+    query.ended = false;
+
+    glQueryCounter(query.queries[0], GL_TIMESTAMP);
+    gpuQueries_.push_back(query);
+    return gpuQueryBase_ + gpuQueries_.size() - 1;
+}
+
+void Profiler::endGPUScope(size_t index)
+{
+    GPUQuery &query = gpuQueries_[index - gpuQueryBase_];
+    glQueryCounter(query.queries[1], GL_TIMESTAMP);
+    query.ended = true;
+}
+
+void Profiler::resolveGPUQueries()
+{
+    // 按发起的顺序读取，遇到还没有结果的就停下，留到下一帧
+    size_t n = 0;
+    uint64_t offsetFrame = uint64_t(-1);
+    int64_t offset = 0;
+    for(; n < gpuQueries_.size(); ++n)
+    {
+        GPUQuery &query = gpuQueries_[n];
+        if(!query.ended)
+        {
+            break;
+        }
+
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(query.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if(available != GL_TRUE)
+        {
+            break;
+        }
+
+        GLuint64 start, end;
+        glGetQueryObjectui64v(query.queries[0], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(query.queries[1], GL_QUERY_RESULT, &end);
+
+        // GPU时钟与CPU时钟无关，每帧用第一个查询的CPU发起时间对齐
+        if(query.frame != offsetFrame)
+        {
+            offsetFrame = query.frame;
+            offset = int64_t(query.cpuStart) - int64_t(start);
+        }
+        Event e = { query.name, uint64_t(int64_t(start) + offset), uint64_t(int64_t(end) + offset),
+            query.depth, uint16_t(GPUThread) };
+        addEvent(e, true);
+
+        freeQueries_.push_back(query.queries[0]);
+        freeQueries_.push_back(query.queries[1]);
+    }
+
+    gpuQueries_.erase(gpuQueries_.begin(), gpuQueries_.begin() + n);
+    gpuQueryBase_ += n;
+}
+
+size_t Profiler::getHistorySize() const
+{
+    return size_t(std::min<uint64_t>(frameIndex_, HistoryFrames));
+}
+
+bool Profiler::getScopeStats(const char *name, bool gpu, ScopeStats &stats) const
+{
+    for(const Scope &scope : scopes_)
+    {
+        if(scope.name == name && scope.gpu == gpu)
+        {
+            computeStats(scope.history, scope.calls, getHistorySize(), stats);
+            stats.name = name;
+            stats.gpu = gpu;
+            return true;
+        }
+    }
+    return false;
+}
+
+Profiler::ScopeStats Profiler::getFrameStats() const
+{
+    ScopeStats stats;
+    computeStats(frameTimes_.data(), nullptr, getHistorySize(), stats);
+    stats.name = "Frame";
+    stats.gpu = false;
+    return stats;
+}
+
+/*static*/ void Profiler::computeStats(const float *history, const uint16_t *calls, size_t n, ScopeStats &stats)
+{
+    stats.avg = stats.p95 = stats.max = 0.0f;
+    stats.calls = calls != nullptr ? 0.0f : 1.0f;
+    if(n == 0)
+    {
+        return;
+    }
+
+    std::vector<float> times(history, history + n);
+    double sum = 0.0;
+    size_t nCalls = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+        sum += times[i];
+        stats.max = std::max(stats.max, times[i]);
+        nCalls += calls != nullptr ? calls[i] : 1;
+    }
+    stats.avg = float(sum / n);
+    stats.calls = float(nCalls) / n;
+
+    size_t k = size_t(std::ceil(n * 0.95)) - 1;
+    std::nth_element(times.begin(), times.begin() + k, times.end());
+    stats.p95 = times[k];
+}
+
+void Profiler::getStats(std::vector<ScopeStats> &stats) const
+{
+    stats.resize(scopes_.size());
+    for(size_t i = 0; i < scopes_.size(); ++i)
+    {
+        computeStats(scopes_[i].history, scopes_[i].calls, getHistorySize(), stats[i]);
+        stats[i].name = scopes_[i].name;
+        stats[i].gpu = scopes_[i].gpu;
+    }
+    std::sort(stats.begin(), stats.end(), [](const ScopeStats &a, const ScopeStats &b)
+    {
+        return a.avg > b.avg;
+    });
+}
+
+void Profiler::beginCapture()
+{
+    captured_.clear();
+    captureStart_ = now();
+    capturing_ = true;
+}
+
+void Profiler::endCapture()
+{
+    capturing_ = false;
+}
+
+bool Profiler::saveChromeTrace(const std::string &fileName) const
+{
+    FILE *fp = fopen(fileName.c_str(), "w");
+    if(fp == nullptr)
+    {
+        LOG_ERROR("Failed to open '%s'", fileName.c_str());
+        return false;
+    }
+
+    fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for(const auto &buffer : threads_)
+        {
+            char name[32];
+            snprintf(name, sizeof(name), "Thread %d", int(buffer->index));
+            fprintf(fp, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": %d, \"args\": {\"name\": ", int(buffer->index));
+            writeJSONString(fp, buffer->name != nullptr ? buffer->name : name);
+            fprintf(fp, "}},\n");
+        }
+    }
+    fprintf(fp, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": %d, \"args\": {\"name\": \"GPU\"}}", int(GPUThread));
+
+    for(const Event &e : captured_)
+    {
+        // 时间单位为微秒
+        double ts = (double(int64_t(e.start - captureStart_))) * 1e-3;
+        double dur = double(e.end - e.start) * 1e-3;
+        fprintf(fp, ",\n{\"name\": ");
+        writeJSONString(fp, e.name);
+        fprintf(fp, ", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 0, \"tid\": %d}",
+            e.thread == GPUThread ? "gpu" : "cpu", ts, dur, int(e.thread));
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+    return true;
+}
+
+void Profiler::dumpStats() const
+{
+    ScopeStats frame = getFrameStats();
+    LOG_INFO("Frame: avg %.3fms, p95 %.3fms, max %.3fms, dropped events %d",
+        frame.avg, frame.p95, frame.max, int(dropped_));
+
+    std::vector<ScopeStats> stats;
+    getStats(stats);
+    for(const ScopeStats &s : stats)
+    {
+        LOG_INFO("  %s%s: avg %.3fms, p95 %.3fms, max %.3fms, calls %.1f",
+            s.gpu ? "[GPU] " : "", s.name, s.avg, s.p95, s.max, s.calls);
+    }
+}
+
+void Profiler::drawOverlay(Renderer *renderer) const
+{
+    if(!DebugDraw::hasInstance())
+    {
+        return;
+    }
+
+    // DebugDraw在世界空间中绘制，把屏幕坐标反投影到近平面上
+    renderer->applyCameraMatrix();
+    Matrix invViewProj;
+    if(!invViewProj.invert(renderer->getViewProjMatrix()))
+    {
+        return;
+    }
+    DebugDraw *debugDraw = DebugDraw::instance();
+    DebugDraw::DepthMode depthMode = debugDraw->getDepthMode();
+    debugDraw->setDepthMode(DebugDraw::NoDepthTest);
+    auto drawRect = [&](float x0, float y0, float x1, float y1, const Color &color)
+    {
+        Vector3 a = invViewProj.transformPoint(Vector3(x0, y0, -0.999f));
+        Vector3 b = invViewProj.transformPoint(Vector3(x1, y0, -0.999f));
+        Vector3 c = invViewProj.transformPoint(Vector3(x1, y1, -0.999f));
+        Vector3 d = invViewProj.transformPoint(Vector3(x0, y1, -0.999f));
+        debugDraw->drawFilledTriangle(a, b, c, color);
+        debugDraw->drawFilledTriangle(a, c, d, color);
+    };
+
+    const size_t maxRows = 16;
+    const float left = -0.98f;
+    const float top = 0.96f;
+    const float rowHeight = 0.04f;
+    const float barHeight = 0.03f;
+    const float width = 0.8f;
+    const float fullScale = 33.3f;
+
+    std::vector<ScopeStats> stats;
+    getStats(stats);
+    stats.insert(stats.begin(), getFrameStats());
+    if(stats.size() > maxRows + 1)
+    {
+        stats.resize(maxRows + 1);
+    }
+
+    float bottom = top - rowHeight * stats.size();
+    drawRect(left - 0.01f, bottom - 0.01f, left + width + 0.01f, top + 0.01f, Color(0.0f, 0.0f, 0.0f));
+    for(size_t i = 0; i < stats.size(); ++i)
+    {
+        const ScopeStats &s = stats[i];
+        float y1 = top - rowHeight * i;
+        float y0 = y1 - barHeight;
+        Color color = i == 0 ? Color(0.8f, 0.8f, 0.8f) : nameToColor(s.name, s.gpu);
+
+        float avg = std::min(s.avg / fullScale, 1.0f) * width;
+        float p95 = std::min(s.p95 / fullScale, 1.0f) * width;
+        float max = std::min(s.max / fullScale, 1.0f) * width;
+        drawRect(left, y0, left + std::max(avg, 0.002f), y1, color);
+        drawRect(left + p95 - 0.002f, y0, left + p95 + 0.002f, y1, color);
+        drawRect(left + max - 0.004f, y0 + barHeight * 0.35f, left + max + 0.004f, y1 - barHeight * 0.35f, color);
+    }
+
+    // 16.6ms的参考线
+    float budget = left + 16.6f / fullScale * width;
+    drawRect(budget - 0.001f, bottom, budget + 0.001f, top, Color(1.0f, 0.2f, 0.2f));
+    debugDraw->setDepthMode(depthMode);
+}
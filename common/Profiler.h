@@ -0,0 +1,276 @@
+#pragma once
+
+#include "Singleton.h"
+#include <vector>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <cstdint>
+
+/** PROFILER_ENABLE为0时，PROFILE_*宏展开为空，不产生任何开销。
+ *  默认只在Debug下开启，Release下需要分析时，用cmake -DUSE_PROFILER=ON打开。
+ */
+#ifndef PROFILER_ENABLE
+#   ifdef NDEBUG
+#       define PROFILER_ENABLE 0
+#   else
+#       define PROFILER_ENABLE 1
+#   endif
+#endif
+
+class Renderer;
+
+/** 帧分析器。
+ *  PROFILE_SCOPE在作用域结束时记录一个事件(名字、开始和结束时间、嵌套深度)，写入当前线程自己的环形缓冲区，
+ *  写入不加锁。endFrame在主线程中取走所有线程的事件，累计每个作用域在这一帧中的总耗时，
+ *  并保留最近HistoryFrames帧，用来计算平均值、95分位和最大值。
+ *
+ *  PROFILE_GPU_SCOPE额外在GL命令流中插入两个时间戳查询，结果在几帧之后可用时再读取，不会阻塞。
+ *  GPU计时默认关闭，只能在创建Profiler的线程(GL线程)中使用。
+ *
+ *  作用域的名字必须是字符串常量，统计时按指针区分。同名的作用域递归嵌套时，耗时会重复累计。
+ *  开始捕获后，所有事件会保留下来，可以导出为Chrome的trace格式(chrome://tracing或Perfetto中打开)。
+ */
+class Profiler : public Singleton<Profiler>
+{
+public:
+    enum
+    {
+        /// 统计窗口的帧数
+        HistoryFrames = 120,
+        /// 每个线程缓冲区可以容纳的事件数量，写满之后的事件被丢弃
+        ThreadBufferSize = 1 << 14,
+        /// 捕获的事件数量上限
+        MaxCaptureEvents = 1 << 22,
+        /// GPU事件在trace中的线程号
+        GPUThread = 0xffff,
+    };
+
+    static const size_t InvalidQuery = size_t(-1);
+
+    struct Event
+    {
+        const char* name;
+        /// 纳秒
+        uint64_t    start;
+        uint64_t    end;
+        uint16_t    depth;
+        uint16_t    thread;
+    };
+
+    /** 一个作用域最近HistoryFrames帧的统计，时间单位为毫秒，是每帧中所有调用的总和。*/
+    struct ScopeStats
+    {
+        const char* name;
+        bool        gpu;
+        float       avg;
+        float       p95;
+        float       max;
+        /// 平均每帧的调用次数
+        float       calls;
+    };
+
+    Profiler();
+    ~Profiler();
+
+    /** 单调时钟，纳秒。*/
+    static uint64_t now();
+
+    /** 关闭后作用域不再记录事件。默认开启。*/
+    void setEnable(bool enable){ enable_ = enable; }
+    bool isEnable() const { return enable_; }
+
+    /** 开启GPU计时。需要GL 3.3或ARB_timer_query。*/
+    void setGPUEnable(bool enable);
+    bool isGPUEnable() const { return gpuEnable_; }
+
+    /** 设置当前线程在trace中显示的名字。name需要一直有效。*/
+    void setThreadName(const char *name);
+
+    /** 在主线程中每帧调用一次，通常在交换缓冲区之后。*/
+    void endFrame();
+    uint64_t getFrameIndex() const { return frameIndex_; }
+
+    /** 按平均耗时从大到小排序。*/
+    void getStats(std::vector<ScopeStats> &stats) const;
+    bool getScopeStats(const char *name, bool gpu, ScopeStats &stats) const;
+    /** 两次endFrame之间的时间。*/
+    ScopeStats getFrameStats() const;
+
+    /** 缓冲区写满而丢弃的事件数量。*/
+    size_t getDroppedEvents() const { return dropped_; }
+
+    void beginCapture();
+    void endCapture();
+    bool isCapturing() const { return capturing_; }
+    const std::vector<Event>& getCapturedEvents() const { return captured_; }
+
+    /** 把捕获的事件保存为Chrome trace-event格式的json。*/
+    bool saveChromeTrace(const std::string &fileName) const;
+
+    /** 输出每个作用域的统计。*/
+    void dumpStats() const;
+
+    /** 用DebugDraw在屏幕左上角画出各个作用域的耗时条，满格为33ms。
+     *  每行是一个作用域，按平均耗时排序：实心条为平均值，细线为95分位，末端的点为最大值。GPU作用域的颜色偏蓝。
+     *  需要在DebugDraw::draw之前调用。
+     */
+    void drawOverlay(Renderer *renderer) const;
+
+private:
+    friend class ProfileScope;
+    friend class GPUProfileScope;
+
+    /** 单生产者单消费者的环形缓冲区。生产者是所属的线程，消费者是endFrame。*/
+    struct ThreadBuffer
+    {
+        std::vector<Event>      events;
+        std::atomic<uint32_t>   head;
+        std::atomic<uint32_t>   tail;
+        uint16_t                index;
+        uint16_t                depth;
+        const char*             name;
+    };
+
+    struct Scope
+    {
+        const char* name;
+        bool        gpu;
+        double      frameTime;
+        uint32_t    frameCalls;
+        float       history[HistoryFrames];
+        uint16_t    calls[HistoryFrames];
+    };
+
+    struct GPUQuery
+    {
+        const char* name;
+        uint32_t    queries[2];
+        uint64_t    frame;
+        uint64_t    cpuStart;
+        uint16_t    depth;
+        bool        ended;
+    };
+
+    ThreadBuffer* getThreadBuffer();
+
+    ThreadBuffer* beginScope()
+    {
+        if(!enable_)
+        {
+            return nullptr;
+        }
+        ThreadBuffer *buffer = getThreadBuffer();
+        ++buffer->depth;
+        return buffer;
+    }
+
+    void endScope(ThreadBuffer *buffer, const char *name, uint64_t start)
+    {
+        Event e = { name, start, now(), uint16_t(--buffer->depth), buffer->index };
+        uint32_t head = buffer->head.load(std::memory_order_relaxed);
+        if(head - buffer->tail.load(std::memory_order_acquire) >= ThreadBufferSize)
+        {
+            ++dropped_;
+            return;
+        }
+        buffer->events[head & (ThreadBufferSize - 1)] = e;
+        buffer->head.store(head + 1, std::memory_order_release);
+    }
+
+    /** 返回查询的序号，不能计时时返回InvalidQuery。*/
+    size_t beginGPUScope(const char *name, uint16_t depth);
+    void endGPUScope(size_t index);
+    void resolveGPUQueries();
+
+    void addEvent(const Event &e, bool gpu);
+    Scope& findScope(const char *name, bool gpu);
+    /** 统计窗口中已经结束的帧数。*/
+    size_t getHistorySize() const;
+    static void computeStats(const float *history, const uint16_t *calls, size_t n, ScopeStats &stats);
+
+    bool        enable_;
+    bool        gpuEnable_;
+    bool        capturing_;
+    uint32_t    generation_;
+    std::thread::id mainThread_;
+
+    mutable std::mutex  mutex_;
+    std::vector<std::unique_ptr<ThreadBuffer>> threads_;
+    std::atomic<size_t> dropped_;
+
+    std::vector<Scope>  scopes_;
+    std::vector<float>  frameTimes_;
+    uint64_t    frameIndex_;
+    uint64_t    frameStart_;
+
+    /// 按发起顺序排列，gpuQueryBase_为第一个元素的序号
+    std::vector<GPUQuery>   gpuQueries_;
+    size_t      gpuQueryBase_;
+    std::vector<uint32_t>   freeQueries_;
+    std::vector<uint32_t>   allQueries_;
+
+    std::vector<Event>  captured_;
+    uint64_t    captureStart_;
+};
+
+/** 记录所在作用域的CPU耗时。使用PROFILE_SCOPE宏，不要直接使用。*/
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char *name)
+        : name_(name)
+        , buffer_(Profiler::hasInstance() ? Profiler::instance()->beginScope() : nullptr)
+        , start_(buffer_ != nullptr ? Profiler::now() : 0)
+    {
+    }
+
+    ~ProfileScope()
+    {
+        if(buffer_ != nullptr)
+        {
+            Profiler::instance()->endScope(buffer_, name_, start_);
+        }
+    }
+
+protected:
+    const char*     name_;
+    Profiler::ThreadBuffer* buffer_;
+    uint64_t        start_;
+};
+
+/** 同时记录CPU和GPU耗时。*/
+class GPUProfileScope : public ProfileScope
+{
+public:
+    explicit GPUProfileScope(const char *name)
+        : ProfileScope(name)
+        , query_(buffer_ != nullptr ? Profiler::instance()->beginGPUScope(name, buffer_->depth - 1) : Profiler::InvalidQuery)
+    {
+    }
+
+    ~GPUProfileScope()
+    {
+        if(query_ != Profiler::InvalidQuery)
+        {
+            Profiler::instance()->endGPUScope(query_);
+        }
+    }
+
+private:
+    size_t  query_;
+};
+
+#if PROFILER_ENABLE
+#   define PROFILE_CONCAT_IMPL(A, B) A##B
+#   define PROFILE_CONCAT(A, B) PROFILE_CONCAT_IMPL(A, B)
+#   define PROFILE_SCOPE(NAME) ProfileScope PROFILE_CONCAT(profileScope_, __LINE__)(NAME)
+#   define PROFILE_GPU_SCOPE(NAME) GPUProfileScope PROFILE_CONCAT(profileScope_, __LINE__)(NAME)
+#   define PROFILE_END_FRAME() do { if(Profiler::hasInstance()) Profiler::instance()->endFrame(); } while(0)
+#else
+#   define PROFILE_SCOPE(NAME)
+#   define PROFILE_GPU_SCOPE(NAME)
+#   define PROFILE_END_FRAME()
+#endif
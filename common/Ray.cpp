@@ -1,6 +1,7 @@
 ﻿#include "Ray.h"
 #include "AABB.h"
 #include "Matrix.h"
+#include "PrecomputedRay.h"
 #include <float.h>
 
 // 算法参考：http://www.cnblogs.com/graphics/archive/2010/08/09/1795348.html
@@ -91,59 +92,17 @@ bool Ray::intersectTriangle(const Vector3 &a, const Vector3 &b, const Vector3 &c
 
 bool Ray::intersectAABB(const AABB &ab, float *distance) const
 {
-    Vector3 base(0.0f, 0.0f, 0.0f);
-    int couter = 0;
+    // slab测试。起点在包围盒内时，进入距离被截断为0
+    PrecomputedRay ray(*this);
 
-    for (int i = 0; i < 3; ++i)
+    float tNear, tFar;
+    if (!ray.intersectAABB(ab, FLT_MAX, tNear, tFar))
     {
-        if (origin_[i] <= ab.min_[i])
-        {
-            base[i] = ab.min_[i];
-        }
-        else if (origin_[i] >= ab.max_[i])
-        {
-            base[i] = ab.max_[i];
-        }
-        else //该方向在包围盒里
-        {
-            couter++;
-            float offset_min_v = origin_[i] - ab.min_[i];
-            float offset_max_v = ab.max_[i] - origin_[i];
-            base[i] = (offset_min_v < offset_max_v) ? ab.min_[i] : ab.max_[i];
-        }
-    }
-
-    if (couter == 3) //起点在包围盒里
-    {
-        if(distance) *distance = 0.0f;
-        return true;
+        return false;
     }
 
-    Vector3 ptOnPlane;
-    for (int axis = 0; axis < 3; axis++)
-    {
-        if (fabs(direction_[axis]) > FLT_EPSILON)
-        {
-            float t = (base[axis] - origin_[axis]) / direction_[axis];
-            if (t > 0.f)
-            {
-                ptOnPlane = origin_ + direction_ * t;
-
-                int nextAxis = (axis + 1) % 3;
-                int prevAxis = (axis + 2) % 3;
-
-                if (ab.min_[nextAxis] < ptOnPlane[nextAxis] &&
-                    ptOnPlane[nextAxis] < ab.max_[nextAxis] &&
-                    ab.min_[prevAxis] < ptOnPlane[prevAxis] &&
-                    ptOnPlane[prevAxis] < ab.max_[prevAxis])
-                {
-                    if(distance) *distance = t;
-                    return true;
-                }
-            }
-        }
-    }
-    return false;
+    if(distance) *distance = tNear;
+    return true;
 }
 
 bool Ray::intersectSphere(const Vector3 &center, float radius, float *out1, float *out2) const
@@ -0,0 +1,371 @@
+#include "RenderQueue.h"
+#include "Renderer.h"
+#include "Mesh.h"
+#include "Material.h"
+#include "ShaderProgram.h"
+#include "GLStateCache.h"
+#include "InstanceBuffer.h"
+#include "glconfig.h"
+#include "Profiler.h"
+#include <cstring>
+#include <algorithm>
+
+RenderQueue::RenderQueue()
+    : sorted_(true)
+    , lastMesh_(nullptr)
+{
+    resetStats();
+}
+
+RenderQueue::~RenderQueue()
+{
+}
+
+void RenderQueue::resetStats()
+{
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+/*static*/ uint32_t RenderQueue::quantizeDepth(float depth)
+{
+    // 非负浮点数的位模式与数值的大小顺序一致，取高16位(符号位为0)即可
+    if (!(depth > 0.0f))
+    {
+        return 0;
+    }
+
+    uint32_t bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    return bits >> 15;
+}
+
+/*static*/ uint64_t RenderQueue::makeKey(Pass pass, uint32_t shader, uint32_t textureSet, uint32_t material, uint32_t mesh, float depth)
+{
+    uint64_t depthBits = quantizeDepth(depth);
+    uint64_t state = (uint64_t(shader & 0x3ff) << 22) | (uint64_t(textureSet & 0x3ff) << 12) | uint64_t(material & 0xfff);
+
+    uint64_t key = uint64_t(pass) << 62;
+    if (pass == PASS_TRANSPARENT)
+    {
+        // 从后往前：深度取反后放在最高位
+        key |= ((~depthBits & 0xffff) << 46) | (state << 14);
+        return key | (mesh & 0x3fff);
+    }
+
+    // 从前往后：同一个指数范围内先按模型分组，再按深度的低位排序
+    return key | (state << 30) | ((depthBits >> 8) << 22) | (uint64_t(mesh & 0x3fff) << 8) | (depthBits & 0xff);
+}
+
+void RenderQueue::add(Mesh *mesh, SubMesh *subMesh, Material *material, const Matrix &world, const Matrix &view,
+    const Color &color)
+{
+    Item item;
+    item.world_ = world;
+    item.mesh_ = mesh;
+    item.subMesh_ = subMesh;
+    item.material_ = material;
+    item.color_ = color;
+
+    // 以模型的原点作为深度
+    float depth = world._41 * view._13 + world._42 * view._23 + world._43 * view._33 + view._43;
+
+    // 实例化绘制时，不透明物体放弃从前往后的顺序，让同一个模型的拷贝排在一起
+    ShaderProgram *shader = material->getShader().get();
+    bool transparent = material->isTransparent();
+    if (!transparent && shader->isInstanced())
+    {
+        depth = 0.0f;
+    }
+
+    // 乘法散列的高位分布更均匀
+    uint32_t textureSet = (material->getTextureSetID() * 2654435761u) >> 22;
+
+    Entry entry;
+    entry.key = makeKey(transparent ? PASS_TRANSPARENT : PASS_OPAQUE,
+        shader->getHandle(), textureSet, material->getSortID(), mesh->getSortID(), depth);
+    entry.index = (uint32_t)items_.size();
+
+    items_.push_back(item);
+    entries_.push_back(entry);
+    sorted_ = false;
+
+    ++stats_.nItems;
+    if (mesh != lastMesh_)
+    {
+        lastMesh_ = mesh;
+        ++stats_.nNaiveMeshBinds;
+    }
+}
+
+void RenderQueue::clear()
+{
+    items_.clear();
+    entries_.clear();
+    batches_.clear();
+    sorted_ = true;
+    lastMesh_ = nullptr;
+}
+
+void RenderQueue::sort()
+{
+    PROFILE_SCOPE("RenderQueue::sort");
+    if (sorted_)
+    {
+        return;
+    }
+    sorted_ = true;
+
+    size_t n = entries_.size();
+    if (n < 2)
+    {
+        return;
+    }
+
+    // 场景不变时，每帧提交的绘制项和排序键几乎相同。按上一帧排好的顺序取出排序键，已经有序时不需要再排序
+    temp_.resize(n);
+    if (lastOrder_.size() == n)
+    {
+        bool ordered = true;
+        for (size_t i = 0; i < n && ordered; ++i)
+        {
+            temp_[i] = entries_[lastOrder_[i]];
+            ordered = i == 0 || temp_[i - 1].key <= temp_[i].key;
+        }
+        if (ordered)
+        {
+            entries_.swap(temp_);
+            ++stats_.nReusedSorts;
+            return;
+        }
+    }
+
+    // LSD基数排序，每次8位。先一次性统计8个字节的直方图，所有元素都相同的字节直接跳过
+    size_t histograms[8][256];
+    memset(histograms, 0, sizeof(histograms));
+    for (const Entry &entry : entries_)
+    {
+        for (int b = 0; b < 8; ++b)
+        {
+            ++histograms[b][(entry.key >> (b * 8)) & 0xff];
+        }
+    }
+
+    Entry *src = entries_.data();
+    Entry *dst = temp_.data();
+    for (int b = 0; b < 8; ++b)
+    {
+        size_t *histogram = histograms[b];
+        if (histogram[(src[0].key >> (b * 8)) & 0xff] == n)
+        {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (int i = 0; i < 256; ++i)
+        {
+            size_t count = histogram[i];
+            histogram[i] = offset;
+            offset += count;
+        }
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            dst[histogram[(src[i].key >> (b * 8)) & 0xff]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+
+    if (src != entries_.data())
+    {
+        entries_.swap(temp_);
+    }
+
+    lastOrder_.resize(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        lastOrder_[i] = entries_[i].index;
+    }
+}
+
+bool RenderQueue::isSameInstance(const Item &a, const Item &b) const
+{
+    return a.subMesh_ == b.subMesh_ && a.material_ == b.material_ &&
+        a.mesh_->getSortID() == b.mesh_->getSortID();
+}
+
+void RenderQueue::buildBatches()
+{
+    batches_.clear();
+    if (instances_)
+    {
+        instances_->clear();
+    }
+
+    size_t n = entries_.size();
+    for (size_t i = 0; i < n; )
+    {
+        const Item &item = items_[entries_[i].index];
+        uint64_t key = entries_[i].key;
+
+        Batch batch;
+        batch.begin = (uint32_t)i;
+        batch.end = (uint32_t)i + 1;
+        batch.instance = NoInstance;
+
+        if (item.material_->getShader()->isInstanced())
+        {
+            if ((key >> 62) == PASS_OPAQUE)
+            {
+                size_t end = i + 1;
+                while (end < n && entries_[end].key == key)
+                {
+                    ++end;
+                }
+
+                // 排序键相同的绘制项中，同一个模型的不同子模型是交错的，按子模型和材质稳定排序
+                if (end - i > 2)
+                {
+                    std::stable_sort(entries_.begin() + i, entries_.begin() + end,
+                        [this](const Entry &a, const Entry &b)
+                    {
+                        const Item &ia = items_[a.index];
+                        const Item &ib = items_[b.index];
+                        if (ia.subMesh_ != ib.subMesh_)
+                        {
+                            return ia.subMesh_ < ib.subMesh_;
+                        }
+                        return ia.material_ < ib.material_;
+                    });
+                }
+
+                const Item &first = items_[entries_[i].index];
+                while (batch.end < end && isSameInstance(items_[entries_[batch.end].index], first))
+                {
+                    ++batch.end;
+                }
+            }
+
+            if (!instances_)
+            {
+                instances_ = new InstanceBuffer();
+            }
+            batch.instance = (uint32_t)instances_->size();
+            for (uint32_t k = batch.begin; k < batch.end; ++k)
+            {
+                const Item &instance = items_[entries_[k].index];
+                instances_->add(instance.world_, instance.color_);
+            }
+        }
+
+        batches_.push_back(batch);
+        i = batch.end;
+    }
+
+    if (instances_ && !instances_->empty())
+    {
+        instances_->upload();
+    }
+}
+
+void RenderQueue::flush(Renderer *renderer)
+{
+    PROFILE_GPU_SCOPE("RenderQueue::flush");
+    sort();
+    buildBatches();
+
+    Mesh *curMesh = nullptr;
+    ShaderProgram *curShader = nullptr;
+    Material *curMaterial = nullptr;
+    bool blending = false;
+
+    renderer->pushMatrix();
+    for (const Batch &batch : batches_)
+    {
+        const Entry &entry = entries_[batch.begin];
+        const Item &item = items_[entry.index];
+
+        if (!blending && (entry.key >> 62) == PASS_TRANSPARENT)
+        {
+            blending = true;
+            GLStateCache::instance()->enable(GL_BLEND);
+            GLStateCache::instance()->blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            renderer->setZWriteEnable(false);
+        }
+
+        if (curMesh == nullptr || item.mesh_->getSortID() != curMesh->getSortID())
+        {
+            if (curMesh != nullptr)
+            {
+                curMesh->unbindBuffers();
+            }
+            curMesh = item.mesh_->bindBuffers() ? item.mesh_ : nullptr;
+            if (curMesh == nullptr)
+            {
+                continue;
+            }
+            ++stats_.nMeshBinds;
+        }
+
+        ShaderProgram *shader = item.material_->getShader().get();
+        if (shader != curShader)
+        {
+            curShader = shader;
+            curShader->bind();
+            ++stats_.nShaderBinds;
+
+            // 纹理采样器的uniform是属于shader的，需要重新绑定
+            curMaterial = nullptr;
+        }
+
+        if (item.material_ != curMaterial)
+        {
+            curMaterial = item.material_;
+            curMaterial->bindTextures();
+            ++stats_.nMaterialBinds;
+        }
+
+        ++stats_.nDrawCalls;
+        if (batch.instance != NoInstance)
+        {
+            // 世界矩阵来自实例数据，自动uniform只需要每帧的部分
+            if (curMaterial->isAutoBindUniform())
+            {
+                curShader->applyAutoUniforms();
+            }
+
+            uint32_t count = batch.end - batch.begin;
+            instances_->bindAttributes(batch.instance);
+            item.subMesh_->drawInstanced(renderer, count);
+            instances_->unbindAttributes();
+
+            ++stats_.nInstancedBatches;
+            stats_.nInstances += count;
+            continue;
+        }
+
+        renderer->setWorldMatrix(item.world_);
+        if (curMaterial->isAutoBindUniform())
+        {
+            curShader->applyAutoUniforms();
+        }
+
+        item.subMesh_->draw(renderer);
+    }
+
+    if (curMesh != nullptr)
+    {
+        curMesh->unbindBuffers();
+    }
+    if (curShader != nullptr)
+    {
+        curShader->unbind();
+    }
+    if (blending)
+    {
+        GLStateCache::instance()->disable(GL_BLEND);
+        renderer->setZWriteEnable(true);
+    }
+    renderer->popMatrix();
+
+    clear();
+}
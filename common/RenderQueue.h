@@ -0,0 +1,132 @@
+#pragma once
+
+#include "Matrix.h"
+#include "Color.h"
+#include "SmartPointer.h"
+#include <vector>
+#include <cstdint>
+
+class Renderer;
+class Mesh;
+class SubMesh;
+class Material;
+class InstanceBuffer;
+
+/** 渲染队列。
+ *  Mesh::draw在渲染器设置了队列时，不直接绘制，而是为每个子模型提交一个带64位排序键的绘制项。
+ *  flush时用基数排序将绘制项排好序，相邻的绘制项之间只切换发生变化的状态(shader、纹理、顶点数组)。
+ *
+ *  排序键从高到低：
+ *  不透明物体  [pass:2][shader:10][纹理集合:10][材质:12][深度高8位:8][模型:14][深度低8位:8]，深度从前往后
+ *  半透明物体  [pass:2][深度:16][shader:10][纹理集合:10][材质:12][模型:14]，深度从后往前
+ *  深度的高8位是浮点数的指数。不透明物体在同一个数量级的深度内按模型分组，减少顶点数组的切换，
+ *  同一个模型的绘制项仍然从前往后。
+ *
+ *  绘制是延迟到flush时进行的，所以shader的自动变量(矩阵、相机等)使用的是flush时渲染器的状态，
+ *  切换相机或投影矩阵之前需要先flush。手动绑定的uniform是保存在shader中的，不受影响。
+ *
+ *  shader声明了实例属性(ShaderProgram::isInstanced)时，世界矩阵和颜色来自实例数据。
+ *  这类不透明的绘制项深度取0，同一个模型的多个拷贝排在一起，flush时合并成一次实例化绘制。
+ *  所有的实例数据在绘制前一次性上传。
+ */
+class RenderQueue
+{
+public:
+    enum Pass
+    {
+        PASS_OPAQUE = 0,
+        PASS_TRANSPARENT = 1,
+    };
+
+    struct Item
+    {
+        Matrix      world_;
+        Mesh*       mesh_;
+        SubMesh*    subMesh_;
+        Material*   material_;
+        Color       color_;
+    };
+
+    /** 状态切换的统计。naive为不使用队列时，逐个子模型绘制所需的切换次数。*/
+    struct Stats
+    {
+        size_t  nItems;
+        size_t  nShaderBinds;
+        size_t  nMaterialBinds;
+        size_t  nMeshBinds;
+        size_t  nNaiveMeshBinds;
+        size_t  nDrawCalls;
+        size_t  nInstancedBatches;
+        size_t  nInstances;
+        /// 沿用上一帧的顺序、没有重新排序的次数
+        size_t  nReusedSorts;
+    };
+
+    RenderQueue();
+    ~RenderQueue();
+
+    /** 提交一个绘制项。指针只在flush之前有效，调用者需要保证对象在此之前不被释放。
+     *  @param view 用于计算排序的深度。
+     *  @param color 实例颜色，只有实例化的shader使用。
+     */
+    void add(Mesh *mesh, SubMesh *subMesh, Material *material, const Matrix &world, const Matrix &view,
+        const Color &color = Color::White);
+
+    /** 排序并绘制所有的绘制项，然后清空队列。*/
+    void flush(Renderer *renderer);
+
+    void clear();
+
+    size_t size() const { return items_.size(); }
+    bool empty() const { return items_.empty(); }
+
+    /** 按排序键排序，flush会自动调用。
+     *  绘制项的数量与上一次排序时相同，且按上一次的顺序排列后排序键已经有序时，直接沿用这个顺序。
+     *  排序键相同的绘制项之间的先后顺序因此可能与提交的顺序不同。
+     */
+    void sort();
+
+    /** 排好序的绘制项下标。*/
+    const Item& getSortedItem(size_t i) const { return items_[entries_[i].index]; }
+    uint64_t getSortedKey(size_t i) const { return entries_[i].key; }
+
+    /** 累计的统计数据，直到调用resetStats。*/
+    const Stats& getStats() const { return stats_; }
+    void resetStats();
+
+    static uint64_t makeKey(Pass pass, uint32_t shader, uint32_t textureSet, uint32_t material, uint32_t mesh, float depth);
+
+    /** 将视空间深度量化为16位，保持大小顺序。*/
+    static uint32_t quantizeDepth(float depth);
+
+private:
+    struct Entry
+    {
+        uint64_t    key;
+        uint32_t    index;
+    };
+
+    /** 连续的一段绘制项[begin, end)。instance为实例数据的起始位置，NoInstance表示逐个绘制。*/
+    struct Batch
+    {
+        uint32_t    begin;
+        uint32_t    end;
+        uint32_t    instance;
+    };
+    enum { NoInstance = ~0u };
+
+    /** 将排好序的绘制项划分成批次，并收集实例数据。*/
+    void buildBatches();
+    bool isSameInstance(const Item &a, const Item &b) const;
+
+    std::vector<Item>   items_;
+    std::vector<Entry>  entries_;
+    std::vector<Entry>  temp_;
+    /// 上一次排序的结果，即排好序的绘制项下标
+    std::vector<uint32_t> lastOrder_;
+    std::vector<Batch>  batches_;
+    SmartPointer<InstanceBuffer> instances_;
+    bool                sorted_;
+    Mesh*               lastMesh_;
+    Stats               stats_;
+};
@@ -170,6 +170,8 @@ enum class BufferUsage
 {
     Static = GL_STATIC_DRAW,
     Dynamic = GL_DYNAMIC_DRAW,
+    /// 每帧整体重写的数据，更新时总是重新分配存储(orphan)
+    Stream = GL_STREAM_DRAW,
 };
 
 enum class IndexType
@@ -3,6 +3,11 @@
 #include "Camera.h"
 #include "glconfig.h"
 #include "Material.h"
+#include "GLStateCache.h"
+#include "AABB.h"
+#include "OcclusionCuller.h"
+#include "Profiler.h"
+#include <cstring>
 
 IMPLEMENT_SINGLETON(Renderer);
 
@@ -11,8 +16,9 @@ enum DirtyFlag
 	DF_WORLD_VIEW_PROJ = 1 << 0,
 	DF_WORLD_VIEW = 1 << 1,
 	DF_VIEW_PROJ = 1 << 2,
+	DF_FRUSTUM = 1 << 3,
 
-	DF_ALL = DF_WORLD_VIEW_PROJ | DF_WORLD_VIEW | DF_VIEW_PROJ,
+	DF_ALL = DF_WORLD_VIEW_PROJ | DF_WORLD_VIEW | DF_VIEW_PROJ | DF_FRUSTUM,
 };
 
 
@@ -22,7 +28,12 @@ Renderer::Renderer()
 	, matProj_(Matrix::Identity)
 	, camera_(nullptr)
 	, ambientColor_(0.2f, 0.2f, 0.2f, 1.0f)
+	, renderQueue_(nullptr)
+	, occlusionCuller_(nullptr)
+	, cullingEnable_(true)
 {
+	memset(&uniformStats_, 0, sizeof(uniformStats_));
+	memset(&cullStats_, 0, sizeof(cullStats_));
 	registerDefaultAutoShaderUniform();
 	pushMatrix(Matrix::Identity);
 }
@@ -58,13 +69,13 @@ void Renderer::setWorldMatrix(const Matrix & matrix)
 void Renderer::setViewMatrix(const Matrix &mat)
 {
 	matView_ = mat;
-	dirtyFlag_ |= DF_WORLD_VIEW | DF_WORLD_VIEW_PROJ | DF_VIEW_PROJ;
+	dirtyFlag_ |= DF_WORLD_VIEW | DF_WORLD_VIEW_PROJ | DF_VIEW_PROJ | DF_FRUSTUM;
 }
 
 void Renderer::setProjMatrix(const Matrix &mat)
 {
 	matProj_ = mat;
-	dirtyFlag_ |= DF_WORLD_VIEW_PROJ | DF_VIEW_PROJ;
+	dirtyFlag_ |= DF_WORLD_VIEW_PROJ | DF_VIEW_PROJ | DF_FRUSTUM;
 }
 
 const Matrix& Renderer::getWorldViewMatrix() const
@@ -97,6 +108,38 @@ const Matrix& Renderer::getViewProjMatrix() const
 	return matViewProj_;
 }
 
+const Frustum& Renderer::getFrustum() const
+{
+	if (dirtyFlag_ & DF_FRUSTUM)
+	{
+		dirtyFlag_ &= ~uint32_t(DF_FRUSTUM);
+		frustum_.setFromMatrix(getViewProjMatrix());
+	}
+	return frustum_;
+}
+
+Frustum::Result Renderer::cullBounds(const AABB &bounds, const Matrix &world)
+{
+	if (!bounds.isValid())
+	{
+		return Frustum::OUTSIDE;
+	}
+
+	++cullStats_.nTests;
+	Frustum::Result result = getFrustum().intersectAABB(bounds, world);
+	if (result == Frustum::OUTSIDE || occlusionCuller_ == nullptr)
+	{
+		return result;
+	}
+
+	if (!occlusionCuller_->isVisible(bounds, world))
+	{
+		++cullStats_.nOccluded;
+		return Frustum::OUTSIDE;
+	}
+	return Frustum::INTERSECT;
+}
+
 void Renderer::setCamera(Camera * camera)
 {
     camera_ = camera;
@@ -116,26 +159,28 @@ void Renderer::applyCameraMatrix()
 
 void Renderer::setZWriteEnable(bool enable)
 {
-	GLboolean e = enable ? GL_TRUE : GL_FALSE;
-	glDepthMask(e);
+	GLStateCache::instance()->depthMask(enable);
 }
 
 void Renderer::setColorWriteEnable(bool enable)
 {
-	GLboolean e = enable ? GL_TRUE : GL_FALSE;
-	glColorMask(e, e, e, e);
+	GLStateCache::instance()->colorMask(enable, enable, enable, enable);
 }
 
 bool Renderer::beginDraw()
 {
+    PROFILE_SCOPE("Renderer::beginDraw");
     setWorldMatrix(Matrix::Identity);
     applyCameraMatrix();
+    ShaderUniform::resetStats();
+    memset(&cullStats_, 0, sizeof(cullStats_));
     return true;
 }
 
 void Renderer::endDraw()
 {
-
+    PROFILE_SCOPE("Renderer::endDraw");
+    uniformStats_ = ShaderUniform::getStats();
 }
 
 void Renderer::setOverwriteMaterial(MaterialPtr mtl)
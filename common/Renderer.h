@@ -4,15 +4,32 @@
 #include "Matrix.h"
 #include "Color.h"
 #include "SmartPointer.h"
+#include "ShaderUniform.h"
+#include "Frustum.h"
 #include <vector>
 
 class Camera;
 class Material;
 typedef SmartPointer<Material> MaterialPtr;
+class RenderQueue;
+class OcclusionCuller;
 
 class Renderer : public Singleton<Renderer>
 {
 public:
+    /** 视锥裁剪的统计，beginDraw时清零。*/
+    struct CullStats
+    {
+        /// 包围盒测试的次数
+        size_t  nTests;
+        /// 提交绘制的模型数量，由Mesh::draw计数，每次绘制只计一次
+        size_t  nVisible;
+        /// 裁剪掉的数量。Transform以有组件的结点为单位，Model以其中的模型为单位
+        size_t  nCulled;
+        /// 在视锥内但被遮挡剔除的包围盒数量
+        size_t  nOccluded;
+    };
+
     Renderer();
     ~Renderer();
 
@@ -48,9 +65,35 @@ public:
     bool beginDraw();
     void endDraw();
 
+    /** 上一帧uniform上传和跳过的次数。*/
+    const ShaderUniform::Stats& getUniformStats() const { return uniformStats_; }
+
+    /** 视锥裁剪，默认开启。开启时Transform和Model绘制前会用包围盒与getFrustum()做测试。*/
+    void setCullingEnable(bool enable) { cullingEnable_ = enable; }
+    bool isCullingEnable() const { return cullingEnable_; }
+
+    /** 当前视图投影矩阵对应的世界空间视锥。*/
+    const Frustum& getFrustum() const;
+
+    /** 用视锥测试经过world变换的局部包围盒，并计入测试次数。空的包围盒返回OUTSIDE。
+     *  设置了遮挡剔除时，被遮挡的包围盒也返回OUTSIDE；并且不再返回INSIDE，子结点仍需要逐个测试遮挡。
+     */
+    Frustum::Result cullBounds(const AABB &bounds, const Matrix &world);
+
+    /** 设置遮挡剔除。遮挡体需要在绘制之前光栅化好，为空时只做视锥裁剪。*/
+    void setOcclusionCuller(OcclusionCuller *culler) { occlusionCuller_ = culler; }
+    OcclusionCuller* getOcclusionCuller() const { return occlusionCuller_; }
+
+    CullStats& getCullStats() { return cullStats_; }
+    const CullStats& getCullStats() const { return cullStats_; }
+
     void setOverwriteMaterial(MaterialPtr mtl);
     MaterialPtr getOverwriteMaterial();
 
+    /** 设置渲染队列。不为空时，Mesh::draw只向队列提交绘制项，需要调用RenderQueue::flush才会真正绘制。*/
+    void setRenderQueue(RenderQueue *queue) { renderQueue_ = queue; }
+    RenderQueue* getRenderQueue() { return renderQueue_; }
+
 private:
     std::vector<Matrix> matrixs_;
     Matrix      matView_;
@@ -59,10 +102,16 @@ private:
 	Color		ambientColor_;
 
     MaterialPtr overwiteMaterial_;
+    RenderQueue* renderQueue_;
+    OcclusionCuller* occlusionCuller_;
+    ShaderUniform::Stats uniformStats_;
+    bool        cullingEnable_;
+    CullStats   cullStats_;
     
     mutable Matrix      matViewProj_;
     mutable Matrix      matWorldViewProj_;
     mutable Matrix      matWorldView_;
+    mutable Frustum     frustum_;
 
 	mutable uint32_t	dirtyFlag_;
 };
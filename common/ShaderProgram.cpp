@@ -5,13 +5,19 @@
 #include "glconfig.h"
 #include "ShaderUniform.h"
 #include "PathTool.h"
+#include "GLStateCache.h"
+#include "UniformBlockMgr.h"
 
 #include <smartjson/sj_parser.hpp>
 #include <iostream>
 
+/*static*/ uint32_t ShaderProgram::s_versionCounter = 0;
+
 ShaderProgram::ShaderProgram()
 : handle_(0)
 , uniformRoot_(new ShaderUniform("root"))
+, version_(0)
+, uniformBlocks_(0)
 {
     for(int i = 0; i < VertexUsageMax; ++i)
     {
@@ -26,6 +32,10 @@ ShaderProgram::~ShaderProgram()
     if(glIsProgram(handle_))
     {
         glDeleteProgram(handle_);
+        if (GLStateCache::hasInstance())
+        {
+            GLStateCache::instance()->onDeleteProgram(handle_);
+        }
     }
 }
 
@@ -100,10 +110,19 @@ bool ShaderProgram::loadFromData(const std::string &data)
 	{
 		return false;
 	}
-    
+	parseUniformBlocks();
+
+	// 新链接的program中uniform都是初始值
+	invalidateUniforms();
     return true;
 }
 
+void ShaderProgram::invalidateUniforms()
+{
+	// 全局递增，保证不同program的版本号也不会相同
+	version_ = ++s_versionCounter;
+}
+
 std::string ShaderProgram::getLinkError() const
 {
     GLint length;
@@ -186,6 +205,11 @@ bool ShaderProgram::parseUniforms()
 		uniformName.erase(len);
 
 		GLint location = glGetUniformLocation(handle_, uniformName.c_str());
+		if (location < 0)
+		{
+			// uniform块中的成员没有location，由块统一上传
+			continue;
+		}
 
 		size_t iBracket = uniformName.find('[');
 		if (iBracket != std::string::npos)
@@ -217,12 +241,12 @@ bool ShaderProgram::parseUniforms()
 
 void ShaderProgram::bind()
 {
-    GL_ASSERT(glUseProgram(handle_));
+    GLStateCache::instance()->useProgram(handle_);
 }
 
 void ShaderProgram::unbind()
 {
-    GL_ASSERT(glUseProgram(0));
+    GLStateCache::instance()->useProgram(0);
 }
 
 int ShaderProgram::getUniformLocation(const char *name)
@@ -246,4 +270,30 @@ void ShaderProgram::applyAutoUniforms()
 	{
 		pair.first->apply(pair.second);
 	}
+
+	if (uniformBlocks_ != 0)
+	{
+		UniformBlockMgr::instance()->apply(uniformBlocks_);
+	}
+}
+
+void ShaderProgram::parseUniformBlocks()
+{
+	uniformBlocks_ = 0;
+
+	const std::pair<const std::string*, AutoUniformBlock::Binding> blocks[] = {
+		std::make_pair(&AutoUniformBlock::Frame, AutoUniformBlock::FrameBinding),
+		std::make_pair(&AutoUniformBlock::Object, AutoUniformBlock::ObjectBinding),
+	};
+	for (auto &block : blocks)
+	{
+		GLuint index = glGetUniformBlockIndex(handle_, block.first->c_str());
+		if (index == GL_INVALID_INDEX)
+		{
+			continue;
+		}
+
+		glUniformBlockBinding(handle_, index, block.second);
+		uniformBlocks_ |= 1 << block.second;
+	}
 }
@@ -29,20 +29,37 @@ public:
     int getUniformLocation(const char *name);
     int getAttribLocation(const char *name);
     int getAttribLocation(VertexUsage usage){ return attributes_[(int)usage]; }
+
+    /** 使用了实例属性(a_instanceWorld)，可以用于实例化绘制。*/
+    bool isInstanced() const { return attributes_[(int)VertexUsage::INSTANCE_WORLD0] >= 0; }
     
     ShaderUniform* findUniform(const std::string &name);
 
+    /** uniform影子值的版本号，每次链接都会分配新的值。*/
+    uint32_t getVersion() const { return version_; }
+    /** 绕过ShaderUniform直接修改了uniform时调用，使所有的影子值作废。*/
+    void invalidateUniforms();
+
+    /** 上传自动uniform。声明了自动uniform块的，由UniformBlockMgr上传整个块。*/
     void applyAutoUniforms();
 
+    /** 使用的自动uniform块，AutoUniformBlock::Mask的组合。*/
+    uint32_t getUniformBlocks() const { return uniformBlocks_; }
+
 private:
 	bool parseAttributes();
 	bool parseUniforms();
+	void parseUniformBlocks();
 
     uint32_t        handle_;
     std::string     fileName_;
 	int             attributes_[VertexUsageMax];
 	ShaderUniform*	uniformRoot_;
     std::vector<std::pair<ShaderAutoUniform*, ShaderUniform*>> autoUnfiorms_;
+    uint32_t        version_;
+    uint32_t        uniformBlocks_;
+
+    static uint32_t s_versionCounter;
 };
 
 typedef SmartPointer<ShaderProgram> ShaderProgramPtr;
@@ -1,5 +1,6 @@
 #include "ShaderProgramMgr.h"
 #include "LogTool.h"
+#include "Profiler.h"
 
 IMPLEMENT_SINGLETON(ShaderProgramMgr);
 
@@ -22,6 +23,7 @@ ShaderProgramPtr ShaderProgramMgr::get(const std::string &fileName, bool load)
     
     if(load)
     {
+        PROFILE_SCOPE("ShaderProgramMgr::load");
         ShaderProgramPtr res = new ShaderProgram();
         if(res->loadFromFile(fileName))
         {
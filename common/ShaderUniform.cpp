@@ -7,7 +7,9 @@
 #include "Matrix.h"
 #include "Texture.h"
 #include "LogTool.h"
+#include "GLStateCache.h"
 #include "glconfig.h"
+#include <cstring>
 
 
 ShaderUniform::ShaderUniform(const std::string & name)
@@ -16,6 +18,8 @@ ShaderUniform::ShaderUniform(const std::string & name)
     , type_(0)
     , index_(0)
     , pEffect_(nullptr)
+    , valueKind_(0)
+    , version_(0)
 {
 }
 
@@ -61,35 +65,94 @@ ShaderUniform *ShaderUniform::getChildren(const std::string & name, bool createI
 }
 
 
+namespace
+{
+    /// 对应的glUniform*函数
+    enum UniformKind
+    {
+        KIND_FLOAT = 1,
+        KIND_INT,
+        KIND_VEC2,
+        KIND_VEC3,
+        KIND_VEC4,
+        KIND_MATRIX,
+        KIND_MATRIX_TRANSPOSE,
+    };
+}
+
+/*static*/ ShaderUniform::Stats ShaderUniform::s_stats = { 0, 0 };
+
+/*static*/ void ShaderUniform::resetStats()
+{
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+
+bool ShaderUniform::updateShadow(uint32_t kind, const void *data, size_t size)
+{
+    uint32_t version = pEffect_ != nullptr ? pEffect_->getVersion() : 0;
+    if (version_ == version && valueKind_ == kind && value_.size() == size &&
+        memcmp(value_.data(), data, size) == 0)
+    {
+        ++s_stats.nSkips;
+        return false;
+    }
+
+    version_ = version;
+    valueKind_ = kind;
+    value_.assign((const uint8_t*)data, (const uint8_t*)data + size);
+    ++s_stats.nUploads;
+    return true;
+}
+
 void ShaderUniform::bindValue(float value)
 {
-    GL_ASSERT( glUniform1f(location_, value) );
+    if (updateShadow(KIND_FLOAT, &value, sizeof(value)))
+    {
+        GL_ASSERT( glUniform1f(location_, value) );
+    }
 }
 
 void ShaderUniform::bindValue(const float* values, int count)
 {
-    GL_ASSERT( glUniform1fv(location_, count, values) );
+    if (updateShadow(KIND_FLOAT, values, sizeof(float) * count))
+    {
+        GL_ASSERT( glUniform1fv(location_, count, values) );
+    }
 }
 
 void ShaderUniform::bindValue(int value)
 {
-    GL_ASSERT( glUniform1i(location_, value) );
+    if (updateShadow(KIND_INT, &value, sizeof(value)))
+    {
+        GL_ASSERT( glUniform1i(location_, value) );
+    }
 }
 
 void ShaderUniform::bindValue(const int* values, int count)
 {
-    GL_ASSERT( glUniform1iv(location_, count, values) );
+    if (updateShadow(KIND_INT, values, sizeof(int) * count))
+    {
+        GL_ASSERT( glUniform1iv(location_, count, values) );
+    }
 }
 
 void ShaderUniform::bindValue(const Matrix& value)
 {
-    GL_ASSERT(glUniformMatrix4fv(location_, 1, GL_FALSE, (const float*) (&value)));
+    if (updateShadow(KIND_MATRIX, &value, sizeof(Matrix)))
+    {
+        GL_ASSERT(glUniformMatrix4fv(location_, 1, GL_FALSE, (const float*) (&value)));
+    }
 }
 
 void ShaderUniform::bindValue(const Matrix* values, int count, bool needTranspos)
 {
     assert(values && count > 0);
 
+    if (!updateShadow(needTranspos ? KIND_MATRIX_TRANSPOSE : KIND_MATRIX, values, sizeof(Matrix) * count))
+    {
+        return;
+    }
+
     if(needTranspos)
     {
         glUniformMatrix4fv(location_, count, GL_TRUE, (GLfloat*) values);
@@ -102,43 +165,67 @@ void ShaderUniform::bindValue(const Matrix* values, int count, bool needTranspos
 
 void ShaderUniform::bindValue(const Vector2& value)
 {
-    GL_ASSERT( glUniform2f(location_, value.x, value.y) );
+    if (updateShadow(KIND_VEC2, &value, sizeof(Vector2)))
+    {
+        GL_ASSERT( glUniform2f(location_, value.x, value.y) );
+    }
 }
 
 void ShaderUniform::bindValue(const Vector2* values, int count)
 {
-    GL_ASSERT( glUniform2fv(location_, count, (GLfloat*)values) );
+    if (updateShadow(KIND_VEC2, values, sizeof(Vector2) * count))
+    {
+        GL_ASSERT( glUniform2fv(location_, count, (GLfloat*)values) );
+    }
 }
 
 void ShaderUniform::bindValue(const Vector3& value)
 {
-    GL_ASSERT( glUniform3f(location_, value.x, value.y, value.z) );
+    if (updateShadow(KIND_VEC3, &value, sizeof(Vector3)))
+    {
+        GL_ASSERT( glUniform3f(location_, value.x, value.y, value.z) );
+    }
 }
 
 void ShaderUniform::bindValue(const Vector3* values, int count)
 {
-    GL_ASSERT( glUniform3fv(location_, count, (GLfloat*)values) );
+    if (updateShadow(KIND_VEC3, values, sizeof(Vector3) * count))
+    {
+        GL_ASSERT( glUniform3fv(location_, count, (GLfloat*)values) );
+    }
 }
 
 void ShaderUniform::bindValue(const Vector4& value)
 {
-    GL_ASSERT( glUniform4f(location_, value.x, value.y, value.z, value.w) );
+    if (updateShadow(KIND_VEC4, &value, sizeof(Vector4)))
+    {
+        GL_ASSERT( glUniform4f(location_, value.x, value.y, value.z, value.w) );
+    }
 }
 
 void ShaderUniform::bindValue(const Vector4* values, int count)
 {
-    GL_ASSERT( glUniform4fv(location_, count, (GLfloat*)values) );
+    if (updateShadow(KIND_VEC4, values, sizeof(Vector4) * count))
+    {
+        GL_ASSERT( glUniform4fv(location_, count, (GLfloat*)values) );
+    }
 }
 
 void ShaderUniform::bindValue(const Color & color)
 {
     if (type_ == GL_FLOAT_VEC4)
     {
-        GL_ASSERT(glUniform4f(location_, color.r, color.g, color.b, color.a));
+        if (updateShadow(KIND_VEC4, &color, sizeof(float) * 4))
+        {
+            GL_ASSERT(glUniform4f(location_, color.r, color.g, color.b, color.a));
+        }
     }
     else if (type_ == GL_FLOAT_VEC3)
     {
-        GL_ASSERT(glUniform3f(location_, color.r, color.g, color.b));
+        if (updateShadow(KIND_VEC3, &color, sizeof(float) * 3))
+        {
+            GL_ASSERT(glUniform3f(location_, color.r, color.g, color.b));
+        }
     }
 }
 
@@ -160,7 +247,7 @@ void ShaderUniform::bindValue(const Texture *texture)
     texture_ = const_cast<Texture*>(texture);
 
     //binds the texture
-    GL_ASSERT(glActiveTexture(GL_TEXTURE0 + index_));
+    GLStateCache::instance()->activeTexture(index_);
 
     if (texture_)
     {
@@ -168,10 +255,11 @@ void ShaderUniform::bindValue(const Texture *texture)
     }
     else
     {
-        GL_ASSERT( glBindTexture(GL_TEXTURE_2D, 0) );
+        GLStateCache::instance()->bindTexture(GL_TEXTURE_2D, 0);
     }
     
-    GL_ASSERT( glUniform1i(location_, index_) );
+    // 纹理单元的编号是固定的，通常只需要上传一次
+    bindValue(int(index_));
 }
 
 //////////////////////////////////////////////////////////////////
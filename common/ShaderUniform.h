@@ -5,6 +5,8 @@
 #include "SmartPointer.h"
 #include <string>
 #include <unordered_map>
+#include <vector>
+#include <cstdint>
 
 
 class ShaderProgram;
@@ -43,6 +45,9 @@ namespace AutoUniform
 
 /**
  * Represents a uniform variable within an effect.
+ *
+ * uniform的值是保存在program中的，每个uniform保存一份最后上传的值。
+ * 再次设置相同的值时，只做一次内存比较，不调用glUniform*。
  */
 class ShaderUniform
 {
@@ -50,6 +55,15 @@ class ShaderUniform
 
 public:
 
+    /** 上传和跳过的次数，直到调用resetStats。*/
+    struct Stats
+    {
+        size_t  nUploads;
+        size_t  nSkips;
+    };
+    static const Stats& getStats() { return s_stats; }
+    static void resetStats();
+
     const std::string& getName() const{ return name_; }
     const uint32_t getType() const{ return type_; }
     ShaderProgram* getProgram() const{ return pEffect_; }
@@ -92,6 +106,11 @@ private:
     ShaderUniform(const std::string & name);
     ~ShaderUniform();
 
+    /** 比较并更新影子值，返回true表示需要上传。
+     *  @param kind 区分调用的glUniform*函数，相同的字节用不同的函数上传时不能跳过。
+     */
+    bool updateShadow(uint32_t kind, const void *data, size_t size);
+
     std::string         name_;
     int                 location_;
     uint32_t            type_;
@@ -100,6 +119,14 @@ private:
     //如果是纹理，这里需要持有它的一个引用技术，防止纹理提前析构而引起崩溃
     SmartPointer<Texture>  texture_;
     std::unordered_map<std::string, ShaderUniform*> children_;
+
+    /// 最后上传的值
+    std::vector<uint8_t> value_;
+    uint32_t            valueKind_;
+    /// 上传时program的版本号。program重新链接或者被标记失效后，版本号改变，影子值作废
+    uint32_t            version_;
+
+    static Stats        s_stats;
 };
 
 /**
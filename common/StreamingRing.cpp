@@ -0,0 +1,130 @@
+#include "StreamingRing.h"
+#include "GLStateCache.h"
+#include "LogTool.h"
+#include <cstring>
+
+namespace
+{
+    inline size_t alignUp(size_t size, size_t alignment)
+    {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+}
+
+void orphanBuffer(GLenum target, size_t capacity, GLenum usage, const void *data, size_t size)
+{
+    GL_ASSERT(glBufferData(target, capacity, nullptr, usage));
+    if (data != nullptr && size > 0)
+    {
+        GL_ASSERT(glBufferSubData(target, 0, size, data));
+    }
+}
+
+StreamingRing::StreamingRing(GLenum target)
+    : target_(target)
+    , buffer_(0)
+    , capacity_(0)
+    , alignment_(1)
+    , head_(0)
+{
+    resetStats();
+}
+
+StreamingRing::~StreamingRing()
+{
+    destroy();
+}
+
+void StreamingRing::destroy()
+{
+    if (buffer_ != 0)
+    {
+        glDeleteBuffers(1, &buffer_);
+        if (GLStateCache::hasInstance())
+        {
+            GLStateCache::instance()->onDeleteBuffer(buffer_);
+        }
+        buffer_ = 0;
+    }
+}
+
+bool StreamingRing::init(size_t capacity, size_t alignment)
+{
+    destroy();
+
+    alignment_ = alignment > 0 ? alignment : 1;
+    capacity_ = alignUp(capacity > 0 ? capacity : 1, alignment_);
+    head_ = 0;
+
+    glGenBuffers(1, &buffer_);
+    if (buffer_ == 0)
+    {
+        LOG_ERROR("Failed to create streaming buffer.");
+        return false;
+    }
+
+    bind();
+    glBufferData(target_, capacity_, nullptr, GL_STREAM_DRAW);
+    unbind();
+    return true;
+}
+
+void StreamingRing::bind()
+{
+    GLStateCache::instance()->bindBuffer(target_, buffer_);
+}
+
+void StreamingRing::unbind()
+{
+    GLStateCache::instance()->bindBuffer(target_, 0);
+}
+
+void StreamingRing::resetStats()
+{
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+bool StreamingRing::reserve(size_t size)
+{
+    if (alignUp(head_, alignment_) + size <= capacity_)
+    {
+        return false;
+    }
+
+    while (capacity_ < size)
+    {
+        capacity_ <<= 1;
+    }
+    orphanBuffer(target_, capacity_, GL_STREAM_DRAW);
+    head_ = 0;
+    ++stats_.nOrphans;
+    return true;
+}
+
+void* StreamingRing::map(size_t size, size_t &offset)
+{
+    reserve(size);
+    offset = alignUp(head_, alignment_);
+    head_ = offset + size;
+
+    ++stats_.nMaps;
+    stats_.nBytes += size;
+    return glMapBufferRange(target_, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+}
+
+void StreamingRing::unmap()
+{
+    glUnmapBuffer(target_);
+}
+
+size_t StreamingRing::write(const void *data, size_t size)
+{
+    size_t offset = 0;
+    void *p = map(size, offset);
+    if (p != nullptr)
+    {
+        memcpy(p, data, size);
+        unmap();
+    }
+    return offset;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "glconfig.h"
+#include <cstddef>
+
+/** 重新分配缓冲区的存储(orphan)，data不为空时接着上传前size字节。缓冲区需要已经绑定到target上。
+ *  GPU还在使用的旧存储由驱动保留，之后写入新的存储不需要等待GPU。
+ */
+void orphanBuffer(GLenum target, size_t capacity, GLenum usage, const void *data = nullptr, size_t size = 0);
+
+/** 每帧重新写入的数据(调试图元、uniform块、实例数据)使用的环形流式缓冲区。
+ *  数据按顺序追加，用GL_MAP_UNSYNCHRONIZED_BIT映射新分配的区域：同一份存储中，这些区域还没有被任何绘制使用，不需要同步。
+ *  放不下时重新分配存储，从头写入；一次分配超过容量时，容量翻倍直到放得下。
+ *  除了init，其他的操作都需要先调用bind。
+ */
+class StreamingRing
+{
+public:
+    struct Stats
+    {
+        size_t  nMaps;
+        size_t  nBytes;
+        size_t  nOrphans;
+    };
+
+    explicit StreamingRing(GLenum target);
+    ~StreamingRing();
+
+    /** 创建缓冲区并分配存储。GL上下文创建之后调用。
+     *  @param alignment 每次分配的起始位置对齐到它的整数倍
+     */
+    bool init(size_t capacity, size_t alignment = 1);
+
+    GLuint getHandle() const { return buffer_; }
+    size_t getCapacity() const { return capacity_; }
+    size_t getAlignment() const { return alignment_; }
+
+    void bind();
+    void unbind();
+
+    /** 保证接下来可以连续分配size字节。重新分配了存储时返回true，之前分配的区域都不能再使用。*/
+    bool reserve(size_t size);
+
+    /** 分配size字节并映射，offset返回分配的起始位置，写完之后调用unmap。映射失败时返回nullptr。*/
+    void* map(size_t size, size_t &offset);
+    void unmap();
+
+    /** 分配size字节并写入data，返回分配的起始位置。*/
+    size_t write(const void *data, size_t size);
+
+    const Stats& getStats() const { return stats_; }
+    void resetStats();
+
+private:
+    void destroy();
+
+    GLenum  target_;
+    GLuint  buffer_;
+    size_t  capacity_;
+    size_t  alignment_;
+    /// 下一次分配的位置，对齐之前
+    size_t  head_;
+    Stats   stats_;
+};
@@ -2,6 +2,7 @@
 #include "LogTool.h"
 #include "PathTool.h"
 #include "FileSystem.h"
+#include "GLStateCache.h"
 
 #include "stb/stb_image.h"
 #include "stb/stb_image_write.h"
@@ -17,6 +18,7 @@ TextureQuality Texture::s_defaultQuality = TextureQuality::ThreeLinear;
 Texture::Texture()
     : format_(TextureFormat::Unknown)
     , handle_(0)
+    , sampler_(0)
     , width_(0)
     , height_(0)
     , mipmapped_(false)
@@ -41,9 +43,12 @@ void Texture::destroy()
 {
     if (glIsTexture(handle_))
     {
-        tryUnbind();
-
         glDeleteTextures(1, &handle_);
+        if (GLStateCache::hasInstance())
+        {
+            // GL会将已删除的纹理从所有纹理单元上解除绑定
+            GLStateCache::instance()->onDeleteTexture(handle_);
+        }
         handle_ = 0;
     }
 
@@ -111,18 +116,18 @@ bool Texture::save(const std::string & filename) const
     int imageSize = width_ * height_ * saveChannels;
     char *pData = new char[imageSize];
 
-    int oldAligment;
-    glGetIntegerv(GL_PACK_ALIGNMENT, &oldAligment);
-    glPixelStorei(GL_PACK_ALIGNMENT, 1);
-    glBindTexture((GLenum)target_, handle_);
+    GLStateCache *cache = GLStateCache::instance();
+    int oldAligment = cache->getPixelStore(GL_PACK_ALIGNMENT);
+    cache->pixelStore(GL_PACK_ALIGNMENT, 1);
+    cache->bindTexture((GLenum)target_, handle_);
     glReadPixels(0, 0, width_, height_, saveFormat, GL_UNSIGNED_BYTE, pData);// split x and y sizes into bytes
     if (GLenum error = glGetError())
     {
         LOG_ERROR("OpenGLTexture::read pixels failed! %x", error);
     }
-    glPixelStorei(GL_PACK_ALIGNMENT, oldAligment);
+    cache->pixelStore(GL_PACK_ALIGNMENT, oldAligment);
 
-    glBindTexture((GLenum)target_, 0);
+    cache->bindTexture((GLenum)target_, 0);
 
     std::string fullpath = FileSystem::instance()->resolveWritablePath(filename);
     int ret = stbi_write_tga(fullpath.c_str(), width_, height_, saveChannels, pData);
@@ -145,16 +150,16 @@ bool Texture::create(uint32_t levels, uint32_t width, uint32_t height, TextureFo
     GLenum internalFormat = GLenum(format_);
     
 	GL_ASSERT(glGenTextures(1, &handle_));
-	GL_ASSERT(glBindTexture((GLenum)target_, handle_));
+	GLStateCache *cache = GLStateCache::instance();
+	cache->bindTexture((GLenum)target_, handle_);
 
-	int oldAlignment;
-	glGetIntegerv(GL_PACK_ALIGNMENT, &oldAlignment);
-	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	int oldAlignment = cache->getPixelStore(GL_PACK_ALIGNMENT);
+	cache->pixelStore(GL_PACK_ALIGNMENT, 1);
 
 	GL_ASSERT(glTexImage2D((GLenum)target_, levels, internalFormat, width_, height_,
 		0, internalFormat, pxieType, pPixelData));
 
-	glPixelStorei(GL_PACK_ALIGNMENT, oldAlignment);
+	cache->pixelStore(GL_PACK_ALIGNMENT, oldAlignment);
     return true;
 }
 
@@ -220,20 +225,7 @@ void Texture::generateMipmaps()
 
 GLuint Texture::getCurrentBinding() const
 {
-	GLint curTexture = 0;
-	if (target_ == TextureTarget::Tex2D)
-	{
-		glGetIntegerv(GL_TEXTURE_BINDING_2D, &curTexture);
-	}
-	else if (target_ == TextureTarget::TexCubeMap)
-	{
-		glGetIntegerv(GL_TEXTURE_BINDING_CUBE_MAP, &curTexture);
-	}
-    else if(target_ == TextureTarget::Tex2DArray)
-    {
-        glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &curTexture);
-    }
-	return curTexture;
+	return GLStateCache::instance()->getTexture((GLenum)target_);
 }
 
 void Texture::updateParameter()
@@ -258,71 +250,90 @@ void Texture::updateParameter()
             quality = TextureQuality::TwoLinear;
     }
 
+    // 默认值与GL相同
+    GLenum minFilter = GL_NEAREST_MIPMAP_LINEAR;
+    GLenum magFilter = GL_LINEAR;
     switch (quality)
     {
     case TextureQuality::Nearest:
-        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        minFilter = GL_NEAREST;
+        magFilter = GL_NEAREST;
         break;
 
     case TextureQuality::Linear:
-        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        minFilter = GL_LINEAR;
+        magFilter = GL_NEAREST;
         break;
 
     case TextureQuality::TwoLinear:
-        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        minFilter = GL_LINEAR;
+        magFilter = GL_LINEAR;
         break;
 
     case TextureQuality::ThreeLinear:
         generateMipmaps();
-        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
-        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        minFilter = GL_LINEAR_MIPMAP_NEAREST;
+        magFilter = GL_LINEAR;
         break;
 
     case TextureQuality::FourLinear:
     case TextureQuality::Anisotropic:
         generateMipmaps();
-        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        minFilter = GL_LINEAR_MIPMAP_LINEAR;
+        magFilter = GL_LINEAR;
         break;
 
     default:
         break;
     };
 
+    // 非立方体纹理不使用R方向，保持GL的默认值
+    GLenum wrapR = target_ == TextureTarget::TexCubeMap ? GLenum(rwrap_) : GL_REPEAT;
+
+    GLStateCache *cache = GLStateCache::instance();
+    if (cache->isSamplerSupported())
+    {
+        // 参数相同的纹理共享同一个采样器，切换纹理时不需要再修改参数
+        sampler_ = cache->getSampler(minFilter, magFilter, GLenum(uwrap_), GLenum(vwrap_), wrapR);
+        return;
+    }
+
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, minFilter);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, magFilter);
     glTexParameteri(target, GL_TEXTURE_WRAP_S, GLenum(uwrap_));
     glTexParameteri(target, GL_TEXTURE_WRAP_T, GLenum(vwrap_));
 
 	if (target_ == TextureTarget::TexCubeMap)
 	{
-		glTexParameteri(target, GL_TEXTURE_WRAP_R, GLenum(rwrap_));
+		glTexParameteri(target, GL_TEXTURE_WRAP_R, wrapR);
 	}
 }
 
 bool Texture::bind()
 {
-    glBindTexture((GLenum)target_, handle_);
+    GLStateCache *cache = GLStateCache::instance();
+    cache->bindTexture((GLenum)target_, handle_, sampler_);
     if(handle_ == 0)
     {
         return false;
     }
 
+    // 参数改变时采样器也会改变，需要重新绑定
     updateParameter();
+    cache->bindSampler(cache->getActiveTexture(), sampler_);
     return true;
 }
 
 void Texture::unbind()
 {
-    glBindTexture((GLenum)target_, 0);
+    GLStateCache::instance()->bindTexture((GLenum)target_, 0);
 }
 
 bool Texture::tryUnbind()
 {
     if (handle_ == getCurrentBinding())
     {
-        glBindTexture((GLenum)target_, 0);
+        GLStateCache::instance()->bindTexture((GLenum)target_, 0);
         return true;
     }
 
@@ -56,12 +56,14 @@ protected:
 	TextureFormat component2format(int n) const;
 	GLuint getCurrentBinding() const;
 
+    /** 支持采样器对象时，过滤和寻址参数保存在共享的采样器中，绑定时一起绑定到纹理单元上。*/
     virtual void updateParameter();
     virtual void generateMipmaps();
 
     std::string         resource_;
     TextureFormat       format_;
     GLuint              handle_;
+    GLuint              sampler_;
     uint32_t            width_;
     uint32_t            height_;
     bool                mipmapped_;
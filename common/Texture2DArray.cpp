@@ -1,5 +1,6 @@
 #include "Texture2DArray.h"
 #include "LogTool.h"
+#include "GLStateCache.h"
 
 Texture2DArray::Texture2DArray()
 {
@@ -31,7 +32,7 @@ bool Texture2DArray::create(int levels, uint32_t width, uint32_t height, Texture
     layerCount_ = layerCount;
     
     glGenTextures(1, &handle_);
-    glBindTexture((GLenum)target_, handle_);
+    GLStateCache::instance()->bindTexture((GLenum)target_, handle_);
     GL_ASSERT(glTexImage3D((GLenum)target_, levels, (GLenum)format, width, height, layerCount, 0, (GLenum)format, GL_UNSIGNED_BYTE, 0));
     return true;
 }
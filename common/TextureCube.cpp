@@ -3,6 +3,7 @@
 #include "FileSystem.h"
 #include "LogTool.h"
 #include "PathTool.h"
+#include "GLStateCache.h"
 
 #include <stb/stb_image.h>
 #include <stb/stb_image_write.h>
@@ -46,11 +47,11 @@ bool TextureCube::load(const std::string & fileName)
 	std::string fileDir = getFilePath(fileName);
 
 	GL_ASSERT(glGenTextures(1, &handle_));
-	GL_ASSERT(glBindTexture((GLenum)target_, handle_));
+	GLStateCache *cache = GLStateCache::instance();
+	cache->bindTexture((GLenum)target_, handle_);
 
-	int oldAlignment;
-	glGetIntegerv(GL_PACK_ALIGNMENT, &oldAlignment);
-	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	int oldAlignment = cache->getPixelStore(GL_PACK_ALIGNMENT);
+	cache->pixelStore(GL_PACK_ALIGNMENT, 1);
 
 	static const char *keys[] = {"right", "left", "up", "down", "back", "front", };
 	bool ret = true;
@@ -112,7 +113,7 @@ bool TextureCube::load(const std::string & fileName)
 		stbi_image_free(pixelData);
 	}
 
-	glPixelStorei(GL_PACK_ALIGNMENT, oldAlignment);
+	cache->pixelStore(GL_PACK_ALIGNMENT, oldAlignment);
 	return ret;
 }
 
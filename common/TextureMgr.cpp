@@ -1,6 +1,7 @@
 ﻿#include "TextureMgr.h"
 #include "LogTool.h"
 #include "TextureCube.h"
+#include "Profiler.h"
 
 IMPLEMENT_SINGLETON(TextureMgr);
 
@@ -23,6 +24,7 @@ TexturePtr TextureMgr::get(const std::string &fileName, bool load)
     
     if(load)
     {
+        PROFILE_SCOPE("TextureMgr::load");
 		TexturePtr tex;
 		if (fileName.size() >= 5 && strcmp(&fileName[(int)fileName.size() - 5], ".cube") == 0)
 		{
@@ -0,0 +1,208 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+    /** 当前线程所属的线程池，以及在线程池中的编号。非工作线程为空。*/
+    thread_local ThreadPool* t_pool = nullptr;
+    thread_local size_t t_workerIndex = 0;
+}
+
+ThreadPool::ThreadPool(size_t nThreads)
+    : pending_(0)
+    , queued_(0)
+    , nextQueue_(0)
+    , quit_(false)
+{
+    if (nThreads == 0)
+    {
+        nThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    queues_.reserve(nThreads);
+    for (size_t i = 0; i < nThreads; ++i)
+    {
+        queues_.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+    }
+
+    threads_.reserve(nThreads);
+    for (size_t i = 0; i < nThreads; ++i)
+    {
+        threads_.push_back(std::thread(&ThreadPool::workerMain, this, i));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        quit_ = true;
+    }
+    sleepCond_.notify_all();
+
+    for (std::thread &t : threads_)
+    {
+        t.join();
+    }
+}
+
+void ThreadPool::submit(Task task)
+{
+    size_t index;
+    if (t_pool == this)
+    {
+        index = t_workerIndex;
+    }
+    else
+    {
+        index = nextQueue_++ % queues_.size();
+    }
+
+    ++pending_;
+    {
+        WorkQueue &queue = *queues_[index];
+        std::lock_guard<std::mutex> lock(queue.mutex_);
+        queue.tasks_.push_back(std::move(task));
+    }
+
+    {
+        // 必须在锁内修改，否则工作线程可能在检查完条件之后，才进入等待，从而错过唤醒
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        ++queued_;
+    }
+    sleepCond_.notify_one();
+}
+
+bool ThreadPool::popTask(size_t index, Task &task)
+{
+    size_t nQueues = queues_.size();
+
+    // 先从自己的队列尾部取
+    if (index < nQueues)
+    {
+        WorkQueue &queue = *queues_[index];
+        std::lock_guard<std::mutex> lock(queue.mutex_);
+        if (!queue.tasks_.empty())
+        {
+            task = std::move(queue.tasks_.back());
+            queue.tasks_.pop_back();
+            --queued_;
+            return true;
+        }
+    }
+
+    // 从其他队列的头部窃取
+    size_t start = index < nQueues ? index + 1 : 0;
+    for (size_t i = 0; i < nQueues; ++i)
+    {
+        WorkQueue &queue = *queues_[(start + i) % nQueues];
+        std::lock_guard<std::mutex> lock(queue.mutex_);
+        if (!queue.tasks_.empty())
+        {
+            task = std::move(queue.tasks_.front());
+            queue.tasks_.pop_front();
+            --queued_;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::runPendingTask(size_t index)
+{
+    Task task;
+    if (!popTask(index, task))
+    {
+        return false;
+    }
+
+    task();
+    finishTask();
+    return true;
+}
+
+void ThreadPool::finishTask()
+{
+    if (--pending_ == 0)
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        doneCond_.notify_all();
+    }
+}
+
+void ThreadPool::workerMain(size_t index)
+{
+    t_pool = this;
+    t_workerIndex = index;
+
+    while (!quit_)
+    {
+        if (runPendingTask(index))
+        {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        sleepCond_.wait(lock, [this]() { return quit_ || queued_ > 0; });
+    }
+
+    t_pool = nullptr;
+}
+
+void ThreadPool::wait()
+{
+    size_t index = t_pool == this ? t_workerIndex : queues_.size();
+
+    while (pending_ > 0)
+    {
+        if (runPendingTask(index))
+        {
+            continue;
+        }
+
+        // 剩下的任务正在其他线程中执行
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        doneCond_.wait_for(lock, std::chrono::milliseconds(1), [this]() { return pending_ == 0; });
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> &fun)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    grain = std::max<size_t>(grain, 1);
+    if (count <= grain)
+    {
+        fun(0, count);
+        return;
+    }
+
+    // 使用独立的计数器，只等待本次提交的任务，不受其他任务的影响
+    std::atomic<size_t> remain((count + grain - 1) / grain);
+    for (size_t begin = grain; begin < count; begin += grain)
+    {
+        size_t end = std::min(begin + grain, count);
+        submit([&fun, &remain, begin, end]()
+        {
+            fun(begin, end);
+            --remain;
+        });
+    }
+
+    // 第一个区间由调用者线程执行
+    fun(0, grain);
+    --remain;
+
+    size_t index = t_pool == this ? t_workerIndex : queues_.size();
+    while (remain > 0)
+    {
+        if (!runPendingTask(index))
+        {
+            std::this_thread::yield();
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+/** 带任务窃取(work stealing)的线程池。
+ *  每个工作线程有自己的任务队列，优先从自己队列的尾部取任务(后进先出，缓存友好)，
+ *  自己的队列为空时，再从其他线程队列的头部窃取任务。
+ */
+class ThreadPool
+{
+    ThreadPool(const ThreadPool &);
+    const ThreadPool & operator = (const ThreadPool &);
+
+public:
+    typedef std::function<void()> Task;
+
+    /** @param nThreads 工作线程的数量。为0则使用硬件线程数。*/
+    explicit ThreadPool(size_t nThreads = 0);
+    ~ThreadPool();
+
+    size_t getNumThreads() const { return threads_.size(); }
+
+    /** 提交一个任务。在工作线程中提交的任务，会放入当前线程的队列。*/
+    void submit(Task task);
+
+    /** 等待所有已提交的任务执行完毕。等待期间，调用者线程也会参与执行任务。*/
+    void wait();
+
+    /** 尚未执行完毕的任务数量。*/
+    size_t getNumPendingTasks() const { return pending_; }
+
+    /** 将[0, count)划分成大小为grain的区间并行执行，执行完毕后才返回。
+     *  fun的参数为区间的[begin, end)。
+     */
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> &fun);
+
+private:
+    struct WorkQueue
+    {
+        std::mutex          mutex_;
+        std::deque<Task>    tasks_;
+    };
+
+    void workerMain(size_t index);
+
+    /** 从index对应的队列中取任务，取不到则从其他队列中窃取。index越界表示非工作线程。*/
+    bool popTask(size_t index, Task &task);
+
+    /** 执行一个任务。没有可执行的任务返回false。*/
+    bool runPendingTask(size_t index);
+
+    void finishTask();
+
+    std::vector<std::thread>    threads_;
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+
+    /** 已提交但还没执行完的任务数量。*/
+    std::atomic<size_t>     pending_;
+    /** 还在队列中，没有被取走的任务数量。*/
+    std::atomic<size_t>     queued_;
+    std::atomic<size_t>     nextQueue_;
+    std::atomic<bool>       quit_;
+
+    std::mutex              sleepMutex_;
+    std::condition_variable sleepCond_;
+    std::condition_variable doneCond_;
+};
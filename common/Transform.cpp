@@ -4,30 +4,67 @@
 #include "Component.h"
 #include <algorithm>
 #include "Renderer.h"
+#include "TransformHierarchy.h"
+#include "Profiler.h"
 
 Transform::Transform()
     : parent_(nullptr)
     , dirtyFlag_(DIRTY_ALL)
     , scale_(Vector3::One)
     , matRotation_(Matrix::Identity)
+    , childrenDirty_(false)
     , componentDirty_(false)
+    , hierarchy_(nullptr)
+    , hierarchyIndex_(-1)
+    , boundsFlags_(BOUNDS_DIRTY)
+    , nDrawables_(0)
 {
 }
 
 Transform::~Transform()
 {
+    if (hierarchy_ != nullptr)
+    {
+        hierarchy_->onTransformDestroyed(hierarchyIndex_);
+    }
+}
+
+void Transform::setDirty(uint32_t flag)
+{
+    dirtyFlag_ |= flag;
+    if (flag & DIRTY_MODEL)
+    {
+        if (hierarchy_ != nullptr)
+        {
+            hierarchy_->setDirty(hierarchyIndex_);
+        }
+
+        // 自身的子树包围盒在局部空间中，不受影响，父结点的需要重新计算
+        if (parent_ != nullptr)
+        {
+            parent_->invalidateSubtreeBounds();
+        }
+    }
+}
+
+void Transform::setStructureDirty()
+{
+    if (hierarchy_ != nullptr)
+    {
+        hierarchy_->setStructureDirty();
+    }
 }
 
 void Transform::setPosition(float x, float y, float z)
 {
     position_.set(x, y, z);
-    dirtyFlag_ |= DIRTY_MODEL_VIEW;
+    setDirty(DIRTY_MODEL_VIEW);
 }
 
 void Transform::setPosition(const Vector3 & position)
 {
     position_ = position;
-    dirtyFlag_ |= DIRTY_MODEL_VIEW;
+    setDirty(DIRTY_MODEL_VIEW);
 }
 
 void Transform::translate(const Vector3 & delta)
@@ -39,26 +76,26 @@ void Transform::setRotation(float pitch, float yaw, float roll)
 {
     rotation_.set(pitch, yaw, roll);
     matRotation_.setRotate(pitch, yaw, roll);
-    dirtyFlag_ |= DIRTY_MODEL_VIEW;
+    setDirty(DIRTY_MODEL_VIEW);
 }
 
 void Transform::setRotation(const Vector3 &rotation)
 {
     rotation_ = rotation;
     matRotation_.setRotate(rotation.x, rotation.y, rotation.z);
-    dirtyFlag_ |= DIRTY_MODEL_VIEW;
+    setDirty(DIRTY_MODEL_VIEW);
 }
 
 void Transform::setScale(float x, float y, float z)
 {
     scale_.set(x, y, z);
-    dirtyFlag_ |= DIRTY_MODEL;
+    setDirty(DIRTY_MODEL);
 }
 
 void Transform::setScale(const Vector3 &scale)
 {
     scale_ = scale;
-    dirtyFlag_ |= DIRTY_MODEL;
+    setDirty(DIRTY_MODEL);
 }
 
 const Matrix& Transform::getModelMatrix() const
@@ -71,13 +108,20 @@ const Matrix& Transform::getModelMatrix() const
         matScale.setScale(scale_);
 
         matModel_.multiply(matRotation_, matScale);
-        matModel_[3] = position_;
+        matModel_._41 = position_.x;
+        matModel_._42 = position_.y;
+        matModel_._43 = position_.z;
     }
     return matModel_;
 }
 
 Matrix Transform::getLocalToWorldMatrix() const
 {
+    if (hierarchy_ != nullptr && hierarchy_->isUpToDate() && hierarchy_->getRoot()->getParent() == nullptr)
+    {
+        return hierarchy_->getWorldMatrix(hierarchyIndex_);
+    }
+
     Matrix matrix = getModelMatrix();
 
     Transform *p = parent_;
@@ -99,7 +143,7 @@ Matrix Transform::getWorldToLocalMatrix() const
 
 void Transform::lookAt(const Vector3 & position, const Vector3 & target, const Vector3 & up)
 {
-    dirtyFlag_ |= DIRTY_MODEL_VIEW;
+    setDirty(DIRTY_MODEL_VIEW);
     position_ = position;
 
     Vector3 forward = target - position;
@@ -123,6 +167,8 @@ void Transform::addChild(TransformPtr child)
 {
     child->parent_ = this;
     children_.push_back(TransformPair(true, child));
+    setStructureDirty();
+    invalidateSubtreeBounds();
 }
 
 std::vector<TransformPtr> Transform::getChildren() const
@@ -161,6 +207,8 @@ void Transform::removeChild(TransformPtr child)
             pair.first = false;
             pair.second->parent_ = nullptr;
             childrenDirty_ = true;
+            setStructureDirty();
+            invalidateSubtreeBounds();
             break;
         }
     }
@@ -175,6 +223,8 @@ void Transform::removeChildByName(const std::string & name)
             pair.first = false;
             pair.second->parent_ = nullptr;
             childrenDirty_ = true;
+            setStructureDirty();
+            invalidateSubtreeBounds();
             break;
         }
     }
@@ -186,6 +236,8 @@ void Transform::removeChildByIndex(int index)
     pair.first = false;
     pair.second->parent_ = nullptr;
     childrenDirty_ = true;
+    setStructureDirty();
+    invalidateSubtreeBounds();
 }
 
 
@@ -193,6 +245,7 @@ void Transform::addComponent(ComponentPtr com)
 {
     com->setTransfrom(this);
     components_.push_back(ComponentPair(true, com));
+    invalidateBounds();
 }
 
 std::vector<ComponentPtr> Transform::getComponents() const
@@ -248,12 +301,19 @@ void Transform::removeComponent(ComponentPtr com)
             componentDirty_ = true;
             pair.first = false;
             pair.second->setTransfrom(nullptr);
+            invalidateBounds();
             break;
         }
     }
 }
 
 void Transform::tick(float elapse)
+{
+    PROFILE_SCOPE("Transform::tick");
+    tickNode(elapse);
+}
+
+void Transform::tickNode(float elapse)
 {
     for (auto &pair : components_)
     {
@@ -267,7 +327,7 @@ void Transform::tick(float elapse)
     {
         if (pair.first)
         {
-            pair.second->tick(elapse);
+            pair.second->tickNode(elapse);
         }
     }
 
@@ -282,15 +342,61 @@ void Transform::tick(float elapse)
 }
 
 void Transform::draw(Renderer * renderer)
+{
+    PROFILE_SCOPE("Transform::draw");
+    if (hierarchy_ != nullptr && hierarchy_->getRoot() == this && hierarchy_->isUpToDate())
+    {
+        hierarchy_->draw(renderer);
+        return;
+    }
+
+    drawNode(renderer, renderer->isCullingEnable());
+}
+
+void Transform::drawNode(Renderer * renderer, bool testBounds)
 {
     renderer->pushMatrix();
-    renderer->getWorldMatrix().preMultiply(getModelMatrix());
+    Matrix &world = renderer->getWorldMatrix();
+    world.preMultiply(getModelMatrix());
 
-    for (auto &pair : components_)
+    bool drawOwn = true;
+    if (testBounds)
     {
-        if (pair.first)
+        if (boundsFlags_ & BOUNDS_DIRTY)
         {
-            pair.second->draw(renderer);
+            updateBounds();
+        }
+
+        if (!(boundsFlags_ & BOUNDS_SUBTREE_INFINITE))
+        {
+            Frustum::Result result = renderer->cullBounds(subtreeBounds_, world);
+            if (result == Frustum::OUTSIDE)
+            {
+                renderer->getCullStats().nCulled += nDrawables_;
+                renderer->popMatrix();
+                return;
+            }
+
+            // 整棵子树都在视锥内，子孙结点不需要再测试
+            testBounds = result == Frustum::INTERSECT;
+        }
+
+        // 没有子结点时，自身的包围盒与子树的相同
+        if (testBounds && !children_.empty() && !(boundsFlags_ & BOUNDS_OWN_INFINITE))
+        {
+            drawOwn = renderer->cullBounds(ownBounds_, world) != Frustum::OUTSIDE;
+        }
+    }
+
+    if (hasComponents())
+    {
+        if (drawOwn)
+        {
+            drawComponents(renderer);
+        }
+        else
+        {
+            ++renderer->getCullStats().nCulled;
         }
     }
 
@@ -298,13 +404,107 @@ void Transform::draw(Renderer * renderer)
     {
         if (pair.first)
         {
-            pair.second->draw(renderer);
+            pair.second->drawNode(renderer, testBounds);
         }
     }
 
     renderer->popMatrix();
 }
 
+bool Transform::getSubtreeBounds(AABB & bounds) const
+{
+    if (boundsFlags_ & BOUNDS_DIRTY)
+    {
+        updateBounds();
+    }
+
+    bounds = subtreeBounds_;
+    return !(boundsFlags_ & BOUNDS_SUBTREE_INFINITE);
+}
+
+void Transform::invalidateBounds()
+{
+    if (hierarchy_ != nullptr)
+    {
+        hierarchy_->setBoundsDirty(hierarchyIndex_);
+    }
+    invalidateSubtreeBounds();
+}
+
+void Transform::invalidateSubtreeBounds()
+{
+    // 脏结点的祖先一定也是脏的，遇到脏结点就可以停止
+    Transform *node = this;
+    while (node != nullptr && !(node->boundsFlags_ & BOUNDS_DIRTY))
+    {
+        node->boundsFlags_ |= BOUNDS_DIRTY;
+        node = node->parent_;
+    }
+}
+
+void Transform::updateBounds() const
+{
+    boundsFlags_ = 0;
+    nDrawables_ = 0;
+    ownBounds_.setEmpty();
+
+    for (auto &pair : components_)
+    {
+        if (pair.first)
+        {
+            nDrawables_ = 1;
+
+            AABB bounds;
+            if (pair.second->getLocalBounds(bounds))
+            {
+                ownBounds_.addAABB(bounds);
+            }
+            else
+            {
+                boundsFlags_ |= BOUNDS_OWN_INFINITE | BOUNDS_SUBTREE_INFINITE;
+            }
+        }
+    }
+
+    subtreeBounds_ = ownBounds_;
+    for (auto &pair : children_)
+    {
+        if (!pair.first)
+        {
+            continue;
+        }
+
+        const Transform *child = pair.second.get();
+        if (child->boundsFlags_ & BOUNDS_DIRTY)
+        {
+            child->updateBounds();
+        }
+
+        nDrawables_ += child->nDrawables_;
+        if (child->boundsFlags_ & BOUNDS_SUBTREE_INFINITE)
+        {
+            boundsFlags_ |= BOUNDS_SUBTREE_INFINITE;
+        }
+        else if (child->subtreeBounds_.isValid())
+        {
+            AABB bounds = child->subtreeBounds_;
+            bounds.applyMatrix(child->getModelMatrix());
+            subtreeBounds_.addAABB(bounds);
+        }
+    }
+}
+
+void Transform::drawComponents(Renderer * renderer)
+{
+    for (auto &pair : components_)
+    {
+        if (pair.first)
+        {
+            pair.second->draw(renderer);
+        }
+    }
+}
+
 void Transform::removeUnusedComponents()
 {
     componentDirty_ = false;
@@ -4,6 +4,7 @@
 #include "Reference.h"
 #include "SmartPointer.h"
 #include "Matrix.h"
+#include "AABB.h"
 #include <vector>
 #include <typeinfo>
 #include <string>
@@ -12,6 +13,7 @@ class Component;
 typedef SmartPointer<Component> ComponentPtr;
 
 class Renderer;
+class TransformHierarchy;
 
 class Transform;
 typedef SmartPointer<Transform> TransformPtr;
@@ -60,6 +62,7 @@ public:
 
     const Matrix& getModelMatrix() const;
 
+    /** 如果所在的TransformHierarchy是最新的，直接返回其中的世界矩阵，否则沿父结点链计算。*/
     Matrix getLocalToWorldMatrix() const;
     Matrix getWorldToLocalMatrix() const;
 
@@ -101,12 +104,59 @@ public: // 组件相关功能
     void removeComponent(ComponentPtr com);
 
     void tick(float elapse);
+
+    /** 绘制组件及子结点。如果当前结点是TransformHierarchy的根结点，并且层次结构是最新的，使用扁平化的绘制。*/
     void draw(Renderer *renderer);
 
+    /** 子树(自身及所有子孙结点)中组件的包围盒，在自身的局部空间中，不包含自身的模型矩阵。
+     *  有组件没有包围盒时返回false。结果是缓存的，局部矩阵、子结点或组件发生变化时自动失效。
+     */
+    bool getSubtreeBounds(AABB &bounds) const;
+
+    /** 组件的包围盒在外部发生了变化(比如重新生成了模型的包围盒)时调用，使自身和祖先结点的缓存失效，
+     *  并通知所在的层次结构更新包围盒树中的代理。
+     */
+    void invalidateBounds();
+
+    /** 只绘制自身的组件，世界矩阵需要事先设置好。*/
+    void drawComponents(Renderer *renderer);
+    bool hasComponents() const { return !components_.empty(); }
+
+    /** 所在的扁平化层次结构。不在任何层次结构中时为空。*/
+    TransformHierarchy* getHierarchy() const { return hierarchy_; }
+    int getHierarchyIndex() const { return hierarchyIndex_; }
+
 protected:
+    friend class TransformHierarchy;
+
+    /** 设置脏标记。局部矩阵发生变化时，会通知所在的层次结构。*/
+    void setDirty(uint32_t flag);
+    void setStructureDirty();
+
     void removeUnusedComponents();
     void removeUnusedChildren();
 
+    enum BoundsFlag
+    {
+        BOUNDS_DIRTY = 1 << 0,
+        /// 自身有组件没有包围盒
+        BOUNDS_OWN_INFINITE = 1 << 1,
+        /// 子树中有组件没有包围盒
+        BOUNDS_SUBTREE_INFINITE = 1 << 2,
+    };
+
+    /** 只使自身和祖先结点的子树包围盒失效，自身组件的包围盒没有变化。*/
+    void invalidateSubtreeBounds();
+
+    /** 重新计算包围盒的缓存，脏的子结点会先被计算。*/
+    void updateBounds() const;
+
+    /** 递归绘制。testBounds为false表示祖先结点已经完全在视锥内，不需要再测试。*/
+    void drawNode(Renderer *renderer, bool testBounds);
+
+    /** 递归更新组件及子结点。tick只在入口处计时，避免每个结点都产生一个分析事件。*/
+    void tickNode(float elapse);
+
     std::string     name_;
     Transform*      parent_;
 
@@ -126,6 +176,16 @@ protected:
 
     bool            childrenDirty_;
     bool            componentDirty_;
+
+    TransformHierarchy* hierarchy_;
+    int             hierarchyIndex_;
+
+    /// 自身组件和整个子树的包围盒，都在自身的局部空间中
+    mutable AABB    ownBounds_;
+    mutable AABB    subtreeBounds_;
+    mutable uint32_t boundsFlags_;
+    /// 子树中有组件的结点数量，用于统计被裁剪掉的数量
+    mutable uint32_t nDrawables_;
 };
 
 #endif //TRANSFORM_H
@@ -0,0 +1,540 @@
+#include "TransformHierarchy.h"
+#include "ThreadPool.h"
+#include "Renderer.h"
+#include "Frustum.h"
+#include "Ray.h"
+#include "PrecomputedRay.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    /// 划分深度上至少要有这么多棵子树，并行才有意义
+    const size_t MinParallelTasks = 32;
+}
+
+TransformHierarchy::TransformHierarchy()
+    : unboundedDirty_(false)
+    , structureDirty_(false)
+    , anyDirty_(false)
+    , nUpdated_(0)
+    , parallelThreshold_(4096)
+{
+}
+
+TransformHierarchy::~TransformHierarchy()
+{
+    clear();
+}
+
+void TransformHierarchy::setRoot(TransformPtr root)
+{
+    clear();
+    root_ = root;
+    structureDirty_ = true;
+}
+
+void TransformHierarchy::clear()
+{
+    for (Transform *node : nodes_)
+    {
+        if (node != nullptr)
+        {
+            node->hierarchy_ = nullptr;
+            node->hierarchyIndex_ = -1;
+        }
+    }
+
+    nodes_.clear();
+    parents_.clear();
+    subtreeEnds_.clear();
+    worldMatrices_.clear();
+    dirty_.clear();
+    changed_.clear();
+    serialNodes_.clear();
+    taskRoots_.clear();
+    anyDirty_ = false;
+
+    tree_.clear();
+    proxies_.clear();
+    worldBounds_.clear();
+    unbounded_.clear();
+    unboundedNodes_.clear();
+    unboundedDirty_ = false;
+    boundsDirty_.clear();
+    dirtyBounds_.clear();
+}
+
+void TransformHierarchy::onTransformDestroyed(int index)
+{
+    nodes_[index] = nullptr;
+    structureDirty_ = true;
+}
+
+void TransformHierarchy::build()
+{
+    clear();
+    structureDirty_ = false;
+    if (!root_)
+    {
+        return;
+    }
+
+    // 深度优先展开。子结点逆序入栈，保证展开后的顺序与递归绘制的顺序一致
+    std::vector<std::pair<Transform*, int>> stack;
+    stack.push_back(std::make_pair(root_.get(), -1));
+    while (!stack.empty())
+    {
+        Transform *node = stack.back().first;
+        int parent = stack.back().second;
+        stack.pop_back();
+
+        int index = (int)nodes_.size();
+        node->hierarchy_ = this;
+        node->hierarchyIndex_ = index;
+        nodes_.push_back(node);
+        parents_.push_back(parent);
+
+        for (auto it = node->children_.rbegin(); it != node->children_.rend(); ++it)
+        {
+            if (it->first)
+            {
+                stack.push_back(std::make_pair(it->second.get(), index));
+            }
+        }
+    }
+
+    size_t n = nodes_.size();
+    worldMatrices_.resize(n);
+    dirty_.assign(n, 1);
+    changed_.assign(n, 0);
+    anyDirty_ = true;
+
+    // 所有结点的代理都在第一次update时重新创建
+    proxies_.assign(n, DynamicAABBTree::NullNode);
+    worldBounds_.resize(n);
+    unbounded_.assign(n, 0);
+    boundsDirty_.assign(n, 1);
+    dirtyBounds_.resize(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        worldBounds_[i].setEmpty();
+        dirtyBounds_[i] = (int)i;
+    }
+
+    // 子孙结点都在父结点之后，逆序遍历即可求出每棵子树的范围
+    subtreeEnds_.resize(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        subtreeEnds_[i] = int(i + 1);
+    }
+    for (size_t i = n - 1; i > 0; --i)
+    {
+        int parent = parents_[i];
+        subtreeEnds_[parent] = std::max(subtreeEnds_[parent], subtreeEnds_[i]);
+    }
+
+    // 选择第一个子树数量足够多的深度，作为并行的划分深度
+    std::vector<int> depths(n, 0);
+    std::vector<size_t> counts(1, 1);
+    for (size_t i = 1; i < n; ++i)
+    {
+        depths[i] = depths[parents_[i]] + 1;
+        if (depths[i] >= (int)counts.size())
+        {
+            counts.push_back(0);
+        }
+        ++counts[depths[i]];
+    }
+
+    int splitDepth = -1;
+    for (size_t d = 1; d < counts.size(); ++d)
+    {
+        if (counts[d] >= MinParallelTasks)
+        {
+            splitDepth = (int)d;
+            break;
+        }
+    }
+
+    if (splitDepth > 0)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (depths[i] < splitDepth)
+            {
+                serialNodes_.push_back((int)i);
+            }
+            else if (depths[i] == splitDepth)
+            {
+                taskRoots_.push_back((int)i);
+            }
+        }
+    }
+}
+
+bool TransformHierarchy::updateNode(int index)
+{
+    int parent = parents_[index];
+    uint8_t changed = dirty_[index] | (parent >= 0 ? changed_[parent] : 0);
+    changed_[index] = changed;
+    if (!changed)
+    {
+        return false;
+    }
+
+    dirty_[index] = 0;
+    const Matrix &local = nodes_[index]->getModelMatrix();
+    if (parent >= 0)
+    {
+        worldMatrices_[index].multiply(local, worldMatrices_[parent]);
+    }
+    else
+    {
+        worldMatrices_[index] = local;
+    }
+    return true;
+}
+
+size_t TransformHierarchy::updateSubtree(int root)
+{
+    PROFILE_SCOPE("TransformHierarchy::updateSubtree");
+    size_t nUpdated = 0;
+    int end = subtreeEnds_[root];
+    for (int i = root; i < end; ++i)
+    {
+        nUpdated += updateNode(i) ? 1 : 0;
+    }
+    return nUpdated;
+}
+
+bool TransformHierarchy::update(ThreadPool *pool)
+{
+    PROFILE_SCOPE("TransformHierarchy::update");
+    if (structureDirty_)
+    {
+        build();
+    }
+
+    if (!anyDirty_)
+    {
+        // 清除上一次update留下的changed_标记
+        if (nUpdated_ > 0)
+        {
+            memset(changed_.data(), 0, changed_.size());
+            nUpdated_ = 0;
+        }
+        refreshBounds();
+        return false;
+    }
+    anyDirty_ = false;
+    nUpdated_ = 0;
+
+    if (pool == nullptr || taskRoots_.empty() || nodes_.size() < parallelThreshold_)
+    {
+        nUpdated_ = updateSubtree(0);
+    }
+    else
+    {
+        for (int i : serialNodes_)
+        {
+            nUpdated_ += updateNode(i) ? 1 : 0;
+        }
+
+        // 划分深度上的子树互不相交，可以并行更新
+        std::atomic<size_t> nUpdated(0);
+        size_t grain = std::max<size_t>(1, taskRoots_.size() / (pool->getNumThreads() * 4 + 1));
+        pool->parallelFor(taskRoots_.size(), grain, [this, &nUpdated](size_t begin, size_t end)
+        {
+            size_t n = 0;
+            for (size_t i = begin; i < end; ++i)
+            {
+                n += updateSubtree(taskRoots_[i]);
+            }
+            nUpdated += n;
+        });
+        nUpdated_ += nUpdated;
+    }
+
+    refreshBounds();
+    return nUpdated_ > 0;
+}
+
+void TransformHierarchy::refreshBounds()
+{
+    // 只移动了的结点和包围盒变化了的结点都需要更新代理，后者在下面统一处理
+    if (nUpdated_ > 0)
+    {
+        for (size_t i = 0; i < nodes_.size(); ++i)
+        {
+            if (changed_[i] && !boundsDirty_[i])
+            {
+                refreshProxy((int)i);
+            }
+        }
+    }
+
+    for (int i : dirtyBounds_)
+    {
+        boundsDirty_[i] = 0;
+        refreshProxy(i);
+    }
+    dirtyBounds_.clear();
+}
+
+void TransformHierarchy::refreshProxy(int index)
+{
+    Transform *node = nodes_[index];
+    int &proxy = proxies_[index];
+
+    bool bounded = false;
+    bool unbounded = false;
+    if (node != nullptr && node->hasComponents())
+    {
+        if (node->boundsFlags_ & Transform::BOUNDS_DIRTY)
+        {
+            node->updateBounds();
+        }
+
+        // 包围盒为空的结点开启裁剪时不会被绘制，与Transform::draw一致
+        unbounded = (node->boundsFlags_ & Transform::BOUNDS_OWN_INFINITE) != 0;
+        bounded = !unbounded && node->ownBounds_.isValid();
+    }
+
+    if (unbounded_[index] != (unbounded ? 1 : 0))
+    {
+        unbounded_[index] = unbounded ? 1 : 0;
+        unboundedDirty_ = true;
+    }
+
+    if (!bounded)
+    {
+        if (proxy != DynamicAABBTree::NullNode)
+        {
+            tree_.destroyProxy(proxy);
+            proxy = DynamicAABBTree::NullNode;
+        }
+        worldBounds_[index].setEmpty();
+        return;
+    }
+
+    AABB bounds = node->ownBounds_;
+    bounds.applyMatrix(worldMatrices_[index]);
+
+    if (proxy == DynamicAABBTree::NullNode)
+    {
+        proxy = tree_.createProxy(bounds, reinterpret_cast<void*>(intptr_t(index)));
+    }
+    else
+    {
+        tree_.moveProxy(proxy, bounds, bounds.getCenter() - worldBounds_[index].getCenter());
+    }
+    worldBounds_[index] = bounds;
+}
+
+void TransformHierarchy::draw(Renderer *renderer)
+{
+    PROFILE_SCOPE("TransformHierarchy::draw");
+    // 父空间为单位矩阵时(通常如此)，可以省掉一次矩阵乘法
+    Matrix parentMatrix = renderer->getWorldMatrix();
+    bool isIdentity = memcmp(&parentMatrix, &Matrix::Identity, sizeof(Matrix)) == 0;
+
+    bool culling = renderer->isCullingEnable();
+    if (culling && isIdentity)
+    {
+        drawVisible(renderer);
+        return;
+    }
+
+    Renderer::CullStats &stats = renderer->getCullStats();
+    // [i, insideEnd)中的结点已经确定完全在视锥内，不需要测试
+    int insideEnd = 0;
+
+    renderer->pushMatrix();
+    Matrix world;
+    for (int i = 0; i < (int)nodes_.size(); ++i)
+    {
+        Transform *node = nodes_[i];
+        if (node == nullptr)
+        {
+            continue;
+        }
+
+        bool testBounds = culling && i >= insideEnd;
+        if (!testBounds && !node->hasComponents())
+        {
+            continue;
+        }
+
+        if (isIdentity)
+        {
+            world = worldMatrices_[i];
+        }
+        else
+        {
+            world = worldMatrices_[i] * parentMatrix;
+        }
+
+        if (testBounds)
+        {
+            if (node->boundsFlags_ & Transform::BOUNDS_DIRTY)
+            {
+                node->updateBounds();
+            }
+
+            if (!(node->boundsFlags_ & Transform::BOUNDS_SUBTREE_INFINITE))
+            {
+                Frustum::Result result = renderer->cullBounds(node->subtreeBounds_, world);
+                if (result == Frustum::OUTSIDE)
+                {
+                    // 跳过整棵子树
+                    stats.nCulled += node->nDrawables_;
+                    i = subtreeEnds_[i] - 1;
+                    continue;
+                }
+                if (result == Frustum::INSIDE)
+                {
+                    insideEnd = subtreeEnds_[i];
+                    testBounds = false;
+                }
+            }
+
+            if (!node->hasComponents())
+            {
+                continue;
+            }
+
+            if (testBounds && subtreeEnds_[i] > i + 1 && !(node->boundsFlags_ & Transform::BOUNDS_OWN_INFINITE) &&
+                renderer->cullBounds(node->ownBounds_, world) == Frustum::OUTSIDE)
+            {
+                ++stats.nCulled;
+                continue;
+            }
+        }
+
+        renderer->setWorldMatrix(world);
+        node->drawComponents(renderer);
+    }
+    renderer->popMatrix();
+}
+
+void TransformHierarchy::drawVisible(Renderer *renderer)
+{
+    // update之后又有组件发生了变化
+    if (!dirtyBounds_.empty())
+    {
+        refreshBounds();
+    }
+
+    Renderer::CullStats &stats = renderer->getCullStats();
+
+    // 树中保存的是胖包围盒，部分相交的代理再用组件的包围盒精确测试一次。有遮挡剔除时，完全在视锥内的也要测试
+    bool occlusion = renderer->getOcclusionCuller() != nullptr;
+    visible_.clear();
+    stats.nTests += tree_.queryFrustum(renderer->getFrustum(), [this, renderer, occlusion](int proxy, bool inside)
+    {
+        int index = (int)reinterpret_cast<intptr_t>(tree_.getUserData(proxy));
+        Transform *node = nodes_[index];
+        if ((inside && !occlusion) ||
+            renderer->cullBounds(node->ownBounds_, worldMatrices_[index]) != Frustum::OUTSIDE)
+        {
+            visible_.push_back(index);
+        }
+        return true;
+    });
+    stats.nCulled += tree_.getProxyCount() - visible_.size();
+
+    if (unboundedDirty_)
+    {
+        unboundedDirty_ = false;
+        unboundedNodes_.clear();
+        for (size_t i = 0; i < unbounded_.size(); ++i)
+        {
+            if (unbounded_[i])
+            {
+                unboundedNodes_.push_back((int)i);
+            }
+        }
+    }
+    visible_.insert(visible_.end(), unboundedNodes_.begin(), unboundedNodes_.end());
+
+    // 恢复深度优先的绘制顺序
+    std::sort(visible_.begin(), visible_.end());
+
+    renderer->pushMatrix();
+    for (int i : visible_)
+    {
+        renderer->setWorldMatrix(worldMatrices_[i]);
+        nodes_[i]->drawComponents(renderer);
+    }
+    renderer->popMatrix();
+}
+
+void TransformHierarchy::queryAABB(const AABB &bounds, std::vector<int> &result) const
+{
+    tree_.queryAABB(bounds, [this, &bounds, &result](int proxy)
+    {
+        int index = (int)reinterpret_cast<intptr_t>(tree_.getUserData(proxy));
+        if (worldBounds_[index].intersect(bounds))
+        {
+            result.push_back(index);
+        }
+        return true;
+    });
+}
+
+void TransformHierarchy::queryFrustum(const Frustum &frustum, std::vector<int> &result) const
+{
+    tree_.queryFrustum(frustum, [this, &frustum, &result](int proxy, bool inside)
+    {
+        int index = (int)reinterpret_cast<intptr_t>(tree_.getUserData(proxy));
+        if (inside || frustum.intersectAABB(worldBounds_[index]) != Frustum::OUTSIDE)
+        {
+            result.push_back(index);
+        }
+        return true;
+    });
+}
+
+int TransformHierarchy::rayCast(const Ray &ray, float tMax, float *outT) const
+{
+    PrecomputedRay pray(ray);
+    int best = -1;
+    float bestT = tMax;
+    tree_.rayCast(ray, tMax, [this, &pray, &best, &bestT](int proxy, float tMax)
+    {
+        int index = (int)reinterpret_cast<intptr_t>(tree_.getUserData(proxy));
+        float tNear, tFar;
+        if (pray.intersectAABB(worldBounds_[index], tMax, tNear, tFar) && tNear < bestT)
+        {
+            best = index;
+            bestT = tNear;
+            return tNear;
+        }
+        return tMax;
+    });
+
+    if (outT != nullptr && best >= 0)
+    {
+        *outT = bestT;
+    }
+    return best;
+}
+
+int TransformHierarchy::queryNearest(const Vector3 &point, float maxDistance, float *outDistance) const
+{
+    int proxy = tree_.queryNearest(point, maxDistance, [this, &point](int proxy)
+    {
+        int index = (int)reinterpret_cast<intptr_t>(tree_.getUserData(proxy));
+        return sqrtf(worldBounds_[index].distanceSquared(point));
+    }, outDistance);
+
+    if (proxy == DynamicAABBTree::NullNode)
+    {
+        return -1;
+    }
+    return (int)reinterpret_cast<intptr_t>(tree_.getUserData(proxy));
+}
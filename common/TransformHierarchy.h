@@ -0,0 +1,171 @@
+#pragma once
+
+#include "Transform.h"
+#include "DynamicAABBTree.h"
+#include <vector>
+#include <cstdint>
+
+class ThreadPool;
+class Renderer;
+class Frustum;
+class Ray;
+
+/** 扁平化的Transform层次结构。
+ *  将以root为根的子树按深度优先的顺序展开到连续的数组中(父结点总是在子结点之前)，
+ *  每帧调用update，只重新计算局部矩阵发生变化的结点及其子孙结点的世界矩阵。
+ *  结点数量足够多时，不同的子树会在线程池中并行更新。
+ *
+ *  世界矩阵是相对于root的父空间的，root本身的模型矩阵也包含在内。
+ *  Transform的局部矩阵修改、子结点增删，都会自动通知所在的层次结构，下一次update时生效。
+ *  update期间不能修改层次结构中的Transform。
+ *
+ *  有组件包围盒的结点会自动注册到一棵DynamicAABBTree中，代理的包围盒是世界空间中的包围盒，
+ *  在update时随着世界矩阵或组件的变化增量更新。绘制时的视锥裁剪和场景查询都在这棵树上进行。
+ */
+class TransformHierarchy
+{
+    TransformHierarchy(const TransformHierarchy &);
+    const TransformHierarchy & operator = (const TransformHierarchy &);
+
+public:
+    TransformHierarchy();
+    ~TransformHierarchy();
+
+    void setRoot(TransformPtr root);
+    TransformPtr getRoot() const { return root_; }
+
+    /** 更新所有脏结点的世界矩阵。结构发生过变化时，会先重新展开。
+     *  @param pool 为空，或者结点数量较少时，在当前线程中更新。
+     *  @return 是否有结点被更新。
+     */
+    bool update(ThreadPool *pool = nullptr);
+
+    /** 按深度优先的顺序绘制所有结点的组件，与Transform::draw的顺序一致，但不需要递归和矩阵栈的累乘。
+     *  开启了视锥裁剪时，用包围盒树查询可见的结点；父空间不是单位矩阵时，退回到用结点缓存的子树包围盒测试。
+     *  调用之前需要先update。
+     */
+    void draw(Renderer *renderer);
+
+    /** 是否所有的世界矩阵都是最新的。*/
+    bool isUpToDate() const { return !structureDirty_ && !anyDirty_; }
+
+    size_t size() const { return nodes_.size(); }
+
+    const std::vector<Transform*>& getNodes() const { return nodes_; }
+    /** 父结点的下标。根结点为-1。*/
+    const std::vector<int>& getParents() const { return parents_; }
+    /** 子树的结束下标(不包含)。结点i的子树为[i, getSubtreeEnds()[i])。*/
+    const std::vector<int>& getSubtreeEnds() const { return subtreeEnds_; }
+
+    /** 所有结点的世界矩阵，下标与getNodes()相同。渲染和裁剪可以直接遍历这个数组。*/
+    const std::vector<Matrix>& getWorldMatrices() const { return worldMatrices_; }
+    const Matrix& getWorldMatrix(int index) const { return worldMatrices_[index]; }
+
+    /** 结点的世界矩阵在最近一次update中是否被重新计算过。可以用于只更新移动过的物体的包围盒等。*/
+    bool isChanged(int index) const { return changed_[index] != 0; }
+
+    /** 最近一次update重新计算的结点数量。*/
+    size_t getNumUpdated() const { return nUpdated_; }
+
+    /** 结点数量少于此值时，不使用线程池。*/
+    void setParallelThreshold(size_t threshold) { parallelThreshold_ = threshold; }
+
+    /** 场景查询。坐标都在root的父空间中，结果是结点的下标，没有包围盒的结点不参与查询。*/
+
+    /** 世界包围盒与bounds相交的结点。*/
+    void queryAABB(const AABB &bounds, std::vector<int> &result) const;
+
+    /** 与视锥相交的结点。*/
+    void queryFrustum(const Frustum &frustum, std::vector<int> &result) const;
+
+    /** 世界包围盒与射线相交的最近的结点，没有时返回-1。
+     *  @param outT 返回射线进入包围盒的距离。
+     */
+    int rayCast(const Ray &ray, float tMax, float *outT = nullptr) const;
+
+    /** 世界包围盒距离point最近的结点，maxDistance范围内没有时返回-1。*/
+    int queryNearest(const Vector3 &point, float maxDistance, float *outDistance = nullptr) const;
+
+    /** 结点在世界空间中的包围盒。没有包围盒的结点为空。*/
+    const AABB& getWorldBounds(int index) const { return worldBounds_[index]; }
+
+    /** 包围盒树，代理的用户数据是结点的下标。*/
+    const DynamicAABBTree& getSpatialIndex() const { return tree_; }
+
+private:
+    friend class Transform;
+
+    /** 结点的局部矩阵发生了变化。*/
+    void setDirty(int index)
+    {
+        dirty_[index] = 1;
+        anyDirty_ = true;
+    }
+
+    /** 结点的组件或组件的包围盒发生了变化。*/
+    void setBoundsDirty(int index)
+    {
+        if (!structureDirty_ && !boundsDirty_[index])
+        {
+            boundsDirty_[index] = 1;
+            dirtyBounds_.push_back(index);
+        }
+    }
+
+    /** 子结点有增删，下一次update时重新展开。*/
+    void setStructureDirty() { structureDirty_ = true; }
+
+    /** 结点被销毁了。*/
+    void onTransformDestroyed(int index);
+
+    void build();
+    void clear();
+
+    /** 更新结点的世界矩阵(如果需要)。父结点必须已经处理过。返回是否重新计算了。*/
+    bool updateNode(int index);
+    /** 按顺序处理子树中的所有结点。返回重新计算的数量。*/
+    size_t updateSubtree(int root);
+
+    /** 更新世界矩阵或包围盒发生了变化的结点在包围盒树中的代理。*/
+    void refreshBounds();
+    void refreshProxy(int index);
+
+    /** 用包围盒树做视锥裁剪并绘制。*/
+    void drawVisible(Renderer *renderer);
+
+    TransformPtr                root_;
+
+    std::vector<Transform*>     nodes_;
+    std::vector<int>            parents_;
+    std::vector<int>            subtreeEnds_;
+    std::vector<Matrix>         worldMatrices_;
+    /// 局部矩阵被修改过，由Transform设置
+    std::vector<uint8_t>        dirty_;
+    /// 最近一次update中世界矩阵被重新计算过
+    std::vector<uint8_t>        changed_;
+
+    /** 并行更新时的划分：深度小于划分深度的结点在当前线程中串行更新，
+     *  然后每个位于划分深度的子树作为一个任务并行更新。
+     */
+    std::vector<int>            serialNodes_;
+    std::vector<int>            taskRoots_;
+
+    DynamicAABBTree             tree_;
+    /// 结点在树中的代理，没有时为-1
+    std::vector<int>            proxies_;
+    std::vector<AABB>           worldBounds_;
+    /// 有组件但没有包围盒的结点，总是要绘制
+    std::vector<uint8_t>        unbounded_;
+    std::vector<int>            unboundedNodes_;
+    bool                        unboundedDirty_;
+    /// 包围盒需要重新计算的结点，由Transform设置
+    std::vector<uint8_t>        boundsDirty_;
+    std::vector<int>            dirtyBounds_;
+    /// 绘制时可见结点的临时数组
+    std::vector<int>            visible_;
+
+    bool                        structureDirty_;
+    bool                        anyDirty_;
+    size_t                      nUpdated_;
+    size_t                      parallelThreshold_;
+};
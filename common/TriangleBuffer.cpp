@@ -0,0 +1,220 @@
+#include "TriangleBuffer.h"
+#include "MeshFaceVisitor.h"
+#include "Mesh.h"
+#include "Matrix.h"
+#include "Ray.h"
+#include "LogTool.h"
+
+namespace
+{
+    /** 将模型的三角形添加到TriangleBuffer中。*/
+    class TriangleBufferVisitor : public MeshFaceVisitor
+    {
+    public:
+        TriangleBuffer &buffer_;
+        /// 已经变换到世界空间的顶点坐标
+        const Vector3 * positions_;
+        const char *    vertexData_;
+        size_t          vertexStride_;
+        int             materialOffset_;
+
+        TriangleBufferVisitor(TriangleBuffer &buffer, const Vector3 *positions, const char *vertexData, size_t vertexStride, int materialOffset)
+            : buffer_(buffer)
+            , positions_(positions)
+            , vertexData_(vertexData)
+            , vertexStride_(vertexStride)
+            , materialOffset_(materialOffset)
+        {}
+
+        virtual bool visit(const SubMesh *pSubMesh, const char **triangle) override
+        {
+            Vector3 p[3];
+            uint32_t indices[3];
+            for (int i = 0; i < 3; ++i)
+            {
+                indices[i] = uint32_t((triangle[i] - vertexData_) / vertexStride_);
+                p[i] = positions_[indices[i]];
+            }
+            buffer_.addTriangle(p[0], p[1], p[2], pSubMesh->getMaterialID() + materialOffset_, indices);
+            return true;
+        }
+    };
+}
+
+TriangleBuffer::TriangleBuffer()
+    : count_(0)
+{
+    boundingBox_.setEmpty();
+}
+
+TriangleBuffer::~TriangleBuffer()
+{
+}
+
+void TriangleBuffer::clear()
+{
+    packets_.clear();
+    normals_.clear();
+    materialIDs_.clear();
+    indices_.clear();
+    count_ = 0;
+    boundingBox_.setEmpty();
+}
+
+void TriangleBuffer::reserve(size_t nTriangles)
+{
+    packets_.reserve((nTriangles + PacketWidth - 1) / PacketWidth);
+    normals_.reserve(nTriangles);
+    materialIDs_.reserve(nTriangles);
+    indices_.reserve(nTriangles * 3);
+}
+
+uint32_t TriangleBuffer::addMesh(const Mesh *mesh, const Matrix &localToWorld, int materialOffset)
+{
+    uint32_t first = (uint32_t)count_;
+
+    VertexBufferPtr vb = mesh->getVertexBuffer();
+    if (!vb)
+    {
+        return first;
+    }
+
+    // 顶点索引由顶点指针还原，需要浮点格式的位置
+    if (mesh->hasPositionDecode())
+    {
+        LOG_ERROR("TriangleBuffer doesn't support meshes with packed vertices.");
+        return first;
+    }
+
+    IndexBufferPtr ib = mesh->getIndexBuffer();
+    reserve(count_ + (ib ? ib->count() : vb->count()) / 3);
+
+    // 用于将顶点指针还原成顶点索引
+    const char *vertexData = vb->lock(true);
+
+    // 每个顶点只变换一次，而不是每个三角形变换3次
+    std::vector<Vector3> positions(vb->count());
+    localToWorld.transformPoints(positions.data(), vertexData, vb->stride(), positions.size());
+
+    TriangleBufferVisitor visitor(*this, positions.data(), vertexData, vb->stride(), materialOffset);
+    mesh->iterateFaces(visitor);
+    vb->unlock();
+
+    return first;
+}
+
+uint32_t TriangleBuffer::addTriangle(const Vector3 &a, const Vector3 &b, const Vector3 &c, int materialID, const uint32_t *indices)
+{
+    uint32_t index = (uint32_t)count_++;
+
+    int lane = index % PacketWidth;
+    if (lane == 0)
+    {
+        packets_.push_back(Packet());
+    }
+    packets_.back().setTriangle(lane, a, b, c);
+
+    // 与MeshInfo及isFrontFace的约定一致：(c - a) x (b - a)
+    Vector3 normal;
+    normal.crossProduct(c - a, b - a);
+    normal.normalize();
+    normals_.push_back(normal);
+
+    materialIDs_.push_back(materialID);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        indices_.push_back(indices ? indices[i] : index * 3 + i);
+    }
+
+    boundingBox_.addPoint(a);
+    boundingBox_.addPoint(b);
+    boundingBox_.addPoint(c);
+    return index;
+}
+
+Vector3 TriangleBuffer::getVertex(uint32_t triangle, int k) const
+{
+    const Packet &packet = packets_[triangle / PacketWidth];
+    int lane = triangle % PacketWidth;
+
+    Vector3 ret(packet.v0[0][lane], packet.v0[1][lane], packet.v0[2][lane]);
+    if (k == 1)
+    {
+        ret += Vector3(packet.e1[0][lane], packet.e1[1][lane], packet.e1[2][lane]);
+    }
+    else if (k == 2)
+    {
+        ret += Vector3(packet.e2[0][lane], packet.e2[1][lane], packet.e2[2][lane]);
+    }
+    return ret;
+}
+
+AABB TriangleBuffer::getTriangleBounds(uint32_t triangle) const
+{
+    AABB ab;
+    ab.setEmpty();
+    for (int k = 0; k < 3; ++k)
+    {
+        ab.addPoint(getVertex(triangle, k));
+    }
+    return ab;
+}
+
+bool TriangleBuffer::intersectTriangle(uint32_t triangle, const Ray &ray, float &t, float &u, float &v) const
+{
+    const Packet &packet = packets_[triangle / PacketWidth];
+    int lane = triangle % PacketWidth;
+
+    return intersectTriangleEdges(ray,
+        Vector3(packet.v0[0][lane], packet.v0[1][lane], packet.v0[2][lane]),
+        Vector3(packet.e1[0][lane], packet.e1[1][lane], packet.e1[2][lane]),
+        Vector3(packet.e2[0][lane], packet.e2[1][lane], packet.e2[2][lane]),
+        t, u, v);
+}
+
+int TriangleBuffer::intersect(const Ray &ray, float &tMax, float &u, float &v) const
+{
+    int ret = -1;
+    PacketHit<PacketWidth> hit;
+    for (size_t i = 0; i < packets_.size(); ++i)
+    {
+        int mask = intersectTrianglePacket(ray, packets_[i], hit);
+        if (mask == 0)
+        {
+            continue;
+        }
+
+        int lane = findClosestHit(mask, hit, tMax);
+        if (lane >= 0)
+        {
+            ret = int(i * PacketWidth + lane);
+            tMax = hit.t[lane];
+            u = hit.u[lane];
+            v = hit.v[lane];
+        }
+    }
+    return ret;
+}
+
+bool TriangleBuffer::intersectAny(const Ray &ray, float tMax) const
+{
+    PacketHit<PacketWidth> hit;
+    for (const Packet &packet : packets_)
+    {
+        int mask = intersectTrianglePacket(ray, packet, hit);
+        if (mask != 0 && findClosestHit(mask, hit, tMax) >= 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t TriangleBuffer::getMemorySize() const
+{
+    return packets_.capacity() * sizeof(Packet)
+        + normals_.capacity() * sizeof(Vector3)
+        + materialIDs_.capacity() * sizeof(int)
+        + indices_.capacity() * sizeof(uint32_t);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "TrianglePacket.h"
+#include "AlignedAllocator.h"
+#include "AABB.h"
+#include <vector>
+#include <cstdint>
+
+class Mesh;
+class Matrix;
+class Ray;
+
+/** SoA布局的三角形缓冲区。
+ *  将模型的三角形展开到世界空间，每8个三角形打包成一个TrianglePacket8，按缓存行对齐。
+ *  边向量、法线和材质ID都是预先计算好的，求交和着色只需要读取连续的内存，不需要再通过索引访问顶点。
+ *  可用于拾取、光线追踪，以及阴影体的提取(通过法线判断朝向，通过原始索引查找邻接边)。
+ */
+class TriangleBuffer
+{
+public:
+    typedef TrianglePacket8 Packet;
+    typedef std::vector<Packet, AlignedAllocator<Packet>> Packets;
+    enum { PacketWidth = Packet::Width };
+
+    TriangleBuffer();
+    ~TriangleBuffer();
+
+    void clear();
+    void reserve(size_t nTriangles);
+
+    /** 添加模型中所有的三角形列表。不支持packMeshVertices压缩过的模型。
+     *  @param localToWorld     顶点会先经过此矩阵变换。
+     *  @param materialOffset   加到子模型的材质ID上。合并多个模型时，用于区分各自的材质。
+     *  @return 添加的第一个三角形的编号。
+     */
+    uint32_t addMesh(const Mesh *mesh, const Matrix &localToWorld, int materialOffset = 0);
+
+    /** 添加一个三角形。
+     *  @param indices  三角形在原模型中的顶点索引，可以为空。
+     *  @return 三角形的编号。
+     */
+    uint32_t addTriangle(const Vector3 &a, const Vector3 &b, const Vector3 &c, int materialID, const uint32_t *indices = nullptr);
+
+    /** 三角形的数量。*/
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+    /** 最后一个包中，未使用的通道是退化三角形，可以直接参与求交。*/
+    const Packets& getPackets() const { return packets_; }
+
+    /** 三角形的第k个顶点。后两个顶点由边向量还原，与原始数据可能有舍入误差。*/
+    Vector3 getVertex(uint32_t triangle, int k) const;
+    const Vector3& getNormal(uint32_t triangle) const { return normals_[triangle]; }
+    int getMaterialID(uint32_t triangle) const { return materialIDs_[triangle]; }
+    const uint32_t* getIndices(uint32_t triangle) const { return &indices_[triangle * 3]; }
+
+    AABB getTriangleBounds(uint32_t triangle) const;
+
+    /** 所有三角形的包围盒。*/
+    const AABB& getBoundingBox() const { return boundingBox_; }
+
+    /** 射线与单个三角形求交。*/
+    bool intersectTriangle(uint32_t triangle, const Ray &ray, float &t, float &u, float &v) const;
+
+    /** 遍历所有三角形，查找最近的交点。适用于没有加速结构的拾取。
+     *  @param tMax 输入为最大的查找距离，如果相交，返回最近交点的距离。
+     *  @return 相交三角形的编号。不相交返回-1。
+     */
+    int intersect(const Ray &ray, float &tMax, float &u, float &v) const;
+
+    /** 射线在tMax距离内是否与任意三角形相交。*/
+    bool intersectAny(const Ray &ray, float tMax) const;
+
+    /** 占用的内存字节数。*/
+    size_t getMemorySize() const;
+
+private:
+    Packets                 packets_;
+    std::vector<Vector3>    normals_;
+    std::vector<int>        materialIDs_;
+    std::vector<uint32_t>   indices_;
+    size_t                  count_;
+    AABB                    boundingBox_;
+};
@@ -0,0 +1,275 @@
+#include "TrianglePacket.h"
+#include "Ray.h"
+#include "MathDef.h"
+#include <cstring>
+#include <cstdint>
+
+#if defined(MATH_SIMD_SSE) || defined(MATH_SIMD_AVX2)
+#include <immintrin.h>
+#endif
+
+/* 注意：要与标量版本逐位相同，编译时不能将乘加合并成FMA指令(-ffp-contract=off)。*/
+
+namespace
+{
+    /** 与Ray::intersectTriangle中的判断保持一致。*/
+    const float DetEpsilon = 0.0001f;
+
+    /** 标量版本，一次处理一个通道。比较的结果用全1的位模式表示。*/
+    struct Float1
+    {
+        enum { Width = 1 };
+        float v;
+
+        static Float1 load(const float *p) { Float1 r = { *p }; return r; }
+        static Float1 set(float x) { Float1 r = { x }; return r; }
+        void store(float *p) const { *p = v; }
+
+        static uint32_t bits(float x) { uint32_t r; memcpy(&r, &x, 4); return r; }
+        static Float1 fromBits(uint32_t x) { Float1 r; memcpy(&r.v, &x, 4); return r; }
+        static Float1 fromBool(bool b) { return fromBits(b ? 0xffffffffu : 0u); }
+
+        Float1 operator + (Float1 b) const { return set(v + b.v); }
+        Float1 operator - (Float1 b) const { return set(v - b.v); }
+        Float1 operator * (Float1 b) const { return set(v * b.v); }
+        Float1 operator / (Float1 b) const { return set(v / b.v); }
+        Float1 operator ^ (Float1 b) const { return fromBits(bits(v) ^ bits(b.v)); }
+        Float1 operator & (Float1 b) const { return fromBits(bits(v) & bits(b.v)); }
+        Float1 operator | (Float1 b) const { return fromBits(bits(v) | bits(b.v)); }
+
+        /** ~a & b */
+        static Float1 andnot(Float1 a, Float1 b) { return fromBits(~bits(a.v) & bits(b.v)); }
+        static Float1 less(Float1 a, Float1 b) { return fromBool(a.v < b.v); }
+        static Float1 greater(Float1 a, Float1 b) { return fromBool(a.v > b.v); }
+        static int movemask(Float1 a) { return int(bits(a.v) >> 31); }
+    };
+
+#if defined(MATH_SIMD_SSE)
+    struct Float4
+    {
+        enum { Width = 4 };
+        __m128 v;
+
+        static Float4 make(__m128 x) { Float4 r; r.v = x; return r; }
+        static Float4 load(const float *p) { return make(_mm_loadu_ps(p)); }
+        static Float4 set(float x) { return make(_mm_set1_ps(x)); }
+        void store(float *p) const { _mm_storeu_ps(p, v); }
+
+        Float4 operator + (Float4 b) const { return make(_mm_add_ps(v, b.v)); }
+        Float4 operator - (Float4 b) const { return make(_mm_sub_ps(v, b.v)); }
+        Float4 operator * (Float4 b) const { return make(_mm_mul_ps(v, b.v)); }
+        Float4 operator / (Float4 b) const { return make(_mm_div_ps(v, b.v)); }
+        Float4 operator ^ (Float4 b) const { return make(_mm_xor_ps(v, b.v)); }
+        Float4 operator & (Float4 b) const { return make(_mm_and_ps(v, b.v)); }
+        Float4 operator | (Float4 b) const { return make(_mm_or_ps(v, b.v)); }
+
+        static Float4 andnot(Float4 a, Float4 b) { return make(_mm_andnot_ps(a.v, b.v)); }
+        static Float4 less(Float4 a, Float4 b) { return make(_mm_cmplt_ps(a.v, b.v)); }
+        static Float4 greater(Float4 a, Float4 b) { return make(_mm_cmpgt_ps(a.v, b.v)); }
+        static int movemask(Float4 a) { return _mm_movemask_ps(a.v); }
+    };
+#endif
+
+#if defined(MATH_SIMD_AVX2)
+    struct Float8
+    {
+        enum { Width = 8 };
+        __m256 v;
+
+        static Float8 make(__m256 x) { Float8 r; r.v = x; return r; }
+        static Float8 load(const float *p) { return make(_mm256_loadu_ps(p)); }
+        static Float8 set(float x) { return make(_mm256_set1_ps(x)); }
+        void store(float *p) const { _mm256_storeu_ps(p, v); }
+
+        Float8 operator + (Float8 b) const { return make(_mm256_add_ps(v, b.v)); }
+        Float8 operator - (Float8 b) const { return make(_mm256_sub_ps(v, b.v)); }
+        Float8 operator * (Float8 b) const { return make(_mm256_mul_ps(v, b.v)); }
+        Float8 operator / (Float8 b) const { return make(_mm256_div_ps(v, b.v)); }
+        Float8 operator ^ (Float8 b) const { return make(_mm256_xor_ps(v, b.v)); }
+        Float8 operator & (Float8 b) const { return make(_mm256_and_ps(v, b.v)); }
+        Float8 operator | (Float8 b) const { return make(_mm256_or_ps(v, b.v)); }
+
+        static Float8 andnot(Float8 a, Float8 b) { return make(_mm256_andnot_ps(a.v, b.v)); }
+        // 使用有序、不触发异常的比较，与标量的<和>语义相同(NaN返回false)
+        static Float8 less(Float8 a, Float8 b) { return make(_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)); }
+        static Float8 greater(Float8 a, Float8 b) { return make(_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)); }
+        static int movemask(Float8 a) { return _mm256_movemask_ps(a.v); }
+    };
+#endif
+
+#if defined(MATH_SIMD_AVX2)
+    typedef Float8 FloatWide8;
+#elif defined(MATH_SIMD_SSE)
+    typedef Float4 FloatWide8;
+#else
+    typedef Float1 FloatWide8;
+#endif
+
+#if defined(MATH_SIMD_SSE)
+    typedef Float4 FloatWide4;
+#else
+    typedef Float1 FloatWide4;
+#endif
+
+    /** Möller–Trumbore求交，逐条指令与Ray::intersectTriangle对应。
+     *  标量版本在det <= 0时，改用a - origin并将det取反，这里按通道选择T。
+     *  不能统一使用origin - a再翻转u, v, t的符号位：结果为0时，翻转得到的是-0，与标量版本的+0不同。
+     */
+    template<typename F>
+    inline int intersectKernel(const F o[3], const F d[3], const F a[3], const F e1[3], const F e2[3],
+        F &outT, F &outU, F &outV)
+    {
+        const F zero = F::set(0.0f);
+
+        // P = D x E2
+        F px = d[1] * e2[2] - d[2] * e2[1];
+        F py = d[2] * e2[0] - d[0] * e2[2];
+        F pz = d[0] * e2[1] - d[1] * e2[0];
+
+        F det = e1[0] * px + e1[1] * py + e1[2] * pz;
+
+        // det > 0的通道T = origin - a，其余(包括NaN)T = a - origin，并将det取反
+        F positive = F::greater(det, zero);
+        det = det ^ F::andnot(positive, F::set(-0.0f));
+
+        F tx = (positive & (o[0] - a[0])) | F::andnot(positive, a[0] - o[0]);
+        F ty = (positive & (o[1] - a[1])) | F::andnot(positive, a[1] - o[1]);
+        F tz = (positive & (o[2] - a[2])) | F::andnot(positive, a[2] - o[2]);
+
+        F u = tx * px + ty * py + tz * pz;
+
+        // Q = T x E1
+        F qx = ty * e1[2] - tz * e1[1];
+        F qy = tz * e1[0] - tx * e1[2];
+        F qz = tx * e1[1] - ty * e1[0];
+
+        F v = d[0] * qx + d[1] * qy + d[2] * qz;
+        F t = e2[0] * qx + e2[1] * qy + e2[2] * qz;
+
+        F reject = F::less(det, F::set(DetEpsilon))
+            | F::less(u, zero) | F::greater(u, det)
+            | F::less(v, zero) | F::greater(u + v, det)
+            | F::less(t, zero);
+
+        F invDet = F::set(1.0f) / det;
+        outT = t * invDet;
+        outU = u * invDet;
+        outV = v * invDet;
+
+        return ~F::movemask(reject) & ((1 << F::Width) - 1);
+    }
+
+    template<typename F, int N>
+    int intersectTrianglesImpl(const Ray &ray, const TrianglePacket<N> &tris, PacketHit<N> &hit)
+    {
+        F o[3], d[3];
+        for (int k = 0; k < 3; ++k)
+        {
+            o[k] = F::set(ray.origin_[k]);
+            d[k] = F::set(ray.direction_[k]);
+        }
+
+        int mask = 0;
+        for (int i = 0; i < N; i += F::Width)
+        {
+            F a[3], e1[3], e2[3];
+            for (int k = 0; k < 3; ++k)
+            {
+                a[k] = F::load(&tris.v0[k][i]);
+                e1[k] = F::load(&tris.e1[k][i]);
+                e2[k] = F::load(&tris.e2[k][i]);
+            }
+
+            F t, u, v;
+            mask |= intersectKernel(o, d, a, e1, e2, t, u, v) << i;
+            t.store(&hit.t[i]);
+            u.store(&hit.u[i]);
+            v.store(&hit.v[i]);
+        }
+        return mask;
+    }
+
+    template<typename F, int N>
+    int intersectRaysImpl(const RayPacket<N> &rays, const Vector3 &v0, const Vector3 &edge1, const Vector3 &edge2, PacketHit<N> &hit)
+    {
+        F a[3], e1[3], e2[3];
+        for (int k = 0; k < 3; ++k)
+        {
+            a[k] = F::set(v0[k]);
+            e1[k] = F::set(edge1[k]);
+            e2[k] = F::set(edge2[k]);
+        }
+
+        int mask = 0;
+        for (int i = 0; i < N; i += F::Width)
+        {
+            F o[3], d[3];
+            for (int k = 0; k < 3; ++k)
+            {
+                o[k] = F::load(&rays.origin[k][i]);
+                d[k] = F::load(&rays.direction[k][i]);
+            }
+
+            F t, u, v;
+            mask |= intersectKernel(o, d, a, e1, e2, t, u, v) << i;
+            t.store(&hit.t[i]);
+            u.store(&hit.u[i]);
+            v.store(&hit.v[i]);
+        }
+        return mask;
+    }
+}
+
+int intersectTrianglePacket(const Ray &ray, const TrianglePacket4 &tris, PacketHit4 &hit)
+{
+    return intersectTrianglesImpl<FloatWide4>(ray, tris, hit);
+}
+
+int intersectTrianglePacket(const Ray &ray, const TrianglePacket8 &tris, PacketHit8 &hit)
+{
+    return intersectTrianglesImpl<FloatWide8>(ray, tris, hit);
+}
+
+int intersectRayPacket(const RayPacket4 &rays, const Vector3 &a, const Vector3 &e1, const Vector3 &e2, PacketHit4 &hit)
+{
+    return intersectRaysImpl<FloatWide4>(rays, a, e1, e2, hit);
+}
+
+int intersectRayPacket(const RayPacket8 &rays, const Vector3 &a, const Vector3 &e1, const Vector3 &e2, PacketHit8 &hit)
+{
+    return intersectRaysImpl<FloatWide8>(rays, a, e1, e2, hit);
+}
+
+bool intersectTriangleEdges(const Ray &ray, const Vector3 &a, const Vector3 &e1, const Vector3 &e2, float &t, float &u, float &v)
+{
+    Float1 fo[3], fd[3], fa[3], fe1[3], fe2[3];
+    for (int k = 0; k < 3; ++k)
+    {
+        fo[k] = Float1::set(ray.origin_[k]);
+        fd[k] = Float1::set(ray.direction_[k]);
+        fa[k] = Float1::set(a[k]);
+        fe1[k] = Float1::set(e1[k]);
+        fe2[k] = Float1::set(e2[k]);
+    }
+
+    Float1 ft, fu, fv;
+    if (intersectKernel(fo, fd, fa, fe1, fe2, ft, fu, fv) == 0)
+    {
+        return false;
+    }
+    t = ft.v;
+    u = fu.v;
+    v = fv.v;
+    return true;
+}
+
+const char* getTrianglePacketISA()
+{
+#if defined(MATH_SIMD_AVX2)
+    return "AVX2";
+#elif defined(MATH_SIMD_SSE)
+    return "SSE";
+#else
+    return "Scalar";
+#endif
+}
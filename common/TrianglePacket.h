@@ -0,0 +1,134 @@
+#pragma once
+
+#include "Vector3.h"
+#include <float.h>
+
+class Ray;
+
+/** N个三角形打包成SoA布局。预先计算好边向量，求交时不需要再通过下标访问顶点。
+ *  未使用的通道会填充成退化三角形(边向量为0)，永远不会相交。
+ */
+template<int N>
+struct alignas(32) TrianglePacket
+{
+    enum { Width = N };
+
+    /// 第一个顶点。v0[0]为所有三角形的x分量，以此类推
+    float   v0[3][N];
+    /// 边向量 b - a
+    float   e1[3][N];
+    /// 边向量 c - a
+    float   e2[3][N];
+
+    TrianglePacket()
+    {
+        for (int i = 0; i < N; ++i)
+        {
+            setEmpty(i);
+        }
+    }
+
+    void setTriangle(int lane, const Vector3 &a, const Vector3 &b, const Vector3 &c)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            v0[k][lane] = a[k];
+            e1[k][lane] = b[k] - a[k];
+            e2[k][lane] = c[k] - a[k];
+        }
+    }
+
+    void setEmpty(int lane)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            v0[k][lane] = e1[k][lane] = e2[k][lane] = 0.0f;
+        }
+    }
+};
+
+/** N条射线打包成SoA布局。适用于相邻像素等方向接近的射线。
+ *  未使用的通道方向为0，永远不会相交。
+ */
+template<int N>
+struct alignas(32) RayPacket
+{
+    enum { Width = N };
+
+    float   origin[3][N];
+    float   direction[3][N];
+
+    RayPacket()
+    {
+        for (int i = 0; i < N; ++i)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                origin[k][i] = direction[k][i] = 0.0f;
+            }
+        }
+    }
+
+    void setRay(int lane, const Vector3 &o, const Vector3 &d)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            origin[k][lane] = o[k];
+            direction[k][lane] = d[k];
+        }
+    }
+};
+
+/** 打包求交的结果。只有相交的通道，t/u/v才是有效的。*/
+template<int N>
+struct alignas(32) PacketHit
+{
+    float   t[N];
+    float   u[N];
+    float   v[N];
+};
+
+typedef TrianglePacket<4>   TrianglePacket4;
+typedef TrianglePacket<8>   TrianglePacket8;
+typedef RayPacket<4>        RayPacket4;
+typedef RayPacket<8>        RayPacket8;
+typedef PacketHit<4>        PacketHit4;
+typedef PacketHit<8>        PacketHit8;
+
+/** 一条射线与打包的三角形求交。
+ *  算法与Ray::intersectTriangle完全一致，结果也是逐位相同的。
+ *  @return 相交的掩码，第i位对应第i个三角形。
+ */
+int intersectTrianglePacket(const Ray &ray, const TrianglePacket4 &tris, PacketHit4 &hit);
+int intersectTrianglePacket(const Ray &ray, const TrianglePacket8 &tris, PacketHit8 &hit);
+
+/** 打包的射线与一个三角形求交。
+ *  @param a    三角形的第一个顶点。
+ *  @param e1   边向量 b - a
+ *  @param e2   边向量 c - a
+ *  @return 相交的掩码，第i位对应第i条射线。
+ */
+int intersectRayPacket(const RayPacket4 &rays, const Vector3 &a, const Vector3 &e1, const Vector3 &e2, PacketHit4 &hit);
+int intersectRayPacket(const RayPacket8 &rays, const Vector3 &a, const Vector3 &e1, const Vector3 &e2, PacketHit8 &hit);
+
+/** 射线与一个三角形求交，三角形使用预先计算好的边向量。结果与Ray::intersectTriangle逐位相同。*/
+bool intersectTriangleEdges(const Ray &ray, const Vector3 &a, const Vector3 &e1, const Vector3 &e2, float &t, float &u, float &v);
+
+/** 当前使用的指令集名称，用于输出日志。*/
+const char* getTrianglePacketISA();
+
+/** 从求交结果中找出距离最近，并且小于tMax的通道。没有则返回-1。*/
+template<int N>
+int findClosestHit(int mask, const PacketHit<N> &hit, float tMax = FLT_MAX)
+{
+    int closest = -1;
+    for (int i = 0; i < N; ++i)
+    {
+        if ((mask & (1 << i)) && hit.t[i] < tMax)
+        {
+            tMax = hit.t[i];
+            closest = i;
+        }
+    }
+    return closest;
+}
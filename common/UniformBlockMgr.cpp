@@ -0,0 +1,132 @@
+#include "UniformBlockMgr.h"
+#include "Renderer.h"
+#include "Camera.h"
+#include <cstring>
+
+IMPLEMENT_SINGLETON(UniformBlockMgr);
+
+using namespace AutoUniformBlock;
+
+static_assert(sizeof(FrameData) == 240, "FrameData must match the std140 layout");
+static_assert(sizeof(ObjectData) == 192, "ObjectData must match the std140 layout");
+
+namespace
+{
+    inline size_t alignUp(size_t size, size_t alignment)
+    {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+}
+
+UniformBlockMgr::UniformBlockMgr()
+    : ring_(GL_UNIFORM_BUFFER)
+    , frame_()
+    , object_()
+    , frameOffset_(-1)
+    , objectOffset_(-1)
+{
+    resetStats();
+}
+
+UniformBlockMgr::~UniformBlockMgr()
+{
+}
+
+bool UniformBlockMgr::init(uint32_t capacity)
+{
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    return ring_.init(capacity, alignment > 16 ? alignment : 16);
+}
+
+void UniformBlockMgr::resetStats()
+{
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+void UniformBlockMgr::apply(uint32_t mask)
+{
+    if (ring_.getHandle() == 0 || mask == 0)
+    {
+        return;
+    }
+
+    Renderer *renderer = Renderer::instance();
+
+    FrameData frame;
+    bool frameChanged = false;
+    if (mask & FrameBit)
+    {
+        // 值初始化把填充的分量也清零，与上一次的数据逐字节比较
+        frame = FrameData();
+        frame.matView = renderer->getViewMatrix();
+        frame.matProj = renderer->getProjMatrix();
+        frame.matViewProj = renderer->getViewProjMatrix();
+
+        Camera *camera = renderer->getCamera();
+        if (camera != nullptr)
+        {
+            frame.cameraPos = camera->getPosition();
+            frame.cameraDir = camera->getForwardVector();
+        }
+
+        const Color &ambient = renderer->getAmbientColor();
+        frame.ambientColor.set(ambient.r, ambient.g, ambient.b);
+
+        frameChanged = frameOffset_ < 0 || memcmp(&frame, &frame_, sizeof(frame)) != 0;
+    }
+
+    ObjectData object;
+    bool objectChanged = false;
+    if (mask & ObjectBit)
+    {
+        object.matWorld = renderer->getWorldMatrix();
+        object.matWorldView = renderer->getWorldViewMatrix();
+        object.matWorldViewProj = renderer->getWorldViewProjMatrix();
+
+        objectChanged = objectOffset_ < 0 || memcmp(&object, &object_, sizeof(object)) != 0;
+        if (!objectChanged)
+        {
+            ++stats_.nObjectReuses;
+        }
+    }
+
+    if (!frameChanged && !objectChanged)
+    {
+        return;
+    }
+
+    ring_.bind();
+
+    // 放不下时环形缓冲区重新分配存储，之前的块都已失效，需要重新写入
+    size_t needed = (frameChanged ? alignUp(sizeof(FrameData), ring_.getAlignment()) : 0) +
+        (objectChanged ? sizeof(ObjectData) : 0);
+    if (ring_.reserve(needed))
+    {
+        frameOffset_ = -1;
+        objectOffset_ = -1;
+        ++stats_.nOrphans;
+        frameChanged = (mask & FrameBit) != 0;
+        objectChanged = (mask & ObjectBit) != 0;
+    }
+
+    if (frameChanged)
+    {
+        size_t offset = ring_.write(&frame, sizeof(FrameData));
+        glBindBufferRange(GL_UNIFORM_BUFFER, FrameBinding, ring_.getHandle(), offset, sizeof(FrameData));
+
+        frame_ = frame;
+        frameOffset_ = offset;
+        ++stats_.nFrameUploads;
+    }
+
+    if (objectChanged)
+    {
+        size_t offset = ring_.write(&object, sizeof(ObjectData));
+        glBindBufferRange(GL_UNIFORM_BUFFER, ObjectBinding, ring_.getHandle(), offset, sizeof(ObjectData));
+
+        object_ = object;
+        objectOffset_ = offset;
+        ++stats_.nObjectUploads;
+    }
+}
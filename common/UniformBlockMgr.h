@@ -0,0 +1,109 @@
+#pragma once
+
+#include "Singleton.h"
+#include "Matrix.h"
+#include "Vector3.h"
+#include "StreamingRing.h"
+#include <string>
+
+/** 自动uniform块(std140)。
+ *  shader中声明了同名的uniform块时，ShaderProgram在链接后将其绑定到固定的绑定点上，
+ *  applyAutoUniforms时由UniformBlockMgr上传数据，不再逐个调用glUniform*。
+ *
+ *  layout(std140) uniform FrameUniforms
+ *  {
+ *      mat4 u_matView;
+ *      mat4 u_matProj;
+ *      mat4 u_matViewProj;
+ *      vec3 u_cameraPos;
+ *      vec3 u_cameraDir;
+ *      vec3 u_ambientColor;
+ *  };
+ *
+ *  layout(std140) uniform ObjectUniforms
+ *  {
+ *      mat4 u_matWorld;
+ *      mat4 u_matWorldView;
+ *      mat4 u_matWorldViewProj;
+ *  };
+ */
+namespace AutoUniformBlock
+{
+    const std::string Frame = "FrameUniforms";
+    const std::string Object = "ObjectUniforms";
+
+    enum Binding
+    {
+        FrameBinding = 0,
+        ObjectBinding = 1,
+    };
+
+    enum Mask
+    {
+        FrameBit = 1 << FrameBinding,
+        ObjectBit = 1 << ObjectBinding,
+    };
+
+    /** 与std140布局一致，vec3按16字节对齐。*/
+    struct FrameData
+    {
+        Matrix  matView;
+        Matrix  matProj;
+        Matrix  matViewProj;
+        Vector3 cameraPos;
+        float   pad0;
+        Vector3 cameraDir;
+        float   pad1;
+        Vector3 ambientColor;
+        float   pad2;
+    };
+
+    struct ObjectData
+    {
+        Matrix  matWorld;
+        Matrix  matWorldView;
+        Matrix  matWorldViewProj;
+    };
+}
+
+/** 管理自动uniform块的数据。
+ *  所有的块都分配在一个环形的uniform buffer中，用glBindBufferRange绑定。
+ *  每帧的数据(相机、环境光)只在发生变化时写入一次；每个物体的数据在每次绘制时写入新的位置，
+ *  与上一次相同时直接复用。环形缓冲区写满后重新分配存储(orphan)，不需要等待GPU。
+ */
+class UniformBlockMgr : public Singleton<UniformBlockMgr>
+{
+public:
+    struct Stats
+    {
+        size_t  nFrameUploads;
+        size_t  nObjectUploads;
+        size_t  nObjectReuses;
+        size_t  nOrphans;
+    };
+
+    UniformBlockMgr();
+    ~UniformBlockMgr();
+
+    /** 创建uniform buffer。GL上下文创建之后调用。*/
+    bool init(uint32_t capacity = 1024 * 1024);
+
+    /** 根据渲染器当前的状态，上传并绑定mask中的块。
+     *  @param mask AutoUniformBlock::Mask的组合
+     */
+    void apply(uint32_t mask);
+
+    const Stats& getStats() const { return stats_; }
+    void resetStats();
+
+private:
+    StreamingRing   ring_;
+
+    AutoUniformBlock::FrameData     frame_;
+    AutoUniformBlock::ObjectData    object_;
+    /// 已经上传的块在缓冲区中的位置，-1表示需要重新上传
+    int64_t     frameOffset_;
+    int64_t     objectOffset_;
+
+    Stats       stats_;
+};
@@ -4,6 +4,8 @@
 #include "Vector2.h"
 #include "Vector3.h"
 #include "Color.h"
+#include "Matrix.h"
+#include <cstdint>
 
 #define DEF_VERTEX_TYPE(name) static const char * getType(){ return #name; }
 
@@ -66,4 +68,26 @@ struct MeshVertex
     DEF_VERTEX_TYPE(oxyznuvt)
 };
 
+/** 压缩的MeshVertex，20字节。由packMeshVertices生成，shader中解码。
+ *  位置量化到模型的包围盒中，由模型的位置解码变换还原；法线和切线使用八面体编码。
+ */
+struct PackedMeshVertex
+{
+    uint16_t    position[4];
+    int16_t     normal[2];
+    uint16_t    uv[2];
+    int16_t     tangent[2];
+
+    DEF_VERTEX_TYPE(pxyznuvt)
+};
+
+/** 实例化绘制时，每个实例的数据。*/
+struct InstanceVertex
+{
+    Matrix  world;
+    Color   color;
+
+    DEF_VERTEX_TYPE(instance)
+};
+
 #endif //VERTEX_H
@@ -3,6 +3,7 @@
 #include "VertexBuffer.h"
 #include "VertexDeclaration.h"
 #include "LogTool.h"
+#include "GLStateCache.h"
 
 VertexAttribute::VertexAttribute()
 	: handle_(0)
@@ -19,6 +20,10 @@ void VertexAttribute::destroy()
     if(isVAOSupported() && glIsVertexArray(handle_))
     {
         glDeleteVertexArrays(1, &handle_);
+        if (GLStateCache::hasInstance())
+        {
+            GLStateCache::instance()->onDeleteVertexArray(handle_);
+        }
         handle_ = 0;
     }
 }
@@ -54,12 +59,12 @@ bool VertexAttribute::init(VertexBuffer * vb, VertexDeclaration * decl)
             return false;
         }
         
-        glBindVertexArray(handle_);
+        GLStateCache::instance()->bindVertexArray(handle_);
         vb_->bind();
         
         bindAttributes();
         
-        glBindVertexArray(0);
+        GLStateCache::instance()->bindVertexArray(0);
         vb->unbind();
     }
     return true; 
@@ -67,22 +72,35 @@ bool VertexAttribute::init(VertexBuffer * vb, VertexDeclaration * decl)
 
 void VertexAttribute::bindAttributes()
 {
-    ptrdiff_t offset = 0;
-    for(size_t i = 0; i < decl_->getNumElement(); ++i)
+    setupAttributes(decl_.get());
+}
+
+void VertexAttribute::unbindAttributes()
+{
+    disableAttributes(decl_.get());
+}
+
+/*static*/ void VertexAttribute::setupAttributes(const VertexDeclaration *decl, ptrdiff_t offset)
+{
+    for(size_t i = 0; i < decl->getNumElement(); ++i)
     {
-		const VertexElement &e = decl_->getElement(i);
+		const VertexElement &e = decl->getElement(i);
 		int location = int(e.usage);
 		glEnableVertexAttribArray(location);
-		glVertexAttribPointer(location, e.nComponent, e.type, e.normalized, decl_->getVertexSize(), (GLvoid*)offset);
+		glVertexAttribPointer(location, e.nComponent, e.type, e.normalized, decl->getVertexSize(), (GLvoid*)offset);
+		if (e.divisor != 0)
+		{
+			glVertexAttribDivisor(location, e.divisor);
+		}
 		offset += e.size();
     }
 }
 
-void VertexAttribute::unbindAttributes()
+/*static*/ void VertexAttribute::disableAttributes(const VertexDeclaration *decl)
 {
-	for (size_t i = 0; i < decl_->getNumElement(); ++i)
+	for (size_t i = 0; i < decl->getNumElement(); ++i)
 	{
-		const VertexElement &e = decl_->getElement(i);
+		const VertexElement &e = decl->getElement(i);
 		int location = int(e.usage);
 		glDisableVertexAttribArray(location);
 	}
@@ -92,7 +110,7 @@ void VertexAttribute::bind()
 {
     if(isVAOSupported())
     {
-        glBindVertexArray(handle_);
+        GLStateCache::instance()->bindVertexArray(handle_);
         vb_->bind();
     }
     else
@@ -106,7 +124,7 @@ void VertexAttribute::unbind()
 {
     if(isVAOSupported())
     {
-        glBindVertexArray(0);
+        GLStateCache::instance()->bindVertexArray(0);
     }
 	else
 	{
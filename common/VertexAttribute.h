@@ -4,6 +4,7 @@
 #include "Reference.h"
 #include "SmartPointer.h"
 #include <cstdint>
+#include <cstddef>
 
 class VertexBuffer;
 class VertexDeclaration;
@@ -23,6 +24,12 @@ public:
 	*/
     void bind();
     void unbind();
+
+    /** նõǰ󶨵Ķ㻺ָ롣
+     *  offsetΪڻеʼλãdivisorΪ0԰ʵ
+     */
+    static void setupAttributes(const VertexDeclaration *decl, ptrdiff_t offset = 0);
+    static void disableAttributes(const VertexDeclaration *decl);
     
 private:
     void bindAttributes();
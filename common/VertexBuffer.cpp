@@ -1,6 +1,10 @@
 ﻿#include "VertexBuffer.h"
 #include "LogTool.h"
+#include "GLStateCache.h"
+#include "StreamingRing.h"
+#include "Compression.h"
 #include <cstring>
+#include <algorithm>
 
 int g_vb_counter = 0;
 int g_ib_counter = 0;
@@ -40,6 +44,10 @@ IndexType size2IndexType(size_t n)
 /// BufferBase
 //////////////////////////////////////////////////////////////////////
 
+BufferResidency BufferBase::s_defaultStaticResidency = BufferResidency::Keep;
+BufferBase::UploadStats BufferBase::s_stats = { 0, 0, 0, 0 };
+BufferBase::UploadStats BufferBase::s_frameStats = { 0, 0, 0, 0 };
+
 BufferBase::BufferBase(BufferType type, BufferUsage usage, size_t stride)
     : type_(type)
     , usage_(usage)
@@ -48,7 +56,9 @@ BufferBase::BufferBase(BufferType type, BufferUsage usage, size_t stride)
     , capacity_(0)
     , size_(0)
     , pData_(0)
-    , dirty_(false)
+    , glSize_(0)
+    , residency_(usage == BufferUsage::Static ? s_defaultStaticResidency : BufferResidency::Keep)
+    , lockCount_(0)
 {
 }
 
@@ -64,26 +74,124 @@ bool BufferBase::isValid() const
 
 char * BufferBase::lock(bool readOnly /*= false*/)
 {
-    if(nullptr == pData_)
-    {
-        pData_ = new char[capacity_];
-    }
+    restoreData();
+    ++lockCount_;
 
     if(!readOnly)
     {
-        dirty_ = true;
+        markDirty(0, size_);
     }
 
     return pData_;
 }
 
+char * BufferBase::lockRange(size_t iStart, size_t nCount)
+{
+    assert((iStart + nCount) * stride_ <= size_ && "BufferBase::lockRange - invalid offset and size!");
+
+    char *p = lock(true);
+    markDirty(iStart * stride_, (iStart + nCount) * stride_);
+    return p + iStart * stride_;
+}
+
 bool BufferBase::unlock()
 {
+    assert(lockCount_ > 0 && "BufferBase::unlock - not locked!");
+    if(lockCount_ > 0 && --lockCount_ == 0 && dirtyRanges_.empty())
+    {
+        releaseData();
+    }
     return true;
 }
 
+void BufferBase::setResidency(BufferResidency residency)
+{
+    if(residency_ == residency)
+    {
+        return;
+    }
+
+    restoreData();
+    std::vector<uint8_t>().swap(compressed_);
+    residency_ = residency;
+    if(lockCount_ == 0 && dirtyRanges_.empty())
+    {
+        releaseData();
+    }
+}
+
+size_t BufferBase::getCPUMemory() const
+{
+    return (pData_ != nullptr ? capacity_ : 0) + compressed_.capacity();
+}
+
+void BufferBase::restoreData()
+{
+    if(pData_ != nullptr || capacity_ == 0)
+    {
+        return;
+    }
+
+    pData_ = new char[capacity_];
+    if(!compressed_.empty())
+    {
+        std::vector<uint8_t> shuffled(size_);
+        if(decompressLZ(compressed_.data(), compressed_.size(), shuffled.data(), size_))
+        {
+            unshuffleBytes(shuffled.data(), size_, stride_, (uint8_t*)pData_);
+        }
+        else
+        {
+            LOG_ERROR("Failed to decompress buffer data.");
+            compressed_.clear();
+        }
+    }
+    else if(vb_ != 0 && glSize_ > 0 && size_ > 0)
+    {
+        // 绑定到GL_COPY_READ_BUFFER上读回，不影响顶点数组中的绑定
+        GL_ASSERT(glBindBuffer(GL_COPY_READ_BUFFER, vb_));
+        GL_ASSERT(glGetBufferSubData(GL_COPY_READ_BUFFER, 0, size_, pData_));
+        GL_ASSERT(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+    }
+}
+
+void BufferBase::releaseData()
+{
+    // 还没有上传过的数据不能释放
+    if(residency_ == BufferResidency::Keep || pData_ == nullptr || glSize_ == 0)
+    {
+        return;
+    }
+
+    // 只读的lock不会使压缩数据失效，不需要重新压缩
+    if(residency_ == BufferResidency::Compressed && size_ > 0 && compressed_.empty())
+    {
+        std::vector<uint8_t> shuffled(size_);
+        shuffleBytes((const uint8_t*)pData_, size_, stride_, shuffled.data());
+        compressed_.clear();
+        compressLZ(shuffled.data(), size_, compressed_);
+        compressed_.shrink_to_fit();
+    }
+
+    delete [] pData_;
+    pData_ = nullptr;
+}
+
 void BufferBase::resize(size_t nCount, const void *data /*= nullptr*/)
 {
+    // 提供了新的数据时，不需要恢复原来的内容
+    if(data == nullptr)
+    {
+        restoreData();
+    }
+    else
+    {
+        compressed_.clear();
+        if(pData_ == nullptr && capacity_ > 0)
+        {
+            pData_ = new char[capacity_];
+        }
+    }
     size_ = stride_ * nCount;
     if (size_ > capacity_)
     {
@@ -103,16 +211,132 @@ void BufferBase::resize(size_t nCount, const void *data /*= nullptr*/)
         memcpy(pData_, data, size_);
     }
 
-    dirty_ = true;
+    dirtyRanges_.clear();
+    markDirty(0, size_);
 }
 
 void BufferBase::fill(size_t iStart, size_t nCount, const void *data)
 {
     assert((iStart + nCount) * stride_ <= size_ && "BufferBase::fill - invalid offset and size!");
-	assert(pData_ != nullptr);
 
+    restoreData();
+	assert(pData_ != nullptr);
     memcpy(pData_ + iStart * stride_, data, nCount * stride_);
-    dirty_ = true;
+    markDirty(iStart * stride_, (iStart + nCount) * stride_);
+}
+
+void BufferBase::markDirty(size_t begin, size_t end)
+{
+    if(begin >= end)
+    {
+        return;
+    }
+    // 压缩数据已经过期
+    if(!compressed_.empty())
+    {
+        std::vector<uint8_t>().swap(compressed_);
+    }
+
+    // 第一个结束位置不小于begin的区间，与它之后起始位置不大于end的区间都和[begin, end)合并
+    auto first = std::lower_bound(dirtyRanges_.begin(), dirtyRanges_.end(), begin,
+        [](const DirtyRange &range, size_t value){ return range.end < value; });
+    auto last = first;
+    while(last != dirtyRanges_.end() && last->begin <= end)
+    {
+        begin = std::min(begin, last->begin);
+        end = std::max(end, last->end);
+        ++last;
+    }
+
+    DirtyRange range = { begin, end };
+    if(first == last)
+    {
+        dirtyRanges_.insert(first, range);
+    }
+    else
+    {
+        *first = range;
+        dirtyRanges_.erase(first + 1, last);
+    }
+
+    // 区间太多时，合并间隔最小的两个相邻区间，限制上传的调用次数
+    if(dirtyRanges_.size() > MaxDirtyRanges)
+    {
+        size_t best = 0;
+        for(size_t i = 1; i + 1 < dirtyRanges_.size(); ++i)
+        {
+            if(dirtyRanges_[i + 1].begin - dirtyRanges_[i].end < dirtyRanges_[best + 1].begin - dirtyRanges_[best].end)
+            {
+                best = i;
+            }
+        }
+        dirtyRanges_[best].end = dirtyRanges_[best + 1].end;
+        dirtyRanges_.erase(dirtyRanges_.begin() + best + 1);
+    }
+}
+
+void BufferBase::upload()
+{
+    GLenum target = GLenum(type_);
+    if(glSize_ == 0 || size_ > glSize_)
+    {
+        // 按容量分配，之后在容量之内增长时不需要重新分配
+        glSize_ = std::max(capacity_, size_t(1));
+        GL_ASSERT(glBufferData(target, glSize_, capacity_ > 0 ? pData_ : nullptr, GLenum(usage_)));
+        s_stats.nBytes += capacity_;
+        ++s_stats.nCalls;
+        ++s_stats.nReallocs;
+        dirtyRanges_.clear();
+
+        if(lockCount_ == 0)
+        {
+            releaseData();
+        }
+        return;
+    }
+
+    size_t dirtyBytes = 0;
+    for(DirtyRange &range : dirtyRanges_)
+    {
+        range.end = std::min(range.end, size_);
+        if(range.begin < range.end)
+        {
+            dirtyBytes += range.end - range.begin;
+        }
+    }
+
+    bool orphan = usage_ == BufferUsage::Stream || (usage_ == BufferUsage::Dynamic && dirtyBytes * 2 >= size_);
+    if(orphan && size_ > 0)
+    {
+        orphanBuffer(target, glSize_, GLenum(usage_), pData_, size_);
+        s_stats.nBytes += size_;
+        s_stats.nCalls += 2;
+        ++s_stats.nOrphans;
+    }
+    else
+    {
+        for(const DirtyRange &range : dirtyRanges_)
+        {
+            if(range.begin < range.end)
+            {
+                GL_ASSERT(glBufferSubData(target, range.begin, range.end - range.begin, pData_ + range.begin));
+                s_stats.nBytes += range.end - range.begin;
+                ++s_stats.nCalls;
+            }
+        }
+    }
+    dirtyRanges_.clear();
+
+    if(lockCount_ == 0)
+    {
+        releaseData();
+    }
+}
+
+/*static*/ void BufferBase::endFrame()
+{
+    s_frameStats = s_stats;
+    memset(&s_stats, 0, sizeof(s_stats));
 }
 
 void BufferBase::destroy()
@@ -120,14 +344,20 @@ void BufferBase::destroy()
     if(vb_ != 0)
     {
         GL_ASSERT( glDeleteBuffers(1, &vb_) );
+        if (GLStateCache::hasInstance())
+        {
+            GLStateCache::instance()->onDeleteBuffer(vb_);
+        }
         vb_ = 0;
     }
+    glSize_ = 0;
 
     if(pData_ != nullptr)
     {
         delete [] pData_;
         pData_ = nullptr;
     }
+    compressed_.clear();
 }
 
 bool BufferBase::bind()
@@ -142,19 +372,18 @@ bool BufferBase::bind()
         return false;
     }
 
-    GL_ASSERT(glBindBuffer(GLenum(type_), vb_));
+    GLStateCache::instance()->bindBuffer(GLenum(type_), vb_);
 
-    if(dirty_)
+    if(glSize_ == 0 || !dirtyRanges_.empty())
     {
-        dirty_ = false;
-        GL_ASSERT(glBufferData(GLenum(type_), size_, pData_, GLenum(usage_)));
+        upload();
     }
     return true;
 }
 
 void BufferBase::unbind()
 {
-    GL_ASSERT( glBindBuffer(GLenum(type_), 0) );
+    GLStateCache::instance()->bindBuffer(GLenum(type_), 0);
 }
 
 void BufferBase::onDeviceClose()
@@ -4,17 +4,47 @@
 #include "RenderState.h"
 #include "Reference.h"
 #include "SmartPointer.h"
+#include <vector>
+#include <cstdint>
 
 
 size_t indexType2Size(IndexType type);
 IndexType size2IndexType(size_t n);
 
+/** 上传到显存之后，内存中副本的保留方式。
+ *  每帧都要lock的缓冲区(比如遮挡体)应当使用Keep。
+ */
+enum class BufferResidency
+{
+    /// 一直保留副本
+    Keep,
+    /// 释放副本，lock时从显存读回。只能在GL线程中lock
+    Discard,
+    /// 只保留压缩后的副本，lock时解压
+    Compressed,
+};
+
+/** 缓冲区的基类。
+ *  数据先写入内存中的副本，bind时只上传修改过的区间：相交或相邻的区间合并，用glBufferSubData上传。
+ *  数据超出显存中的存储时按capacity重新分配。
+ *  Dynamic缓冲区大部分被修改、以及Stream缓冲区被修改时，先重新分配存储(orphan)再上传，不等待GPU使用旧的数据。
+ *  按BufferResidency，上传之后且没有被lock时可以释放内存中的副本，lock时再恢复，unlock之后再次释放。
+ */
 class BufferBase : public ReferenceCount
 {
     BufferBase(const BufferBase &);
     const BufferBase & operator = (const BufferBase &);
 
 public:
+    /** 上传统计，所有缓冲区共享。*/
+    struct UploadStats
+    {
+        size_t  nBytes;
+        /// glBufferData和glBufferSubData的调用次数
+        size_t  nCalls;
+        size_t  nOrphans;
+        size_t  nReallocs;
+    };
 
     BufferBase(BufferType type, BufferUsage usage, size_t stride);
     virtual ~BufferBase();
@@ -27,9 +57,24 @@ public:
 
     size_t count() const { return size_ / stride_; }
 
+    /** 不是只读时，整个缓冲区都视为被修改。*/
     char* lock(bool readOnly = false);
+    /** 只修改从iStart开始的nCount个元素，返回第iStart个元素的地址。*/
+    char* lockRange(size_t iStart, size_t nCount);
+    /** 与lock配对调用，可以嵌套。*/
     bool unlock();
 
+    void setResidency(BufferResidency residency);
+    BufferResidency getResidency() const { return residency_; }
+    /** 内存中的副本当前是否存在。*/
+    bool isResident() const { return pData_ != nullptr; }
+    /** 内存中的副本和压缩数据占用的字节数。*/
+    size_t getCPUMemory() const;
+
+    /** 之后创建的Static缓冲区使用的residency，默认为Keep。*/
+    static void setDefaultStaticResidency(BufferResidency residency){ s_defaultStaticResidency = residency; }
+    static BufferResidency getDefaultStaticResidency(){ return s_defaultStaticResidency; }
+
     void resize(size_t nCount, const void *data = nullptr);
     void fill(size_t iStart, size_t nCount, const void *data);
 
@@ -38,8 +83,27 @@ public:
 
     virtual void onDeviceClose();
 
+    /** 上一帧的上传统计。*/
+    static const UploadStats& getUploadStats(){ return s_frameStats; }
+    /** 每帧调用一次，结束当前帧的统计。*/
+    static void endFrame();
+
 private:
+    enum { MaxDirtyRanges = 32 };
 
+    struct DirtyRange
+    {
+        size_t  begin;
+        size_t  end;
+    };
+
+    /** 标记[begin, end)字节被修改。*/
+    void markDirty(size_t begin, size_t end);
+    void upload();
+    /** 恢复内存中的副本。*/
+    void restoreData();
+    /** 按residency释放内存中的副本。*/
+    void releaseData();
     void destroy();
 
 protected:
@@ -50,7 +114,17 @@ protected:
     size_t      capacity_;
     size_t      size_;
     char *      pData_;
-    bool        dirty_;
+    /// 显存中存储的字节数
+    size_t      glSize_;
+    /// 按起始位置排序，互不相交也不相邻
+    std::vector<DirtyRange> dirtyRanges_;
+    BufferResidency residency_;
+    int         lockCount_;
+    std::vector<uint8_t>    compressed_;
+
+    static BufferResidency s_defaultStaticResidency;
+    static UploadStats s_stats;
+    static UploadStats s_frameStats;
 };
 
 //顶点缓冲区
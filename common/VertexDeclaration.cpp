@@ -27,6 +27,8 @@ AttrMap[ATTR] = VertexUsage::USAGE
         REGISTER_ATTR("a_color",       COLOR);
 		REGISTER_ATTR("a_blendWeights", BLENDWEIGHTS);
 		REGISTER_ATTR("a_blendIndices", BLENDINDICES);
+        REGISTER_ATTR("a_instanceWorld", INSTANCE_WORLD0);
+        REGISTER_ATTR("a_instanceColor", INSTANCE_COLOR);
 
 #undef REGISTER_ATTR
 
@@ -45,6 +47,8 @@ TypeMap[NAME] = VertexElement(VertexUsage::NONE, COM, TYPE, TP_SIZE, NML)
 	    REGISTER_TYPE( "short4n",   4, GL_SHORT, 2, true );
         REGISTER_TYPE( "ushort2n",  2, GL_UNSIGNED_SHORT, 2, true );
 	    REGISTER_TYPE( "ushort4n",  4, GL_UNSIGNED_SHORT, 2, true );
+        REGISTER_TYPE( "half2",     2, GL_HALF_FLOAT, 2, false );
+        REGISTER_TYPE( "half4",     4, GL_HALF_FLOAT, 2, false );
 
 #undef REGISTER_TYPE
 
@@ -89,23 +93,26 @@ VertexElement::VertexElement()
     , type(GL_FLOAT)
     , tpSize(sizeof(float))
     , normalized(GL_TRUE)
+    , divisor(0)
 {}
 
-VertexElement::VertexElement(VertexUsage usage_, int nComponent_)
+VertexElement::VertexElement(VertexUsage usage_, int nComponent_, int divisor_)
     : usage(usage_)
     , nComponent(nComponent_)
     , type(GL_FLOAT)
     , tpSize(sizeof(float))
     , normalized(GL_TRUE)
+    , divisor(divisor_)
 {}
 
 VertexElement::VertexElement(VertexUsage usage_, int nComponent_,
-    int type_, int tpsize_, bool normalized_)
+    int type_, int tpsize_, bool normalized_, int divisor_)
     : usage(usage_)
     , nComponent(nComponent_)
     , type(type_)
     , tpSize(tpsize_)
     , normalized(normalized_)
+    , divisor(divisor_)
 {}
 
 int VertexElement::size() const
@@ -173,9 +180,9 @@ void VertexDeclaration::addElement(const VertexElement & e)
     vertexSize_ += e.size();
 }
 
-void VertexDeclaration::addElement(VertexUsage usage, int nComponent)
+void VertexDeclaration::addElement(VertexUsage usage, int nComponent, int divisor)
 {
-    elements_.push_back(VertexElement(usage, nComponent));
+    elements_.push_back(VertexElement(usage, nComponent, divisor));
     vertexSize_ += elements_.back().size();
 }
 
@@ -262,6 +269,22 @@ void VertexDeclMgr::init()
 	decl->addElement(VertexUsage::TEXCOORD0, 2);
 	decl->addElement(VertexUsage::TANGENT, 3);
 	add(decl);
+
+    decl = new VertexDeclaration(PackedMeshVertex::getType());
+    decl->addElement(VertexElement(VertexUsage::POSITION, 4, GL_UNSIGNED_SHORT, 2, true));
+    decl->addElement(VertexElement(VertexUsage::NORMAL, 2, GL_SHORT, 2, true));
+    decl->addElement(VertexElement(VertexUsage::TEXCOORD0, 2, GL_HALF_FLOAT, 2, false));
+    decl->addElement(VertexElement(VertexUsage::TANGENT, 2, GL_SHORT, 2, true));
+    add(decl);
+
+    // 每个实例一份数据
+    decl = new VertexDeclaration(InstanceVertex::getType());
+    decl->addElement(VertexUsage::INSTANCE_WORLD0, 4, 1);
+    decl->addElement(VertexUsage::INSTANCE_WORLD1, 4, 1);
+    decl->addElement(VertexUsage::INSTANCE_WORLD2, 4, 1);
+    decl->addElement(VertexUsage::INSTANCE_WORLD3, 4, 1);
+    decl->addElement(VertexUsage::INSTANCE_COLOR, 4, 1);
+    add(decl);
 }
 
 bool VertexDeclMgr::loadFromFile(const std::string & fileName)
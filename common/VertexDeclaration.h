@@ -27,11 +27,12 @@ public:
     int         type;
     int         tpSize;
     bool        normalized;
+    int         divisor;//0表示每个顶点一份数据，n表示每n个实例一份数据。
 
     VertexElement();
-    VertexElement(VertexUsage usage, int nComponent);
+    VertexElement(VertexUsage usage, int nComponent, int divisor = 0);
     VertexElement(VertexUsage usage, int nComponent,
-        int type, int tpsize, bool normalized);
+        int type, int tpsize, bool normalized, int divisor = 0);
 
     int size() const;
 };
@@ -49,7 +50,7 @@ public:
     bool load(const mjson::Node &section);
 
     void addElement(const VertexElement & e);
-    void addElement(VertexUsage usage, int nComponent);
+    void addElement(VertexUsage usage, int nComponent, int divisor = 0);
     const VertexElement & getElement(size_t i) const;
     size_t getNumElement() const;
     size_t getVertexSize() const;
@@ -0,0 +1,205 @@
+#include "VertexPacking.h"
+#include "Vertex.h"
+#include "Mesh.h"
+#include "VertexBuffer.h"
+#include "VertexDeclaration.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    const float QuantizeScale = 65535.0f;
+    const float SnormScale = 32767.0f;
+
+    inline int16_t toSnorm16(float v)
+    {
+        v = std::max(-1.0f, std::min(1.0f, v));
+        return int16_t(std::floor(v * SnormScale + 0.5f));
+    }
+
+    inline float signNotZero(float v)
+    {
+        return v >= 0.0f ? 1.0f : -1.0f;
+    }
+}
+
+uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    bits &= 0x7fffffff;
+
+    // 不小于65536的值、无穷大和NaN
+    if (bits >= 0x47800000)
+    {
+        return uint16_t(sign | (bits > 0x7f800000 ? 0x7e00 : 0x7c00));
+    }
+
+    // 小于2^-14的值转换为非规格化数，借助浮点加法完成移位和舍入
+    if (bits < 0x38800000)
+    {
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        f += 0.5f;
+        memcpy(&bits, &f, sizeof(bits));
+        return uint16_t(sign | (bits - 0x3f000000));
+    }
+
+    // 调整指数的偏移，尾数舍入到偶数
+    uint32_t odd = (bits >> 13) & 1;
+    bits += 0xc8000fff + odd;
+    return uint16_t(sign | (bits >> 13));
+}
+
+float halfToFloat(uint16_t value)
+{
+    uint32_t sign = uint32_t(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x3ff;
+
+    uint32_t bits;
+    if (exponent == 0)
+    {
+        float f = float(mantissa) * (1.0f / 16777216.0f);
+        memcpy(&bits, &f, sizeof(bits));
+        bits |= sign;
+    }
+    else if (exponent == 31)
+    {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    }
+    else
+    {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+void encodeOctahedral(const Vector3 &v, int16_t out[2])
+{
+    float l1 = std::fabs(v.x) + std::fabs(v.y) + std::fabs(v.z);
+    if (l1 <= 0.0f)
+    {
+        out[0] = out[1] = 0;
+        return;
+    }
+
+    // 投影到八面体上，下半部分沿对角线翻折到外侧
+    float x = v.x / l1;
+    float y = v.y / l1;
+    if (v.z < 0.0f)
+    {
+        float fx = (1.0f - std::fabs(y)) * signNotZero(x);
+        float fy = (1.0f - std::fabs(x)) * signNotZero(y);
+        x = fx;
+        y = fy;
+    }
+    out[0] = toSnorm16(x);
+    out[1] = toSnorm16(y);
+}
+
+Vector3 decodeOctahedral(const int16_t in[2])
+{
+    // 与model_packed.vsh中的decodeOctahedral一致
+    Vector3 v(std::max(in[0] / SnormScale, -1.0f), std::max(in[1] / SnormScale, -1.0f), 0.0f);
+    v.z = 1.0f - std::fabs(v.x) - std::fabs(v.y);
+    float t = std::max(-v.z, 0.0f);
+    v.x += v.x >= 0.0f ? -t : t;
+    v.y += v.y >= 0.0f ? -t : t;
+    v.normalize();
+    return v;
+}
+
+void packVertices(PackedMeshVertex *dst, const MeshVertex *src, size_t count, Vector3 &offset, float &scale)
+{
+    offset = Vector3::Zero;
+    scale = 1.0f;
+    if (count == 0)
+    {
+        return;
+    }
+
+    Vector3 minPoint = src[0].position;
+    Vector3 maxPoint = src[0].position;
+    for (size_t i = 1; i < count; ++i)
+    {
+        const Vector3 &p = src[i].position;
+        minPoint.set(std::min(minPoint.x, p.x), std::min(minPoint.y, p.y), std::min(minPoint.z, p.z));
+        maxPoint.set(std::max(maxPoint.x, p.x), std::max(maxPoint.y, p.y), std::max(maxPoint.z, p.z));
+    }
+
+    Vector3 extent = maxPoint - minPoint;
+    float maxExtent = std::max(extent.x, std::max(extent.y, extent.z));
+    offset = minPoint;
+    scale = maxExtent > 0.0f ? maxExtent : 1.0f;
+
+    float invScale = QuantizeScale / scale;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const MeshVertex &v = src[i];
+        PackedMeshVertex &p = dst[i];
+
+        Vector3 q = (v.position - offset) * invScale;
+        for (int k = 0; k < 3; ++k)
+        {
+            p.position[k] = uint16_t(std::max(0.0f, std::min(QuantizeScale, q[k] + 0.5f)));
+        }
+        // w解码为1，shader中可以直接作为齐次坐标使用
+        p.position[3] = 0xffff;
+
+        encodeOctahedral(v.normal, p.normal);
+        p.uv[0] = floatToHalf(v.uv.x);
+        p.uv[1] = floatToHalf(v.uv.y);
+        encodeOctahedral(v.tangent, p.tangent);
+    }
+}
+
+void makePositionDecode(Matrix &decode, const Vector3 &offset, float scale)
+{
+    decode.setScale(scale);
+    decode._41 = offset.x;
+    decode._42 = offset.y;
+    decode._43 = offset.z;
+}
+
+void decodePositions(Vector3 *out, const void *in, size_t stride, size_t count, const Matrix &decode)
+{
+    const float invScale = 1.0f / QuantizeScale;
+    const char *p = (const char*)in;
+    for (size_t i = 0; i < count; ++i, p += stride)
+    {
+        const uint16_t *q = ((const PackedMeshVertex*)p)->position;
+        out[i] = decode.transformPoint(Vector3(q[0] * invScale, q[1] * invScale, q[2] * invScale));
+    }
+}
+
+bool packMeshVertices(Mesh *mesh)
+{
+    VertexBufferPtr vb = mesh->getVertexBuffer();
+    VertexDeclarationPtr decl = mesh->getVertexDecl();
+    if (!vb || !decl || decl->getName() != MeshVertex::getType() || vb->stride() != sizeof(MeshVertex))
+    {
+        return false;
+    }
+
+    std::vector<PackedMeshVertex> vertices(vb->count());
+    Vector3 offset;
+    float scale;
+    packVertices(vertices.data(), (const MeshVertex*)vb->lock(true), vertices.size(), offset, scale);
+    vb->unlock();
+
+    VertexBufferPtr packed = new VertexBufferEx<PackedMeshVertex>(BufferUsage::Static, vertices.size(), vertices.data());
+    packed->setResidency(vb->getResidency());
+
+    mesh->setVertexBuffer(packed);
+    mesh->setVertexDecl(VertexDeclMgr::instance()->get(PackedMeshVertex::getType()));
+    mesh->setPositionDecode(offset, scale);
+    return true;
+}
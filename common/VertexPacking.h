@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+class Vector3;
+class Matrix;
+class Mesh;
+struct MeshVertex;
+struct PackedMeshVertex;
+
+/** 32位浮点数转换为16位半精度浮点数，就近舍入，超出范围的值变为无穷大。*/
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t value);
+
+/** 单位向量的八面体编码，两个分量都在[-32767, 32767]之间，对应shader中的snorm16。*/
+void encodeOctahedral(const Vector3 &v, int16_t out[2]);
+Vector3 decodeOctahedral(const int16_t in[2]);
+
+/** 把MeshVertex转换为PackedMeshVertex。
+ *  位置按包围盒量化到[0, 65535]，三个轴使用相同的缩放，解码变换不会改变法线的方向。
+ *  @param offset   输出位置解码的平移，即包围盒的最小点
+ *  @param scale    输出位置解码的缩放，即包围盒最长的边
+ */
+void packVertices(PackedMeshVertex *dst, const MeshVertex *src, size_t count, Vector3 &offset, float &scale);
+
+/** 位置的解码变换：先按scale等比缩放，再平移offset，参数为packVertices的输出。*/
+void makePositionDecode(Matrix &decode, const Vector3 &offset, float scale);
+
+/** 解码PackedMeshVertex格式的位置。stride是相邻两个顶点之间的字节数。*/
+void decodePositions(Vector3 *out, const void *in, size_t stride, size_t count, const Matrix &decode);
+
+/** 把MeshVertex格式的模型转换为PackedMeshVertex格式，顶点从44字节减少到20字节。
+ *  替换模型的顶点缓冲区，并设置位置的解码变换，需要在clone之前调用。
+ *  使用这种格式的模型需要配合解码法线的shader，比如model_packed.shader。
+ */
+bool packMeshVertices(Mesh *mesh);
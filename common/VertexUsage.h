@@ -17,6 +17,13 @@ enum class VertexUsage
 	BLENDWEIGHTS,
 	BLENDINDICES,
 
+    // 实例数据。世界矩阵是mat4，占用4个连续的location
+    INSTANCE_WORLD0,
+    INSTANCE_WORLD1,
+    INSTANCE_WORLD2,
+    INSTANCE_WORLD3,
+    INSTANCE_COLOR,
+
     NONE,
     MAX_NUM
 };
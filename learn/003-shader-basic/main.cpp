@@ -5,6 +5,7 @@
 #include "LogTool.h"
 #include "FileSystem.h"
 #include "DemoTool.h"
+#include "GLStateCache.h"
 
 struct Vertex
 {
@@ -63,10 +64,10 @@ public:
         };
 
         glGenVertexArrays(1, &vao_);
-        glBindVertexArray(vao_);
+        GLStateCache::instance()->bindVertexArray(vao_);
         
         glGenBuffers(1, &vbo_);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+        GLStateCache::instance()->bindBuffer(GL_ARRAY_BUFFER, vbo_);
         glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
 		// 设置属性必须先绑定顶点buffer
@@ -76,9 +77,9 @@ public:
 		glEnableVertexAttribArray(crLocation);
 		glVertexAttribPointer(crLocation, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)(sizeof(float) * 3));
 
-        glBindVertexArray(0);
+        GLStateCache::instance()->bindVertexArray(0);
 
-        glEnable(GL_CULL_FACE);
+        GLStateCache::instance()->enable(GL_CULL_FACE);
 		return true;
     }
     
@@ -87,10 +88,12 @@ public:
         if(glIsBuffer(vbo_))
         {
             glDeleteBuffers(1, &vbo_);
+            GLStateCache::instance()->onDeleteBuffer(vbo_);
         }
         if (glIsVertexArray(vao_))
         {
             glDeleteVertexArrays(1, &vao_);
+            GLStateCache::instance()->onDeleteVertexArray(vao_);
         }
     }
     
@@ -99,7 +102,7 @@ public:
         Application::onDraw(renderer);
 
         shader_->bind();
-        glBindVertexArray(vao_);
+        GLStateCache::instance()->bindVertexArray(vao_);
         glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
     }
     
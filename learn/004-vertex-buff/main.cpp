@@ -10,6 +10,7 @@
 #include "DemoTool.h"
 #include "PathTool.h"
 #include "Matrix.h"
+#include "GLStateCache.h"
 
 class MyApplication : public Application
 {
@@ -65,8 +66,8 @@ public:
             return false;
         }
 
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
+		GLStateCache::instance()->enable(GL_CULL_FACE);
+		GLStateCache::instance()->cullFace(GL_BACK);
         return true;
     }
     
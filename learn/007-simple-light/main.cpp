@@ -9,6 +9,7 @@
 #include "LogTool.h"
 #include "Matrix.h"
 #include "Mesh.h"
+#include "GLStateCache.h"
 
 const float PI = 3.141592f;
 
@@ -40,7 +41,8 @@ class MyApplication : public Application
 
 		curShader_ = shaderVertex_;
 
-		mesh_ = createSimpleGround(Vector2(5.0f, 5.0f), 0.6f, 0.2f, 1.6f);
+		// 地面的网格较密，重排三角形和顶点
+		mesh_ = createSimpleGround(Vector2(5.0f, 5.0f), 0.6f, 0.2f, 1.6f, true);
 		//mesh_ = createPlane(Vector2(1.0f, 1.0f), 0.2f);
 		//mesh_ = createCube(Vector3(1.0f, 1.0f, 1.0f));
 		MaterialPtr material = new Material();
@@ -61,8 +63,8 @@ class MyApplication : public Application
 		matViewProj = matView * matProj;
 
 		//glDisable(GL_CULL_FACE);
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
+		GLStateCache::instance()->enable(GL_CULL_FACE);
+		GLStateCache::instance()->cullFace(GL_BACK);
 		
 		return true;
 	}
@@ -9,6 +9,7 @@
 #include "LogTool.h"
 #include "Matrix.h"
 #include "Mesh.h"
+#include "GLStateCache.h"
 
 const float PI = 3.141592f;
 
@@ -75,8 +76,8 @@ public:
 
 		setupViewProjMatrix();
 
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
+		GLStateCache::instance()->enable(GL_CULL_FACE);
+		GLStateCache::instance()->cullFace(GL_BACK);
 		return true;
 	}
 
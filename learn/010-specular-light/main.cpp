@@ -10,6 +10,7 @@
 #include "Matrix.h"
 #include "Mesh.h"
 #include "Camera.h"
+#include "GLStateCache.h"
 
 class MyApplication : public Application
 {
@@ -65,8 +66,8 @@ public:
 		camera_.lookAt(Vector3(0, 1, -2), Vector3::Zero, Vector3::YAxis);
 		setupViewProjMatrix();
 
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
+		GLStateCache::instance()->enable(GL_CULL_FACE);
+		GLStateCache::instance()->cullFace(GL_BACK);
 		return true;
 	}
 
@@ -11,6 +11,7 @@
 #include "Mesh.h"
 #include "Camera.h"
 #include "FrameBuffer.h"
+#include "GLStateCache.h"
 
 class MyApplication : public Application
 {
@@ -82,8 +83,8 @@ public:
 		mesh2_->addMaterial(material2_);
 #endif
 
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
+		GLStateCache::instance()->enable(GL_CULL_FACE);
+		GLStateCache::instance()->cullFace(GL_BACK);
 		return true;
 	}
 
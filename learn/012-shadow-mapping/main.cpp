@@ -11,6 +11,8 @@
 #include "Mesh.h"
 #include "Camera.h"
 #include "FrameBuffer.h"
+#include "GLStateCache.h"
+#include "Profiler.h"
 
 class MyApplication : public Application
 {
@@ -94,8 +96,8 @@ public:
 		// 注意zfar不要设置太大，否则平均之后的z值就太小了
 		lightCamera_.setOrtho(4, 4, 1.0f, 10.0f);
 
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
+		GLStateCache::instance()->enable(GL_CULL_FACE);
+		GLStateCache::instance()->cullFace(GL_BACK);
 		return true;
 	}
 
@@ -133,7 +135,8 @@ public:
 
 		if (frameBuffer_)
 		{
-            glDisable(GL_CULL_FACE);
+            PROFILE_GPU_SCOPE("ShadowPass");
+            GLStateCache::instance()->disable(GL_CULL_FACE);
 			frameBuffer_->bind();
 
 			glViewport(0, 0, frameSize_.x, frameSize_.y);
@@ -148,7 +151,7 @@ public:
 			// 恢复视口
 			Vector2 size = getFrameBufferSize();
 			glViewport(0, 0, size.x, size.y);
-            glEnable(GL_CULL_FACE);
+            GLStateCache::instance()->enable(GL_CULL_FACE);
 		}
 
 		glClearColor(0.15f, 0.24f, 0.24f, 0);
@@ -12,6 +12,7 @@
 #include "Camera.h"
 #include "Model.h"
 #include "Renderer.h"
+#include "GLStateCache.h"
 
 class MyApplication : public Application
 {
@@ -29,7 +30,8 @@ public:
 		FileSystem::instance()->addSearchPath(joinPath(resPath, "common"));
 		FileSystem::instance()->dumpSearchPath();
 
-		modelShader_ = ShaderProgramMgr::instance()->get("shader/model.shader");
+		// 顶点压缩为20字节的PackedMeshVertex，由model_packed.shader解码
+		modelShader_ = ShaderProgramMgr::instance()->get("shader/model_packed.shader");
 		if (!modelShader_)
 		{
 			return false;
@@ -44,8 +46,9 @@ public:
 		bindShaderUniform(modelShader_.get(), "u_ambientColor", Vector3(0.5f));
 		modelShader_->unbind();
 
+		// 模型加载之后不再修改，内存中只保留压缩后的顶点和索引
 		model_ = new Model();
-		if (!model_->load("model/axe.x", modelShader_))
+		if (!model_->load("model/axe.x", modelShader_, true, BufferResidency::Compressed))
 		{
 			return false;
 		}
@@ -54,8 +57,8 @@ public:
 		camera_.lookAt(Vector3(0, 1, -2), Vector3::Zero, Vector3::YAxis);
 		setupViewProjMatrix();
 
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
+		GLStateCache::instance()->enable(GL_CULL_FACE);
+		GLStateCache::instance()->cullFace(GL_BACK);
 		//glDisable(GL_CULL_FACE);
 
 		return true;
@@ -15,6 +15,7 @@
 
 #include <AntTweakBar/AntTweakBar.h>
 #include "title.h"
+#include "GLStateCache.h"
 
 TwType TW_TYPE_VECTOR3;
 
@@ -141,8 +142,8 @@ public:
 		camera_.lookAt(Vector3(0, 1, -2), Vector3::Zero, Vector3::YAxis);
 		setupViewProjMatrix();
 
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
+		GLStateCache::instance()->enable(GL_CULL_FACE);
+		GLStateCache::instance()->cullFace(GL_BACK);
 		//glDisable(GL_CULL_FACE);
 
 
@@ -189,6 +190,8 @@ public:
 		model_->draw(renderer);
 
 		TwDraw();
+		// AntTweakBar直接修改了GL状态
+		GLStateCache::instance()->invalidate();
 	}
 
 	void onSizeChange(int width, int height) override
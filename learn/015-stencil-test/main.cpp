@@ -15,6 +15,7 @@
 #include "title.h"
 #include "Vertex.h"
 #include "VertexBuffer.h"
+#include "GLStateCache.h"
 
 class MyApplication : public Application
 {
@@ -57,10 +58,10 @@ public:
 		camera_.lookAt(Vector3(0, 1, -2), Vector3::Zero, Vector3::YAxis);
 		setupViewProjMatrix();
 
-		glDisable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
+		GLStateCache::instance()->disable(GL_CULL_FACE);
+		GLStateCache::instance()->cullFace(GL_BACK);
 		// ģ
-		glEnable(GL_STENCIL_TEST);
+		GLStateCache::instance()->enable(GL_STENCIL_TEST);
 
 		quadShader_ = ShaderProgramMgr::instance()->get("shader/xyzcolor.shader");
 		if (!quadShader_)
@@ -95,30 +96,30 @@ public:
 		Renderer::instance()->setProjMatrix(camera_.getProjMatrix());
 
 		// ѾθǵģֵΪ 1
-		glStencilFunc(GL_ALWAYS, 0, 0xffffffff);
-		glStencilOp(GL_KEEP, GL_KEEP, GL_INCR);
+		GLStateCache::instance()->stencilFunc(GL_ALWAYS, 0, 0xffffffff);
+		GLStateCache::instance()->stencilOp(GL_KEEP, GL_KEEP, GL_INCR);
 
 		// رɫдд롣ĿֻıģֵӰԭֵɫֵ
-		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-		glDepthMask(GL_FALSE);
+		GLStateCache::instance()->colorMask(false, false, false, false);
+		GLStateCache::instance()->depthMask(false);
 		drawQuad();
 
 		// ָɫдд
-		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
-		glDepthMask(GL_TRUE);
+		GLStateCache::instance()->colorMask(true, true, true, true);
+		GLStateCache::instance()->depthMask(true);
 
 		// ֵֻ(0) < ģֵԽȾ
-		glStencilFunc(GL_LESS, 0, 0xffffffff);
-		glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+		GLStateCache::instance()->stencilFunc(GL_LESS, 0, 0xffffffff);
+		GLStateCache::instance()->stencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
 
 		renderer->setWorldMatrix(modelTransform_.getModelMatrix());
 		model_->draw(renderer);
 
 		// ھαȾһ͸ͼ
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		GLStateCache::instance()->enable(GL_BLEND);
+		GLStateCache::instance()->blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 		drawQuad();
-		glDisable(GL_BLEND);
+		GLStateCache::instance()->disable(GL_BLEND);
 	}
 
 	void drawQuad()
@@ -16,6 +16,7 @@
 #include "Vertex.h"
 #include "VertexBuffer.h"
 #include "Material.h"
+#include "GLStateCache.h"
 
 
 class MyApplication : public Application
@@ -79,8 +80,8 @@ public:
 
 		lightTransform_.lookAt(Vector3(1, 1, -0.5), Vector3::Zero, Vector3::YAxis);
 
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
+		GLStateCache::instance()->enable(GL_CULL_FACE);
+		GLStateCache::instance()->cullFace(GL_BACK);
 		return true;
 	}
 
@@ -140,23 +141,23 @@ public:
 		renderer->setWorldMatrix(Matrix::Identity);
 
 		// ZFail 㷨
-		glEnable(GL_STENCIL_TEST);
-		glStencilFunc(GL_ALWAYS, 0, 0xffffffff);
+		GLStateCache::instance()->enable(GL_STENCIL_TEST);
+		GLStateCache::instance()->stencilFunc(GL_ALWAYS, 0, 0xffffffff);
 		renderer->setColorWriteEnable(false);
 		renderer->setZWriteEnable(false);
 
 		// Ⱦ档Ȳʧʱģֵ+1
-		glCullFace(GL_FRONT);
-		glStencilOp(GL_KEEP, GL_INCR, GL_KEEP);
+		GLStateCache::instance()->cullFace(GL_FRONT);
+		GLStateCache::instance()->stencilOp(GL_KEEP, GL_INCR, GL_KEEP);
 		volume->draw(renderer);
 
 		// Ⱦ档Ȳǰʱģֵ-1
-		glCullFace(GL_BACK);
-		glStencilOp(GL_KEEP, GL_DECR, GL_KEEP);
+		GLStateCache::instance()->cullFace(GL_BACK);
+		GLStateCache::instance()->stencilOp(GL_KEEP, GL_DECR, GL_KEEP);
 		volume->draw(renderer);
 
 		renderer->setColorWriteEnable(true);
-		glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+		GLStateCache::instance()->stencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
 
 		// ʾӰ
 		if (showVolume_)
@@ -164,10 +165,10 @@ public:
 			materialVolume_->bindShader();
 			materialVolume_->bindUniform("u_color", Color(0.5f, 0.5f, 0.5f, 0.5f));
 
-			glEnable(GL_BLEND);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			GLStateCache::instance()->enable(GL_BLEND);
+			GLStateCache::instance()->blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 			volume->draw(renderer);
-			glDisable(GL_BLEND);
+			GLStateCache::instance()->disable(GL_BLEND);
 		}
 
 		renderer->setZWriteEnable(true);
@@ -180,18 +181,18 @@ public:
 			renderer->setViewMatrix(Matrix::Identity);
 			renderer->setProjMatrix(Matrix::Identity);
 
-			glEnable(GL_BLEND);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			GLStateCache::instance()->enable(GL_BLEND);
+			GLStateCache::instance()->blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-			glDisable(GL_DEPTH_TEST);
-			glStencilFunc(GL_LESS, 0, 0xffffffff);
+			GLStateCache::instance()->disable(GL_DEPTH_TEST);
+			GLStateCache::instance()->stencilFunc(GL_LESS, 0, 0xffffffff);
 			meshQuad_->draw(renderer);
 
-			glDisable(GL_BLEND);
-			glEnable(GL_DEPTH_TEST);
+			GLStateCache::instance()->disable(GL_BLEND);
+			GLStateCache::instance()->enable(GL_DEPTH_TEST);
 		}
 
-		glDisable(GL_STENCIL_TEST);
+		GLStateCache::instance()->disable(GL_STENCIL_TEST);
 	}
 
 	void onSizeChange(int width, int height) override
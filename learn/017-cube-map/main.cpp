@@ -13,6 +13,7 @@
 #include "Model.h"
 #include "Renderer.h"
 #include "title.h"
+#include "GLStateCache.h"
 
 class MyApplication : public Application
 {
@@ -87,8 +88,8 @@ public:
 		setupViewProjMatrix();
 		Renderer::instance()->setCamera(&camera_);
 
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
+		GLStateCache::instance()->enable(GL_CULL_FACE);
+		GLStateCache::instance()->cullFace(GL_BACK);
 		return true;
 	}
 
@@ -101,10 +102,10 @@ public:
 	{
 		Application::onDraw(renderer);
 
-		glCullFace(GL_FRONT);
+		GLStateCache::instance()->cullFace(GL_FRONT);
         skyTransform_.draw(renderer);
 		
-        glCullFace(GL_BACK);
+        GLStateCache::instance()->cullFace(GL_BACK);
         modelTransform_.draw(renderer);
 	}
 
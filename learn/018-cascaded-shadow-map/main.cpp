@@ -15,6 +15,10 @@
 #include "title.h"
 #include "FrameBuffer.h"
 #include "Texture2DArray.h"
+#include "TransformHierarchy.h"
+#include "RenderQueue.h"
+#include "GLStateCache.h"
+#include "Profiler.h"
 #include <algorithm>
 
 const int MaxCascades = 4;
@@ -81,6 +85,8 @@ public:
             t->addComponent(cubeMesh_);
             casters_->addChild(t);
         }
+        // 投影物的世界矩阵由扁平化的层次结构统一更新，casters_->draw会直接使用
+        casterHierarchy_.setRoot(casters_);
 
 		camera_.lookAt(Vector3(0, 3, -10), Vector3::Zero, Vector3::YAxis);
 		setupProjectionMatrix();
@@ -94,8 +100,8 @@ public:
         quadMesh_ = createQuad(Vector2(0.4f, 0.4f));
         quadMesh_->addMaterial(quadMaterial_);
         
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
+		GLStateCache::instance()->enable(GL_CULL_FACE);
+		GLStateCache::instance()->cullFace(GL_BACK);
 		return true;
 	}
     
@@ -203,10 +209,7 @@ public:
             };
             
             // 转换到灯光空间
-            for(int i = 0; i < 8; ++i)
-            {
-                points[i] = lightSpaceMatrix.transformPoint(points[i]);
-            }
+            lightSpaceMatrix.transformPoints(points, points, 8);
             
             // 计算包围盒
             Vector3 maxV = points[0];
@@ -238,6 +241,7 @@ public:
 	void onTick(float elapse) override
 	{
 		camera_.handleCameraMove();
+        casterHierarchy_.update();
 	}
 
 	void onDraw(Renderer *renderer) override
@@ -251,7 +255,8 @@ public:
     
     void generateShadow(Renderer *renderer)
     {
-        glDisable(GL_CULL_FACE);
+        PROFILE_GPU_SCOPE("ShadowPass");
+        GLStateCache::instance()->disable(GL_CULL_FACE);
         renderer->setCamera(&lightCamera_);
         renderer->setOverwriteMaterial(lightMaterial_);
         frameBuffer_->bind();
@@ -270,16 +275,20 @@ public:
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
             
             //ground_->draw(renderer);
+            renderer->setRenderQueue(&renderQueue_);
             casters_->draw(renderer);
+            renderer->setRenderQueue(nullptr);
+            renderQueue_.flush(renderer);
         }
         
         frameBuffer_->unbind();
         renderer->setOverwriteMaterial(nullptr);
-        glEnable(GL_CULL_FACE);
+        GLStateCache::instance()->enable(GL_CULL_FACE);
     }
     
     void drawScene(Renderer *renderer)
     {
+        PROFILE_GPU_SCOPE("ScenePass");
         Vector2 size = getFrameBufferSize();
         glViewport(0, 0, size.x, size.y);
         glClearColor(0.15f, 0.24f, 0.24f, 0);
@@ -312,14 +321,18 @@ public:
             un->bindValue(cascadeSplits_, MaxCascades);
         }
 
+        // 场景中的物体共用同一个材质，通过渲染队列合并状态切换
+        renderer->setRenderQueue(&renderQueue_);
         ground_->draw(renderer);
         casters_->draw(renderer);
+        renderer->setRenderQueue(nullptr);
+        renderQueue_.flush(renderer);
     }
     
     // 在屏幕上渲染cascade贴图
     void drawCascadeTexture(Renderer *renderer)
     {
-        glDisable(GL_DEPTH_TEST);
+        GLStateCache::instance()->disable(GL_DEPTH_TEST);
         renderer->setViewMatrix(Matrix::Identity);
         renderer->setProjMatrix(Matrix::Identity);
         float startX = -0.8f;
@@ -335,7 +348,7 @@ public:
             
             startX += 0.45f;
         }
-        glEnable(GL_DEPTH_TEST);
+        GLStateCache::instance()->enable(GL_DEPTH_TEST);
 	}
 
 	void onSizeChange(int width, int height) override
@@ -423,6 +436,8 @@ private:
     MaterialPtr     materials_[2];
 
     TransformPtr    casters_;
+    TransformHierarchy casterHierarchy_;
+    RenderQueue     renderQueue_;
     TransformPtr    ground_;
     
     MeshPtr         groundMesh_;
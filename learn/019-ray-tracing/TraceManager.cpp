@@ -0,0 +1,532 @@
+#include "TraceManager.h"
+#include "LogTool.h"
+
+#include <algorithm>
+#include <random>
+#include <cmath>
+#include <cstring>
+
+///////////////////////////////////////////////////////////////////
+MeshInfo::MeshInfo(const Material &mtl)
+    : material_(mtl)
+{
+    boundingBox_.setZero();
+}
+
+void MeshInfo::build()
+{
+    if (triangles_.empty())
+    {
+        boundingBox_.setZero();
+    }
+    else
+    {
+        boundingBox_ = triangles_.getBoundingBox();
+    }
+
+    std::vector<AABB> bounds(triangles_.size());
+    for (size_t i = 0; i < bounds.size(); ++i)
+    {
+        bounds[i] = triangles_.getTriangleBounds((uint32_t)i);
+    }
+    bvh_.build(bounds);
+}
+
+///////////////////////////////////////////////////////////////////
+bool FaceIntersector::intersect(uint32_t primitive, const Ray &ray, float &tMax)
+{
+    float t, u, v;
+    if (mesh_->triangles_.intersectTriangle(primitive, ray, t, u, v) && t < tMax)
+    {
+        tMax = t;
+        face_ = (int)primitive;
+        u_ = u;
+        v_ = v;
+        return true;
+    }
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////
+void TraceCamera::init(const Matrix &matrix, float fov, float aspect, float nearPlane)
+{
+    zNear = nearPlane;
+    halfHeight = zNear * tan(fov / 2.0f);
+    halfWidth = halfHeight * aspect;
+    viewToWorld = matrix;
+}
+
+void TraceCamera::lookAt(const Vector3 &position, const Vector3 &target, const Vector3 &up, float fov, float aspect, float nearPlane)
+{
+    Vector3 forward = target - position;
+    forward.normalize();
+
+    Vector3 right = up.crossProduct(forward);
+    right.normalize();
+
+    Vector3 newUp = forward.crossProduct(right);
+    newUp.normalize();
+
+    Matrix matrix(
+        right.x, right.y, right.z, 0.0f,
+        newUp.x, newUp.y, newUp.z, 0.0f,
+        forward.x, forward.y, forward.z, 0.0f,
+        position.x, position.y, position.z, 1.0f);
+    init(matrix, fov, aspect, nearPlane);
+}
+
+Ray TraceCamera::generateRay(float x, float y) const
+{
+    Vector3 dirInView(x * halfWidth, y * halfHeight, zNear);
+
+    Ray ray;
+    ray.direction_ = viewToWorld.transformNormal(dirInView);
+    ray.direction_.normalize();
+    ray.origin_ = viewToWorld.transformPoint(Vector3::Zero);
+    return ray;
+}
+
+///////////////////////////////////////////////////////////////////
+bool TraceManager::MeshIntersector::intersect(uint32_t primitive, const Ray &ray, float &tMax)
+{
+    const MeshInfo *mesh = meshs_[primitive].get();
+    FaceIntersector intersector(mesh);
+
+    // info_为空表示任意相交查询
+    if (info_ == nullptr)
+    {
+        return mesh->bvh_.intersectAny(ray, intersector, tMax);
+    }
+
+    if (mesh->bvh_.intersectClosest(ray, intersector, tMax))
+    {
+        info_->meshIndex_ = (int)primitive;
+        info_->t_ = tMax;
+        info_->u_ = intersector.u_;
+        info_->v_ = intersector.v_;
+        info_->face_ = intersector.face_;
+        return true;
+    }
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////
+TraceManager::TraceManager(size_t nThreads)
+    : lightColor_(1.0f, 1.0f, 1.0f, 1.0f)
+    , ambientColor_(0.2f, 0.2f, 0.2f, 1.0f)
+    , pass_(0)
+    , nPendingTiles_(0)
+    , finished_(true)
+    , totalSamples_(0)
+    , totalCastRays_(0)
+    , generation_(0)
+    , pool_(nThreads)
+{
+
+}
+
+TraceManager::~TraceManager()
+{
+    cancelTrace();
+}
+
+void TraceManager::addMesh(MeshInfoPtr mesh)
+{
+    meshs_.push_back(mesh);
+}
+
+void TraceManager::buildAccelerator()
+{
+    std::vector<AABB> bounds(meshs_.size());
+    for (size_t i = 0; i < meshs_.size(); ++i)
+    {
+        bounds[i] = meshs_[i]->boundingBox_;
+    }
+    meshBVH_.build(bounds, 1);
+}
+
+void TraceManager::initTrace(int width, int height, const TraceCamera &camera)
+{
+    cancelTrace();
+
+    camera_ = camera;
+    viewPosition_ = camera.getPosition();
+
+    width_ = width;
+    height_ = height;
+
+    size_t nPixels = width * height;
+    pixels_.assign(nPixels * 4, 0);
+    accumulation_.assign(nPixels, Vector4(0.0f, 0.0f, 0.0f, 0.0f));
+    lumSquareSum_.assign(nPixels, 0.0f);
+    sampleCounts_.assign(nPixels, 0);
+    converged_.assign(nPixels, 0);
+
+    tiles_.clear();
+    for (int y = 0; y < height; y += TileSize)
+    {
+        for (int x = 0; x < width; x += TileSize)
+        {
+            TraceTile tile;
+            tile.x = x;
+            tile.y = y;
+            tile.width = std::min(width - x, (int)TileSize);
+            tile.height = std::min(height - y, (int)TileSize);
+            tiles_.push_back(tile);
+        }
+    }
+    tileActive_.assign(tiles_.size(), 1);
+
+    finishedTiles_.clear();
+    totalSamples_ = 0;
+    totalCastRays_ = 0;
+    firstPassTime_ = 0.0f;
+    traceTime_ = 0.0f;
+    finished_ = tiles_.empty();
+
+    totalRays_ = nPixels;
+    LOG_DEBUG("Total rays: %d, tiles: %d, threads: %d",
+        (int)totalRays_, (int)tiles_.size(), (int)pool_.getNumThreads());
+
+    startTime_ = std::chrono::steady_clock::now();
+    pass_ = 0;
+    submitPass(generation_);
+}
+
+void TraceManager::cancelTrace()
+{
+    ++generation_;
+    pool_.wait();
+
+    // 被取消的区块不会再提交下一轮，这里结束追踪，否则waitTrace会一直等待
+    nPendingTiles_ = 0;
+    finished_ = true;
+}
+
+void TraceManager::waitTrace()
+{
+    while (!finished_)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    pool_.wait();
+}
+
+void TraceManager::popFinishedTiles(std::vector<TraceTile> &tiles)
+{
+    tiles.clear();
+
+    std::lock_guard<std::mutex> lock(finishedMutex_);
+    tiles.swap(finishedTiles_);
+}
+
+void TraceManager::getAverageColors(std::vector<float> &rgb) const
+{
+    rgb.resize(accumulation_.size() * 3);
+    for (size_t i = 0; i < accumulation_.size(); ++i)
+    {
+        float invN = sampleCounts_[i] > 0 ? 1.0f / float(sampleCounts_[i]) : 0.0f;
+        rgb[i * 3 + 0] = accumulation_[i].x * invN;
+        rgb[i * 3 + 1] = accumulation_[i].y * invN;
+        rgb[i * 3 + 2] = accumulation_[i].z * invN;
+    }
+}
+
+void TraceManager::submitPass(int generation)
+{
+    std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - startTime_;
+    if (pass_ == 1)
+    {
+        firstPassTime_ = elapsed.count();
+    }
+
+    std::vector<int> activeTiles;
+    for (size_t i = 0; i < tiles_.size(); ++i)
+    {
+        if (tileActive_[i])
+        {
+            activeTiles.push_back((int)i);
+        }
+    }
+
+    int maxPasses = progressive_ ? maxSamples_ : 1;
+    if (activeTiles.empty() || pass_ >= maxPasses)
+    {
+        traceTime_ = elapsed.count();
+        LOG_DEBUG("Ray trace finished. passes: %d, samples: %d, time: %.3fs",
+            (int)pass_, (int)totalSamples_, traceTime_);
+        finished_ = true;
+        return;
+    }
+
+    if (pass_ > 0)
+    {
+        LOG_DEBUG("Ray trace pass: %d, active tiles: %d", (int)pass_, (int)activeTiles.size());
+    }
+
+    int pass = pass_++;
+    nPendingTiles_ = (int)activeTiles.size();
+    for (int index : activeTiles)
+    {
+        pool_.submit([this, index, pass, generation]()
+        {
+            traceTile(index, pass, generation);
+        });
+    }
+}
+
+void TraceManager::traceTile(int tileIndex, int pass, int generation)
+{
+    const TraceTile &tile = tiles_[tileIndex];
+
+    // 每个区块、每一轮使用独立的随机序列，结果与线程的调度无关
+    std::minstd_rand random(uint32_t(tileIndex * 7919 + pass * 104729 + 1));
+    std::uniform_real_distribution<float> jitter(0.0f, 1.0f);
+
+    bool active = false;
+    size_t nSamples = 0;
+    size_t nRays = 0;
+    for (int r = tile.y; r < tile.y + tile.height; ++r)
+    {
+        // 已经开始了新的追踪，放弃当前区块
+        if (generation != generation_)
+        {
+            return;
+        }
+
+        for (int c = tile.x; c < tile.x + tile.width; ++c)
+        {
+            int index = r * width_ + c;
+            if (converged_[index])
+            {
+                continue;
+            }
+
+            // 第一个采样位于像素中心，之后的采样在像素内随机抖动
+            float dx = 0.5f, dy = 0.5f;
+            if (pass > 0)
+            {
+                dx = jitter(random);
+                dy = jitter(random);
+            }
+            float px = (float(c) + dx) / float(width_) * 2.0f - 1.0f;
+            float py = 1.0f - (float(r) + dy) / float(height_) * 2.0f;
+
+            TraceInfo info;
+            info.pixelIndex_ = index * 4;
+            info.ray_ = camera_.generateRay(px, py);
+            Vector4 cr = tracePixel(info);
+
+            accumulateSample(index, cr);
+            ++nSamples;
+            nRays += info.nRays_;
+
+            if (!converged_[index])
+            {
+                active = true;
+            }
+        }
+    }
+
+    tileActive_[tileIndex] = active;
+    totalSamples_ += nSamples;
+    totalCastRays_ += nRays;
+
+    // 本轮所有区块完成之前，不会开始下一轮，此时区块的像素不会被改写
+    TraceTile finished = tile;
+    finished.pixels.resize(tile.width * tile.height * 4);
+    for (int r = 0; r < tile.height; ++r)
+    {
+        memcpy(&finished.pixels[r * tile.width * 4], &pixels_[((tile.y + r) * width_ + tile.x) * 4], tile.width * 4);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(finishedMutex_);
+        finishedTiles_.push_back(std::move(finished));
+    }
+
+    // 本轮的最后一个区块，负责提交下一轮
+    if (--nPendingTiles_ == 0 && generation == generation_)
+    {
+        submitPass(generation);
+    }
+}
+
+void TraceManager::accumulateSample(int index, const Vector4 &color)
+{
+    Vector4 &sum = accumulation_[index];
+    sum += color;
+
+    float lum = color.x * 0.2126f + color.y * 0.7152f + color.z * 0.0722f;
+    lumSquareSum_[index] += lum * lum;
+
+    int n = ++sampleCounts_[index];
+    float invN = 1.0f / float(n);
+    Vector4 avg = sum * invN;
+
+    if (!progressive_)
+    {
+        converged_[index] = 1;
+    }
+    else if (n >= minSamples_)
+    {
+        // 均值的方差 = 样本方差 / n
+        float mean = (sum.x * 0.2126f + sum.y * 0.7152f + sum.z * 0.0722f) * invN;
+        float variance = std::max(lumSquareSum_[index] * invN - mean * mean, 0.0f);
+        if (variance * invN < adaptiveThreshold_ * adaptiveThreshold_)
+        {
+            converged_[index] = 1;
+        }
+    }
+
+    char *pixel = &pixels_[index * 4];
+    pixel[0] = (char)clamp(int(avg.x * 255), 0, 255);
+    pixel[1] = (char)clamp(int(avg.y * 255), 0, 255);
+    pixel[2] = (char)clamp(int(avg.z * 255), 0, 255);
+    pixel[3] = (char)clamp(int(avg.w * 255), 0, 255);
+}
+
+Vector4 TraceManager::tracePixel(TraceInfo &info)
+{
+    rayTrace(info, 1);
+
+    Vector4 cr = ambientColor_;
+    if (info.isValid())
+    {
+        cr = info.color_;
+        cr += ambientColor_ * meshs_[info.meshIndex_]->material_.color;
+    }
+
+    cr.x = clamp(cr.x, 0.0f, 1.0f);
+    cr.y = clamp(cr.y, 0.0f, 1.0f);
+    cr.z = clamp(cr.z, 0.0f, 1.0f);
+    cr.w = clamp(cr.w, 0.0f, 1.0f);
+    return cr;
+}
+
+void TraceManager::rayTrace(TraceInfo &info, int depth)
+{
+    rayIntersect(info);
+    ++info.nRays_;
+
+    if (!info.isValid())
+    {
+        return;
+    }
+
+    const Ray &ray = info.ray_;
+
+    // 添加一点偏移，防止拾取到自己
+    const float epsilon = 0.01f;
+    Vector3 position = ray.origin_ + ray.direction_ * info.t_;
+
+    MeshInfoPtr &mesh = meshs_[info.meshIndex_];
+    const Vector3 &normal = mesh->triangles_.getNormal(info.face_);
+
+    // 检测是否对光源可见
+    do
+    {
+        Vector3 lightDir = lightPosition_ - position;
+        float distanceToLight = lightDir.length();
+        lightDir /= distanceToLight; // normalize
+
+        Ray lightRay;
+        lightRay.origin_ = position + lightDir * epsilon;
+        lightRay.direction_ = lightDir;
+        distanceToLight -= epsilon;
+
+        // 交点到灯光之间，有障碍物
+        info.bShadow_ = isOccluded(lightRay, distanceToLight);
+        ++info.nRays_;
+        if (!info.bShadow_)
+        {
+            info.color_ += lightVertex(position, normal, lightPosition_, lightColor_,
+                viewPosition_, mesh->material_, 1.0f, 0.2f, 0.0f);
+        }
+    } while (0);
+
+    // 反射光线
+    if(depth-- > 0 && mesh->material_.reflection > 0.0f)
+    {
+        Vector3 reflactDir = reflect(-ray.direction_, normal);
+
+        TraceInfo reflectTrace;
+        reflectTrace.ray_.origin_ = position + reflactDir * epsilon; // 添加一点偏移，防止拾取到自己
+        reflectTrace.ray_.direction_ = reflactDir;
+
+        rayTrace(reflectTrace, depth);
+        info.nRays_ += reflectTrace.nRays_;
+
+        if (reflectTrace.isValid())
+        {
+            // 以相交点为灯光，照射当前点
+            MeshInfo::Material &lightMtl = meshs_[reflectTrace.meshIndex_]->material_;
+            Vector3 lightPos = reflectTrace.ray_.origin_ + reflactDir * reflectTrace.t_;
+            // 加上环境光颜色
+            Vector4 lightColor = reflectTrace.color_ + lightMtl.color * ambientColor_;
+
+            Vector4 color = lightVertex(position, normal, lightPos, lightColor,
+                viewPosition_, mesh->material_, 1.0f, 1.0f, 0.1f);
+            info.color_ += color * (lightMtl.reflection * bounceAttenuation_);
+        }
+    }
+}
+
+void TraceManager::rayIntersect(TraceInfo &info)
+{
+    MeshIntersector intersector(meshs_, &info);
+    float tMax = info.t_;
+    meshBVH_.intersectClosest(info.ray_, intersector, tMax);
+}
+
+bool TraceManager::isOccluded(const Ray &ray, float distance)
+{
+    MeshIntersector intersector(meshs_, nullptr);
+    return meshBVH_.intersectAny(ray, intersector, distance);
+}
+
+Vector3 TraceManager::reflect(const Vector3 &ray, const Vector3 &normal)
+{
+    Vector3 ret = normal * (normal.dotProduct(ray) * 2.0f) - ray;
+    ret.normalize();
+    return ret;
+}
+
+Vector4 TraceManager::lightVertex(
+    const Vector3 &position,
+    const Vector3 &normal,
+    const Vector3 &lightPos,
+    const Vector4 &lightColor,
+    const Vector3 &viewPos,
+    const MeshInfo::Material &material,
+    float attK0, float attk1, float attK2)
+{
+    Vector3 lightDir = lightPos - position;
+    float distanceToLight = lightDir.length();
+    lightDir /= distanceToLight;
+
+    Vector4 ret;
+    // 漫反射
+    float diffuse = normal.dotProduct(lightDir);
+    if (diffuse <= 0.0f)
+    {
+        return ret;
+    }
+
+    float indensity = diffuse;
+
+    // 镜面反射
+    Vector3 reflectDir = reflect(lightDir, normal);
+    Vector3 viewDir = viewPos - position;
+    viewDir.normalize();
+
+    float specular = reflectDir.dotProduct(viewDir);
+    if (specular > 0)
+    {
+        indensity += std::pow(specular, 32);
+    }
+
+    float attenuation = 1.0f / (1.0f + distanceToLight * 0.1f + distanceToLight * distanceToLight * attK2);
+    ret = material.color * lightColor * (indensity * attenuation);
+    return ret;
+}
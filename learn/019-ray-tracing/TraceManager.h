@@ -0,0 +1,286 @@
+#pragma once
+
+#include "Reference.h"
+#include "SmartPointer.h"
+#include "Matrix.h"
+#include "Vector4.h"
+#include "Ray.h"
+#include "BVH.h"
+#include "TriangleBuffer.h"
+#include "ThreadPool.h"
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <float.h>
+
+/** 参与光线追踪的模型。三角形已经变换到世界空间。
+ *  不依赖GL资源，可以在没有窗口的环境下使用。
+ */
+class MeshInfo : public ReferenceCount
+{
+public:
+    /// 测试材质
+    struct Material
+    {
+        // 表面颜色
+        Vector4 color;
+        // 反射系数
+        float   reflection;
+        // 折射系数
+        float   refraction;
+    };
+
+    Material        material_;
+
+    /// 世界空间中的三角形
+    TriangleBuffer  triangles_;
+    AABB            boundingBox_;
+    /// 三角形的层次包围盒
+    BVH             bvh_;
+
+public:
+    explicit MeshInfo(const Material &mtl);
+
+    /** 三角形添加完毕之后，需要调用此函数构建包围盒和BVH。*/
+    void build();
+};
+
+typedef SmartPointer<MeshInfo> MeshInfoPtr;
+
+/** 底层BVH的求交器。对模型中的单个三角形求交。*/
+class FaceIntersector : public BVHIntersector
+{
+public:
+    const MeshInfo* mesh_;
+    int     face_ = -1;
+    float   u_ = 0.0f;
+    float   v_ = 0.0f;
+
+    explicit FaceIntersector(const MeshInfo *mesh)
+        : mesh_(mesh)
+    {}
+
+    virtual bool intersect(uint32_t primitive, const Ray &ray, float &tMax) override;
+};
+
+class TraceInfo
+{
+public:
+    Ray     ray_;
+    int     pixelIndex_ = 0;
+    int     meshIndex_ = -1;
+    int     face_;
+    float   t_ = FLT_MAX;
+    float   u_ = 0.0f;
+    float   v_ = 0.0f;
+    Vector4 color_;
+    bool    bShadow_ = false;
+    /// 追踪过程中发射的射线数量，包括阴影射线和反射射线
+    int     nRays_ = 0;
+
+    TraceInfo()
+    {}
+
+    bool isValid() const { return meshIndex_ >= 0; }
+};
+
+/** 光线追踪使用的相机参数。
+ *  工作线程中不能直接访问Camera，因为相机在追踪的过程中可能会移动。
+ */
+struct TraceCamera
+{
+    Matrix  viewToWorld;
+    float   halfWidth = 0.0f;
+    float   halfHeight = 0.0f;
+    float   zNear = 0.0f;
+
+    /** @param fov  y方向上的张角 */
+    void init(const Matrix &matrix, float fov, float aspect, float nearPlane);
+
+    /** 与Transform::lookAt的约定相同。*/
+    void lookAt(const Vector3 &position, const Vector3 &target, const Vector3 &up, float fov, float aspect, float nearPlane);
+
+    Vector3 getPosition() const { return Vector3(viewToWorld._41, viewToWorld._42, viewToWorld._43); }
+
+    /** 生成投影空间中(x, y)处的射线。参考Camera::projectionPosToWorldRay */
+    Ray generateRay(float x, float y) const;
+};
+
+/** 图像中的一个矩形区块。区块是多线程追踪的最小单位。*/
+struct TraceTile
+{
+    int x;
+    int y;
+    int width;
+    int height;
+    /// 追踪完毕时区块像素的副本(RGBA，每行width个像素)，只有popFinishedTiles取走的区块才有
+    std::vector<char> pixels;
+};
+
+class TraceManager
+{
+    /** 顶层BVH的求交器。对模型实例求交，再进入模型自己的BVH。*/
+    class MeshIntersector : public BVHIntersector
+    {
+    public:
+        const std::vector<MeshInfoPtr> &meshs_;
+        TraceInfo*  info_;
+
+        MeshIntersector(const std::vector<MeshInfoPtr> &meshs, TraceInfo *info)
+            : meshs_(meshs)
+            , info_(info)
+        {}
+
+        virtual bool intersect(uint32_t primitive, const Ray &ray, float &tMax) override;
+    };
+
+public:
+
+    /// 场景中所有的模型
+    std::vector<MeshInfoPtr> meshs_;
+    /// 模型实例的顶层BVH
+    BVH         meshBVH_;
+    /// 追踪的结果。工作线程直接写入自己负责的区块，追踪结束之前只能通过popFinishedTiles读取
+    std::vector<char>       pixels_;
+
+    size_t      totalRays_ = 0;
+    Vector4     lightColor_;
+    Vector3     lightPosition_;
+    Vector3     viewPosition_;
+    Vector4     ambientColor_;
+    /// 每次反射后的衰减
+    float       bounceAttenuation_ = 1.0f;
+
+    /// 渐进模式。每一轮给每个像素增加一个抖动的采样，显示累积的平均值
+    bool        progressive_ = true;
+    /// 渐进模式下，每个像素最多的采样数
+    int         maxSamples_ = 64;
+    /// 自适应采样：至少采样这么多次之后，才开始估计方差
+    int         minSamples_ = 4;
+    /// 自适应采样：亮度均值的标准误差小于此值时，认为像素已经收敛，不再采样
+    float       adaptiveThreshold_ = 0.5f / 255.0f;
+
+private:
+    /// 区块的边长(像素)
+    static const int TileSize = 32;
+
+    int         width_ = 0;
+    int         height_ = 0;
+    TraceCamera camera_;
+    std::vector<TraceTile>  tiles_;
+
+    /// 每个像素累积的颜色
+    std::vector<Vector4>    accumulation_;
+    /// 每个像素累积的亮度平方，用于估计方差
+    std::vector<float>      lumSquareSum_;
+    std::vector<int>        sampleCounts_;
+    std::vector<char>       converged_;
+    /// 区块中是否还有没收敛的像素。只由负责该区块的任务修改
+    std::vector<char>       tileActive_;
+
+    /// 当前的轮次，以及本轮还没有完成的区块数量
+    std::atomic<int>        pass_;
+    std::atomic<int>        nPendingTiles_;
+    std::atomic<bool>       finished_;
+    std::atomic<size_t>     totalSamples_;
+    std::atomic<size_t>     totalCastRays_;
+
+    /// 已经追踪完毕，但还没有被取走的区块
+    std::vector<TraceTile>  finishedTiles_;
+    std::mutex              finishedMutex_;
+
+    /// 每次开始追踪都会递增，用于取消上一次还未执行完的区块
+    std::atomic<int>        generation_;
+    std::chrono::steady_clock::time_point startTime_;
+    /// 第一轮和整个追踪花费的时间(秒)
+    float       firstPassTime_ = 0.0f;
+    float       traceTime_ = 0.0f;
+
+    /// 必须放在最后，保证最先析构
+    ThreadPool  pool_;
+
+public:
+    /** @param nThreads 追踪使用的线程数量。为0则使用硬件线程数。*/
+    explicit TraceManager(size_t nThreads = 0);
+    ~TraceManager();
+
+    bool isFinished() const { return finished_; }
+
+    void addMesh(MeshInfoPtr mesh);
+
+    /** 构建顶层BVH。添加完所有模型后，需要调用此函数。*/
+    void buildAccelerator();
+
+    /** 开始追踪。图像被划分成区块，提交到线程池中并行追踪。
+     *  渐进模式下，所有区块完成一轮之后，再对还没收敛的区块开始下一轮。
+     */
+    void initTrace(int width, int height, const TraceCamera &camera);
+
+    /** 取消正在进行的追踪，等待工作线程退出。之后isFinished返回true，waitTrace立即返回。*/
+    void cancelTrace();
+
+    /** 阻塞等待追踪结束。调用者线程不参与追踪，所以实际使用的线程数就是线程池的大小。*/
+    void waitTrace();
+
+    /** 取走已经追踪完毕的区块，区块带有完成时像素的副本。
+     *  下一轮追踪可能已经开始改写pixels_，所以只能使用副本中的像素。只能在主线程中调用。
+     */
+    void popFinishedTiles(std::vector<TraceTile> &tiles);
+
+    int getWidth() const { return width_; }
+    int getHeight() const { return height_; }
+    size_t getNumThreads() const { return pool_.getNumThreads(); }
+
+    /** 以下统计数据在追踪结束之后才是准确的。*/
+    int getNumPasses() const { return pass_; }
+    size_t getNumSamples() const { return totalSamples_; }
+    /** 发射的射线总数，包括阴影射线和反射射线。*/
+    size_t getNumRays() const { return totalCastRays_; }
+    float getFirstPassTime() const { return firstPassTime_; }
+    float getTraceTime() const { return traceTime_; }
+
+    /** 每个像素的平均颜色，每个像素3个float(RGB)。*/
+    void getAverageColors(std::vector<float> &rgb) const;
+
+    void rayTrace(TraceInfo &info, int depth);
+
+    void rayIntersect(TraceInfo &info);
+
+    /** 射线在distance距离内是否有遮挡。*/
+    bool isOccluded(const Ray &ray, float distance);
+
+    /** 计算反射向量
+    *   @param  ray     输入向量的负方向向量
+    *   @param  normal  平面的法向量
+    */
+    static Vector3 reflect(const Vector3 &ray, const Vector3 &normal);
+
+    /** 顶点光照计算
+    *   @param  position    顶点位置
+    *   @param  normal      顶点的法线
+    *   @param  lightPos    灯光位置
+    */
+    static Vector4 lightVertex(
+        const Vector3 &position,
+        const Vector3 &normal,
+        const Vector3 &lightPos,
+        const Vector4 &lightColor,
+        const Vector3 &viewPos,
+        const MeshInfo::Material &material,
+        float attK0, float attk1, float attK2);
+
+private:
+    /** 提交一轮追踪。只提交还有没收敛像素的区块。*/
+    void submitPass(int generation);
+
+    /** 对区块中每个没收敛的像素增加一个采样。在工作线程中执行。*/
+    void traceTile(int tileIndex, int pass, int generation);
+
+    /** 累积一个采样，更新显示的颜色，并判断像素是否收敛。*/
+    void accumulateSample(int index, const Vector4 &color);
+
+    /** 追踪一条主射线，返回截断到[0, 1]的颜色。*/
+    Vector4 tracePixel(TraceInfo &info);
+};
@@ -0,0 +1,168 @@
+#include "TraceScene.h"
+#include "DemoTool.h"
+#include "Mesh.h"
+#include "Vector2.h"
+#include "LogTool.h"
+
+#include <smartjson/smartjson.hpp>
+#include <map>
+
+namespace
+{
+    const float DegreeToRadian = PI_FULL / 180.0f;
+
+    Vector3 readVector3(const mjson::Node &node, const Vector3 &defaultValue)
+    {
+        if (node.isNumber())
+        {
+            float v = (float)node.asFloat();
+            return Vector3(v, v, v);
+        }
+        if (!node.isArray() || node.size() < 3)
+        {
+            return defaultValue;
+        }
+        return Vector3((float)node[0u].asFloat(), (float)node[1u].asFloat(), (float)node[2u].asFloat());
+    }
+
+    Vector4 readVector4(const mjson::Node &node, const Vector4 &defaultValue)
+    {
+        if (!node.isArray() || node.size() < 3)
+        {
+            return defaultValue;
+        }
+        float w = node.size() > 3 ? (float)node[3u].asFloat() : 1.0f;
+        return Vector4((float)node[0u].asFloat(), (float)node[1u].asFloat(), (float)node[2u].asFloat(), w);
+    }
+
+    float readFloat(const mjson::Node &node, float defaultValue)
+    {
+        return node.isNumber() ? (float)node.asFloat() : defaultValue;
+    }
+
+    /** 用DemoTool中的生成函数创建单位大小的模型，由物体的scale缩放。不支持的类型返回空。*/
+    MeshPtr createShape(const std::string &type)
+    {
+        if (type == "box")
+        {
+            return createCube(Vector3(1.0f, 1.0f, 1.0f));
+        }
+        if (type == "plane")
+        {
+            return createPlane(Vector2(1.0f, 1.0f), 1.0f);
+        }
+        if (type == "quad")
+        {
+            return createQuad(Vector2(1.0f, 1.0f));
+        }
+        return nullptr;
+    }
+}
+
+TraceScene::TraceScene()
+    : cameraPosition_(0.0f, 3.0f, -10.0f)
+    , cameraTarget_(0.0f, 0.0f, 0.0f)
+    , cameraUp_(0.0f, 1.0f, 0.0f)
+    , cameraFov_(PI_QUARTER)
+    , cameraNear_(1.0f)
+{
+}
+
+bool TraceScene::load(const std::string &text, TraceManager &mgr)
+{
+    mjson::Parser parser;
+    if (!parser.parseFromData(text.c_str(), text.size()))
+    {
+        LOG_ERROR("Failed to parse scene.");
+        return false;
+    }
+
+    mjson::Node root = parser.getRoot();
+    if (!root.isDict())
+    {
+        LOG_ERROR("Scene root must be a dict.");
+        return false;
+    }
+
+    const mjson::Node &camera = root["camera"];
+    if (camera.isDict())
+    {
+        cameraPosition_ = readVector3(camera["position"], cameraPosition_);
+        cameraTarget_ = readVector3(camera["target"], cameraTarget_);
+        cameraUp_ = readVector3(camera["up"], cameraUp_);
+        cameraFov_ = readFloat(camera["fov"], cameraFov_ / DegreeToRadian) * DegreeToRadian;
+        cameraNear_ = readFloat(camera["near"], cameraNear_);
+    }
+
+    const mjson::Node &light = root["light"];
+    if (light.isDict())
+    {
+        mgr.lightPosition_ = readVector3(light["position"], mgr.lightPosition_);
+        mgr.lightColor_ = readVector4(light["color"], mgr.lightColor_);
+    }
+    mgr.ambientColor_ = readVector4(root["ambient"], mgr.ambientColor_);
+
+    std::vector<MeshInfo::Material> materials;
+    const mjson::Node &materialList = root["materials"];
+    for (size_t i = 0; i < materialList.size(); ++i)
+    {
+        const mjson::Node &config = materialList[i];
+
+        MeshInfo::Material mtl;
+        mtl.color = readVector4(config["color"], Vector4(1.0f, 1.0f, 1.0f, 1.0f));
+        mtl.reflection = readFloat(config["reflection"], 0.0f);
+        mtl.refraction = readFloat(config["refraction"], 0.0f);
+        materials.push_back(mtl);
+    }
+
+    // 同一种类型的物体共用一个模型
+    std::map<std::string, MeshPtr> shapes;
+
+    const mjson::Node &objects = root["objects"];
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        const mjson::Node &config = objects[i];
+
+        int mtlIndex = config["material"].asInt();
+        if (mtlIndex < 0 || mtlIndex >= (int)materials.size())
+        {
+            LOG_ERROR("Object %d has invalid material %d.", (int)i, mtlIndex);
+            return false;
+        }
+
+        Vector3 scale = readVector3(config["scale"], Vector3(1.0f, 1.0f, 1.0f));
+        Vector3 rotation = readVector3(config["rotation"], Vector3::Zero) * DegreeToRadian;
+        Vector3 position = readVector3(config["position"], Vector3::Zero);
+
+        // 与Transform一致，先缩放，再旋转，最后平移
+        Matrix matScale, matRotation, matTranslate;
+        matScale.setScale(scale);
+        matRotation.setRotate(rotation.x, rotation.y, rotation.z);
+        matTranslate.setTranslate(position);
+        Matrix localToWorld = matScale * matRotation * matTranslate;
+
+        std::string type = config["type"].asStdString();
+        MeshPtr &shape = shapes[type];
+        if (!shape)
+        {
+            shape = createShape(type);
+        }
+        if (!shape)
+        {
+            LOG_ERROR("Object %d has unsupported type '%s'.", (int)i, type.c_str());
+            return false;
+        }
+
+        MeshInfoPtr mesh = new MeshInfo(materials[mtlIndex]);
+        mesh->triangles_.addMesh(shape.get(), localToWorld);
+        mgr.addMesh(mesh);
+    }
+    return true;
+}
+
+TraceCamera TraceScene::createCamera(float aspect) const
+{
+    TraceCamera camera;
+    camera.lookAt(cameraPosition_, cameraTarget_, cameraUp_, cameraFov_, aspect, cameraNear_);
+    return camera;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "TraceManager.h"
+#include <string>
+
+/** 光线追踪的场景描述，使用json格式。
+ *  {
+ *      "camera": { "position": [0, 3, -10], "target": [0, 0, 0], "up": [0, 1, 0], "fov": 45, "near": 1 },
+ *      "light": { "position": [-2, 5, -4], "color": [1, 1, 1, 1] },
+ *      "ambient": [0.2, 0.2, 0.2, 1],
+ *      "materials": [ { "color": [1, 1, 1, 1], "reflection": 1.0, "refraction": 0.0 } ],
+ *      "objects": [ { "type": "box", "position": [0, -5, 0], "rotation": [0, 0, 0], "scale": 10, "material": 0 } ]
+ *  }
+ *  角度使用度数。scale可以是数字或者数组。
+ *  type是DemoTool中生成的单位大小的模型：box(createCube)、plane(createPlane，xz平面)、quad(createQuad，xy平面)。
+ */
+class TraceScene
+{
+public:
+    Vector3     cameraPosition_;
+    Vector3     cameraTarget_;
+    Vector3     cameraUp_;
+    /// y方向上的张角(弧度)
+    float       cameraFov_;
+    float       cameraNear_;
+
+    TraceScene();
+
+    /** 解析场景，将模型添加到mgr中。模型的BVH和顶层BVH不会构建。
+     *  生成模型需要VertexDeclMgr，调用之前需要初始化。
+     *  @return 解析失败返回false，错误信息会输出到日志。
+     */
+    bool load(const std::string &text, TraceManager &mgr);
+
+    /** 根据场景中的相机参数，生成追踪用的相机。*/
+    TraceCamera createCamera(float aspect) const;
+};
@@ -0,0 +1,336 @@
+/** 命令行版本的光线追踪。不创建窗口和GL上下文，追踪结果直接写入图片文件。
+ *  用法：raytrace_cli scene.json [-o output.png] [-w 800] [-h 600] [--spp 1] [--threads 0] [--threshold 0.002]
+ *  输出格式由扩展名决定：png/bmp/tga/ppm输出8位颜色，hdr输出Radiance RGBE浮点颜色。
+ */
+#include "TraceScene.h"
+#include "VertexDeclaration.h"
+
+#include <stb/stb_image_write.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    struct Options
+    {
+        std::string scene;
+        std::string output = "output.png";
+        int     width = 800;
+        int     height = 600;
+        /// 每个像素的采样数。1表示非渐进模式，只追踪一轮
+        int     spp = 1;
+        /// 为0则使用硬件线程数
+        int     threads = 0;
+        /// 自适应采样的阈值。为负数则使用默认值
+        float   threshold = -1.0f;
+    };
+
+    float secondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<float>(Clock::now() - start).count();
+    }
+
+    void printUsage(const char *exe)
+    {
+        printf("usage: %s scene.json [options]\n"
+            "  -o <file>           output image. png/bmp/tga/ppm/hdr (default output.png)\n"
+            "  -w <width>          image width (default 800)\n"
+            "  -h <height>         image height (default 600)\n"
+            "  --spp <n>           max samples per pixel. >1 enables adaptive sampling (default 1)\n"
+            "  --threads <n>       number of worker threads. 0 = hardware threads (default 0)\n"
+            "  --threshold <v>     adaptive sampling threshold of luminance standard error\n",
+            exe);
+    }
+
+    std::string getExtension(const std::string &path)
+    {
+        size_t pos = path.rfind('.');
+        if (pos == std::string::npos)
+        {
+            return std::string();
+        }
+
+        std::string ext = path.substr(pos + 1);
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        return ext;
+    }
+
+    bool parseOptions(int argc, char **argv, Options &options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const char *arg = argv[i];
+            const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+            if (arg[0] != '-')
+            {
+                options.scene = arg;
+                continue;
+            }
+
+            if (value == nullptr)
+            {
+                printf("Missing value for option '%s'.\n", arg);
+                return false;
+            }
+            ++i;
+
+            if (strcmp(arg, "-o") == 0)
+            {
+                options.output = value;
+            }
+            else if (strcmp(arg, "-w") == 0)
+            {
+                options.width = atoi(value);
+            }
+            else if (strcmp(arg, "-h") == 0)
+            {
+                options.height = atoi(value);
+            }
+            else if (strcmp(arg, "--spp") == 0)
+            {
+                options.spp = atoi(value);
+            }
+            else if (strcmp(arg, "--threads") == 0)
+            {
+                options.threads = atoi(value);
+            }
+            else if (strcmp(arg, "--threshold") == 0)
+            {
+                options.threshold = (float)atof(value);
+            }
+            else
+            {
+                printf("Unknown option '%s'.\n", arg);
+                return false;
+            }
+        }
+
+        if (options.scene.empty())
+        {
+            printf("Missing scene file.\n");
+            return false;
+        }
+        if (options.width <= 0 || options.height <= 0 || options.spp <= 0 || options.threads < 0)
+        {
+            printf("Invalid image size, spp or thread count.\n");
+            return false;
+        }
+
+        // 追踪之前就检查输出格式，避免白白追踪一遍
+        std::string ext = getExtension(options.output);
+        if (ext != "png" && ext != "bmp" && ext != "tga" && ext != "ppm" && ext != "hdr")
+        {
+            printf("Unsupported output format '%s'. Use png, bmp, tga, ppm or hdr.\n", ext.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool readFile(const std::string &path, std::string &content)
+    {
+        FILE *fp = fopen(path.c_str(), "rb");
+        if (fp == nullptr)
+        {
+            return false;
+        }
+
+        fseek(fp, 0, SEEK_END);
+        long length = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+
+        content.resize(length > 0 ? (size_t)length : 0);
+        size_t nRead = content.empty() ? 0 : fread(&content[0], 1, content.size(), fp);
+        fclose(fp);
+        return nRead == content.size();
+    }
+
+    bool writePPM(const std::string &path, int width, int height, const std::vector<unsigned char> &rgb)
+    {
+        FILE *fp = fopen(path.c_str(), "wb");
+        if (fp == nullptr)
+        {
+            return false;
+        }
+
+        fprintf(fp, "P6\n%d %d\n255\n", width, height);
+        size_t nWritten = fwrite(rgb.data(), 1, rgb.size(), fp);
+        fclose(fp);
+        return nWritten == rgb.size();
+    }
+
+    /** Radiance RGBE格式。扫描线不压缩，大部分读取器都支持。*/
+    bool writeHDR(const std::string &path, int width, int height, const std::vector<float> &rgb)
+    {
+        FILE *fp = fopen(path.c_str(), "wb");
+        if (fp == nullptr)
+        {
+            return false;
+        }
+
+        fprintf(fp, "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y %d +X %d\n", height, width);
+
+        std::vector<unsigned char> rgbe(width * 4);
+        bool ok = true;
+        for (int y = 0; y < height && ok; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                const float *color = &rgb[(y * width + x) * 3];
+                unsigned char *out = &rgbe[x * 4];
+
+                float maxValue = std::max(color[0], std::max(color[1], color[2]));
+                if (maxValue < 1e-32f)
+                {
+                    out[0] = out[1] = out[2] = out[3] = 0;
+                    continue;
+                }
+
+                int exponent;
+                float scale = frexpf(maxValue, &exponent) * 256.0f / maxValue;
+                out[0] = (unsigned char)(color[0] * scale);
+                out[1] = (unsigned char)(color[1] * scale);
+                out[2] = (unsigned char)(color[2] * scale);
+                out[3] = (unsigned char)(exponent + 128);
+            }
+            ok = fwrite(rgbe.data(), 1, rgbe.size(), fp) == rgbe.size();
+        }
+        fclose(fp);
+        return ok;
+    }
+
+    /** 追踪结果的第0行是图片顶部，与图片文件的行顺序一致。*/
+    bool writeImage(const std::string &path, const TraceManager &mgr)
+    {
+        int width = mgr.getWidth();
+        int height = mgr.getHeight();
+        std::string ext = getExtension(path);
+
+        if (ext == "hdr")
+        {
+            std::vector<float> colors;
+            mgr.getAverageColors(colors);
+            return writeHDR(path, width, height, colors);
+        }
+
+        // 去掉alpha通道
+        std::vector<unsigned char> rgb(width * height * 3);
+        for (int i = 0; i < width * height; ++i)
+        {
+            memcpy(&rgb[i * 3], &mgr.pixels_[i * 4], 3);
+        }
+
+        if (ext == "png")
+        {
+            return stbi_write_png(path.c_str(), width, height, 3, rgb.data(), width * 3) != 0;
+        }
+        else if (ext == "bmp")
+        {
+            return stbi_write_bmp(path.c_str(), width, height, 3, rgb.data()) != 0;
+        }
+        else if (ext == "tga")
+        {
+            return stbi_write_tga(path.c_str(), width, height, 3, rgb.data()) != 0;
+        }
+        else if (ext == "ppm")
+        {
+            return writePPM(path, width, height, rgb);
+        }
+        return false;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    TraceManager mgr((size_t)options.threads);
+    mgr.progressive_ = options.spp > 1;
+    mgr.maxSamples_ = options.spp;
+    mgr.minSamples_ = std::min(mgr.minSamples_, options.spp);
+    if (options.threshold >= 0.0f)
+    {
+        mgr.adaptiveThreshold_ = options.threshold;
+    }
+
+    // 加载场景
+    Clock::time_point start = Clock::now();
+
+    std::string content;
+    if (!readFile(options.scene, content))
+    {
+        printf("Failed to read scene '%s'.\n", options.scene.c_str());
+        return 1;
+    }
+
+    // 场景中的模型由DemoTool生成，只在加载时需要顶点声明
+    VertexDeclMgr::initInstance();
+    TraceScene scene;
+    bool loaded = scene.load(content, mgr);
+    VertexDeclMgr::finiInstance();
+    if (!loaded)
+    {
+        printf("Failed to load scene '%s'.\n", options.scene.c_str());
+        return 1;
+    }
+    float loadTime = secondsSince(start);
+
+    // 构建BVH
+    start = Clock::now();
+    size_t nTriangles = 0;
+    for (MeshInfoPtr &mesh : mgr.meshs_)
+    {
+        mesh->build();
+        nTriangles += mesh->triangles_.size();
+    }
+    float meshBVHTime = secondsSince(start);
+
+    start = Clock::now();
+    mgr.buildAccelerator();
+    float sceneBVHTime = secondsSince(start);
+
+    // 追踪
+    TraceCamera camera = scene.createCamera(float(options.width) / float(options.height));
+    mgr.initTrace(options.width, options.height, camera);
+    mgr.waitTrace();
+
+    // 输出
+    start = Clock::now();
+    if (!writeImage(options.output, mgr))
+    {
+        printf("Failed to write image '%s'.\n", options.output.c_str());
+        return 1;
+    }
+    float writeTime = secondsSince(start);
+
+    float traceTime = mgr.getTraceTime();
+    float rayRate = traceTime > 0.0f ? float(mgr.getNumRays()) / traceTime : 0.0f;
+    float sampleRate = traceTime > 0.0f ? float(mgr.getNumSamples()) / traceTime : 0.0f;
+
+    printf("scene:        %s (%d meshes, %d triangles)\n", options.scene.c_str(), (int)mgr.meshs_.size(), (int)nTriangles);
+    printf("image:        %s (%dx%d, %d spp, %d threads)\n", options.output.c_str(),
+        options.width, options.height, options.spp, (int)mgr.getNumThreads());
+    printf("load:         %.3f ms\n", loadTime * 1000.0f);
+    printf("mesh BVH:     %.3f ms\n", meshBVHTime * 1000.0f);
+    printf("scene BVH:    %.3f ms\n", sceneBVHTime * 1000.0f);
+    printf("first pass:   %.3f ms\n", mgr.getFirstPassTime() * 1000.0f);
+    printf("trace:        %.3f ms (%d passes)\n", traceTime * 1000.0f, mgr.getNumPasses());
+    printf("write:        %.3f ms\n", writeTime * 1000.0f);
+    printf("rays:         %llu (%.3f Mrays/s)\n", (unsigned long long)mgr.getNumRays(), rayRate * 1e-6f);
+    printf("samples:      %llu (%.3f Msamples/s)\n", (unsigned long long)mgr.getNumSamples(), sampleRate * 1e-6f);
+    return 0;
+}
@@ -15,395 +15,10 @@
 #include "title.h"
 #include "FrameBuffer.h"
 #include "Texture2DArray.h"
-#include "Ray.h"
-#include "MeshFaceVisitor.h"
 #include "DebugDraw.h"
-
-#include <algorithm>
-#include <float.h>
-
-class MeshInfo : public ReferenceCount
-{
-public:
-    /// Բ
-    struct Material
-    {
-        // ɫ
-        Vector4 color;
-        // ϵ
-        float   reflection;
-        // ϵ
-        float   refraction;
-    };
-
-    TransformPtr    transform_;
-    MeshPtr         mesh_;
-    Material        material_;
-
-    struct Face
-    {
-        int i[3];
-        Vector3 normal;
-    };
-
-    std::vector<Vector3>    vertices_;
-    std::vector<Face>       faces_;
-    AABB            boundingBox_;
-
-public:
-    MeshInfo(TransformPtr t, MeshPtr m, const Material &mtl, const Matrix &localToWorld)
-    {
-        transform_ = t;
-        mesh_ = m;
-        material_ = mtl;
-
-        VertexBufferPtr vb = m->getVertexBuffer();
-        IndexBufferPtr ib = m->getIndexBuffer();
-
-        if(true)
-        {
-            vertices_.resize(vb->count());
-            const char *data = vb->lock(true);
-            for (size_t i = 0; i < vb->count(); ++i)
-            {
-                vertices_[i] = localToWorld.transformPoint(*(Vector3*)data);
-                data += vb->stride();
-            }
-            vb->unlock();
-        }
-
-        if (ib)
-        {
-            faces_.resize(ib->count() / 3);
-            const char *data = ib->lock(true);
-            for (size_t i = 0; i < faces_.size(); ++i)
-            {
-                Face &f = faces_[i];
-                f.i[0] = Mesh::extractIndex(data, ib->stride(), i * 3 + 0);
-                f.i[1] = Mesh::extractIndex(data, ib->stride(), i * 3 + 1);
-                f.i[2] = Mesh::extractIndex(data, ib->stride(), i * 3 + 2);
-            }
-            ib->unlock();
-        }
-        else
-        {
-            faces_.resize(vertices_.size() / 3);
-            for (size_t i = 0; i < faces_.size(); ++i)
-            {
-                Face &f = faces_[i];
-                f.i[0] = i * 3 + 0;
-                f.i[1] = i * 3 + 1;
-                f.i[2] = i * 3 + 2;
-            }
-        }
-
-        boundingBox_ = caculateBoundingBox();
-
-        for (Face &face : faces_)
-        {
-            calculateNormal(face);
-        }
-    }
-
-    AABB caculateBoundingBox()
-    {
-        AABB aabb;
-        if (faces_.empty())
-        {
-            aabb.max_ = aabb.min_ = transform_->getPosition();
-        }
-        else
-        {
-            aabb.setEmpty();
-            for (Face &f : faces_)
-            {
-                aabb.addPoint(vertices_[f.i[0]]);
-                aabb.addPoint(vertices_[f.i[1]]);
-                aabb.addPoint(vertices_[f.i[2]]);
-            }
-        }
-        return aabb;
-    }
-
-    void calculateNormal(Face &face)
-    {
-        Vector3 &a = vertices_[face.i[0]];
-        Vector3 &b = vertices_[face.i[1]];
-        Vector3 &c = vertices_[face.i[2]];
-
-        face.normal.crossProduct(c - a, b - a);
-        face.normal.normalize();
-    }
-};
-
-typedef SmartPointer<MeshInfo> MeshInfoPtr;
-
-class TraceInfo
-{
-public:
-    Ray     ray_;
-    int     pixelIndex_ = 0;
-    int     meshIndex_ = -1;
-    int     face_;
-    float   t_ = FLT_MAX;
-    float   u_ = 0.0f;
-    float   v_ = 0.0f;
-    Vector4 color_;
-    bool    bShadow_ = false;
-
-    TraceInfo()
-    {}
-
-    bool isValid() const { return meshIndex_ >= 0; }
-};
-
-class TraceManager
-{
-public:
-
-    /// еģ
-    std::vector<MeshInfoPtr> meshs_;
-    /// ִеĹ׷ٳ
-    std::list<TraceInfo>    pendingRays_;
-    std::vector<char>       pixels_;
-
-    size_t      totalRays_ = 0;
-    Vector4     lightColor_;
-    Vector3     lightPosition_;
-    Vector3     viewPosition_;
-    Vector4     ambientColor_;
-    /// ÿη˥
-    float       bounceAttenuation_ = 1.0f;
-
-public:
-    TraceManager()
-        : lightColor_(1.0f, 1.0f, 1.0f, 1.0f)
-        , ambientColor_(0.2f, 0.2f, 0.2f, 1.0f)
-    {
-
-    }
-
-    bool isFinished() const { return pendingRays_.empty(); }
-
-    void initTrace(int winWidth, int winHeight, Camera *camera)
-    {
-        viewPosition_ = camera->getPosition();
-
-        pixels_.resize(winWidth * winHeight * 4);
-        memset(pixels_.data(), 0, pixels_.size());
-
-        pendingRays_.clear();
-
-        for (int r = 0; r < winHeight; ++r)
-        {
-            for (int c = 0; c < winWidth; ++c)
-            {
-                int index = (r * winWidth + c) * 4;
-
-                float px = float(c) / float(winWidth) * 2.0f - 1.0f;
-                float py = 1.0f - float(r) / float(winHeight) * 2.0f;
-
-                TraceInfo info;
-                info.pixelIndex_ = index;
-                info.ray_ = camera->projectionPosToWorldRay(px, py);
-                pendingRays_.push_back(info);
-            }
-        }
-
-        totalRays_ = pendingRays_.size();
-        LOG_DEBUG("Total rays: %d", (int)pendingRays_.size());
-    }
-
-    void tick()
-    {
-        if (isFinished())
-        {
-            return;
-        }
-
-        TraceInfo info = pendingRays_.front();
-        pendingRays_.pop_front();
-
-        if (pendingRays_.size() % (totalRays_ / 100) == 0)
-        {
-            int progress = pendingRays_.size() * 100 / totalRays_;
-            LOG_DEBUG("Ray trace progress: %d", 100 - progress);
-        }
-
-        rayTrace(info, 1);
-
-        Vector4 cr = ambientColor_;
-        if (info.isValid())
-        {
-            cr = info.color_;
-            cr += ambientColor_ * meshs_[info.meshIndex_]->material_.color;
-        }
-
-        int index = info.pixelIndex_;
-        pixels_[index + 0] = (char)clamp(int(cr.x * 255), 0, 255);
-        pixels_[index + 1] = (char)clamp(int(cr.y * 255), 0, 255);
-        pixels_[index + 2] = (char)clamp(int(cr.z * 255), 0, 255);
-        pixels_[index + 3] = (char)clamp(int(cr.w * 255), 0, 255);
-
-        if (isFinished())
-        {
-            LOG_DEBUG("Ray trace finished.");
-        }
-    }
-
-    void rayTrace(TraceInfo &info, int depth)
-    {
-        rayIntersect(info);
-
-        if (!info.isValid())
-        {
-            return;
-        }
-
-        const Ray &ray = info.ray_;
-
-        // һƫƣֹʰȡԼ
-        const float epsilon = 0.01f;
-        Vector3 position = ray.origin_ + ray.direction_ * info.t_;
-       
-        MeshInfoPtr &mesh = meshs_[info.meshIndex_];
-        MeshInfo::Face &face = mesh->faces_[info.face_];
-
-        // ǷԹԴɼ
-        do
-        {
-            Vector3 lightDir = lightPosition_ - position;
-            float distanceToLight = lightDir.length();
-            lightDir /= distanceToLight; // normalize
-
-            TraceInfo lightTrace;
-            lightTrace.ray_.origin_ = position + lightDir * epsilon;
-            lightTrace.ray_.direction_ = lightDir;
-            distanceToLight -= epsilon;
-
-            rayIntersect(lightTrace);
-
-            // 㵽ƹ֮䣬ϰ
-            info.bShadow_ = lightTrace.isValid() && lightTrace.t_ < distanceToLight;
-            if (!info.bShadow_)
-            {
-                info.color_ += lightVertex(position, face.normal, lightPosition_, lightColor_,
-                    viewPosition_, mesh->material_, 1.0f, 0.2f, 0.0f);
-            }
-        } while (0);
-
-        // 
-        if(depth-- > 0 && mesh->material_.reflection > 0.0f)
-        {
-            Vector3 reflactDir = reflect(-ray.direction_, face.normal); 
-
-            TraceInfo reflectTrace;
-            reflectTrace.ray_.origin_ = position + reflactDir * epsilon; // һƫƣֹʰȡԼ
-            reflectTrace.ray_.direction_ = reflactDir;
-
-            rayTrace(reflectTrace, depth);
-
-            if (reflectTrace.isValid())
-            {
-                // ཻΪƹ⣬䵱ǰ
-                MeshInfo::Material &lightMtl = meshs_[reflectTrace.meshIndex_]->material_;
-                Vector3 lightPos = reflectTrace.ray_.origin_ + reflactDir * reflectTrace.t_;
-                // ϻɫ
-                Vector4 lightColor = reflectTrace.color_ + lightMtl.color * ambientColor_;
-
-                Vector4 color = lightVertex(position, face.normal, lightPos, lightColor,
-                    viewPosition_, mesh->material_, 1.0f, 1.0f, 0.1f);
-                info.color_ += color * (lightMtl.reflection * bounceAttenuation_);
-            }
-        }
-    }
-
-    void rayIntersect(TraceInfo &info)
-    {
-        Ray &ray = info.ray_;
-        for (size_t meshIndex = 0; meshIndex < meshs_.size(); ++meshIndex)
-        {
-            MeshInfoPtr mesh = meshs_[meshIndex];
-            if (!ray.intersectAABB(mesh->boundingBox_))
-            {
-                continue;
-            }
-
-            for (size_t i = 0; i < mesh->faces_.size(); ++i)
-            {
-                MeshInfo::Face &f = mesh->faces_[i];
-                float t, u, v;
-                if (ray.intersectTriangle(
-                    mesh->vertices_[f.i[0]],
-                    mesh->vertices_[f.i[1]],
-                    mesh->vertices_[f.i[2]],
-                    &t, &u, &v) && t < info.t_)
-                {
-                    info.meshIndex_ = meshIndex;
-                    info.t_ = t;
-                    info.u_ = u;
-                    info.v_ = v;
-                    info.face_ = (int)i;
-                }
-            }
-        }
-    }
-
-    /** 㷴
-    *   @param  ray     ĸ
-    *   @param  normal  ƽķ
-    */
-    static Vector3 reflect(const Vector3 &ray, const Vector3 &normal)
-    {
-        Vector3 ret = normal * (normal.dotProduct(ray) * 2.0f) - ray;
-        ret.normalize();
-        return ret;
-    }
-
-    /** ռ
-    *   @param  position    λ
-    *   @param  normal      ķ
-    *   @param  lightPos    ƹλ
-    */
-    static Vector4 lightVertex(
-        const Vector3 &position,
-        const Vector3 &normal,
-        const Vector3 &lightPos,
-        const Vector4 &lightColor,
-        const Vector3 &viewPos,
-        const MeshInfo::Material &material,
-        float attK0, float attk1, float attK2)
-    {
-        Vector3 lightDir = lightPos - position;
-        float distanceToLight = lightDir.length();
-        lightDir /= distanceToLight;
-
-        Vector4 ret;
-        // 
-        float diffuse = normal.dotProduct(lightDir);
-        if (diffuse <= 0.0f)
-        {
-            return ret;
-        }
-
-        float indensity = diffuse;
-
-        // 淴
-        Vector3 reflectDir = reflect(lightDir, normal);
-        Vector3 viewDir = viewPos - position;
-        viewDir.normalize();
-
-        float specular = reflectDir.dotProduct(viewDir);
-        if (specular > 0)
-        {
-            indensity += std::pow(specular, 32);
-        }
-
-        float attenuation = 1.0f / (1.0f + distanceToLight * 0.1f + distanceToLight * distanceToLight * attK2);
-        ret = material.color * lightColor * (indensity * attenuation);
-        return ret;
-    }
-};
+#include "TraceManager.h"
+#include "GLStateCache.h"
+#include "RenderQueue.h"
 
 class MyApplication : public Application
 {
@@ -470,13 +85,21 @@ public:
             TransformPtr t = new Transform();
             t->setPosition(Vector3(p[0], p[1], p[2]));
             t->setScale(p[3]);
-            t->addComponent(cubeMesh_);
+            int mtlIndex = (int)p[4];
+            const Vector4 &color = materials[mtlIndex].color;
+
+            // ݺţȾлὫǺϲһʵ
+            MeshPtr mesh = cubeMesh_->clone();
+            mesh->setInstanceColor(Color(color.x, color.y, color.z, color.w));
+            t->addComponent(mesh);
             objects_->addChild(t);
 
-            int mtlIndex = (int)p[4];
-            MeshInfoPtr m = new MeshInfo(t, cubeMesh_, materials[mtlIndex], t->getLocalToWorldMatrix());
-            traceMgr_.meshs_.push_back(m);
+            MeshInfoPtr m = new MeshInfo(materials[mtlIndex]);
+            m->triangles_.addMesh(cubeMesh_.get(), t->getLocalToWorldMatrix());
+            m->build();
+            traceMgr_.addMesh(m);
         }
+        traceMgr_.buildAccelerator();
 
         camera_.lookAt(Vector3(0, 3, -10), Vector3::Zero, Vector3::YAxis);
         setupProjectionMatrix();
@@ -492,8 +115,8 @@ public:
 
         traceMgr_.lightPosition_ = lightCamera_.getPosition();
 
-        glEnable(GL_CULL_FACE);
-        glCullFace(GL_BACK);
+        GLStateCache::instance()->enable(GL_CULL_FACE);
+        GLStateCache::instance()->cullFace(GL_BACK);
         return true;
     }
 
@@ -503,13 +126,20 @@ public:
 
         material = new Material();
         materials_[0] = material;
-        if (!material->loadShader("shader/light_pixel.shader"))
+        if (!material->loadShader("shader/light_instanced.shader"))
         {
             return false;
         }
 
         material = new Material();
         materials_[1] = material;
+        if (!material->loadShader("shader/light_pixel.shader"))
+        {
+            return false;
+        }
+
+        material = new Material();
+        materials_[2] = material;
         if (!material->loadShader("shader/light_vertex.shader"))
         {
             return false;
@@ -533,15 +163,17 @@ public:
 
     void onTick(float elapse) override
     {
-        camera_.handleCameraMove();
-        if (!traceMgr_.isFinished())
+        // ģʽ£ƶ¿ʼ׷٣ΪʵʱԤ
+        if (camera_.handleCameraMove() && bShowRayTrace_ && traceMgr_.progressive_)
         {
-            int step = winWidth_;
-            for (int i = 0; i < step; ++i)
-            {
-                traceMgr_.tick();
-            }
-            savePixelToTexture();
+            doRayTracing();
+        }
+
+        // 黹׷ٵʱ򣬾ͿϴѾɵ
+        traceMgr_.popFinishedTiles(finishedTiles_);
+        for (const TraceTile &tile : finishedTiles_)
+        {
+            savePixelToTexture(tile);
         }
     }
 
@@ -571,7 +203,12 @@ public:
         lightDir.normalize();
         material->bindUniform("lightDir", lightDir);
 
+        renderer->setOverwriteMaterial(material);
+        renderer->setRenderQueue(&renderQueue_);
         objects_->draw(renderer);
+        renderer->setRenderQueue(nullptr);
+        renderQueue_.flush(renderer);
+        renderer->setOverwriteMaterial(nullptr);
     }
 
     void drawPick(Renderer *renderer)
@@ -587,12 +224,12 @@ public:
         {
             MeshInfoPtr mesh = traceMgr_.meshs_[info.meshIndex_];
 
-            MeshInfo::Face &f = mesh->faces_[info.face_];
+            const TriangleBuffer &triangles = mesh->triangles_;
 
             DebugDraw::instance()->drawFilledTriangle(
-                mesh->vertices_[f.i[0]],
-                mesh->vertices_[f.i[1]],
-                mesh->vertices_[f.i[2]],
+                triangles.getVertex(info.face_, 0),
+                triangles.getVertex(info.face_, 1),
+                triangles.getVertex(info.face_, 2),
                 Color::Red,
                 Matrix::Identity);
         }
@@ -602,7 +239,7 @@ public:
 
     void drawScreenTexture(Renderer *renderer)
     {
-        glDisable(GL_DEPTH_TEST);
+        GLStateCache::instance()->disable(GL_DEPTH_TEST);
         renderer->setViewMatrix(Matrix::Identity);
         renderer->setProjMatrix(Matrix::Identity);
 
@@ -613,7 +250,7 @@ public:
         quadMaterial_->bindShader();
         quadMesh_->draw(renderer);
 
-        glEnable(GL_DEPTH_TEST);
+        GLStateCache::instance()->enable(GL_DEPTH_TEST);
     }
 
     void onSizeChange(int width, int height) override
@@ -669,7 +306,7 @@ public:
             switch (key)
             {
             case GLFW_KEY_M:
-                materialIndex_ = (materialIndex_ + 1) % 2;
+                materialIndex_ = (materialIndex_ + 1) % 3;
                 break;
 
             case GLFW_KEY_SPACE:
@@ -679,6 +316,13 @@ public:
             case GLFW_KEY_R:
                 bShowRayTrace_ = !bShowRayTrace_;
                 break;
+
+            case GLFW_KEY_P:
+                traceMgr_.cancelTrace();
+                traceMgr_.progressive_ = !traceMgr_.progressive_;
+                LOG_DEBUG("progressive mode: %d", traceMgr_.progressive_);
+                doRayTracing();
+                break;
             }
         }
     }
@@ -691,25 +335,27 @@ public:
     void doRayTracing()
     {
         LOG_DEBUG("start ray tracing...");
-        traceMgr_.initTrace(winWidth_, winHeight_, &camera_);
+        TraceCamera camera;
+        camera.init(camera_.getLocalToWorldMatrix(), camera_.getFov(), camera_.getAspect(), camera_.getZNear());
+        traceMgr_.initTrace(winWidth_, winHeight_, camera);
+
+        // һ׷ٵĽ߳Ѿʼдpixels_ϴ
+        TraceTile tile = { 0, 0, winWidth_, winHeight_ };
+        tile.pixels.assign(winWidth_ * winHeight_ * 4, 0);
+        savePixelToTexture(tile);
 
         bShowRayTrace_ = true;
     }
 
-    void savePixelToTexture()
+    /** صĸϴС*/
+    void savePixelToTexture(const TraceTile &tile)
     {
         texture_->bind();
-        
-        int oldAlignment;
-        glGetIntegerv(GL_PACK_ALIGNMENT, &oldAlignment);
-        glPixelStorei(GL_PACK_ALIGNMENT, 1);
-        
+
         GLenum format = (GLenum)TextureFormat::RGBA;
-        
-        GL_ASSERT(glTexImage2D(GL_TEXTURE_2D, 0, format, winWidth_, winHeight_,
-                               0, format, GL_UNSIGNED_BYTE, traceMgr_.pixels_.data()));
-        
-        glPixelStorei(GL_PACK_ALIGNMENT, oldAlignment);
+
+        GL_ASSERT(glTexSubImage2D(GL_TEXTURE_2D, 0, tile.x, tile.y, tile.width, tile.height,
+                                  format, GL_UNSIGNED_BYTE, tile.pixels.data()));
     }
 
 private:
@@ -718,7 +364,8 @@ private:
 	Vector2         lastCursorPos_;
 
     int             materialIndex_ = 0;
-    MaterialPtr     materials_[2];
+    MaterialPtr     materials_[3];
+    RenderQueue     renderQueue_;
 
     TransformPtr    objects_;
     
@@ -733,6 +380,7 @@ private:
     int             winWidth_;
     int             winHeight_;
     TraceManager    traceMgr_;
+    std::vector<TraceTile> finishedTiles_;
     bool            bShowRayTrace_ = false;
 };
 
@@ -0,0 +1,4 @@
+{
+	"vertexShader" : "light_instanced.vsh",
+	"fragmentShader" : "light_instanced.fsh"
+}
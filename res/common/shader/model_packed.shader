@@ -0,0 +1,4 @@
+{
+	"vertexShader" : "model_packed.vsh",
+	"fragmentShader" : "light_pixel.fsh"
+}
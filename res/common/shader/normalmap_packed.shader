@@ -0,0 +1,4 @@
+{
+	"vertexShader" : "normalmap_packed.vsh",
+	"fragmentShader" : "normalmap.fsh"
+}